@@ -261,6 +261,36 @@ int mbedtls_aes_crypt_ecb( mbedtls_aes_context *ctx,
                     const unsigned char input[16],
                     unsigned char output[16] );
 
+/**
+ * \brief          This function performs an AES-ECB encryption or decryption
+ *                 operation on several blocks.
+ *
+ *                 It gives the same result as calling mbedtls_aes_crypt_ecb()
+ *                 on each block in turn, but lets AES-NI or the Armv8-A
+ *                 Cryptographic Extension work on several blocks in parallel.
+ *
+ * \param ctx      The AES context to use for encryption or decryption.
+ *                 It must be initialized and bound to a key.
+ * \param mode     The AES operation: #MBEDTLS_AES_ENCRYPT or
+ *                 #MBEDTLS_AES_DECRYPT.
+ * \param length   The length of the input data in Bytes. This must be a
+ *                 multiple of the block size (\c 16 Bytes).
+ * \param input    The buffer holding the input data.
+ *                 It must be readable and of size \p length Bytes.
+ * \param output   The buffer where the output data will be written.
+ *                 It must be writeable and of size \p length Bytes.
+ *                 It may be the same buffer as \p input.
+ *
+ * \return         \c 0 on success.
+ * \return         #MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH
+ *                 on invalid input length.
+ */
+int mbedtls_aes_crypt_ecb_blocks( mbedtls_aes_context *ctx,
+                                  int mode,
+                                  size_t length,
+                                  const unsigned char *input,
+                                  unsigned char *output );
+
 #if defined(MBEDTLS_CIPHER_MODE_CBC)
 /**
  * \brief  This function performs an AES-CBC encryption or decryption operation
@@ -0,0 +1,111 @@
+/**
+ * \file aesce.h
+ *
+ * \brief Support hardware AES acceleration on Armv8-A processors with
+ *        the Armv8-A Cryptographic Extension.
+ *
+ * \warning These functions are only for internal use by other library
+ *          functions; you must not call them directly.
+ */
+/*
+ *  Copyright The Mbed TLS Contributors
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Backported from Mbed TLS 3.x for XBee Host C Library.  Uses the round
+// keys from the table-based key schedule in aes.c, which are already in
+// the byte order and (for decryption) equivalent-inverse-cipher form the
+// AESE/AESD instructions expect; adds multi-block ECB and CTR routines.
+
+#ifndef MBEDTLS_AESCE_H
+#define MBEDTLS_AESCE_H
+
+#include "mbedtls/aes.h"
+
+#if defined(__aarch64__) && defined(__GNUC__) && \
+    ! defined(__ARM_BIG_ENDIAN) && \
+    ( defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES) || \
+      ! defined(__clang__) )
+#define MBEDTLS_AESCE_HAVE_CODE
+#endif
+
+#if defined(MBEDTLS_AESCE_HAVE_CODE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Internal function to detect the crypto extension in CPUs.
+ *
+ * \return         1 if CPU has support for the feature, 0 otherwise
+ */
+int mbedtls_aesce_has_support( void );
+
+/**
+ * \brief          Internal AES-ECB block encryption and decryption
+ *
+ * \param ctx      AES context
+ * \param mode     MBEDTLS_AES_ENCRYPT or MBEDTLS_AES_DECRYPT
+ * \param input    16-byte input block
+ * \param output   16-byte output block
+ *
+ * \return         0 on success (cannot fail)
+ */
+int mbedtls_aesce_crypt_ecb( mbedtls_aes_context *ctx,
+                             int mode,
+                             const unsigned char input[16],
+                             unsigned char output[16] );
+
+/**
+ * \brief          Internal AES-ECB encryption and decryption of several
+ *                 blocks, four at a time so the AES units stay busy
+ *
+ * \param ctx      AES context
+ * \param mode     MBEDTLS_AES_ENCRYPT or MBEDTLS_AES_DECRYPT
+ * \param blocks   number of 16-byte blocks
+ * \param input    \p blocks * 16 bytes of input
+ * \param output   \p blocks * 16 bytes of output (may equal \p input)
+ */
+void mbedtls_aesce_crypt_ecb_blocks( mbedtls_aes_context *ctx,
+                                     int mode,
+                                     size_t blocks,
+                                     const unsigned char *input,
+                                     unsigned char *output );
+
+/**
+ * \brief          Internal AES-CTR encryption and decryption of whole
+ *                 blocks, four at a time
+ *
+ * \param ctx      AES context (encryption key schedule)
+ * \param blocks   number of 16-byte blocks
+ * \param nonce_counter  128-bit big-endian counter for the first block;
+ *                 advanced by \p blocks
+ * \param input    \p blocks * 16 bytes of input
+ * \param output   \p blocks * 16 bytes of output (may equal \p input)
+ */
+void mbedtls_aesce_crypt_ctr_blocks( mbedtls_aes_context *ctx,
+                                     size_t blocks,
+                                     unsigned char nonce_counter[16],
+                                     const unsigned char *input,
+                                     unsigned char *output );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MBEDTLS_AESCE_HAVE_CODE */
+
+#endif /* MBEDTLS_AESCE_H */
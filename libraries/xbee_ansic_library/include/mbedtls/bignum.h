@@ -21,6 +21,10 @@
  *
  *  This file is part of mbed TLS (https://tls.mbed.org)
  */
+
+// Modified for XBee Host C Library: fixed-base comb exponentiation
+// (mbedtls_mpi_comb and MBEDTLS_MPI_COMB_TEETH).
+
 #ifndef MBEDTLS_BIGNUM_H
 #define MBEDTLS_BIGNUM_H
 
@@ -71,6 +75,16 @@
 #define MBEDTLS_MPI_WINDOW_SIZE                           6        /**< Maximum windows size used. */
 #endif /* !MBEDTLS_MPI_WINDOW_SIZE */
 
+#if !defined(MBEDTLS_MPI_COMB_TEETH)
+/*
+ * Bits of exponent per table lookup in mbedtls_mpi_exp_mod_comb(). Default: 6
+ * Minimum value: 1. Maximum value: 8.
+ *
+ * Each comb holds ( 1 << MBEDTLS_MPI_COMB_TEETH ) MPIs. (So 64 by default)
+ */
+#define MBEDTLS_MPI_COMB_TEETH                            6        /**< Comb width. */
+#endif /* !MBEDTLS_MPI_COMB_TEETH */
+
 #if !defined(MBEDTLS_MPI_MAX_SIZE)
 /*
  * Maximum size of MPIs allowed in bits and bytes for user-MPIs.
@@ -834,6 +848,80 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A,
                          const mbedtls_mpi *E, const mbedtls_mpi *N,
                          mbedtls_mpi *_RR );
 
+/**
+ * \brief          Fixed-base comb for repeated exponentiations G^E mod N
+ *                 with the same \c G and \c N.
+ *
+ *                 The table holds ( 1 << MBEDTLS_MPI_COMB_TEETH ) MPIs of
+ *                 the size of \c N.
+ */
+typedef struct mbedtls_mpi_comb
+{
+    mbedtls_mpi G;              /*!<  base, reduced mod N               */
+    mbedtls_mpi N;              /*!<  modulus                           */
+    mbedtls_mpi RR;             /*!<  R^2 mod N                         */
+    mbedtls_mpi_uint mm;        /*!<  Montgomery constant               */
+    size_t teeth;               /*!<  bits of E per table lookup        */
+    size_t spacing;             /*!<  distance between those bits       */
+    mbedtls_mpi *T;             /*!<  table, in Montgomery form         */
+}
+mbedtls_mpi_comb;
+
+/**
+ * \brief          Initialize a comb context.
+ *
+ * \param comb     The comb context to initialize. This must not be \c NULL.
+ */
+void mbedtls_mpi_comb_init( mbedtls_mpi_comb *comb );
+
+/**
+ * \brief          Free the table and values held by a comb context.
+ *
+ * \param comb     The comb context to free. This may be \c NULL, in which
+ *                 case this function is a no-op.
+ */
+void mbedtls_mpi_comb_free( mbedtls_mpi_comb *comb );
+
+/**
+ * \brief          Precompute the comb for exponentiations of \p G mod \p N.
+ *
+ * \param comb     The comb context. This must be initialized; anything it
+ *                 already holds is freed.
+ * \param G        The base of the exponentiations.
+ * \param N        The modulus.
+ * \param max_bits The largest exponent, in bits, that takes the comb.
+ *                 mbedtls_mpi_exp_mod_comb() falls back to
+ *                 mbedtls_mpi_exp_mod() for wider exponents.
+ *
+ * \return         \c 0 if successful.
+ * \return         #MBEDTLS_ERR_MPI_ALLOC_FAILED if a memory allocation failed.
+ * \return         #MBEDTLS_ERR_MPI_BAD_INPUT_DATA if \c N is negative or
+ *                 even, or if \p max_bits is \c 0.
+ */
+int mbedtls_mpi_comb_setup( mbedtls_mpi_comb *comb, const mbedtls_mpi *G,
+                            const mbedtls_mpi *N, size_t max_bits );
+
+/**
+ * \brief          Perform a fixed-base comb exponentiation: X = G^E mod N,
+ *                 for the \c G and \c N given to mbedtls_mpi_comb_setup().
+ *
+ *                 Takes one squaring and one multiplication per
+ *                 \c max_bits / MBEDTLS_MPI_COMB_TEETH bits of exponent,
+ *                 and reads the whole table for each lookup so the
+ *                 access pattern doesn't depend on \p E.
+ *
+ * \param X        The destination MPI. This must point to an initialized MPI.
+ * \param comb     The comb set up for \c G and \c N.
+ * \param E        The exponent MPI. This must point to an initialized MPI.
+ *
+ * \return         \c 0 if successful.
+ * \return         #MBEDTLS_ERR_MPI_ALLOC_FAILED if a memory allocation failed.
+ * \return         #MBEDTLS_ERR_MPI_BAD_INPUT_DATA if \p comb isn't set up,
+ *                 or if \c E is negative.
+ */
+int mbedtls_mpi_exp_mod_comb( mbedtls_mpi *X, const mbedtls_mpi_comb *comb,
+                              const mbedtls_mpi *E );
+
 /**
  * \brief          Fill an MPI with a number of random bytes.
  *
@@ -32,11 +32,37 @@
 #define MBEDTLS_ENTROPY_C
 #define MBEDTLS_SHA256_C
 
+// Hardware AES where the CPU has it (checked at run time): AES-NI on x86,
+// the Cryptographic Extension on Armv8-A.  Ignored on other targets.
+#define MBEDTLS_AESNI_C
+#define MBEDTLS_AESCE_C
+
+// Hardware SHA-256 where the CPU has it (checked at run time): the SHA
+// extensions on x86, the Cryptographic Extension on Armv8-A.
+#define MBEDTLS_SHA256_USE_SHA_NI_IF_PRESENT
+#define MBEDTLS_SHA256_USE_ARMV8_A_CRYPTO_IF_PRESENT
+
+// mbedtls_aes_crypt_ctr(), for encrypting application data
+#define MBEDTLS_CIPHER_MODE_CTR
+
+// Inline assembly for the MPI multiply loops (bn_mul.h) on 64-bit hosts
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+#define MBEDTLS_HAVE_ASM
+#endif
+
 // Save RAM by adjusting to our exact needs
 #define MBEDTLS_MPI_MAX_SIZE            32 // 384 bits is 48 bytes
 
-// Reduce stack usage in mbedtls_mpi_exp_mod() by reducing the MPI window size.
+// Reduce stack usage in mbedtls_mpi_exp_mod() by reducing the MPI window size,
+// except on 64-bit hosts where the larger window makes SRP handshakes faster.
+// Define MBEDTLS_MPI_WINDOW_SIZE (1 to 6) before this file to override.
+#if !defined(MBEDTLS_MPI_WINDOW_SIZE)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__)
+#define MBEDTLS_MPI_WINDOW_SIZE         5
+#else
 #define MBEDTLS_MPI_WINDOW_SIZE         3
+#endif
+#endif
 
 #include "mbedtls/check_config.h"
 
@@ -243,6 +243,34 @@ int mbedtls_sha256_ret( const unsigned char *input,
                         unsigned char output[32],
                         int is224 );
 
+/**
+ * \brief          This function calculates the SHA-224 or SHA-256 checksums
+ *                 of several independent buffers.
+ *
+ *                 Without SHA-256 instructions, the messages are hashed
+ *                 together in the 4 or 8 lanes of the CPU's vector unit,
+ *                 which is several times faster than hashing them one at
+ *                 a time.  The results are the same as calling
+ *                 mbedtls_sha256_ret() for each buffer.
+ *
+ * \param input    The buffers holding the data. \c input[i] must be a
+ *                 readable buffer of length \c ilen[i] Bytes.
+ * \param ilen     The lengths of the buffers in Bytes.
+ * \param output   The checksum results. \c output[i] must be a writable
+ *                 buffer of length \c 32 Bytes.
+ * \param count    The number of buffers.
+ * \param is224    Determines which function to use. This must be
+ *                 either \c 0 for SHA-256, or \c 1 for SHA-224.
+ *
+ * \return         \c 0 on success.
+ * \return         A negative error code on failure.
+ */
+int mbedtls_sha256_ret_multi( const unsigned char * const input[],
+                              const size_t ilen[],
+                              unsigned char * const output[],
+                              size_t count,
+                              int is224 );
+
 #if !defined(MBEDTLS_DEPRECATED_REMOVED)
 #if defined(MBEDTLS_DEPRECATED_WARNING)
 #define MBEDTLS_DEPRECATED      __attribute__((deprecated))
@@ -25,3 +25,11 @@ uint16_t crc16buypass_bit(uint16_t crc, void const *mem, size_t len);
 
 // Compute the CRC a byte at a time.
 uint16_t crc16buypass_byte(uint16_t crc, void const *mem, size_t len);
+
+// Compute the CRC eight bytes at a time (slicing-by-8), or 64 bytes at a time
+// with carry-less multiplies on CPUs that have them.
+uint16_t crc16buypass_word(uint16_t crc, void const *mem, size_t len);
+
+// Compute the CRC of the first bits bits (most significant first) of the byte
+// val, applied to the previous CRC value, crc.
+uint16_t crc16buypass_rem(uint16_t crc, unsigned val, unsigned bits);
@@ -0,0 +1,55 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_xmodem
+   @{
+   @file util/crc16fold.h
+   Carry-less multiply (PCLMULQDQ on x86, PMULL on AArch64) kernel shared by
+   the non-reflected CRC-16 routines.  Only built where the compiler can
+   target those instructions; callers check crc16_fold_available() at run
+   time and fall back to their tables otherwise.
+*/
+
+#ifndef UTIL_CRC16FOLD_H
+#define UTIL_CRC16FOLD_H
+
+#include "xbee/platform.h"
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+   #define CRC16_FOLD
+#elif defined __GNUC__ && defined __aarch64__ && defined __linux__ \
+   && defined __ARM_FEATURE_CRYPTO
+   #define CRC16_FOLD
+#endif
+
+/// Shortest buffer worth folding; shorter ones go straight to the tables.
+#define CRC16_FOLD_MIN     64
+
+XBEE_BEGIN_DECLS
+
+/// Constants for one polynomial P, each x^n mod P.
+typedef struct crc16_fold_t {
+   uint16_t    k576;       ///< x^576 mod P (fold 64 bytes, high half)
+   uint16_t    k512;       ///< x^512 mod P (fold 64 bytes, low half)
+   uint16_t    k192;       ///< x^192 mod P (fold 16 bytes, high half)
+   uint16_t    k128;       ///< x^128 mod P (fold 16 bytes, low half)
+   /// table-driven CRC used for the final reduction and trailing bytes
+   uint16_t    (*table)( uint16_t crc, const void *mem, size_t len);
+} crc16_fold_t;
+
+#ifdef CRC16_FOLD
+// documented in crc16fold.c
+bool_t crc16_fold_available( void);
+uint16_t crc16_fold( uint16_t crc, const void *mem, size_t len,
+   const crc16_fold_t *fold);
+#endif
+
+XBEE_END_DECLS
+
+#endif      // UTIL_CRC16FOLD_H
+
+///@}
@@ -69,6 +69,13 @@
 struct SRPVerifier;
 struct SRPUser;
 
+/* Precompute the group's exponentiation tables (about as much work as one
+ * exponentiation).  The first call to any SRP function does this if it hasn't
+ * been done; call it at startup if several threads may start handshakes at
+ * the same time.  Returns 0 on success or an Mbed TLS error code.
+ */
+int srp_group_init( void );
+
 /* Out: bytes_s, len_s, bytes_v, len_v
  *
  * The caller is responsible for freeing the memory allocated for bytes_s and bytes_v
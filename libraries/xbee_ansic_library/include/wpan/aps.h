@@ -376,6 +376,54 @@ typedef int (*wpan_tick_fn)( struct wpan_dev_t *dev);
 typedef const wpan_endpoint_table_entry_t *(*wpan_endpoint_get_next_fn)(
    struct wpan_dev_t *dev, const wpan_endpoint_table_entry_t *ep);
 
+#ifndef WPAN_APS_INDEX_SLOTS
+   /// Number of slots in the cluster hash of the lookup index built by
+   /// wpan_aps_index_build(), which holds up to 7/8 that many (endpoint,
+   /// cluster) pairs.  Must be a power of two, no larger than 256.
+   /// Define as 0 to leave the index out of wpan_dev_t and save about 400
+   /// bytes of RAM per device.
+   #define WPAN_APS_INDEX_SLOTS   32
+#endif
+#if WPAN_APS_INDEX_SLOTS < 0 || WPAN_APS_INDEX_SLOTS > 256 \
+   || (WPAN_APS_INDEX_SLOTS & (WPAN_APS_INDEX_SLOTS - 1))
+   // the lookup masks hashes with WPAN_APS_INDEX_SLOTS - 1
+   #error "WPAN_APS_INDEX_SLOTS must be 0 or a power of two, up to 256"
+#endif
+
+#if WPAN_APS_INDEX_SLOTS
+/// One (endpoint, cluster) pair in a wpan_aps_index_t.
+typedef struct wpan_aps_index_slot_t {
+   uint16_t    cluster_id;    ///< cluster ID of this entry
+   uint8_t     ep_pos;        ///< position of endpoint in endpoint table
+   /// 1 + position of cluster in the endpoint's cluster table (0 = unused)
+   uint8_t     clust_pos;
+} wpan_aps_index_slot_t;
+
+/**
+   Lookup index over a device's endpoint table, so dispatching a received
+   frame doesn't have to walk the endpoint and cluster tables.  Built by
+   wpan_aps_index_build() and only used while \c table matches the
+   device's endpoint table.
+*/
+typedef struct wpan_aps_index_t {
+   /// endpoint table the index was built from (NULL = not built)
+   const wpan_endpoint_table_entry_t   *table;
+
+   /// hash seed for \c cluster, 0 if clusters aren't indexed
+   uint32_t                            seed;
+
+   /// for each endpoint number, 1 + position of its first entry in
+   /// \c table (0 = no entry)
+   uint8_t                             endpoint[WPAN_ENDPOINT_BROADCAST];
+
+   /// displacement of each bucket of the cluster hash
+   uint8_t                             disp[WPAN_APS_INDEX_SLOTS / 4 + 1];
+
+   /// perfect hash of the (endpoint, cluster) pairs
+   wpan_aps_index_slot_t               cluster[WPAN_APS_INDEX_SLOTS];
+} wpan_aps_index_t;
+#endif
+
 /**
    Structure used by the WPAN/ZigBee layers.  Contains information about the
    node (addresses, payload limit, capabilities) along with an endpoint
@@ -417,6 +465,10 @@ typedef struct wpan_dev_t {
    /// wpan_endpoint_get_next() to walk the table.
    const wpan_endpoint_table_entry_t   *endpoint_table;
 
+#if WPAN_APS_INDEX_SLOTS
+   /// Index over \c endpoint_table, built by wpan_aps_index_build().
+   wpan_aps_index_t                    index;
+#endif
 } wpan_dev_t;
 
 /// Macro to test whether a device has joined the network.
@@ -460,6 +512,8 @@ const wpan_endpoint_table_entry_t *wpan_endpoint_of_cluster( wpan_dev_t *dev,
 //          to cast this value to uint16_t?
 #define WPAN_APS_PROFILE_ANY     0xFFFF
 
+int wpan_aps_index_build( wpan_dev_t *dev);
+
 void wpan_envelope_create( wpan_envelope_t *envelope, wpan_dev_t *dev,
    const addr64 FAR *ieee, uint16_t network_addr);
 
@@ -0,0 +1,681 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_device
+   @{
+   @file xbee/async.hpp
+   Coroutine API for AT commands, transmits and receives (C++20, POSIX).
+
+   Operations on an AsyncDevice are awaitable from an xbee::Task, and an
+   EventLoop drives every device registered with it from a single thread,
+   sleeping in poll() on the serial ports between frames:
+
+   @code
+   xbee::Task<> configure( xbee::AsyncDevice &dev)
+   {
+      xbee::AtResult np = co_await dev.at( "NP");
+      if (np.status == 0)
+      {
+         printf( "max payload %" PRIu32 "\n", np.value);
+      }
+      xbee::SendResult sent = co_await dev.send( xbee::TransmitExplicit(),
+         xbee::as_bytes( payload));
+      std::optional<xbee::Received> rx = co_await dev.receive( 1000);
+   }
+
+   xbee::EventLoop loop;
+   xbee::AsyncDevice dev( loop);
+   dev.open( "/dev/ttyS0", 921600);
+   loop.spawn( configure( dev));
+   loop.run();
+   @endcode
+
+   Each await completes from the event loop (never from inside a frame
+   handler), so a coroutine can start new operations as soon as it
+   resumes.  Tasks must not be destroyed while suspended on an operation;
+   EventLoop::run() returns only after every spawned task has finished.
+*/
+
+#ifndef XBEE_ASYNC_HPP
+#define XBEE_ASYNC_HPP
+
+#if __cplusplus < 202002L || ! __has_include(<coroutine>)
+   #error "xbee/async.hpp requires C++20 coroutines"
+#endif
+
+#include <algorithm>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <vector>
+#include <poll.h>
+
+#include "xbee/wpan.hpp"
+#include "xbee/delivery_status.h"
+
+#ifndef XBEE_ASYNC_RX_QUEUE
+   /// Received frames kept for later receive() calls; oldest are dropped.
+   #define XBEE_ASYNC_RX_QUEUE      16
+#endif
+
+#ifndef XBEE_ASYNC_TX_TIMEOUT_MS
+   /// Milliseconds to wait for a Transmit Status after send().
+   #define XBEE_ASYNC_TX_TIMEOUT_MS 5000
+#endif
+
+#ifndef XBEE_ASYNC_POLL_MS
+   /// Longest the event loop sleeps, so AT command timeouts are noticed.
+   #define XBEE_ASYNC_POLL_MS       100
+#endif
+
+namespace xbee {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+   std::coroutine_handle<> continuation;
+
+   struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+      template <typename Promise>
+      std::coroutine_handle<> await_suspend(
+         std::coroutine_handle<Promise> handle) noexcept
+      {
+         auto continuation = handle.promise().continuation;
+         return continuation ? continuation : std::noop_coroutine();
+      }
+      void await_resume() const noexcept {}
+   };
+
+   std::suspend_always initial_suspend() const noexcept { return {}; }
+   FinalAwaiter final_suspend() const noexcept { return {}; }
+
+   // errors are returned as values; an escaping exception is a bug
+   void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+   std::optional<T> value;
+
+   Task<T> get_return_object() noexcept;
+   void return_value( T result) { value.emplace( std::move( result)); }
+   T take() { return std::move( *value); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+   Task<void> get_return_object() noexcept;
+   void return_void() const noexcept {}
+   void take() const noexcept {}
+};
+
+} // namespace detail
+
+/**
+   Lazily started coroutine returning \a T.  Awaiting a Task starts it and
+   resumes the awaiting coroutine when it finishes; top-level tasks are
+   started with EventLoop::spawn().
+*/
+template <typename T>
+class Task {
+public:
+   using promise_type = detail::Promise<T>;
+   using handle_type = std::coroutine_handle<promise_type>;
+
+   Task() noexcept = default;
+   explicit Task( handle_type handle) noexcept : handle_( handle) {}
+   Task( Task &&other) noexcept : handle_( std::exchange( other.handle_, {})) {}
+   Task &operator=( Task &&other) noexcept
+   {
+      if (this != &other)
+      {
+         reset();
+         handle_ = std::exchange( other.handle_, {});
+      }
+      return *this;
+   }
+   Task( const Task &) = delete;
+   Task &operator=( const Task &) = delete;
+   ~Task() { reset(); }
+
+   bool done() const noexcept { return ! handle_ || handle_.done(); }
+
+   bool await_ready() const noexcept { return done(); }
+   std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<> awaiting) noexcept
+   {
+      handle_.promise().continuation = awaiting;
+      return handle_;
+   }
+   T await_resume() { return handle_.promise().take(); }
+
+private:
+   friend class EventLoop;
+
+   void reset() noexcept
+   {
+      if (handle_)
+      {
+         handle_.destroy();
+         handle_ = {};
+      }
+   }
+
+   handle_type handle_;
+};
+
+namespace detail {
+
+template <typename T>
+inline Task<T> Promise<T>::get_return_object() noexcept
+{
+   return Task<T>( std::coroutine_handle<Promise<T>>::from_promise( *this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept
+{
+   return Task<void>( std::coroutine_handle<Promise<void>>::from_promise( *this));
+}
+
+inline bool deadline_passed( uint32_t deadline) noexcept
+{
+   return static_cast<int32_t>( xbee_millisecond_timer() - deadline) >= 0;
+}
+
+} // namespace detail
+
+/// Result of AsyncDevice::at().
+struct AtResult {
+   /// 0 on success, -ETIMEDOUT without a response, -EIO if the XBee
+   /// returned an error (see \c at_status), or an error from xbee_cmd_*
+   int         status = 0;
+   uint8_t     at_status = 0;       ///< XBEE_AT_RESP_* status byte
+   uint8_t     length = 0;          ///< bytes in \c bytes
+   uint32_t    value = 0;           ///< response if \c length <= 4
+   std::array<uint8_t, XBEE_CMD_MAX_PARAM_LENGTH> bytes{};
+};
+
+/// Result of AsyncDevice::send().
+struct SendResult {
+   /// 0 if delivered, -EIO if delivery failed (see \c delivery),
+   /// -ETIMEDOUT without a Transmit Status, or an error from
+   /// xbee_frame_write()
+   int         status = 0;
+   uint8_t     delivery = 0;        ///< XBEE_TX_DELIVERY_* status
+   uint8_t     retries = 0;
+};
+
+/// Frame returned by AsyncDevice::receive().
+struct Received {
+   addr64               ieee_address;
+   uint16_t             network_address;
+   uint8_t              source_endpoint;
+   uint8_t              dest_endpoint;
+   uint16_t             cluster_id;
+   uint16_t             profile_id;
+   uint8_t              options;     ///< XBEE_RX_OPT_* bits
+   std::vector<uint8_t> payload;
+};
+
+class AsyncDevice;
+
+/**
+   Single-threaded loop driving a set of AsyncDevices.  Coroutines resumed
+   by completed operations run in the order their operations completed.
+*/
+class EventLoop {
+public:
+   EventLoop() = default;
+   EventLoop( const EventLoop &) = delete;
+   EventLoop &operator=( const EventLoop &) = delete;
+
+   /// Queue \a task to start on the next run() iteration.
+   void spawn( Task<> task)
+   {
+      post( task.handle_);
+      tasks_.push_back( std::move( task));
+   }
+
+   /// Queue \a handle to be resumed from the loop.
+   void post( std::coroutine_handle<> handle) { ready_.push_back( handle); }
+
+   /// Run until every spawned task has finished.
+   inline void run();
+
+private:
+   friend class AsyncDevice;
+
+   bool tasks_done() const noexcept
+   {
+      return std::all_of( tasks_.begin(), tasks_.end(),
+         []( const Task<> &task) { return task.done(); });
+   }
+
+   std::vector<Task<>>                 tasks_;
+   std::deque<std::coroutine_handle<>> ready_;
+   std::vector<AsyncDevice *>          devices_;
+};
+
+/**
+   XBee attached to a serial port, with awaitable operations.  Frame
+   handlers reference the AsyncDevice, so it can't be moved or copied.
+*/
+class AsyncDevice {
+public:
+   explicit AsyncDevice( EventLoop &loop) : loop_( loop)
+   {
+      loop_.devices_.push_back( this);
+   }
+   ~AsyncDevice()
+   {
+      auto &devices = loop_.devices_;
+      devices.erase( std::remove( devices.begin(), devices.end(), this),
+         devices.end());
+   }
+   AsyncDevice( const AsyncDevice &) = delete;
+   AsyncDevice &operator=( const AsyncDevice &) = delete;
+
+   /// Open the serial port and enable the AT command layer.
+   int open( const char *port, uint32_t baudrate)
+   {
+      handlers_ = {{
+         { XBEE_FRAME_TRANSMIT_STATUS, 0, &AsyncDevice::tx_status_handler, this },
+         { XBEE_FRAME_RECEIVE_EXPLICIT, 0, &AsyncDevice::receive_handler, this },
+         XBEE_FRAME_HANDLE_LOCAL_AT,
+         XBEE_FRAME_HANDLE_REMOTE_AT,
+         XBEE_FRAME_TABLE_END
+      }};
+
+      int error = device_.open( port, baudrate, handlers_.data());
+      if (error == 0)
+      {
+         error = device_.init_at();
+      }
+      return error;
+   }
+
+   Device &device() noexcept { return device_; }
+   xbee_dev_t *get() noexcept { return device_.get(); }
+
+   /// Awaitable for at(); resumes with an AtResult.
+   class AtOperation {
+   public:
+      bool await_ready() const noexcept { return false; }
+
+      bool await_suspend( std::coroutine_handle<> waiter)
+      {
+         int16_t handle;
+         int error;
+
+         waiter_ = waiter;
+         handle = xbee_cmd_create( dev_.get(), command_);
+         if (handle < 0)
+         {
+            result_.status = handle;
+            return false;
+         }
+         error = xbee_cmd_set_callback( handle, &AtOperation::callback, this);
+         if (! error && param_)
+         {
+            error = xbee_cmd_set_param( handle, *param_);
+         }
+         if (! error)
+         {
+            error = xbee_cmd_send( handle);
+         }
+         if (error)
+         {
+            xbee_cmd_release_handle( handle);
+            result_.status = error;
+            return false;
+         }
+         return true;
+      }
+
+      AtResult await_resume() noexcept { return result_; }
+
+   private:
+      friend class AsyncDevice;
+
+      AtOperation( AsyncDevice &dev, const char *command,
+         std::optional<uint32_t> param) noexcept
+         : dev_( dev), command_( command), param_( param) {}
+
+      static int callback( const xbee_cmd_response_t FAR *response)
+      {
+         auto *self = static_cast<AtOperation *>( response->context);
+         AtResult &result = self->result_;
+
+         if (response->flags & XBEE_CMD_RESP_FLAG_TIMEOUT)
+         {
+            result.status = -ETIMEDOUT;
+         }
+         else
+         {
+            result.at_status =
+               static_cast<uint8_t>( response->flags & XBEE_CMD_RESP_MASK_STATUS);
+            result.status = result.at_status == XBEE_AT_RESP_SUCCESS ? 0 : -EIO;
+            result.length = static_cast<uint8_t>( std::min<std::size_t>(
+               response->value_length, result.bytes.size()));
+            std::copy_n( response->value_bytes, result.length,
+               result.bytes.begin());
+            result.value = response->value;
+         }
+         self->dev_.loop_.post( self->waiter_);
+         return XBEE_ATCMD_DONE;
+      }
+
+      AsyncDevice                &dev_;
+      const char                 *command_;
+      std::optional<uint32_t>    param_;
+      std::coroutine_handle<>    waiter_;
+      AtResult                   result_;
+   };
+
+   /// Awaitable for send(); resumes with a SendResult.
+   class SendOperation {
+   public:
+      bool await_ready() const noexcept { return false; }
+
+      bool await_suspend( std::coroutine_handle<> waiter)
+      {
+         waiter_ = waiter;
+         header_.frame_id = dev_.device_.next_frame_id();
+         int error = dev_.device_.send( header_, payload_);
+         if (error < 0)
+         {
+            result_.status = error;
+            return false;
+         }
+         deadline_ = xbee_millisecond_timer() + XBEE_ASYNC_TX_TIMEOUT_MS;
+         dev_.sending_.push_back( this);
+         return true;
+      }
+
+      SendResult await_resume() noexcept { return result_; }
+
+   private:
+      friend class AsyncDevice;
+
+      bool expires() const noexcept { return true; }
+
+      SendOperation( AsyncDevice &dev, const TransmitExplicit &header,
+         span<const uint8_t> payload) noexcept
+         : dev_( dev), header_( header), payload_( payload) {}
+
+      AsyncDevice                &dev_;
+      TransmitExplicit           header_;
+      span<const uint8_t>        payload_;
+      uint32_t                   deadline_ = 0;
+      std::coroutine_handle<>    waiter_;
+      SendResult                 result_;
+   };
+
+   /// Awaitable for receive(); resumes with the next frame, or
+   /// std::nullopt on timeout.
+   class ReceiveOperation {
+   public:
+      bool await_ready() noexcept
+      {
+         if (dev_.received_.empty())
+         {
+            return false;
+         }
+         result_ = std::move( dev_.received_.front());
+         dev_.received_.pop_front();
+         return true;
+      }
+
+      void await_suspend( std::coroutine_handle<> waiter)
+      {
+         waiter_ = waiter;
+         deadline_ = xbee_millisecond_timer() + timeout_ms_;
+         dev_.receiving_.push_back( this);
+      }
+
+      std::optional<Received> await_resume() noexcept
+      {
+         return std::move( result_);
+      }
+
+   private:
+      friend class AsyncDevice;
+
+      bool expires() const noexcept { return timeout_ms_ != 0; }
+
+      ReceiveOperation( AsyncDevice &dev, uint32_t timeout_ms) noexcept
+         : dev_( dev), timeout_ms_( timeout_ms) {}
+
+      AsyncDevice                &dev_;
+      uint32_t                   timeout_ms_;
+      uint32_t                   deadline_ = 0;
+      std::coroutine_handle<>    waiter_;
+      std::optional<Received>    result_;
+   };
+
+   /// Read AT register \a command (e.g., "NP") from the local XBee.
+   AtOperation at( const char *command) noexcept
+   {
+      return AtOperation( *this, command, std::nullopt);
+   }
+
+   /// Set AT register \a command to \a value on the local XBee.
+   AtOperation at( const char *command, uint32_t value) noexcept
+   {
+      return AtOperation( *this, command, value);
+   }
+
+   /// Send \a payload with \a header, completing on the Transmit Status.
+   /// The payload must stay valid until the send is awaited.
+   SendOperation send( const TransmitExplicit &header,
+      span<const uint8_t> payload) noexcept
+   {
+      return SendOperation( *this, header, payload);
+   }
+
+   /// Send the payload in \a envelope (addressing, endpoints, cluster and
+   /// profile), completing on the Transmit Status.
+   SendOperation send( const wpan_envelope_t &envelope) noexcept
+   {
+      TransmitExplicit header;
+      header.dest( envelope.ieee_address, envelope.network_address)
+         .endpoints( envelope.source_endpoint, envelope.dest_endpoint)
+         .cluster( envelope.cluster_id)
+         .profile( envelope.profile_id);
+      return SendOperation( *this, header, span<const uint8_t>(
+         static_cast<const uint8_t *>( envelope.payload), envelope.length));
+   }
+
+   /// Wait for the next Explicit Receive frame, for up to \a timeout_ms
+   /// milliseconds (0 to wait forever).
+   ReceiveOperation receive( uint32_t timeout_ms = 0) noexcept
+   {
+      return ReceiveOperation( *this, timeout_ms);
+   }
+
+private:
+   friend class EventLoop;
+
+   static int tx_status_handler( xbee_dev_t *xbee, const void FAR *raw,
+      uint16_t length, void FAR *context)
+   {
+      auto *self = static_cast<AsyncDevice *>( context);
+      const auto *frame = static_cast<const xbee_frame_transmit_status_t FAR *>( raw);
+
+      XBEE_UNUSED_PARAMETER( xbee);
+      if (length < sizeof *frame)
+      {
+         return -EINVAL;
+      }
+
+      auto &sending = self->sending_;
+      auto op = std::find_if( sending.begin(), sending.end(),
+         [frame]( const SendOperation *send) {
+            return send->header_.frame_id == frame->frame_id;
+         });
+      if (op != sending.end())
+      {
+         SendOperation *send = *op;
+         sending.erase( op);
+         send->result_.delivery = frame->delivery;
+         send->result_.retries = frame->retries;
+         send->result_.status =
+            frame->delivery == XBEE_TX_DELIVERY_SUCCESS ? 0 : -EIO;
+         self->loop_.post( send->waiter_);
+      }
+      return 0;
+   }
+
+   static int receive_handler( xbee_dev_t *xbee, const void FAR *raw,
+      uint16_t length, void FAR *context)
+   {
+      constexpr std::size_t header_size =
+         frame_traits<xbee_frame_receive_explicit_t>::header_size;
+      auto *self = static_cast<AsyncDevice *>( context);
+      const auto *frame = static_cast<const xbee_frame_receive_explicit_t FAR *>( raw);
+      const auto *payload = static_cast<const uint8_t FAR *>( raw) + header_size;
+
+      XBEE_UNUSED_PARAMETER( xbee);
+      if (length < header_size)
+      {
+         return -EINVAL;
+      }
+
+      Received rx{ frame->ieee_address, be16( frame->network_address_be),
+         frame->source_endpoint, frame->dest_endpoint,
+         be16( frame->cluster_id_be), be16( frame->profile_id_be),
+         frame->options,
+         std::vector<uint8_t>( payload, payload + (length - header_size)) };
+
+      if (! self->receiving_.empty())
+      {
+         ReceiveOperation *receive = self->receiving_.front();
+         self->receiving_.pop_front();
+         receive->result_ = std::move( rx);
+         self->loop_.post( receive->waiter_);
+      }
+      else
+      {
+         if (self->received_.size() >= XBEE_ASYNC_RX_QUEUE)
+         {
+            self->received_.pop_front();
+         }
+         self->received_.push_back( std::move( rx));
+      }
+      return 0;
+   }
+
+   /// Process frames and expire operations; returns ms until the next
+   /// deadline (capped at XBEE_ASYNC_POLL_MS).
+   int service()
+   {
+      uint32_t wait = XBEE_ASYNC_POLL_MS;
+      uint32_t now;
+
+      if (! device_)
+      {
+         return static_cast<int>( wait);
+      }
+
+      while (device_.tick() > 0)
+      {
+         // keep reading while frames are waiting
+      }
+      xbee_cmd_tick();
+
+      now = xbee_millisecond_timer();
+      auto expire = [&]( auto &ops, auto on_timeout) {
+         for (auto op = ops.begin(); op != ops.end(); )
+         {
+            if (! (*op)->expires())
+            {
+               ++op;
+            }
+            else if (detail::deadline_passed( (*op)->deadline_))
+            {
+               on_timeout( *op);
+               loop_.post( (*op)->waiter_);
+               op = ops.erase( op);
+            }
+            else
+            {
+               wait = std::min( wait, (*op)->deadline_ - now);
+               ++op;
+            }
+         }
+      };
+      expire( sending_, []( SendOperation *op) {
+         op->result_.status = -ETIMEDOUT;
+      });
+      expire( receiving_, []( ReceiveOperation *) {
+         // resumes with std::nullopt
+      });
+
+      return static_cast<int>( wait);
+   }
+
+   int fd() const noexcept
+   {
+      return device_ ? device_.get()->serport.fd : -1;
+   }
+
+   EventLoop                              &loop_;
+   Device                                 device_;
+   std::array<xbee_dispatch_table_entry_t, 6> handlers_{};
+   std::deque<SendOperation *>            sending_;
+   std::deque<ReceiveOperation *>         receiving_;
+   std::deque<Received>                   received_;
+};
+
+inline void EventLoop::run()
+{
+   std::vector<struct pollfd> fds;
+
+   for (;;)
+   {
+      while (! ready_.empty())
+      {
+         std::coroutine_handle<> handle = ready_.front();
+         ready_.pop_front();
+         handle.resume();
+      }
+      if (tasks_done())
+      {
+         break;
+      }
+
+      // read frames and expire operations, then sleep until the next
+      // deadline unless that resumed a coroutine
+      int timeout = XBEE_ASYNC_POLL_MS;
+      fds.clear();
+      for (AsyncDevice *dev : devices_)
+      {
+         timeout = std::min( timeout, dev->service());
+         if (dev->fd() >= 0)
+         {
+            fds.push_back( { dev->fd(), POLLIN, 0 });
+         }
+      }
+      if (ready_.empty())
+      {
+         ::poll( fds.data(), fds.size(), timeout);
+      }
+   }
+
+   tasks_.clear();
+}
+
+} // namespace xbee
+
+#endif
+
+///@}
@@ -25,11 +25,18 @@
 XBEE_BEGIN_DECLS
 
 #ifndef XBEE_CMD_REQUEST_TABLESIZE
-   /// Maximum number of outstanding requests.  Two should be sufficient in
-   /// most (all?) cases.  One might even be enough if space is tight.
+   /// Maximum number of outstanding requests, shared by all devices.  Two
+   /// should be sufficient for simple programs.  One might even be enough if
+   /// space is tight.  Hosts that keep many local and remote requests in
+   /// flight (see ports/posix/platform_config.h) should raise it.
    #define XBEE_CMD_REQUEST_TABLESIZE  2
 #endif
 
+// Handles are (index << 8 | sequence) in a non-negative int16_t.
+#if XBEE_CMD_REQUEST_TABLESIZE > 127
+   #error XBEE_CMD_REQUEST_TABLESIZE must be <= 127.
+#endif
+
 /// Maximum number of bytes in the parameter sent to a command.
 /// Platforms can override this when limiting to AT commands with shorter
 /// parameters (e.g., 16 bytes when not using the certificate parameters).
@@ -180,13 +187,21 @@ typedef struct xbee_cmd_request {
    /// Handle is a combination of index and this sequence byte.
    uint8_t        sequence;
 
-   /// Device that sent this request -- if we have a table for each XBee, this
-   /// element isn't necessary.  NULL if slot is empty.
+   /// Link to the next entry (1-based index into xbee_cmd_request_table[], 0
+   /// ends the list).  Empty entries are chained on the table's free list,
+   /// and entries in use are chained on their device's \c cmd_active list.
+   uint8_t        next;
+
+   /// Device that sent this request.  NULL if slot is empty.
    xbee_dev_t     *device;
 
    /// expire entry if XBEE_CHECK_TIMEOUT_SEC(timeout) is true
    uint16_t       timeout;
 
+   /// seconds to wait for a response, set with xbee_cmd_set_timeout();
+   /// 0 to use #XBEE_CMD_LOCAL_TIMEOUT or #XBEE_CMD_REMOTE_TIMEOUT
+   uint16_t       response_timeout;
+
    /// combination of XBEE_CMD_FLAG_* macros
    uint16_t       flags;
    /** @name
@@ -668,7 +683,7 @@ enum xbee_command_list_status (xbee_cmd_list_status)(
 /// Return the handle for entry \a index (combination of \a index and
 /// \a .sequence member of entry).
 #define XBEE_CMD_REQUEST_HANDLE(index) \
-   ((index << 8) || xbee_cmd_request_table[index].sequence)
+   (((index) << 8) | xbee_cmd_request_table[index].sequence)
 
 // documented in xbee_atcmd.c
 extern FAR xbee_cmd_request_t
@@ -680,10 +695,12 @@ xbee_cmd_request_t FAR *_xbee_cmd_handle_to_address( int16_t handle);
 int xbee_cmd_init_device( xbee_dev_t *xbee);
 int xbee_cmd_query_device( xbee_dev_t *xbee, uint_fast8_t refresh);
 int xbee_cmd_query_status( xbee_dev_t *xbee);
+int _xbee_cmd_verify_cached( xbee_dev_t *xbee);
 
 int16_t xbee_cmd_create( xbee_dev_t *xbee, const char FAR command[3]);
 int _xbee_cmd_release_request( xbee_cmd_request_t FAR *request);
 int xbee_cmd_release_handle( int16_t handle);
+int xbee_cmd_release_device( xbee_dev_t *xbee);
 int xbee_cmd_set_command( int16_t handle, const char FAR command[3]);
 int xbee_cmd_set_callback( int16_t handle, xbee_cmd_callback_fn callback,
    void FAR *context);
@@ -691,6 +708,7 @@ int xbee_cmd_set_target( int16_t handle, const addr64 FAR *ieee,
    uint16_t network_address);
 int xbee_cmd_set_flags( int16_t handle, uint16_t flags);
 int xbee_cmd_clear_flags( int16_t handle, uint16_t flags);
+int xbee_cmd_set_timeout( int16_t handle, uint16_t seconds);
 int xbee_cmd_set_param( int16_t handle, uint32_t value);
 int xbee_cmd_set_param_bytes( int16_t handle, const void FAR *data,
    uint8_t length);
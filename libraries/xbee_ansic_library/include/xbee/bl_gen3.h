@@ -76,6 +76,8 @@ typedef struct xbee_gen3_update_t {
     /// <n> if sending checksum/CRC16 (where <n> = XBEE_GEN3_UPLOAD_PAGE_SIZE).
     int16_t                     page_offset;
 
+    uint16_t                    pages_skipped;  ///< pages of 0xFF not sent
+
     xbee_gen3_extended_ver_t    ext_ver;        ///< parsed response from 'V' cmd
 
     xbee_dev_t                  *xbee;
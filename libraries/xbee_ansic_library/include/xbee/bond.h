@@ -0,0 +1,208 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_wpan
+   @{
+   @file xbee/bond.h
+   Stripe one data stream across several XBee radios.
+
+   A bond sends each payload through whichever of its links (local XBee
+   modules, ideally on different channels via \c CM or \c ID) has the most
+   credit.  A link's credit is the number of frames it may have waiting for a
+   Transmit Status.  Each payload is prefixed with a 16-bit sequence number,
+   and the receiving bond puts payloads back in order before handing them
+   to the application.  Because each radio paces itself with its own Transmit
+   Status frames, adding a radio adds its full air-time to the bond.
+
+   Sender setup:
+
+   @code
+   xbee_bond_t bond;
+
+   const xbee_dispatch_table_entry_t xbee_frame_handlers[] = {
+      XBEE_FRAME_HANDLE_LOCAL_AT,
+      XBEE_BOND_FRAME_HANDLE_TRANSMIT_STATUS( &bond),
+      XBEE_FRAME_TABLE_END
+   };
+
+   xbee_bond_init( &bond, &collector_addr, NULL, NULL);
+   xbee_bond_add_link( &bond, &radio_a);
+   xbee_bond_add_link( &bond, &radio_b);
+   ...
+   if (xbee_bond_send( &bond, sample, sizeof sample) == -EBUSY)
+   {
+      // all links are full; tick the devices and try again
+   }
+   xbee_bond_tick( &bond);
+   @endcode
+
+   On the receiver, add #XBEE_BOND_CLUSTER_ENTRY to the cluster table of the
+   #WPAN_ENDPOINT_DIGI_DATA endpoint on every radio.  Payloads from all
+   radios go to the \c deliver callback passed to xbee_bond_init().
+
+   A payload that failed on its link is not retransmitted.  The receiver
+   waits up to #XBEE_BOND_GAP_MS for a missing sequence number before
+   skipping it; fresh telemetry is more useful than a late retry.
+*/
+
+#ifndef XBEE_BOND_H
+#define XBEE_BOND_H
+
+#include "xbee/wpan.h"
+#include "wpan/aps.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_BOND_MAX_LINKS
+   /// Maximum number of radios in one bond.
+   #define XBEE_BOND_MAX_LINKS      4
+#endif
+
+#ifndef XBEE_BOND_WINDOW
+   /// Frames each link may have waiting for a Transmit Status.
+   #define XBEE_BOND_WINDOW         4
+#endif
+
+#ifndef XBEE_BOND_REORDER
+   /// Out-of-order payloads the receiver holds while waiting for a gap.
+   #define XBEE_BOND_REORDER        16
+#endif
+
+#ifndef XBEE_BOND_MAX_PAYLOAD
+   /// Largest payload (not counting the sequence number) the bond carries.
+   #define XBEE_BOND_MAX_PAYLOAD    100
+#endif
+
+#ifndef XBEE_BOND_TX_TIMEOUT_MS
+   /// Milliseconds to wait for a Transmit Status before counting a loss.
+   #define XBEE_BOND_TX_TIMEOUT_MS  5000
+#endif
+
+#ifndef XBEE_BOND_GAP_MS
+   /// Milliseconds the receiver waits for a missing sequence number.
+   #define XBEE_BOND_GAP_MS         500
+#endif
+
+/// Cluster ID used for bonded payloads on the Digi data endpoint.
+#define XBEE_BOND_CLUSTER           0x00B0
+
+/// Prefix on every bonded payload.
+typedef XBEE_PACKED(xbee_bond_header_t, {
+   uint16_t       sequence_be;
+}) xbee_bond_header_t;
+
+/**
+   @brief
+   Callback for payloads the receiver has put back in order.
+
+   @param[in] context   \a context passed to xbee_bond_init()
+   @param[in] payload   payload, without the sequence number
+   @param[in] length    number of bytes in \a payload
+*/
+typedef void (*xbee_bond_deliver_fn)( void FAR *context,
+   const void FAR *payload, uint16_t length);
+
+/// Frame sent on a link and still waiting for its Transmit Status.
+typedef struct xbee_bond_pending_t {
+   uint8_t        frame_id;         ///< 0 if the entry is free
+   uint16_t       length;           ///< payload bytes in the frame
+   uint32_t       sent_ms;          ///< xbee_millisecond_timer() at send
+} xbee_bond_pending_t;
+
+/// One radio in the bond.
+typedef struct xbee_bond_link_t {
+   xbee_dev_t     *xbee;
+   uint8_t        outstanding;      ///< entries used in \c pending
+   xbee_bond_pending_t pending[XBEE_BOND_WINDOW];
+
+   uint32_t       sent;             ///< frames written to the radio
+   uint32_t       delivered;        ///< Transmit Status of SUCCESS
+   uint32_t       failed;           ///< failed or timed out
+   uint32_t       bytes_delivered;  ///< payload bytes in \c delivered
+   uint16_t       loss_permille;    ///< recent loss rate (moving average)
+   uint32_t       bytes_per_sec;    ///< throughput over the last window
+
+   uint32_t       window_start_ms;  ///< start of throughput window
+   uint32_t       window_bytes;     ///< bytes delivered in the window
+} xbee_bond_link_t;
+
+typedef struct xbee_bond_t {
+   uint8_t              link_count;
+   uint8_t              next_link;  ///< tie-break, rotates on each send
+   xbee_bond_link_t     link[XBEE_BOND_MAX_LINKS];
+
+   // sender
+   addr64               ieee_address;   ///< destination of bonded frames
+   uint16_t             tx_sequence;    ///< sequence number of next send
+
+   // receiver
+   xbee_bond_deliver_fn deliver;
+   void                 FAR *context;
+   uint16_t             rx_next;        ///< next sequence to deliver
+   bool_t               rx_synced;      ///< set after first payload
+   uint8_t              rx_held;        ///< slots in use in \c rx_slot
+   uint32_t             rx_gap_ms;      ///< when \c rx_next went missing
+   struct {
+      uint8_t           used;
+      uint16_t          sequence;
+      uint16_t          length;
+      uint8_t           data[XBEE_BOND_MAX_PAYLOAD];
+   } rx_slot[XBEE_BOND_REORDER];
+
+   uint32_t             rx_delivered;   ///< payloads passed to \c deliver
+   uint32_t             rx_duplicates;  ///< old or repeated sequences
+   uint32_t             rx_skipped;     ///< sequences given up on
+   uint32_t             rx_resyncs;     ///< restarts of the sender's sequence
+} xbee_bond_t;
+
+// documented in xbee_bond.c
+int xbee_bond_init( xbee_bond_t *bond, const addr64 FAR *ieee_address,
+   xbee_bond_deliver_fn deliver, void FAR *context);
+int xbee_bond_add_link( xbee_bond_t *bond, xbee_dev_t *xbee);
+int xbee_bond_send( xbee_bond_t *bond, const void FAR *payload,
+   uint16_t length);
+int xbee_bond_tick( xbee_bond_t *bond);
+int xbee_bond_receive( xbee_bond_t *bond, const void FAR *payload,
+   uint16_t length);
+
+/**
+   @brief
+   Frame handler for 0x8B (XBEE_FRAME_TRANSMIT_STATUS) frames that credits
+   the link the frame arrived on.  Use the
+   XBEE_BOND_FRAME_HANDLE_TRANSMIT_STATUS() macro in the frame handler table.
+
+   View the documentation of xbee_frame_handler_fn() for this function's
+   parameters and return value.
+*/
+int xbee_bond_handle_transmit_status( xbee_dev_t *xbee,
+   const void FAR *frame, uint16_t length, void FAR *context);
+
+/// Frame handler table entry for a bond's Transmit Status processing.
+#define XBEE_BOND_FRAME_HANDLE_TRANSMIT_STATUS(bond) \
+   { XBEE_FRAME_TRANSMIT_STATUS, 0, xbee_bond_handle_transmit_status, bond }
+
+/**
+   @brief
+   Cluster handler for bonded payloads.  Use the XBEE_BOND_CLUSTER_ENTRY()
+   macro in the cluster table of the Digi data endpoint.
+
+   View the documentation of wpan_aps_handler_fn() for this function's
+   parameters and return value.
+*/
+int xbee_bond_cluster_handler( const wpan_envelope_t FAR *envelope,
+   void FAR *context);
+
+/// Cluster table entry for the receive side of a bond.
+#define XBEE_BOND_CLUSTER_ENTRY(bond) \
+   { XBEE_BOND_CLUSTER, xbee_bond_cluster_handler, bond, \
+      WPAN_CLUST_FLAG_INOUT | WPAN_CLUST_FLAG_NOT_ZCL }
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
@@ -0,0 +1,205 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_cbuf
+   @{
+   @file xbee/cbuf_spsc.h
+   Single-producer, single-consumer circular buffer that is safe to share
+   between two threads (or a thread and an ISR) without locks.
+
+   Differences from xbee_cbuf_t:
+
+   - The producer publishes \c tail with a release store and the consumer
+     reads it with an acquire load (and vice versa for \c head), so the
+     bytes are visible before the index that covers them.
+   - \c head and \c tail are in separate cache lines, and each side keeps a
+     cached copy of the other side's index, so the two cores don't keep
+     stealing one line from each other.
+   - Indexes run freely and are masked on access, so all \c size bytes of
+     the buffer are usable (no separator byte).
+   - The caller supplies the data buffer, which can be any power of 2.
+   - xbee_cbuf_spsc_reserve()/xbee_cbuf_spsc_commit() let the producer
+     write (for example, read() from a serial port) straight into the
+     buffer, and xbee_cbuf_spsc_peek()/xbee_cbuf_spsc_consume() let the
+     consumer parse in place.
+
+   Only one thread may call the producer functions (put, reserve, commit)
+   and only one may call the consumer functions (get, peek, consume).
+
+   @code
+   static uint8_t rx_space[4096];
+   static xbee_cbuf_spsc_t rx;
+
+   xbee_cbuf_spsc_init( &rx, rx_space, sizeof rx_space);
+
+   // reader thread
+   length = 0;
+   p = xbee_cbuf_spsc_reserve( &rx, &length);
+   if (p != NULL && (n = read( fd, p, length)) > 0)
+   {
+      xbee_cbuf_spsc_commit( &rx, n);
+   }
+
+   // consumer
+   n = xbee_cbuf_spsc_get( &rx, frame, sizeof frame);
+   @endcode
+*/
+
+#ifndef XBEE_CBUF_SPSC_H
+#define XBEE_CBUF_SPSC_H
+
+#include "xbee/platform.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_CACHE_LINE
+   /// Size of a cache line, used to keep producer and consumer state apart.
+   #define XBEE_CACHE_LINE    64
+#endif
+
+#if defined __GNUC__
+   #define XBEE_CBUF_SPSC_LOAD_ACQUIRE(p)      __atomic_load_n( p, __ATOMIC_ACQUIRE)
+   #define XBEE_CBUF_SPSC_STORE_RELEASE(p, v)  __atomic_store_n( p, v, __ATOMIC_RELEASE)
+   #define XBEE_CBUF_SPSC_ALIGNED      __attribute__((aligned(XBEE_CACHE_LINE)))
+#else
+   // Single-core targets: volatile keeps the compiler from caching indexes.
+   #define XBEE_CBUF_SPSC_LOAD_ACQUIRE(p)      (*(volatile unsigned int *)(p))
+   #define XBEE_CBUF_SPSC_STORE_RELEASE(p, v)  (*(volatile unsigned int *)(p) = (v))
+   #define XBEE_CBUF_SPSC_ALIGNED
+#endif
+
+/// Lock-free single-producer, single-consumer circular buffer.
+typedef struct xbee_cbuf_spsc_t {
+   // written only by the producer
+   unsigned int   tail;          ///< bytes written, free-running
+   unsigned int   head_cache;    ///< producer's last look at \c head
+   uint8_t        pad_producer[XBEE_CACHE_LINE - 2 * sizeof(unsigned int)];
+
+   // written only by the consumer
+   unsigned int   head;          ///< bytes read, free-running
+   unsigned int   tail_cache;    ///< consumer's last look at \c tail
+   uint8_t        pad_consumer[XBEE_CACHE_LINE - 2 * sizeof(unsigned int)];
+
+   // read-only after xbee_cbuf_spsc_init()
+   unsigned int   mask;          ///< size of \c data - 1
+   uint8_t  FAR   *data;
+} XBEE_CBUF_SPSC_ALIGNED xbee_cbuf_spsc_t;
+
+/**
+   @brief
+   Initialize a circular buffer.
+
+   @param[out] cbuf     buffer to initialize
+   @param[in]  data     storage for buffered bytes
+   @param[in]  size     bytes in \a data; a power of 2 of at least 2
+
+   @retval  0        success
+   @retval  -EINVAL  invalid parameter
+*/
+int xbee_cbuf_spsc_init( xbee_cbuf_spsc_t *cbuf, void FAR *data,
+   unsigned int size);
+
+/// Capacity of the circular buffer.
+#define xbee_cbuf_spsc_length(cbuf)    ((cbuf)->mask + 1)
+
+/**
+   @brief
+   Number of bytes in the buffer.  Exact when called by the producer or
+   consumer; a snapshot when called by anyone else.
+
+   @param[in] cbuf   circular buffer
+*/
+unsigned int xbee_cbuf_spsc_used( xbee_cbuf_spsc_t *cbuf);
+
+/**
+   @brief
+   Number of bytes that can be added to the buffer.
+
+   @param[in] cbuf   circular buffer
+*/
+unsigned int xbee_cbuf_spsc_free( xbee_cbuf_spsc_t *cbuf);
+
+/**
+   @brief
+   Append bytes to the buffer (producer).
+
+   @param[in,out] cbuf     circular buffer
+   @param[in]     buffer   data to append
+   @param[in]     length   number of bytes in \a buffer
+
+   @return  number of bytes appended (less than \a length if the buffer
+            filled up)
+*/
+unsigned int xbee_cbuf_spsc_put( xbee_cbuf_spsc_t *cbuf,
+   const void FAR *buffer, unsigned int length);
+
+/**
+   @brief
+   Remove bytes from the buffer (consumer).
+
+   @param[in,out] cbuf     circular buffer
+   @param[out]    buffer   destination for the bytes
+   @param[in]     length   maximum bytes to remove
+
+   @return  number of bytes removed
+*/
+unsigned int xbee_cbuf_spsc_get( xbee_cbuf_spsc_t *cbuf, void FAR *buffer,
+   unsigned int length);
+
+/**
+   @brief
+   Get a contiguous free region to write into (producer).  Nothing is
+   visible to the consumer until xbee_cbuf_spsc_commit().
+
+   @param[in,out] cbuf     circular buffer
+   @param[in,out] length   on entry, bytes wanted (0 for as many as
+                           possible); on exit, bytes available at the
+                           returned address (may be fewer if the free space
+                           wraps)
+
+   @return  address to write to, or NULL if the buffer is full
+*/
+void FAR *xbee_cbuf_spsc_reserve( xbee_cbuf_spsc_t *cbuf,
+   unsigned int *length);
+
+/**
+   @brief
+   Publish bytes written to a region from xbee_cbuf_spsc_reserve().
+
+   @param[in,out] cbuf     circular buffer
+   @param[in]     length   bytes written, no more than reserved
+*/
+void xbee_cbuf_spsc_commit( xbee_cbuf_spsc_t *cbuf, unsigned int length);
+
+/**
+   @brief
+   Get a contiguous region of buffered bytes without removing them
+   (consumer).
+
+   @param[in,out] cbuf     circular buffer
+   @param[out]    length   bytes available at the returned address; more
+                           may follow at the start of the buffer
+
+   @return  address of the oldest byte, or NULL if the buffer is empty
+*/
+const void FAR *xbee_cbuf_spsc_peek( xbee_cbuf_spsc_t *cbuf,
+   unsigned int *length);
+
+/**
+   @brief
+   Remove bytes examined with xbee_cbuf_spsc_peek().
+
+   @param[in,out] cbuf     circular buffer
+   @param[in]     length   bytes to remove, no more than peeked
+*/
+void xbee_cbuf_spsc_consume( xbee_cbuf_spsc_t *cbuf, unsigned int length);
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
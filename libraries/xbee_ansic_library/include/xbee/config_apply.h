@@ -0,0 +1,130 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_atcmd
+   @{
+   @file xbee/config_apply.h
+   Apply a profile of numeric AT command settings to a local or remote
+   XBee, writing only the settings that differ from the module's current
+   values.
+*/
+
+#ifndef XBEE_CONFIG_APPLY_H
+#define XBEE_CONFIG_APPLY_H
+
+#include "xbee/atcmd.h"
+
+XBEE_BEGIN_DECLS
+
+/// One entry in a configuration profile passed to xbee_config_apply_start().
+typedef struct xbee_config_setting_t {
+   const char  FAR   *command;   ///< two-letter AT command (e.g., "NP")
+   uint32_t          value;      ///< desired value of the register
+} xbee_config_setting_t;
+
+/// Values for the \c status field of xbee_config_result_t.
+enum xbee_config_status {
+   XBEE_CONFIG_PENDING = 0,   ///< register hasn't been read yet
+   XBEE_CONFIG_MATCHED,       ///< register already had the desired value
+   XBEE_CONFIG_DIFFERS,       ///< register differs, write pending
+   XBEE_CONFIG_CHANGED,       ///< register was written with the new value
+   XBEE_CONFIG_FAILED,        ///< read or write failed (see \c at_status)
+};
+
+/**
+   Result for one entry of the profile.  The caller supplies an array of
+   these (one per setting) to xbee_config_apply_start().
+*/
+typedef struct xbee_config_result_t {
+   /// Value read from the module before any change.
+   uint32_t          previous;
+
+   /// Handle of the outstanding request for this setting, or -1.
+   int16_t           handle;
+
+   /// One of the values from enum xbee_config_status.
+   uint8_t           status;
+
+   /// Status byte of the last AT response (XBEE_AT_RESP_*), or
+   /// #XBEE_CONFIG_AT_STATUS_TIMEOUT if the module didn't respond.
+   uint8_t           at_status;
+      #define XBEE_CONFIG_AT_STATUS_TIMEOUT  0xFF
+} xbee_config_result_t;
+
+/// Phases of xbee_config_apply_tick().
+enum xbee_config_apply_state {
+   XBEE_CONFIG_STATE_QUERY,   ///< reading every register in the profile
+   XBEE_CONFIG_STATE_WRITE,   ///< writing registers that differ
+   XBEE_CONFIG_STATE_SAVE,    ///< sending ATWR and ATAC
+   XBEE_CONFIG_STATE_DONE     ///< finished, see \c status
+};
+
+/**
+   State of a configuration being applied.  Must stay in scope (typically
+   static) until xbee_config_apply_tick() stops returning -EBUSY, since
+   AT command callbacks reference it.
+*/
+typedef struct xbee_config_apply_t {
+   xbee_dev_t                          *xbee;      ///< device to send through
+   const xbee_config_setting_t   FAR   *settings;  ///< desired profile
+   xbee_config_result_t                *results;   ///< one per setting
+
+#ifndef XBEE_CMD_DISABLE_REMOTE
+   /// target address, used if \c flags has #XBEE_CONFIG_FLAG_REMOTE set
+   wpan_address_t                      address;
+#endif
+
+   uint16_t          flags;
+   /** @name
+      Values for \c flags field of xbee_config_apply_t.
+      @{
+   */
+      /// Only read and compare the registers; don't write the differences.
+      #define XBEE_CONFIG_FLAG_VERIFY_ONLY   0x0001
+      /// Apply changes with ATAC, but don't save them with ATWR.
+      #define XBEE_CONFIG_FLAG_NO_SAVE       0x0002
+      /// Set by xbee_config_apply_start() when \c address was provided.
+      #define XBEE_CONFIG_FLAG_REMOTE        0x0100
+      /// Set once ATWR has been sent.
+      #define XBEE_CONFIG_FLAG_SAVED         0x0200
+   ///@}
+
+   /// Seconds to wait for each response, or 0 for the AT layer's default
+   /// (see xbee_cmd_set_timeout()).  May be changed after calling
+   /// xbee_config_apply_start().
+   uint16_t          timeout;
+
+   uint8_t           count;         ///< number of entries in \c settings
+   uint8_t           state;         ///< see enum xbee_config_apply_state
+   uint8_t           next;          ///< next entry to issue in this phase
+   uint8_t           outstanding;   ///< requests waiting for a response
+
+   uint8_t           matched;       ///< registers already at desired value
+   uint8_t           differs;       ///< registers that needed a change
+   uint8_t           changed;       ///< registers successfully written
+   uint8_t           failed;        ///< registers that failed to read/write
+   uint8_t           save_failed;   ///< ATWR or ATAC failed (or wasn't sent)
+
+   /// -EBUSY while running (until every request has a response), 0 on
+   /// success, -EIO if any entry failed or \c save_failed is set.
+   int               status;
+} xbee_config_apply_t;
+
+// all functions are documented in xbee_config_apply.c
+int xbee_config_apply_start( xbee_config_apply_t *apply, xbee_dev_t *xbee,
+   const xbee_config_setting_t FAR *settings, xbee_config_result_t *results,
+   uint_fast8_t count, const wpan_address_t FAR *address, uint16_t flags);
+int xbee_config_apply_tick( xbee_config_apply_t *apply);
+
+/// Current status of \a apply (-EBUSY while running).
+#define xbee_config_apply_status(apply)   ((apply)->status)
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
@@ -0,0 +1,120 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_atcmd
+   @{
+   @file xbee/config_fleet.h
+   Apply a profile of AT command settings to many remote XBee modules at
+   once, using Remote AT Commands sent through a local XBee.
+*/
+
+#ifndef XBEE_CONFIG_FLEET_H
+#define XBEE_CONFIG_FLEET_H
+
+#include "xbee/config_apply.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_CONFIG_FLEET_PARALLEL
+   /// Maximum number of nodes configured concurrently.  Each node pipelines
+   /// all of the profile's requests, so this times the profile size should
+   /// fit in #XBEE_CMD_REQUEST_TABLESIZE.
+   #define XBEE_CONFIG_FLEET_PARALLEL     4
+#endif
+
+#ifndef XBEE_CONFIG_FLEET_TIMEOUT
+   /// Default seconds to wait for each remote response.
+   #define XBEE_CONFIG_FLEET_TIMEOUT      5
+#endif
+
+#ifndef XBEE_CONFIG_FLEET_RETRIES
+   /// Default number of times to retry a node that didn't respond.
+   #define XBEE_CONFIG_FLEET_RETRIES      2
+#endif
+
+/**
+   One remote node to configure, with its per-setting results (the diff
+   report).  The caller supplies an array of these to
+   xbee_config_fleet_start().
+*/
+typedef struct xbee_config_node_t {
+   /// 64-bit address of the node
+   addr64                  ieee;
+
+   /// Array with one entry per setting in the profile, filled in with the
+   /// node's previous value and the outcome for that setting.  Reflects the
+   /// node's last attempt if it was retried.
+   xbee_config_result_t    *results;
+
+   /// -EBUSY until the node is finished, then 0 if every setting matched or
+   /// was written, -ETIMEDOUT if the node stopped responding, or -EIO if
+   /// a setting failed (see \c results)
+   int                     status;
+
+   uint8_t                 attempts;   ///< number of times node was started
+   uint8_t                 changed;    ///< settings written on last attempt
+   uint8_t                 failed;     ///< settings failed on last attempt
+} xbee_config_node_t;
+
+/**
+   State of a fleet configuration.  Must stay in scope (typically static)
+   until xbee_config_fleet_tick() stops returning -EBUSY, since AT command
+   callbacks reference it.
+*/
+typedef struct xbee_config_fleet_t {
+   xbee_dev_t                          *xbee;      ///< local device
+   const xbee_config_setting_t   FAR   *settings;  ///< desired profile
+   xbee_config_node_t                  *nodes;     ///< nodes to configure
+
+   /// Seconds to wait for each remote response.  Defaults to
+   /// #XBEE_CONFIG_FLEET_TIMEOUT, may be changed before the first tick.
+   uint16_t          timeout;
+
+   /// XBEE_CONFIG_FLAG_* values passed to xbee_config_apply_start()
+   uint16_t          flags;
+
+   uint8_t           count;         ///< number of entries in \c settings
+   uint8_t           node_count;    ///< number of entries in \c nodes
+   uint8_t           next_node;     ///< next node to start
+
+   /// Nodes configured concurrently.  Defaults to (and can't exceed)
+   /// #XBEE_CONFIG_FLEET_PARALLEL, may be lowered before the first tick.
+   uint8_t           parallel;
+
+   /// Times to retry a node that didn't respond.  Defaults to
+   /// #XBEE_CONFIG_FLEET_RETRIES, may be changed before the first tick.
+   uint8_t           retries;
+
+   uint8_t           succeeded;     ///< nodes finished with status 0
+   uint8_t           failed;        ///< nodes finished with an error
+
+   /// index into \c nodes for each slot, or #XBEE_CONFIG_FLEET_SLOT_IDLE
+   uint8_t           slot_node[XBEE_CONFIG_FLEET_PARALLEL];
+      #define XBEE_CONFIG_FLEET_SLOT_IDLE    0xFF
+
+   /// read-compare-write engine for each concurrently configured node
+   xbee_config_apply_t  slot[XBEE_CONFIG_FLEET_PARALLEL];
+
+   /// -EBUSY while running, 0 on success, -EIO if any node failed.
+   int               status;
+} xbee_config_fleet_t;
+
+// all functions are documented in xbee_config_fleet.c
+int xbee_config_fleet_start( xbee_config_fleet_t *fleet, xbee_dev_t *xbee,
+   const xbee_config_setting_t FAR *settings, uint_fast8_t count,
+   xbee_config_node_t *nodes, uint_fast8_t node_count, uint16_t flags);
+int xbee_config_fleet_tick( xbee_config_fleet_t *fleet);
+void xbee_config_fleet_report( const xbee_config_fleet_t *fleet);
+
+/// Current status of \a fleet (-EBUSY while running).
+#define xbee_config_fleet_status(fleet)   ((fleet)->status)
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
@@ -319,6 +319,8 @@ enum xbee_dev_flags
    XBEE_DEV_FLAG_QUERY_ERROR     = 0x0008,   ///< querying timed out or error
    XBEE_DEV_FLAG_QUERY_REFRESH   = 0x0010,   ///< need to re-query device
    XBEE_DEV_FLAG_QUERY_INPROGRESS= 0x0020,   ///< query is in progress
+   XBEE_DEV_FLAG_QUERY_CACHED    = 0x0040,   ///< values loaded from cache,
+                                             ///< not yet revalidated
 
    XBEE_DEV_FLAG_IN_TICK         = 0x0080,   ///< in xbee_dev_tick
 
@@ -444,6 +446,15 @@ typedef struct xbee_dev_t
 
    uint8_t     frame_id;            ///< last frame_id used for sending
 
+   /// Head of this device's list of outstanding AT Command requests (1-based
+   /// index into xbee_cmd_request_table[], 0 if none).  Maintained by
+   /// xbee_atcmd.c so responses are only matched against this device's
+   /// requests.
+   uint8_t     cmd_active;
+
+   /// Number of entries on the \c cmd_active list.
+   uint8_t     cmd_active_count;
+
    // Need some state variables here if AT mode is supported (necessary when
    // using modules with AT firmware instead of API firmware, or when doing
    // firmware updates on DigiMesh 900 with API firmware).  Current state:
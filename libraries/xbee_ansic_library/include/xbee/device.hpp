@@ -0,0 +1,390 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_device
+   @{
+   @file xbee/device.hpp
+   Header-only C++17 wrapper for xbee_dev_t.
+
+   - xbee::Device owns an xbee_dev_t (and its serial port) and is move-only,
+     so it can be returned from functions and stored in containers without
+     leaving AT command requests pointing at a stale copy.
+   - Frames are written with xbee::span views of the header and payload.
+   - xbee::on() maps a callable to an xbee_dispatch_table_entry_t, passing
+     it a typed frame and a span of the bytes that follow the frame header.
+     The callable is referenced (not copied), so nothing is allocated.
+
+   Every member is a thin inline call into the C library, and errors are
+   returned as negative errno values just like the C API.
+
+   @code
+   static auto on_tx_status = [](xbee_dev_t &, const xbee_frame_transmit_status_t &status,
+                                 xbee::span<const uint8_t>) {
+      printf( "TX status 0x%02X\n", status.delivery);
+      return 0;
+   };
+   static const auto handlers = xbee::make_dispatch_table(
+      xbee::on<xbee_frame_transmit_status_t>( XBEE_FRAME_TRANSMIT_STATUS, on_tx_status),
+      xbee::handle_local_at);
+
+   xbee::Device dev;
+   int err = dev.open( "/dev/ttyS0", 921600, handlers.data());
+   @endcode
+*/
+
+#ifndef XBEE_DEVICE_HPP
+#define XBEE_DEVICE_HPP
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 202002L && __has_include(<span>)
+   #include <span>
+#endif
+
+#include "xbee/device.h"
+#include "xbee/atcmd.h"
+#include "xbee/wpan.h"
+
+namespace xbee {
+
+#ifdef __cpp_lib_span
+template <typename T>
+using span = std::span<T>;
+#else
+/// Minimal stand-in for C++20's std::span (contiguous, dynamic extent).
+template <typename T>
+class span {
+public:
+   using element_type = T;
+   using value_type = std::remove_cv_t<T>;
+   using size_type = std::size_t;
+   using pointer = T *;
+   using iterator = T *;
+
+   constexpr span() noexcept = default;
+   constexpr span( T *data, std::size_t size) noexcept
+      : data_( data), size_( size) {}
+   template <std::size_t N>
+   constexpr span( T (&array)[N]) noexcept : data_( array), size_( N) {}
+   template <typename Container, typename = std::enable_if_t<
+      std::is_convertible_v<decltype( std::declval<Container &>().data()), T *>>>
+   constexpr span( Container &container) noexcept
+      : data_( container.data()), size_( container.size()) {}
+   template <typename U, typename = std::enable_if_t<
+      std::is_convertible_v<U (*)[], T (*)[]>>>
+   constexpr span( const span<U> &other) noexcept
+      : data_( other.data()), size_( other.size()) {}
+
+   constexpr T *data() const noexcept { return data_; }
+   constexpr std::size_t size() const noexcept { return size_; }
+   constexpr std::size_t size_bytes() const noexcept { return size_ * sizeof(T); }
+   constexpr bool empty() const noexcept { return size_ == 0; }
+   constexpr T &operator[]( std::size_t index) const noexcept
+   {
+      return data_[index];
+   }
+   constexpr T *begin() const noexcept { return data_; }
+   constexpr T *end() const noexcept { return data_ + size_; }
+   constexpr span first( std::size_t count) const noexcept
+   {
+      return span( data_, count);
+   }
+   constexpr span subspan( std::size_t offset) const noexcept
+   {
+      return span( data_ + offset, size_ - offset);
+   }
+   constexpr span subspan( std::size_t offset, std::size_t count) const noexcept
+   {
+      return span( data_ + offset, count);
+   }
+
+private:
+   T *data_ = nullptr;
+   std::size_t size_ = 0;
+};
+#endif
+
+/// View any contiguous, trivially copyable data as bytes for sending.
+template <typename T>
+inline span<const uint8_t> as_bytes( span<T> data) noexcept
+{
+   static_assert( std::is_trivially_copyable_v<std::remove_cv_t<T>>,
+      "only trivially copyable data can be sent as bytes");
+   return { reinterpret_cast<const uint8_t *>( data.data()),
+      data.size_bytes() };
+}
+
+template <typename T, std::size_t N>
+inline span<const uint8_t> as_bytes( T (&array)[N]) noexcept
+{
+   return as_bytes( span<T>( array));
+}
+
+/**
+   Minimum length of a received frame of type \a Frame.  Frames that end in
+   a variable-length \c payload member are specialized below so handlers
+   get the payload as a span.
+*/
+template <typename Frame>
+struct frame_traits {
+   static constexpr std::size_t header_size = sizeof(Frame);
+};
+
+template <>
+struct frame_traits<xbee_frame_receive_t> {
+   static constexpr std::size_t header_size =
+      offsetof( xbee_frame_receive_t, payload);
+};
+
+template <>
+struct frame_traits<xbee_frame_receive_explicit_t> {
+   static constexpr std::size_t header_size =
+      offsetof( xbee_frame_receive_explicit_t, payload);
+};
+
+template <>
+struct frame_traits<xbee_frame_local_at_resp_t> {
+   static constexpr std::size_t header_size =
+      offsetof( xbee_frame_local_at_resp_t, value);
+};
+
+template <>
+struct frame_traits<xbee_frame_remote_at_resp_t> {
+   static constexpr std::size_t header_size =
+      offsetof( xbee_frame_remote_at_resp_t, value);
+};
+
+namespace detail {
+
+template <typename Frame, typename Handler>
+int dispatch_trampoline( xbee_dev_t *xbee, const void FAR *raw,
+   uint16_t length, void FAR *context)
+{
+   constexpr std::size_t header_size = frame_traits<Frame>::header_size;
+   const auto *bytes = static_cast<const uint8_t *>( raw);
+
+   if (length < header_size)
+   {
+      return -EINVAL;
+   }
+
+   return (*static_cast<Handler *>( context))( *xbee,
+      *static_cast<const Frame *>( raw),
+      span<const uint8_t>( bytes + header_size, length - header_size));
+}
+
+} // namespace detail
+
+/**
+   Build a dispatch table entry that calls \a handler as
+   <tt>int handler( xbee_dev_t &, const Frame &, xbee::span<const uint8_t>)</tt>
+   for frames of type \a frame_type.  Frames shorter than the Frame header
+   are dropped before reaching the handler.
+
+   \a handler is referenced by the entry and must outlive the table
+   (typically a static lambda or function object).
+*/
+template <typename Frame, typename Handler>
+constexpr xbee_dispatch_table_entry_t on( uint8_t frame_type,
+   Handler &handler, uint8_t frame_id = 0) noexcept
+{
+   static_assert( std::is_invocable_r_v<int, Handler &, xbee_dev_t &,
+      const Frame &, span<const uint8_t>>,
+      "handler must be callable as int( xbee_dev_t &, const Frame &, "
+      "xbee::span<const uint8_t>)");
+
+   return { frame_type, frame_id,
+      &detail::dispatch_trampoline<Frame, Handler>,
+      const_cast<void *>( static_cast<const void *>( std::addressof( handler)))
+   };
+}
+
+/// Frame handlers for the AT command layer, for use with
+/// make_dispatch_table() (C++ versions of the XBEE_FRAME_HANDLE_* macros).
+inline constexpr std::array<xbee_dispatch_table_entry_t, 2>
+   handle_local_at = {{ XBEE_FRAME_HANDLE_LOCAL_AT }};
+inline constexpr std::array<xbee_dispatch_table_entry_t, 1>
+   handle_remote_at = {{ XBEE_FRAME_HANDLE_REMOTE_AT }};
+
+namespace detail {
+
+template <typename T>
+struct entry_count;
+
+template <>
+struct entry_count<xbee_dispatch_table_entry_t> {
+   static constexpr std::size_t value = 1;
+};
+
+template <std::size_t N>
+struct entry_count<std::array<xbee_dispatch_table_entry_t, N>> {
+   static constexpr std::size_t value = N;
+};
+
+template <std::size_t Total>
+constexpr void append_entries( std::array<xbee_dispatch_table_entry_t, Total> &table,
+   std::size_t &used, const xbee_dispatch_table_entry_t &entry) noexcept
+{
+   table[used++] = entry;
+}
+
+template <std::size_t Total, std::size_t N>
+constexpr void append_entries( std::array<xbee_dispatch_table_entry_t, Total> &table,
+   std::size_t &used, const std::array<xbee_dispatch_table_entry_t, N> &entries)
+   noexcept
+{
+   for (const auto &entry : entries)
+   {
+      table[used++] = entry;
+   }
+}
+
+} // namespace detail
+
+/**
+   Assemble dispatch table entries (from on(), or groups like
+   handle_local_at) into an array ending with XBEE_FRAME_TABLE_END, ready
+   to pass to Device::open().
+*/
+template <typename... Entries>
+constexpr auto make_dispatch_table( const Entries &... entries) noexcept
+{
+   constexpr std::size_t count = (detail::entry_count<Entries>::value + ... + 1);
+   std::array<xbee_dispatch_table_entry_t, count> table{};
+   std::size_t used = 0;
+
+   (detail::append_entries( table, used, entries), ...);
+   table[used] = xbee_dispatch_table_entry_t XBEE_FRAME_TABLE_END;
+
+   return table;
+}
+
+/**
+   Move-only owner of an xbee_dev_t and its serial port.
+
+   The xbee_dev_t lives at a fixed address for the life of the Device (the
+   AT command layer keeps pointers to it), so moving a Device only moves
+   ownership.  The destructor releases outstanding AT requests and closes
+   the serial port.
+*/
+class Device {
+public:
+   Device() noexcept = default;
+   Device( Device &&) noexcept = default;
+   Device &operator=( Device &&) noexcept = default;
+   Device( const Device &) = delete;
+   Device &operator=( const Device &) = delete;
+   ~Device() = default;
+
+   /**
+      Open \a port and initialize the device (see xbee_dev_init()).
+
+      @retval  0        device ready
+      @retval  -ENOMEM  couldn't allocate the xbee_dev_t
+      @retval  <0       error from xbee_dev_init()
+   */
+   int open( const char *port, uint32_t baudrate,
+      const xbee_dispatch_table_entry_t *handlers,
+      xbee_is_awake_fn is_awake = nullptr, xbee_reset_fn reset = nullptr)
+      noexcept
+   {
+      xbee_serial_t serial{};
+      int error;
+
+      close();
+      std::unique_ptr<xbee_dev_t, Closer> dev( new (std::nothrow) xbee_dev_t{});
+      if (! dev)
+      {
+         return -ENOMEM;
+      }
+
+      serial.baudrate = baudrate;
+      std::strncpy( serial.device, port, sizeof serial.device - 1);
+      error = xbee_dev_init( dev.get(), &serial, is_awake, reset, handlers);
+      if (error == 0)
+      {
+         dev_ = std::move( dev);
+      }
+      else
+      {
+         // xbee_dev_init() opens the port last, so nothing to close (and
+         // Closer would close fd 0 from the zeroed serport)
+         delete dev.release();
+      }
+
+      return error;
+   }
+
+   /// Release outstanding AT requests and close the serial port.
+   void close() noexcept { dev_.reset(); }
+
+   bool is_open() const noexcept { return dev_ != nullptr; }
+   explicit operator bool() const noexcept { return is_open(); }
+
+   /// Underlying xbee_dev_t, for calling the C API directly.
+   xbee_dev_t *get() noexcept { return dev_.get(); }
+   const xbee_dev_t *get() const noexcept { return dev_.get(); }
+   xbee_dev_t *operator->() noexcept { return dev_.get(); }
+
+   /// Process received frames, see xbee_dev_tick().
+   int tick() noexcept { return xbee_dev_tick( dev_.get()); }
+
+   /// Enable the AT command layer, see xbee_cmd_init_device().
+   int init_at() noexcept { return xbee_cmd_init_device( dev_.get()); }
+
+   /// Status of the device query, see xbee_cmd_query_status().
+   int query_status() noexcept { return xbee_cmd_query_status( dev_.get()); }
+
+   uint8_t next_frame_id() noexcept { return xbee_next_frame_id( dev_.get()); }
+
+   /// Write a frame from separate header and payload buffers, see
+   /// xbee_frame_write().
+   int write( span<const uint8_t> header, span<const uint8_t> payload = {},
+      uint16_t flags = XBEE_DEV_FLAG_NONE) noexcept
+   {
+      return xbee_frame_write( dev_.get(), header.data(),
+         static_cast<uint16_t>( header.size()), payload.data(),
+         static_cast<uint16_t>( payload.size()), flags);
+   }
+
+   /// Write a frame with a typed header (e.g., xbee::TransmitExplicit or
+   /// xbee_header_transmit_explicit_t) followed by \a payload.
+   template <typename Header>
+   int send( const Header &header, span<const uint8_t> payload = {},
+      uint16_t flags = XBEE_DEV_FLAG_NONE) noexcept
+   {
+      static_assert( std::is_trivially_copyable_v<Header>,
+         "frame headers must be trivially copyable");
+      return xbee_frame_write( dev_.get(), &header, sizeof header,
+         payload.data(), static_cast<uint16_t>( payload.size()), flags);
+   }
+
+private:
+   struct Closer {
+      void operator()( xbee_dev_t *xbee) const noexcept
+      {
+         xbee_cmd_release_device( xbee);
+         xbee_ser_close( &xbee->serport);
+         delete xbee;
+      }
+   };
+
+   std::unique_ptr<xbee_dev_t, Closer> dev_;
+};
+
+} // namespace xbee
+
+#endif
+
+///@}
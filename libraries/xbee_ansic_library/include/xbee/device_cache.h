@@ -0,0 +1,62 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_device
+   @{
+   @file xbee/device_cache.h
+   Optional on-disk cache of the values xbee_cmd_query_device() reads from
+   the XBee module at startup (hardware and firmware versions, IEEE address,
+   etc.), so a program can start using its radio without waiting for the
+   query to complete.
+
+   Typical use:
+   @code
+   xbee_dev_init( &my_xbee, &serial, NULL, NULL, handlers);
+   xbee_dev_cache_load( &my_xbee, NULL);     // OK if this fails
+   xbee_cmd_init_device( &my_xbee);          // revalidates cached values
+   do {
+      xbee_dev_tick( &my_xbee);
+      err = xbee_cmd_query_status( &my_xbee);
+   } while (err == -EBUSY);      // doesn't wait if values were cached
+   ...
+   // in the main loop: once the module has been queried for real (not
+   // just revalidated in the background), refresh the cache
+   if (pending && ! (my_xbee.flags & (XBEE_DEV_FLAG_QUERY_CACHED
+                                     | XBEE_DEV_FLAG_QUERY_INPROGRESS)))
+   {
+      pending = FALSE;
+      xbee_dev_cache_save( &my_xbee, NULL);
+   }
+   @endcode
+
+   Cache entries are keyed by serial port.  The cached IEEE address,
+   hardware and firmware versions are confirmed in the background by
+   xbee_cmd_init_device(), and the device is queried from scratch if a
+   different module (or firmware) is attached.
+*/
+
+#ifndef XBEE_DEVICE_CACHE_H
+#define XBEE_DEVICE_CACHE_H
+
+#include "xbee/device.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_DEV_CACHE_PATH
+   /// Default cache file used when NULL is passed as the \a path.
+   #define XBEE_DEV_CACHE_PATH   "xbee_device.cache"
+#endif
+
+// documented in ports/posix/xbee_device_cache_posix.c
+int xbee_dev_cache_load( xbee_dev_t *xbee, const char *path);
+int xbee_dev_cache_save( const xbee_dev_t *xbee, const char *path);
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
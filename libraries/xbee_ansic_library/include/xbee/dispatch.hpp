@@ -0,0 +1,164 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_device
+   @{
+   @file xbee/dispatch.hpp
+   Frame dispatch resolved at compile time (C++17).
+
+   Handlers are listed as a type, and Dispatch<> expands them into a chain
+   of comparisons against constant frame types that the compiler turns into
+   a single switch, with each handler inlined:
+
+   @code
+   struct TxStatusFn {
+      int operator()( xbee_dev_t &, const xbee_frame_transmit_status_t &status,
+         xbee::span<const uint8_t>) const;
+   };
+   struct RxFn {
+      int operator()( xbee_dev_t &, const xbee_frame_receive_explicit_t &frame,
+         xbee::span<const uint8_t> payload) const;
+   };
+   using Handlers = xbee::Dispatch<
+      xbee::On<XBEE_FRAME_TRANSMIT_STATUS, TxStatusFn>,
+      xbee::On<XBEE_FRAME_RECEIVE_EXPLICIT, RxFn>>;
+
+   static const auto table = xbee::make_dispatch_table(
+      Handlers::entry(), xbee::handle_local_at);
+   @endcode
+
+   The device's dispatch table then holds one entry for all of the typed
+   handlers instead of one per frame type, so _xbee_frame_dispatch() makes
+   a single indirect call per frame.  Handlers get a reference to the frame
+   struct and a span of the bytes that follow it, and frames shorter than
+   the struct are dropped.
+
+   Handler types must be default constructible; they're constructed for
+   each frame, so keep state in static storage.  With C++20, the type of a
+   captureless lambda works (<tt>On<XBEE_FRAME_RECEIVE, decltype(fn)></tt>).
+*/
+
+#ifndef XBEE_DISPATCH_HPP
+#define XBEE_DISPATCH_HPP
+
+#include "xbee/device.hpp"
+
+namespace xbee {
+
+/**
+   Frame struct for each API frame type, used by On<> when the struct isn't
+   given explicitly.  Specialize for other frame types as needed.
+*/
+template <uint8_t FrameType>
+struct frame_for;
+
+template <>
+struct frame_for<XBEE_FRAME_LOCAL_AT_RESPONSE> {
+   using type = xbee_frame_local_at_resp_t;
+};
+template <>
+struct frame_for<XBEE_FRAME_MODEM_STATUS> {
+   using type = xbee_frame_modem_status_t;
+};
+template <>
+struct frame_for<XBEE_FRAME_TRANSMIT_STATUS> {
+   using type = xbee_frame_transmit_status_t;
+};
+template <>
+struct frame_for<XBEE_FRAME_RECEIVE> {
+   using type = xbee_frame_receive_t;
+};
+template <>
+struct frame_for<XBEE_FRAME_RECEIVE_EXPLICIT> {
+   using type = xbee_frame_receive_explicit_t;
+};
+template <>
+struct frame_for<XBEE_FRAME_REMOTE_AT_RESPONSE> {
+   using type = xbee_frame_remote_at_resp_t;
+};
+
+/**
+   Bind \a Handler to frames of type \a FrameType (and, if not 0, only to
+   frames with ID \a FrameId).  \a Frame defaults to the struct from
+   frame_for<FrameType>.
+*/
+template <uint8_t FrameType, typename Handler,
+   typename Frame = typename frame_for<FrameType>::type, uint8_t FrameId = 0>
+struct On {
+   static constexpr uint8_t frame_type = FrameType;
+   static constexpr uint8_t frame_id = FrameId;
+   static constexpr std::size_t header_size = frame_traits<Frame>::header_size;
+
+   static_assert( std::is_invocable_r_v<int, const Handler &, xbee_dev_t &,
+      const Frame &, span<const uint8_t>>,
+      "handler must be callable as int( xbee_dev_t &, const Frame &, "
+      "xbee::span<const uint8_t>) const");
+
+   /// Call the handler if the frame matches; returns 1 if it was called.
+   static int call( xbee_dev_t &xbee, const uint8_t FAR *frame,
+      uint16_t length) noexcept( std::is_nothrow_invocable_v<const Handler &,
+         xbee_dev_t &, const Frame &, span<const uint8_t>>)
+   {
+      if (length < header_size || (FrameId && frame[1] != FrameId))
+      {
+         return 0;
+      }
+
+      Handler{}( xbee, *reinterpret_cast<const Frame FAR *>( frame),
+         span<const uint8_t>( frame + header_size, length - header_size));
+      return 1;
+   }
+};
+
+/**
+   Dispatcher for a list of On<> bindings.  Frames are passed to every
+   binding that matches, in the order listed.
+*/
+template <typename... Bindings>
+struct Dispatch {
+   /**
+      Pass a frame to the matching handlers.
+
+      @param[in]  xbee     device that received the frame
+      @param[in]  frame    frame, starting with the frame type byte
+      @param[in]  length   number of bytes in \a frame
+
+      @return  number of handlers called
+   */
+   static int dispatch( xbee_dev_t &xbee, const uint8_t FAR *frame,
+      uint16_t length)
+   {
+      const uint8_t frame_type = frame[0];
+      int dispatched = 0;
+
+      ((frame_type == Bindings::frame_type
+         ? (void)(dispatched += Bindings::call( xbee, frame, length))
+         : (void)0), ...);
+
+      return dispatched;
+   }
+
+   /// xbee_frame_handler_fn for the device's dispatch table.
+   static int handler( xbee_dev_t *xbee, const void FAR *raw,
+      uint16_t length, void FAR *context)
+   {
+      XBEE_UNUSED_PARAMETER( context);
+      return dispatch( *xbee, static_cast<const uint8_t FAR *>( raw), length);
+   }
+
+   /// Dispatch table entry (matching all frame types) that calls handler().
+   static constexpr xbee_dispatch_table_entry_t entry() noexcept
+   {
+      return { 0, 0, &handler, nullptr };
+   }
+};
+
+} // namespace xbee
+
+#endif
+
+///@}
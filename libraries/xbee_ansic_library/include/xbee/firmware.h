@@ -40,6 +40,15 @@ typedef struct xbee_fw_oem_state_t {
    uint16_t          block_length;
 } xbee_fw_oem_state_t;
 
+/// Size of each Xmodem packet buffer in xbee_fw_source_t.  Define
+/// XBEE_FW_XMODEM_1K to offer 1K blocks to the bootloader (falling back to
+/// 128-byte blocks if it doesn't take them).
+#ifdef XBEE_FW_XMODEM_1K
+   #define XBEE_FW_XMODEM_BUFFER    (1024+5)
+#else
+   #define XBEE_FW_XMODEM_BUFFER    (128+5)
+#endif
+
 typedef struct xbee_fw_source_t
 {
    xbee_dev_t           *xbee;
@@ -52,8 +61,9 @@ typedef struct xbee_fw_source_t
       xbee_xmodem_state_t  xbxm;       // sub-status of xmodem transfer
       xbee_fw_oem_state_t  oem;        // sub-status of oem transfer
    } u;
-   char                 buffer[128+5]; // buffer for xmodem packet, must persist
-                                       // for duration of update
+   // buffers for xmodem packets, must persist for duration of update
+   char                 buffer[XBEE_FW_XMODEM_BUFFER];
+   char                 next_buffer[XBEE_FW_XMODEM_BUFFER];
    int      (*seek)( void FAR *context, uint32_t offset);
    int      (*read)( void FAR *context, void FAR *buffer, int16_t bytes);
    void           FAR *context;     // spot to hold user data
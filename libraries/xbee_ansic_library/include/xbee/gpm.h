@@ -19,6 +19,9 @@
    self-addressed frame, or a frame addressed to a remote node.
 */
 
+#ifndef XBEE_GPM_H
+#define XBEE_GPM_H
+
 #include "xbee/platform.h"
 #include "xbee/device.h"
 #include "wpan/aps.h"
@@ -121,3 +124,4 @@ int xbee_gpm_firmware_verify( const wpan_envelope_t *envelope);
 
 int xbee_gpm_firmware_install( const wpan_envelope_t *envelope);
 
+#endif
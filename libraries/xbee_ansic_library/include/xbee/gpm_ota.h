@@ -0,0 +1,159 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @file xbee/gpm_ota.h
+   Stage a firmware image in the General Purpose Memory of many remote
+   nodes at once, then have each node verify (and optionally install) it.
+*/
+
+#ifndef XBEE_GPM_OTA_H
+#define XBEE_GPM_OTA_H
+
+#include "xbee/gpm.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_GPM_OTA_PARALLEL
+   /// Default number of nodes updated concurrently.
+   #define XBEE_GPM_OTA_PARALLEL    8
+#endif
+
+#ifndef XBEE_GPM_OTA_WINDOW
+   /// Maximum number of GPM write requests in flight to each node.
+   #define XBEE_GPM_OTA_WINDOW      4
+#endif
+
+#ifndef XBEE_GPM_OTA_TIMEOUT
+   /// Default milliseconds to wait for each GPM response.
+   #define XBEE_GPM_OTA_TIMEOUT     3000
+#endif
+
+#ifndef XBEE_GPM_OTA_ERASE_TIMEOUT
+   /// Milliseconds to wait for a node to erase its GPM.
+   #define XBEE_GPM_OTA_ERASE_TIMEOUT  15000
+#endif
+
+#ifndef XBEE_GPM_OTA_RETRIES
+   /// Default number of times to resend each request before giving up on
+   /// the node.
+   #define XBEE_GPM_OTA_RETRIES     3
+#endif
+
+/// Values for \c state member of xbee_gpm_ota_node_t
+enum xbee_gpm_ota_state {
+   XBEE_GPM_OTA_STATE_WAITING,      ///< not started yet
+   XBEE_GPM_OTA_STATE_INFO,         ///< waiting for platform info
+   XBEE_GPM_OTA_STATE_ERASE,        ///< waiting for GPM erase
+   XBEE_GPM_OTA_STATE_WRITE,        ///< writing the image
+   XBEE_GPM_OTA_STATE_VERIFY,       ///< waiting for firmware verify
+   XBEE_GPM_OTA_STATE_INSTALL,      ///< waiting for firmware install
+   XBEE_GPM_OTA_STATE_DONE          ///< took the image
+};
+
+/// One write request to a node, either in flight or waiting to be resent.
+typedef struct xbee_gpm_ota_write_t {
+   uint32_t    offset;     ///< offset into the image
+   uint32_t    sent;       ///< xbee_millisecond_timer() when sent
+   uint16_t    length;     ///< bytes in this write (0 = slot unused)
+   uint8_t     tries;      ///< times sent so far
+   uint8_t     rejects;    ///< times the node responded with an error
+   bool_t      pending;    ///< needs to be (re)sent
+} xbee_gpm_ota_write_t;
+
+/**
+   One remote node to update.  The caller supplies an array of these to
+   xbee_gpm_ota_start(), with \c ieee set.
+*/
+typedef struct xbee_gpm_ota_node_t {
+   /// 64-bit address of the node
+   addr64                  ieee;
+
+   /// -EBUSY until the node is finished, then 0 if it took the image, or
+   /// -ETIMEDOUT if it stopped responding, -ENOSPC if the image doesn't fit
+   /// in its GPM, or -EIO if it reported an error (or kept rejecting a write)
+   int                     status;
+
+   /// one of XBEE_GPM_OTA_STATE_* (for a failed node, the state it failed in)
+   uint8_t                 state;
+   uint8_t                 tries;         ///< sends of current command
+   uint32_t                sent;          ///< when current command was sent
+   uint16_t                block_size;    ///< node's GPM block size
+   uint32_t                next_offset;   ///< next image offset to write
+   uint32_t                written;       ///< bytes confirmed (progress)
+   uint16_t                resends;       ///< write requests sent again
+
+   /// writes in flight
+   xbee_gpm_ota_write_t    window[XBEE_GPM_OTA_WINDOW];
+} xbee_gpm_ota_node_t;
+
+/**
+   State of a GPM update.  Must stay in scope (typically static) until
+   xbee_gpm_ota_tick() stops returning -EBUSY, since the GPM response
+   handler references it.
+*/
+typedef struct xbee_gpm_ota_t {
+   wpan_dev_t                 *dev;       ///< local device
+   const uint8_t        FAR   *image;     ///< image to send, shared by nodes
+   uint32_t                   length;     ///< bytes in \c image
+   xbee_gpm_ota_node_t        *nodes;     ///< nodes to update
+
+   /// Milliseconds to wait for each response.  Defaults to
+   /// #XBEE_GPM_OTA_TIMEOUT, may be changed before the first tick.
+   uint16_t          timeout;
+
+   /// Bytes per write request.  Defaults to xbee_gpm_max_write(), may be
+   /// lowered before the first tick.
+   uint16_t          chunk_size;
+
+   uint16_t          flags;
+      /// send FIRMWARE_INSTALL to each node after it verifies the image
+      #define XBEE_GPM_OTA_FLAG_INSTALL      0x0001
+
+   uint8_t           node_count;    ///< number of entries in \c nodes
+   uint8_t           next_node;     ///< next node to start
+
+   /// Nodes updated concurrently.  Defaults to #XBEE_GPM_OTA_PARALLEL,
+   /// may be changed before the first tick.
+   uint8_t           parallel;
+
+   /// Write requests in flight per node.  Defaults to (and can't exceed)
+   /// #XBEE_GPM_OTA_WINDOW, may be lowered before the first tick.
+   uint8_t           window;
+
+   /// Times to resend each request.  Defaults to #XBEE_GPM_OTA_RETRIES,
+   /// may be changed before the first tick.
+   uint8_t           retries;
+
+   uint8_t           active;        ///< nodes started but not done
+   uint8_t           succeeded;     ///< nodes finished with status 0
+   uint8_t           failed;        ///< nodes finished with an error
+
+   /// -EBUSY while running, 0 on success, -EIO if any node failed.
+   int               status;
+} xbee_gpm_ota_t;
+
+// all functions are documented in xbee_gpm_ota.c
+int xbee_gpm_ota_start( xbee_gpm_ota_t *ota, wpan_dev_t *dev,
+   const void FAR *image, uint32_t length,
+   xbee_gpm_ota_node_t *nodes, uint_fast8_t node_count, uint16_t flags);
+int xbee_gpm_ota_tick( xbee_gpm_ota_t *ota);
+int xbee_gpm_ota_response( const wpan_envelope_t FAR *envelope,
+   void FAR *context);
+void xbee_gpm_ota_report( const xbee_gpm_ota_t *ota);
+
+/// Current status of \a ota (-EBUSY while running).
+#define xbee_gpm_ota_status(ota)    ((ota)->status)
+
+/// Cluster table entry for the WPAN_ENDPOINT_DIGI_DEVICE endpoint, passing
+/// GPM responses to the xbee_gpm_ota_t \a ota.
+#define XBEE_GPM_OTA_CLUST_ENTRY(ota) \
+   { DIGI_CLUST_MEMORY_ACCESS, xbee_gpm_ota_response, &(ota), \
+      WPAN_CLUST_FLAG_INOUT | WPAN_CLUST_FLAG_NOT_ZCL }
+
+XBEE_END_DECLS
+
+#endif
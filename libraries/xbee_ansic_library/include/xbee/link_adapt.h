@@ -0,0 +1,179 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_wpan
+   @{
+   @file xbee/link_adapt.h
+   Adjust send rate, payload size and addressing mode to link quality.
+
+   The controller watches Transmit Status frames and the received signal
+   strength reported by periodic \c ATDB queries, and adjusts:
+
+   - \c rate: sends per second.  It grows by #XBEE_LINK_ADAPT_RATE_STEP after
+     every #XBEE_LINK_ADAPT_INCREASE_AFTER clean deliveries and halves on
+     each failure (AIMD).
+   - \c payload: bytes to aggregate into each frame.  It grows the same way,
+     up to the module's maximum payload.  It halves on a failure, on a weak
+     signal, or when deliveries need several retries.  Shorter frames spend
+     less air-time per attempt at the edge of range.
+   - \c broadcast: set after #XBEE_LINK_ADAPT_BROADCAST_AFTER consecutive
+     unicast failures, so any receiver in range can pick up the data.  Every
+     #XBEE_LINK_ADAPT_PROBE_MS the controller tries unicast again.
+
+   @code
+   xbee_link_adapt_t adapt;
+
+   const xbee_dispatch_table_entry_t xbee_frame_handlers[] = {
+      XBEE_FRAME_HANDLE_LOCAL_AT,
+      XBEE_LINK_ADAPT_FRAME_HANDLE_TRANSMIT_STATUS( &adapt),
+      XBEE_FRAME_TABLE_END
+   };
+
+   xbee_link_adapt_init( &adapt, &my_xbee);
+   for (;;)
+   {
+      xbee_dev_tick( &my_xbee);
+      xbee_link_adapt_tick( &adapt);
+      length = xbee_link_adapt_due( &adapt);
+      if (length > 0)
+      {
+         // send up to <length> bytes, broadcast if adapt.broadcast is set
+      }
+   }
+   @endcode
+
+   All Transmit Status frames from the device count, so use a separate
+   device for traffic that shouldn't steer the controller.
+*/
+
+#ifndef XBEE_LINK_ADAPT_H
+#define XBEE_LINK_ADAPT_H
+
+#include "xbee/wpan.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_LINK_ADAPT_RATE_MIN
+   /// Lowest send rate (sends per second).
+   #define XBEE_LINK_ADAPT_RATE_MIN          1
+#endif
+
+#ifndef XBEE_LINK_ADAPT_RATE_MAX
+   /// Highest send rate (sends per second).
+   #define XBEE_LINK_ADAPT_RATE_MAX          100
+#endif
+
+#ifndef XBEE_LINK_ADAPT_RATE_START
+   /// Send rate after xbee_link_adapt_init().
+   #define XBEE_LINK_ADAPT_RATE_START        10
+#endif
+
+#ifndef XBEE_LINK_ADAPT_RATE_STEP
+   /// Sends per second added on each increase.
+   #define XBEE_LINK_ADAPT_RATE_STEP         2
+#endif
+
+#ifndef XBEE_LINK_ADAPT_PAYLOAD_MIN
+   /// Smallest payload the controller asks for.
+   #define XBEE_LINK_ADAPT_PAYLOAD_MIN       16
+#endif
+
+#ifndef XBEE_LINK_ADAPT_PAYLOAD_MAX
+   /// Largest payload if the device hasn't reported \c ATNP.
+   #define XBEE_LINK_ADAPT_PAYLOAD_MAX       100
+#endif
+
+#ifndef XBEE_LINK_ADAPT_PAYLOAD_STEP
+   /// Bytes added to the payload on each increase.
+   #define XBEE_LINK_ADAPT_PAYLOAD_STEP      8
+#endif
+
+#ifndef XBEE_LINK_ADAPT_INCREASE_AFTER
+   /// Clean deliveries needed before each increase.
+   #define XBEE_LINK_ADAPT_INCREASE_AFTER    8
+#endif
+
+#ifndef XBEE_LINK_ADAPT_WEAK_RSSI
+   /// \c ATDB value (-dBm) at or above which the signal counts as weak.
+   #define XBEE_LINK_ADAPT_WEAK_RSSI         85
+#endif
+
+#ifndef XBEE_LINK_ADAPT_DB_MS
+   /// Milliseconds between \c ATDB queries.
+   #define XBEE_LINK_ADAPT_DB_MS             2000
+#endif
+
+#ifndef XBEE_LINK_ADAPT_BROADCAST_AFTER
+   /// Consecutive unicast failures before switching to broadcast.
+   #define XBEE_LINK_ADAPT_BROADCAST_AFTER   4
+#endif
+
+#ifndef XBEE_LINK_ADAPT_PROBE_MS
+   /// Milliseconds in broadcast mode before trying unicast again.
+   #define XBEE_LINK_ADAPT_PROBE_MS          5000
+#endif
+
+typedef struct xbee_link_adapt_t {
+   xbee_dev_t     *xbee;
+
+   // controller output
+   uint16_t       rate;             ///< sends per second
+   uint16_t       payload;          ///< bytes to aggregate per send
+   bool_t         broadcast;        ///< send as broadcast instead of unicast
+
+   // link quality
+   uint8_t        rssi;             ///< last \c ATDB (-dBm), 0 if unknown
+   uint16_t       loss_permille;    ///< recent loss rate (moving average)
+   uint16_t       retries_x16;      ///< recent retries per frame, times 16
+   uint8_t        consecutive_failures;
+
+   // counters
+   uint32_t       delivered;        ///< Transmit Status of SUCCESS
+   uint32_t       failed;           ///< any other Transmit Status
+   uint32_t       increases;        ///< additive increases applied
+   uint32_t       decreases;        ///< multiplicative decreases applied
+
+   // internal state
+   uint16_t       payload_max;      ///< \c ATNP or #XBEE_LINK_ADAPT_PAYLOAD_MAX
+   uint8_t        clean;            ///< clean deliveries since last increase
+   int16_t        db_handle;        ///< outstanding \c ATDB request, or -1
+   uint32_t       last_send_ms;
+   uint32_t       last_db_ms;
+   uint32_t       broadcast_ms;     ///< when broadcast mode started
+} xbee_link_adapt_t;
+
+// documented in xbee_link_adapt.c
+int xbee_link_adapt_init( xbee_link_adapt_t *adapt, xbee_dev_t *xbee);
+int xbee_link_adapt_tick( xbee_link_adapt_t *adapt);
+int xbee_link_adapt_due( xbee_link_adapt_t *adapt);
+void xbee_link_adapt_tx_status( xbee_link_adapt_t *adapt, uint8_t delivery,
+   uint8_t retries);
+void xbee_link_adapt_rssi( xbee_link_adapt_t *adapt, uint8_t rssi);
+void xbee_link_adapt_dump( const xbee_link_adapt_t *adapt);
+
+/**
+   @brief
+   Frame handler for 0x8B (XBEE_FRAME_TRANSMIT_STATUS) frames that feeds
+   the controller.  Use the XBEE_LINK_ADAPT_FRAME_HANDLE_TRANSMIT_STATUS()
+   macro in the frame handler table.
+
+   View the documentation of xbee_frame_handler_fn() for this function's
+   parameters and return value.
+*/
+int xbee_link_adapt_handle_transmit_status( xbee_dev_t *xbee,
+   const void FAR *frame, uint16_t length, void FAR *context);
+
+/// Frame handler table entry for a link controller.
+#define XBEE_LINK_ADAPT_FRAME_HANDLE_TRANSMIT_STATUS(adapt) \
+   { XBEE_FRAME_TRANSMIT_STATUS, 0, xbee_link_adapt_handle_transmit_status, \
+      adapt }
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
@@ -0,0 +1,123 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_pool Block Pool
+   Fixed-size block allocator for frame buffers, message envelopes and
+   other records that would otherwise come from malloc().
+   @ingroup util
+   @{
+   @file xbee/pool.h
+
+   A pool carves caller-supplied storage into equal blocks and keeps the free
+   ones on a linked list, so xbee_pool_alloc() and xbee_pool_free() are O(1)
+   and the heap never fragments.
+
+   Threads that allocate and free often can each keep an xbee_pool_cache_t.
+   It holds a few blocks and only takes the pool's lock to move half of
+   them at a time.
+
+   @code
+   #define MSG_SIZE    101
+   #define MSG_COUNT   50
+   static XBEE_POOL_STORAGE( msg_space, MSG_SIZE, MSG_COUNT);
+   static xbee_pool_t msg_pool;
+
+   xbee_pool_init( &msg_pool, msg_space, sizeof msg_space, MSG_SIZE);
+
+   char *msg = xbee_pool_alloc( &msg_pool);
+   ...
+   xbee_pool_free( &msg_pool, msg);
+   @endcode
+*/
+
+#ifndef XBEE_POOL_H
+#define XBEE_POOL_H
+
+#include "xbee/platform.h"
+
+XBEE_BEGIN_DECLS
+
+/// Blocks are aligned for any of these types.
+typedef union xbee_pool_align_t {
+   void FAR    *p;
+   uint32_t    u32;
+} xbee_pool_align_t;
+
+/// Size of each block for a requested \a size (rounded up for alignment).
+#define XBEE_POOL_BLOCK_SIZE(size) \
+   (((size) + sizeof(xbee_pool_align_t) - 1) \
+      / sizeof(xbee_pool_align_t) * sizeof(xbee_pool_align_t))
+
+/// Declare aligned storage for \a count blocks of \a size bytes.
+#define XBEE_POOL_STORAGE(name, size, count) \
+   xbee_pool_align_t name[XBEE_POOL_BLOCK_SIZE(size) * (count) \
+      / sizeof(xbee_pool_align_t)]
+
+/**
+   @def XBEE_POOL_LOCK
+   @def XBEE_POOL_UNLOCK
+   Protect a pool's free list.  GCC builds use a spinlock in the pool (held
+   for a few instructions); other targets disable interrupts.  Define both
+   in the platform header to use something else.
+*/
+#ifndef XBEE_POOL_LOCK
+   #if defined __GNUC__
+      #define XBEE_POOL_LOCK(pool) \
+         while (__atomic_test_and_set( &(pool)->lock, __ATOMIC_ACQUIRE)) {}
+      #define XBEE_POOL_UNLOCK(pool) \
+         __atomic_clear( &(pool)->lock, __ATOMIC_RELEASE)
+   #else
+      #define XBEE_POOL_LOCK(pool)     INTERRUPT_DISABLE
+      #define XBEE_POOL_UNLOCK(pool)   INTERRUPT_ENABLE
+   #endif
+#endif
+
+typedef struct xbee_pool_t {
+   uint8_t  FAR   *start;        ///< first block
+   uint8_t  FAR   *end;          ///< byte after the last block
+   void     FAR   *free_list;    ///< next free block, or NULL
+   uint16_t       block_size;    ///< bytes per block (after rounding)
+   uint16_t       blocks;        ///< total blocks
+   uint16_t       in_use;        ///< blocks allocated (including cached)
+   uint16_t       high_water;    ///< largest value of \c in_use
+   uint32_t       failures;      ///< allocations that found the pool empty
+   uint8_t        lock;          ///< used by XBEE_POOL_LOCK()
+} xbee_pool_t;
+
+#ifndef XBEE_POOL_CACHE_SIZE
+   /// Blocks held by each xbee_pool_cache_t.
+   #define XBEE_POOL_CACHE_SIZE     8
+#endif
+#if XBEE_POOL_CACHE_SIZE < 2 || XBEE_POOL_CACHE_SIZE > 255
+   #error "XBEE_POOL_CACHE_SIZE must be 2 to 255"
+#endif
+
+/// Per-thread stash of free blocks from one pool, set up with
+/// xbee_pool_cache_init().
+typedef struct xbee_pool_cache_t {
+   xbee_pool_t    *pool;
+   uint8_t        count;         ///< blocks in \c block
+   void  FAR      *block[XBEE_POOL_CACHE_SIZE];
+} xbee_pool_cache_t;
+
+// documented in xbee_pool.c
+int xbee_pool_init( xbee_pool_t *pool, void FAR *storage, size_t size,
+   uint16_t block_size);
+void FAR *xbee_pool_alloc( xbee_pool_t *pool);
+int xbee_pool_free( xbee_pool_t *pool, void FAR *block);
+bool_t xbee_pool_contains( const xbee_pool_t *pool, const void FAR *block);
+uint16_t xbee_pool_available( const xbee_pool_t *pool);
+void xbee_pool_cache_init( xbee_pool_cache_t *cache, xbee_pool_t *pool);
+void FAR *xbee_pool_cache_alloc( xbee_pool_cache_t *cache);
+int xbee_pool_cache_free( xbee_pool_cache_t *cache, void FAR *block);
+void xbee_pool_cache_flush( xbee_pool_cache_t *cache);
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
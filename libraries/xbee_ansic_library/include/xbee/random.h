@@ -10,8 +10,61 @@
  * ===========================================================================
  */
 
+#ifndef XBEE_RANDOM_H
+#define XBEE_RANDOM_H
+
 #include <stdlib.h>
 #include "xbee/platform.h"
+#include "mbedtls/ctr_drbg.h"
+
+XBEE_BEGIN_DECLS
+
+/**
+    @def XBEE_RANDOM_LOCK
+    @def XBEE_RANDOM_UNLOCK
+    Protect the shared entropy source (and the shared stream behind
+    xbee_random(), unless it's thread-local).  GCC builds use a spinlock;
+    other targets disable interrupts.  Define both in the platform header to
+    use something else.
+*/
+#ifndef XBEE_RANDOM_LOCK
+    #if defined __GNUC__
+        #define XBEE_RANDOM_LOCK(flag) \
+            while (__atomic_test_and_set(&(flag), __ATOMIC_ACQUIRE)) {}
+        #define XBEE_RANDOM_UNLOCK(flag) \
+            __atomic_clear(&(flag), __ATOMIC_RELEASE)
+    #else
+        #define XBEE_RANDOM_LOCK(flag)      INTERRUPT_DISABLE
+        #define XBEE_RANDOM_UNLOCK(flag)    INTERRUPT_ENABLE
+    #endif
+#endif
+
+/**
+    @def XBEE_RANDOM_THREAD_LOCAL
+    Storage class (for example \c __thread) that gives each thread its own
+    stream for xbee_random(), so it never takes a lock.  Leave undefined to
+    share one stream between threads.
+*/
+
+#ifndef XBEE_RANDOM_BUFFER_SIZE
+    /// Bytes an xbee_random_stream_t generates at a time.
+    #define XBEE_RANDOM_BUFFER_SIZE     1024
+#endif
+#if XBEE_RANDOM_BUFFER_SIZE < 16 || XBEE_RANDOM_BUFFER_SIZE % 16 \
+    || XBEE_RANDOM_BUFFER_SIZE > MBEDTLS_CTR_DRBG_MAX_REQUEST
+    #error "XBEE_RANDOM_BUFFER_SIZE must be a multiple of 16, up to " \
+        "MBEDTLS_CTR_DRBG_MAX_REQUEST"
+#endif
+
+/// CTR-DRBG seeded from the shared entropy source, with a buffer of bytes
+/// it has generated.  Not thread-safe; give each thread its own (for
+/// example, a \c __thread variable).  A zeroed stream is seeded on first use.
+typedef struct xbee_random_stream_t {
+    mbedtls_ctr_drbg_context    drbg;
+    bool_t                      seeded;
+    uint16_t                    avail;      ///< unused bytes at end of buffer
+    uint8_t                     buffer[XBEE_RANDOM_BUFFER_SIZE];
+} xbee_random_stream_t;
 
 /**
     @brief
@@ -23,6 +76,15 @@
     @retval     0       Success
     @retval     <0      Failure
 
-    @sa xbee_random_init
+    @sa xbee_random_stream
 */
 int xbee_random(void *output, size_t output_len);
+
+// documented in xbee_random_mbedtls.c
+int xbee_random_stream(xbee_random_stream_t *stream,
+                       void *output, size_t output_len);
+void xbee_random_stream_free(xbee_random_stream_t *stream);
+
+XBEE_END_DECLS
+
+#endif // XBEE_RANDOM_H
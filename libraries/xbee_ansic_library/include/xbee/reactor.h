@@ -0,0 +1,84 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_device
+   @{
+   @file xbee/reactor.h
+   Drive several XBee devices from one thread.
+
+   Instead of calling xbee_dev_tick() on every device in a busy loop, register
+   the devices with a reactor and call xbee_reactor_poll().  It sleeps until
+   at least one serial port has data (or the timeout expires), then ticks
+   only the devices that are ready.
+
+   Each ready device gets one xbee_dev_tick() per round, which dispatches at
+   most #XBEE_DEV_MAX_DISPATCH_PER_TICK frames.  Rounds start with a
+   different device each time.  A radio with a constant stream of frames
+   therefore can't starve the others; its leftover data is handled on the
+   next round.
+
+   @code
+   xbee_reactor_t reactor;
+
+   xbee_reactor_init( &reactor);
+   xbee_reactor_add( &reactor, &radio_a);
+   xbee_reactor_add( &reactor, &radio_b);
+   for (;;)
+   {
+      xbee_reactor_poll( &reactor, 100);
+   }
+   @endcode
+*/
+
+#ifndef XBEE_REACTOR_H
+#define XBEE_REACTOR_H
+
+#include "xbee/device.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_REACTOR_MAX_DEVICES
+   /// Maximum number of devices registered with one reactor.
+   #define XBEE_REACTOR_MAX_DEVICES    8
+#endif
+
+/// Per-device counters kept by the reactor.
+typedef struct xbee_reactor_stats_t {
+   uint32_t    wakeups;       ///< times the serial port was reported ready
+   uint32_t    ticks;         ///< calls to xbee_dev_tick()
+   uint32_t    frames;        ///< frames dispatched
+   uint32_t    deferred;      ///< ticks that hit the per-tick frame limit
+   uint32_t    errors;        ///< ticks that returned an error
+   uint32_t    last_frame_ms; ///< xbee_millisecond_timer() at last frame
+} xbee_reactor_stats_t;
+
+typedef struct xbee_reactor_t {
+   int                  epoll_fd;      ///< -1 if not initialized
+   uint8_t              count;         ///< entries used in \c device
+   uint8_t              next;          ///< first device of the next round
+
+   /// Registered devices (NULL for unused entries).
+   xbee_dev_t           *device[XBEE_REACTOR_MAX_DEVICES];
+
+   /// Counters for the device at the same index in \c device.
+   xbee_reactor_stats_t stats[XBEE_REACTOR_MAX_DEVICES];
+} xbee_reactor_t;
+
+// documented in ports/posix/xbee_reactor_posix.c
+int xbee_reactor_init( xbee_reactor_t *reactor);
+void xbee_reactor_close( xbee_reactor_t *reactor);
+int xbee_reactor_add( xbee_reactor_t *reactor, xbee_dev_t *xbee);
+int xbee_reactor_remove( xbee_reactor_t *reactor, xbee_dev_t *xbee);
+int xbee_reactor_poll( xbee_reactor_t *reactor, int timeout_ms);
+const xbee_reactor_stats_t *xbee_reactor_stats( const xbee_reactor_t *reactor,
+   const xbee_dev_t *xbee);
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
@@ -0,0 +1,127 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_device
+   @{
+   @file xbee/shm_bus.h
+   Publish received frames to other processes through shared memory.
+
+   Only one process can own the serial port.  It creates a bus and adds
+   XBEE_SHM_BUS_FRAME_HANDLER() to its dispatch table.  Every frame it
+   receives is then copied once into a ring of fixed-size slots in a POSIX
+   shared memory object.
+
+   Any number of local processes (dashboards, loggers, alerting) attach
+   read-only and follow the ring at their own pace.  Each slot carries a
+   sequence counter that the publisher makes odd while it writes and even
+   when it finishes, so a reader can use a frame in place and then check
+   whether it was overwritten in the meantime.  Readers keep their position
+   in their own memory.  They never write to the bus, and the publisher
+   never waits for them.  A reader that falls more than a ring behind skips
+   ahead and counts the frames it missed.
+
+   @code
+   // radio process
+   xbee_shm_bus_t bus;
+   xbee_shm_bus_create( &bus, "/xbee0", 0);
+   const xbee_dispatch_table_entry_t xbee_frame_handlers[] = {
+      XBEE_SHM_BUS_FRAME_HANDLER( &bus),
+      ...
+   };
+
+   // consumer process
+   xbee_shm_bus_reader_t reader;
+   const xbee_shm_bus_slot_t *slot;
+
+   xbee_shm_bus_attach( &reader, "/xbee0");
+   for (;;)
+   {
+      if ((slot = xbee_shm_bus_peek( &reader)) != NULL)
+      {
+         handle( slot->data, slot->length);
+         xbee_shm_bus_release( &reader);
+      }
+   }
+   @endcode
+*/
+
+#ifndef XBEE_SHM_BUS_H
+#define XBEE_SHM_BUS_H
+
+#include "xbee/device.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_SHM_BUS_SLOTS
+   /// Default number of slots in the ring (a power of 2).
+   #define XBEE_SHM_BUS_SLOTS       1024
+#endif
+
+/// Largest frame a slot holds.
+#define XBEE_SHM_BUS_FRAME_MAX      XBEE_MAX_RX_FRAME_LEN
+
+/// One frame in the ring, padded to a multiple of 64 bytes.
+typedef struct xbee_shm_bus_slot_t {
+   /// 2 * n + 1 while frame n is being written, 2 * n + 2 once it's ready
+   uint64_t    sequence;
+   uint32_t    timestamp_ms;     ///< xbee_millisecond_timer() at publish
+   uint16_t    length;           ///< bytes in \c data
+   uint8_t     data[(XBEE_SHM_BUS_FRAME_MAX + 14 + 63) / 64 * 64 - 14];
+} xbee_shm_bus_slot_t;
+
+/// Start of the shared memory object, followed by the slots.
+typedef struct xbee_shm_bus_header_t {
+   uint32_t    magic;            ///< set last, once the bus is ready
+   uint16_t    version;
+   uint16_t    slot_size;        ///< sizeof(xbee_shm_bus_slot_t)
+   uint32_t    slots;            ///< power of 2
+   uint32_t    publisher_pid;
+   uint64_t    published;        ///< frames published so far
+   uint8_t     pad[64 - 3 * sizeof(uint32_t) - 2 * sizeof(uint16_t)
+                     - sizeof(uint64_t)];
+} xbee_shm_bus_header_t;
+
+typedef struct xbee_shm_bus_t {
+   xbee_shm_bus_header_t   *header;
+   xbee_shm_bus_slot_t     *slot;
+   size_t                  size;
+   char                    name[64];
+} xbee_shm_bus_t;
+
+typedef struct xbee_shm_bus_reader_t {
+   const xbee_shm_bus_header_t   *header;
+   const xbee_shm_bus_slot_t     *slot;
+   size_t                        size;
+   uint64_t                      next;    ///< next frame to read
+   uint64_t                      lost;    ///< frames overwritten unread
+} xbee_shm_bus_reader_t;
+
+// documented in ports/posix/xbee_shm_bus_posix.c
+int xbee_shm_bus_create( xbee_shm_bus_t *bus, const char *name,
+   uint32_t slots);
+void xbee_shm_bus_destroy( xbee_shm_bus_t *bus);
+int xbee_shm_bus_publish( xbee_shm_bus_t *bus, const void FAR *frame,
+   uint16_t length);
+int xbee_shm_bus_frame_handler( xbee_dev_t *xbee, const void FAR *frame,
+   uint16_t length, void FAR *context);
+int xbee_shm_bus_attach( xbee_shm_bus_reader_t *reader, const char *name);
+void xbee_shm_bus_detach( xbee_shm_bus_reader_t *reader);
+const xbee_shm_bus_slot_t *xbee_shm_bus_peek(
+   xbee_shm_bus_reader_t *reader);
+int xbee_shm_bus_release( xbee_shm_bus_reader_t *reader);
+int xbee_shm_bus_read( xbee_shm_bus_reader_t *reader, void *buffer,
+   uint16_t size);
+
+/// Dispatch table entry that publishes every received frame to \a bus.
+#define XBEE_SHM_BUS_FRAME_HANDLER(bus) \
+   { 0, 0, xbee_shm_bus_frame_handler, bus }
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
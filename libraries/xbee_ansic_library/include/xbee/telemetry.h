@@ -0,0 +1,147 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_telemetry Telemetry Store
+   Columnar on-disk storage for sensor records received over the air.
+   @ingroup util
+   @{
+   @file xbee/telemetry.h
+
+   A remote sends a telemetry record as an RF payload: a timestamp plus one
+   32-bit value per sensor channel (see xbee_telemetry_wire_t).  The
+   receiver decodes it with xbee_telemetry_decode() and appends it to a
+   store with xbee_telemetry_append().
+
+   The store keeps rows in memory until #XBEE_TELEMETRY_CHUNK_ROWS have
+   arrived, then writes them as a chunk with one column for the timestamps
+   and one per channel.  Each column holds its first value, then the
+   zigzag-encoded differences between neighbours, bit-packed at the width
+   of the largest one.  Slowly changing sensors need a few bits per sample.
+
+   Each chunk also gets an entry in a sidecar index file (\c <path>.idx)
+   with its first and last timestamp.  Readers map both files and
+   binary-search the index, then decode only the chunks and columns a query
+   touches.
+
+   @code
+   xbee_telemetry_t store;
+   xbee_telemetry_record_t record;
+
+   xbee_telemetry_create( &store, "flight.xbt", 6);
+   // in the receive handler
+   if (xbee_telemetry_decode( payload, length, &record) == 0)
+   {
+      xbee_telemetry_append( &store, &record);
+   }
+   ...
+   xbee_telemetry_close( &store);
+
+   // later
+   xbee_telemetry_reader_t reader;
+   uint32_t t[100];
+   int32_t altitude[100];
+
+   xbee_telemetry_open( &reader, "flight.xbt");
+   n = xbee_telemetry_range( &reader, 60000, 120000, 2, t, altitude, 100);
+   @endcode
+*/
+
+#ifndef XBEE_TELEMETRY_H
+#define XBEE_TELEMETRY_H
+
+#include "xbee/platform.h"
+
+XBEE_BEGIN_DECLS
+
+#ifndef XBEE_TELEMETRY_MAX_CHANNELS
+   /// Maximum sensor channels in a record.
+   #define XBEE_TELEMETRY_MAX_CHANNELS    16
+#endif
+
+#ifndef XBEE_TELEMETRY_CHUNK_ROWS
+   /// Records buffered before writing a chunk.
+   #define XBEE_TELEMETRY_CHUNK_ROWS      1024
+#endif
+
+/// First byte of a telemetry RF payload.
+#define XBEE_TELEMETRY_WIRE_TYPE          0x54
+
+/// Over-the-air telemetry record; \c value_be has \c channels entries.
+typedef XBEE_PACKED(xbee_telemetry_wire_t, {
+   uint8_t     type;             ///< #XBEE_TELEMETRY_WIRE_TYPE
+   uint8_t     channels;         ///< number of entries in \c value_be
+   uint32_t    timestamp_be;     ///< sender's clock, in milliseconds
+   int32_t     value_be[1];      ///< sensor readings (variable length)
+}) xbee_telemetry_wire_t;
+
+/// Decoded telemetry record.
+typedef struct xbee_telemetry_record_t {
+   uint32_t    timestamp;
+   uint8_t     channels;
+   int32_t     value[XBEE_TELEMETRY_MAX_CHANNELS];
+} xbee_telemetry_record_t;
+
+/// Index entry for one chunk, stored little-endian in \c <path>.idx.
+typedef struct xbee_telemetry_index_t {
+   uint32_t    first;            ///< timestamp of the chunk's first row
+   uint32_t    last;             ///< timestamp of the chunk's last row
+   uint32_t    offset;           ///< chunk's offset in the data file
+   uint32_t    length;           ///< bytes in the chunk
+} xbee_telemetry_index_t;
+
+/// Store open for appending.
+typedef struct xbee_telemetry_t {
+   int         fd;               ///< data file
+   int         index_fd;         ///< index file
+   uint32_t    offset;           ///< size of the data file
+   uint32_t    chunks;           ///< chunks written
+   uint8_t     channels;         ///< channels per record
+   uint16_t    rows;             ///< rows in \c column
+   uint32_t    last;             ///< timestamp of the last record appended
+
+   /// Buffered rows: column 0 is the timestamp, then one per channel.
+   int32_t     column[XBEE_TELEMETRY_MAX_CHANNELS + 1]
+                     [XBEE_TELEMETRY_CHUNK_ROWS];
+} xbee_telemetry_t;
+
+/// Store mapped for queries.
+typedef struct xbee_telemetry_reader_t {
+   const uint8_t                 *data;
+   size_t                        data_size;
+   const xbee_telemetry_index_t  *index;
+   size_t                        index_size;
+   uint32_t                      chunks;
+   uint8_t                       channels;
+} xbee_telemetry_reader_t;
+
+/// Column number of the timestamps in xbee_telemetry_read_column().
+#define XBEE_TELEMETRY_TIME      0xFF
+
+// documented in ports/posix/xbee_telemetry_posix.c
+int xbee_telemetry_decode( const void FAR *payload, uint16_t length,
+   xbee_telemetry_record_t *record);
+int xbee_telemetry_create( xbee_telemetry_t *store, const char *path,
+   uint8_t channels);
+int xbee_telemetry_append( xbee_telemetry_t *store,
+   const xbee_telemetry_record_t *record);
+int xbee_telemetry_flush( xbee_telemetry_t *store);
+int xbee_telemetry_close( xbee_telemetry_t *store);
+int xbee_telemetry_open( xbee_telemetry_reader_t *reader, const char *path);
+void xbee_telemetry_reader_close( xbee_telemetry_reader_t *reader);
+int32_t xbee_telemetry_find( const xbee_telemetry_reader_t *reader,
+   uint32_t timestamp);
+int xbee_telemetry_read_column( const xbee_telemetry_reader_t *reader,
+   uint32_t chunk, uint8_t column, int32_t *values);
+int xbee_telemetry_range( const xbee_telemetry_reader_t *reader,
+   uint32_t from, uint32_t to, uint8_t channel, uint32_t *timestamps,
+   int32_t *values, int max);
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
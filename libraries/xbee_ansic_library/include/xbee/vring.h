@@ -0,0 +1,72 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_cbuf
+   @{
+   @file xbee/vring.h
+   Circular buffer whose pages are mapped twice, back to back (Linux).
+
+   Because byte <size> of the mapping is byte 0 of the buffer again, every
+   run of buffered bytes is contiguous in memory, even when it wraps.  A
+   frame can be parsed, checksummed and dispatched where it sits, and reads
+   and writes are always a single memcpy() or read().
+
+   Head and tail use the same acquire/release protocol as xbee_cbuf_spsc_t,
+   so one thread can fill the ring while another parses it.
+
+   @code
+   xbee_vring_t rx;
+
+   xbee_vring_init( &rx, 0);              // one page
+   for (;;)
+   {
+      // replaces xbee_dev_tick(); frames are dispatched from the ring
+      xbee_vring_dev_tick( &my_xbee, &rx);
+   }
+   @endcode
+*/
+
+#ifndef XBEE_VRING_H
+#define XBEE_VRING_H
+
+#include "xbee/device.h"
+
+XBEE_BEGIN_DECLS
+
+typedef struct xbee_vring_t {
+   unsigned int   tail;          ///< bytes written, free-running
+   unsigned int   head;          ///< bytes read, free-running
+   unsigned int   size;          ///< bytes in the buffer, a power of 2
+   uint8_t        *base;         ///< start of 2 * \c size byte mapping
+
+   uint32_t       bad_frames;    ///< frames dropped for a bad checksum
+   uint32_t       skipped;       ///< bytes skipped while looking for 0x7E
+} xbee_vring_t;
+
+// documented in ports/posix/xbee_vring_posix.c
+int xbee_vring_init( xbee_vring_t *vring, unsigned int size);
+void xbee_vring_close( xbee_vring_t *vring);
+unsigned int xbee_vring_used( xbee_vring_t *vring);
+unsigned int xbee_vring_free( xbee_vring_t *vring);
+void *xbee_vring_reserve( xbee_vring_t *vring, unsigned int *length);
+void xbee_vring_commit( xbee_vring_t *vring, unsigned int length);
+const void *xbee_vring_peek( xbee_vring_t *vring, unsigned int *length);
+void xbee_vring_consume( xbee_vring_t *vring, unsigned int length);
+unsigned int xbee_vring_put( xbee_vring_t *vring, const void *buffer,
+   unsigned int length);
+unsigned int xbee_vring_get( xbee_vring_t *vring, void *buffer,
+   unsigned int length);
+int xbee_vring_read( xbee_vring_t *vring, int fd);
+const uint8_t *xbee_vring_frame( xbee_vring_t *vring, uint16_t *length);
+void xbee_vring_frame_done( xbee_vring_t *vring, uint16_t length);
+int xbee_vring_dev_tick( xbee_dev_t *xbee, xbee_vring_t *vring);
+
+XBEE_END_DECLS
+
+#endif
+
+///@}
@@ -0,0 +1,136 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_wpan
+   @{
+   @file xbee/wpan.hpp
+   constexpr builders for XBee transmit frame headers (C++17).
+
+   The builder handles the big-endian conversion of the network address,
+   cluster and profile, so a header for a fixed destination can be built
+   entirely at compile time:
+
+   @code
+   constexpr auto to_pits = xbee::TransmitExplicit()
+      .dest( xbee::make_addr64( 0x0013A20040A1B2C3))
+      .cluster( DIGI_CLUST_SERIAL);
+
+   dev.send( to_pits, xbee::as_bytes( payload));
+   @endcode
+*/
+
+#ifndef XBEE_WPAN_HPP
+#define XBEE_WPAN_HPP
+
+#include "xbee/device.hpp"
+#include "wpan/aps.h"
+
+namespace xbee {
+
+/// Convert a 16-bit value between host and big-endian byte order.
+constexpr uint16_t be16( uint16_t value) noexcept
+{
+#if BYTE_ORDER == LITTLE_ENDIAN
+   return static_cast<uint16_t>( (value << 8) | (value >> 8));
+#else
+   return value;
+#endif
+}
+
+/// Build an addr64 from a 64-bit integer (e.g., 0x0013A20040A1B2C3).
+constexpr addr64 make_addr64( uint64_t value) noexcept
+{
+   return addr64{{
+      static_cast<uint8_t>( value >> 56), static_cast<uint8_t>( value >> 48),
+      static_cast<uint8_t>( value >> 40), static_cast<uint8_t>( value >> 32),
+      static_cast<uint8_t>( value >> 24), static_cast<uint8_t>( value >> 16),
+      static_cast<uint8_t>( value >> 8), static_cast<uint8_t>( value) }};
+}
+
+/// Broadcast address (00-00-00-00-00-00-FF-FF).
+constexpr addr64 addr64_broadcast = make_addr64( 0xFFFF);
+
+/**
+   xbee_header_transmit_explicit_t with constexpr setters.  Defaults to a
+   broadcast of serial data on the Digi data endpoint, the same frame
+   xbee_transparent_serial() would send.  Being derived from the C header
+   (without adding members), it can be passed anywhere the C type is used.
+*/
+struct TransmitExplicit : xbee_header_transmit_explicit_t {
+   constexpr TransmitExplicit() noexcept
+      : xbee_header_transmit_explicit_t{
+         XBEE_FRAME_TRANSMIT_EXPLICIT,
+         0,
+         addr64_broadcast,
+         be16( WPAN_NET_ADDR_UNDEFINED),
+         WPAN_ENDPOINT_DIGI_DATA,
+         WPAN_ENDPOINT_DIGI_DATA,
+         be16( DIGI_CLUST_SERIAL),
+         be16( WPAN_PROFILE_DIGI),
+         0,
+         0 }
+   {}
+
+   /// Frame ID for the Transmit Status response (0 to suppress it).
+   constexpr TransmitExplicit &frame( uint8_t id) noexcept
+   {
+      frame_id = id;
+      return *this;
+   }
+
+   /// Destination 64-bit and (optional) 16-bit network address.
+   constexpr TransmitExplicit &dest( const addr64 &ieee,
+      uint16_t network = WPAN_NET_ADDR_UNDEFINED) noexcept
+   {
+      ieee_address = ieee;
+      network_address_be = be16( network);
+      return *this;
+   }
+
+   constexpr TransmitExplicit &endpoints( uint8_t source,
+      uint8_t destination) noexcept
+   {
+      source_endpoint = source;
+      dest_endpoint = destination;
+      return *this;
+   }
+
+   constexpr TransmitExplicit &cluster( uint16_t cluster_id) noexcept
+   {
+      cluster_id_be = be16( cluster_id);
+      return *this;
+   }
+
+   constexpr TransmitExplicit &profile( uint16_t profile_id) noexcept
+   {
+      profile_id_be = be16( profile_id);
+      return *this;
+   }
+
+   /// Maximum hops for a broadcast (0 for the network maximum).
+   constexpr TransmitExplicit &radius( uint8_t hops) noexcept
+   {
+      broadcast_radius = hops;
+      return *this;
+   }
+
+   /// Combination of XBEE_TX_OPT_* macros.
+   constexpr TransmitExplicit &opts( uint8_t tx_options) noexcept
+   {
+      options = tx_options;
+      return *this;
+   }
+};
+
+static_assert( sizeof(TransmitExplicit) == sizeof(xbee_header_transmit_explicit_t),
+   "TransmitExplicit must have the same layout as the C header");
+
+} // namespace xbee
+
+#endif
+
+///@}
@@ -136,6 +136,12 @@ typedef struct xbee_xmodem_state_t
       #define XBEE_XMODEM_FLAG_1K         0x0200
       /// alternate macro name for #XBEE_XMODEM_FLAG_1K
       #define XBEE_XMODEM_FLAG_1024       XBEE_XMODEM_FLAG_1K
+      /// send 1K blocks if the receiver starts XMODEM-CRC, and drop back to
+      /// the block size above if it rejects the first one (requires
+      /// xbee_xmodem_set_prefetch() and 1029-byte buffers)
+      #define XBEE_XMODEM_FLAG_AUTO_1K    0x0400
+      /// receiver is getting 1K blocks negotiated by #XBEE_XMODEM_FLAG_AUTO_1K
+      #define XBEE_XMODEM_FLAG_SEND_1K    0x0800
 #ifdef XBEE_XMODEM_TESTING
       // Macros for testing both sides of the xmodem transfer code
       /// ignore the next ACK that comes in from the receiver
@@ -150,7 +156,8 @@ typedef struct xbee_xmodem_state_t
 
       /// mask of user-settable flags that can be passed to xbee_xmodem_tx_init
       #define XBEE_XMODEM_FLAG_USER       \
-         (XBEE_XMODEM_MASK_BLOCKSIZE | XBEE_XMODEM_FLAG_FORCE_CRC)
+         (XBEE_XMODEM_MASK_BLOCKSIZE | XBEE_XMODEM_FLAG_FORCE_CRC \
+            | XBEE_XMODEM_FLAG_AUTO_1K)
       ///@}
 
    /// current packet number; starts at 1 and low byte used in block headers
@@ -163,6 +170,13 @@ typedef struct xbee_xmodem_state_t
    uint_fast8_t               tries;      ///< # of tries left before giving up
    int                        offset;     ///< offset into packet being sent
    char                 FAR   *buffer;    ///< buffer we can use
+   /// second buffer, for assembling the next packet while waiting on the
+   /// current one (or NULL)
+   char                 FAR   *next;
+   int                        next_status;   ///< contents of \c next
+   uint16_t                   stash;      ///< bytes to resend from \c next
+   uint16_t                   stash_offset;  ///< offset of stash in \c next
+   uint16_t                   probe_len;  ///< bytes of data in first 1K block
    struct {
       xbee_xmodem_read_fn     read;       ///< source of bytes to send
       void              FAR   *context;   ///< context for file.read()
@@ -214,6 +228,23 @@ int xbee_xmodem_use_serport( xbee_xmodem_state_t *xbxm, xbee_serial_t *serport);
 int xbee_xmodem_set_source( xbee_xmodem_state_t *xbxm,
    void FAR *buffer, xbee_xmodem_read_fn read, const void FAR *context);
 
+/**
+   @brief
+   Give the Xmodem send a second buffer, so it can read and checksum the next
+   block while the current one is on the wire or waiting for an ACK.
+
+   Optional; call after xbee_xmodem_tx_init(), which clears it.  Also
+   required for #XBEE_XMODEM_FLAG_AUTO_1K.
+
+   @param[out]    xbxm     state structure to configure
+   @param[in]     buffer   buffer the same size as the one passed to
+                           xbee_xmodem_set_source()
+
+   @retval     0        successfully configured second buffer
+   @retval     -EINVAL  invalid parameter passed in
+*/
+int xbee_xmodem_set_prefetch( xbee_xmodem_state_t *xbxm, void FAR *buffer);
+
 /**
    @brief
    Configure the stream used to communicate with the target.
@@ -248,6 +279,8 @@ int xbee_xmodem_set_stream( xbee_xmodem_state_t *xbxm,
                   -  XBEE_XMODEM_FLAG_64
                   -  XBEE_XMODEM_FLAG_128
                   -  XBEE_XMODEM_FLAG_1024
+                        optionally combined with XBEE_XMODEM_FLAG_FORCE_CRC
+                        and XBEE_XMODEM_FLAG_AUTO_1K
 
    @retval  -EINVAL  invalid parameter passed in
    @retval  0        initialized state, can pass it to xbee_xmodem_tx_tick
@@ -52,6 +52,173 @@ int zcl_create_attribute_records( void FAR *buffer,
 int zcl_send_write_attributes( wpan_envelope_t *envelope,
    const zcl_attribute_base_t FAR *attr_list);
 
+#ifndef ZCL_BATCH_WINDOW
+   /// Maximum number of Read or Write Attributes requests in flight to each
+   /// node.
+   #define ZCL_BATCH_WINDOW         2
+#endif
+
+#ifndef ZCL_BATCH_MAX_TXN
+   /// Maximum number of Read or Write Attributes requests in flight for a
+   /// batch.
+   /// Each one uses a conversation on the local endpoint, so this is also
+   /// limited by #WPAN_MAX_CONVERSATIONS.
+   #define ZCL_BATCH_MAX_TXN        WPAN_MAX_CONVERSATIONS
+#endif
+
+#ifndef ZCL_BATCH_MAX_ATTRIBS
+   /// Maximum number of attribute IDs in each Read Attributes request; each
+   /// Write Attributes request holds up to twice this many bytes of records
+   /// (both also limited by the device's maximum payload).
+   #define ZCL_BATCH_MAX_ATTRIBS    40
+#endif
+
+#ifndef ZCL_BATCH_VALUE_MAX
+   /// Bytes of each attribute value saved in zcl_batch_attr_t (enough for a
+   /// 32-character string); longer values are truncated.
+   #define ZCL_BATCH_VALUE_MAX      33
+#endif
+
+#ifndef ZCL_BATCH_TIMEOUT
+   /// Default seconds to wait for each Read or Write Attributes Response.
+   #define ZCL_BATCH_TIMEOUT        10
+#endif
+
+#ifndef ZCL_BATCH_RETRIES
+   /// Default number of times to resend a request before giving up on
+   /// its attributes.
+   #define ZCL_BATCH_RETRIES        2
+#endif
+
+/** @name ZCL_BATCH_STATUS_*
+   Values for the \c status member of zcl_batch_attr_t, in addition to the
+   ZCL_STATUS_* value from the Read or Write Attributes Response.
+   @{
+*/
+/// attribute hasn't been requested yet
+#define ZCL_BATCH_STATUS_PENDING    0xF0
+/// attribute was requested, waiting for the response
+#define ZCL_BATCH_STATUS_SENT       0xF1
+/// node didn't respond to any of the requests for this attribute
+#define ZCL_BATCH_STATUS_TIMEOUT    0xF2
+///@}
+
+/**
+   Result of reading one attribute with zcl_batch_read_start(), or the value
+   to write and the result of writing it with zcl_batch_write_start().
+*/
+typedef struct zcl_batch_attr_t {
+   uint16_t    id;            ///< attribute ID
+   uint8_t     status;        ///< ZCL_STATUS_* or ZCL_BATCH_STATUS_*
+   uint8_t     type;          ///< ZCL_TYPE_* of value (if ZCL_STATUS_SUCCESS)
+   /// bytes in the attribute's value (only the first #ZCL_BATCH_VALUE_MAX
+   /// are in \c value)
+   uint16_t    length;
+   uint8_t     value[ZCL_BATCH_VALUE_MAX];    ///< value, as sent over the air
+   uint8_t     txn;           ///< internal: request this attribute was sent in
+} zcl_batch_attr_t;
+
+/**
+   Attributes of one cluster on a remote node, read by zcl_batch_read_start()
+   or written by zcl_batch_write_start().
+*/
+typedef struct zcl_batch_read_t {
+   wpan_address_t          node;          ///< node to read from
+   uint8_t                 endpoint;      ///< endpoint on \c node
+   uint8_t                 flags;
+      /// read attributes of a client cluster (a SERVER_TO_CLIENT request)
+      #define ZCL_BATCH_READ_FLAG_CLIENT     0x01
+   uint16_t                cluster_id;    ///< cluster to read
+   uint16_t                mfg_id;        ///< ZCL_MFG_NONE for standard
+   /// attributes to read, ending with #ZCL_ATTRIBUTE_END_OF_LIST
+   const uint16_t    FAR   *attribute_list;
+   /// room for one result for each entry of \c attribute_list; for writes,
+   /// with the \c type, \c length and \c value of each entry set
+   zcl_batch_attr_t        *results;
+   /// entries in \c attribute_list, set by zcl_batch_read_start()
+   uint16_t                count;
+} zcl_batch_read_t;
+
+/// Attributes of one cluster to write with zcl_batch_write_start().
+typedef zcl_batch_read_t zcl_batch_write_t;
+
+struct zcl_batch_t;
+
+/// A Read or Write Attributes request in flight.
+typedef struct zcl_batch_txn_t {
+   struct zcl_batch_t      *batch;        ///< batch this request belongs to
+   uint8_t                 read;          ///< index into batch's \c reads
+   uint8_t                 state;
+      #define ZCL_BATCH_TXN_IDLE       0  ///< slot unused
+      #define ZCL_BATCH_TXN_SENT       1  ///< waiting for response
+      #define ZCL_BATCH_TXN_RESEND     2  ///< timed out, send again
+   uint8_t                 tries;         ///< times sent (or failed to send)
+   uint8_t                 requested;     ///< attributes in the request
+   uint8_t                 transaction;   ///< ZCL sequence number
+} zcl_batch_txn_t;
+
+/**
+   State of a batch of attribute reads or writes.  Must stay in scope
+   (typically static) until zcl_batch_read_tick() stops returning -EBUSY,
+   since the conversation handler references it.
+*/
+typedef struct zcl_batch_t {
+   wpan_dev_t                          *dev;    ///< device to send with
+   /// local endpoint to send from (must have an \c ep_state)
+   const wpan_endpoint_table_entry_t   *ep;
+   zcl_batch_read_t                    *reads;  ///< attributes to read
+   uint8_t                             read_count;   ///< entries in \c reads
+   uint8_t                             next_read;    ///< next read to serve
+   /// ZCL_CMD_READ_ATTRIB or ZCL_CMD_WRITE_ATTRIB
+   uint8_t                             command;
+
+   /// Requests in flight to each node.  Defaults to (and can't exceed)
+   /// #ZCL_BATCH_WINDOW, may be lowered before the first tick.
+   uint8_t           window;
+
+   /// Times to resend a request.  Defaults to #ZCL_BATCH_RETRIES.
+   uint8_t           retries;
+
+   /// Seconds to wait for each response.  Defaults to #ZCL_BATCH_TIMEOUT.
+   uint16_t          timeout;
+
+   /// Attribute IDs per request.  Starts with as many as fit in the
+   /// device's payload, and drops to the number of records in a Read
+   /// Attributes Response that couldn't hold all of them.
+   uint8_t           per_request;
+
+   /// Bytes of attribute IDs (or write records) that fit in each request.
+   uint16_t          space;
+
+   zcl_batch_txn_t   txn[ZCL_BATCH_MAX_TXN];    ///< requests in flight
+
+   uint16_t          succeeded;     ///< attributes read (or written)
+   uint16_t          failed;        ///< attributes with an error status
+   uint16_t          timeouts;      ///< attributes that got no response
+   uint16_t          requests;      ///< Read or Write Attributes requests sent
+
+   /// -EBUSY while running, 0 once every attribute has a response (success
+   /// or error status), -ETIMEDOUT if some didn't.
+   int               status;
+} zcl_batch_t;
+
+int zcl_batch_read_start( zcl_batch_t *batch, wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep,
+   zcl_batch_read_t *reads, uint_fast8_t read_count);
+int zcl_batch_read_tick( zcl_batch_t *batch);
+int zcl_batch_read_response( wpan_conversation_t FAR *conversation,
+   const wpan_envelope_t FAR *envelope);
+int zcl_batch_write_start( zcl_batch_t *batch, wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep,
+   zcl_batch_write_t *writes, uint_fast8_t write_count);
+int zcl_batch_write_response( wpan_conversation_t FAR *conversation,
+   const wpan_envelope_t FAR *envelope);
+/// Advance a batch started with zcl_batch_write_start(); the same as
+/// zcl_batch_read_tick().
+#define zcl_batch_write_tick(batch)    zcl_batch_read_tick( batch)
+int zcl_batch_endpoint_handler( const wpan_envelope_t FAR *envelope,
+   wpan_ep_state_t FAR *ep_state);
+
 int zcl_print_attribute_value( uint8_t type, const void *value,
    int value_length);
 int zcl_print_array_value( const void *value, int value_length);
@@ -62,9 +62,20 @@
         #define XBEE_CELLULAR_ENABLED 1
     #endif
 
+    // Hosts have plenty of RAM; allow dozens of local and remote AT commands
+    // to be in flight at once.
+    #ifndef XBEE_CMD_REQUEST_TABLESIZE
+        #define XBEE_CMD_REQUEST_TABLESIZE 64
+    #endif
+
     // compiler natively supports 64-bit integers
     #define XBEE_NATIVE_64BIT
 
+    // give each thread its own xbee_random() stream, so it never locks
+    #ifndef XBEE_RANDOM_THREAD_LOCAL
+        #define XBEE_RANDOM_THREAD_LOCAL __thread
+    #endif
+
 // Elements needed to keep track of serial port settings.  Must have a
 // baudrate member, other fields are platform-specific.
 typedef struct xbee_serial_t {
@@ -0,0 +1,185 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+    @addtogroup hal_posix
+    @{
+    @file xbee_device_cache_posix.c
+    On-disk cache of xbee_dev_t query results (POSIX Platform).
+
+    The cache is a text file with one line per serial port:
+
+    @code
+    <device> <ieee> <HV> <HS> <VR> <NP> <GT> <CT> <CC>
+    @endcode
+
+    with all numeric values in hex.  The GT, CT and CC fields are only used
+    when XBEE_DEVICE_ENABLE_ATMODE is defined.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/device_cache.h"
+
+#define XBEE_DEV_CACHE_LINE_MAX    (sizeof(((xbee_serial_t *)0)->device) + 80)
+
+/**
+    @brief
+    Load the values saved for \a xbee's serial port into the xbee_dev_t.
+
+    Must be called after xbee_dev_init() and before xbee_cmd_init_device().
+    On success, the device is flagged with #XBEE_DEV_FLAG_QUERY_CACHED and
+    xbee_cmd_init_device() revalidates the values in the background instead
+    of blocking on a full query.
+
+    @param[in,out] xbee  device to populate
+    @param[in]     path  cache file, or NULL for #XBEE_DEV_CACHE_PATH
+
+    @retval  0        values loaded
+    @retval  -EINVAL  \a xbee is NULL
+    @retval  -ENOENT  no cache file, or no entry for this serial port
+*/
+int xbee_dev_cache_load( xbee_dev_t *xbee, const char *path)
+{
+    FILE *f;
+    char line[XBEE_DEV_CACHE_LINE_MAX];
+    char device[sizeof xbee->serport.device];
+    char ieee[ADDR64_STRING_LENGTH];
+    unsigned hv, hs, np, gt, ct, cc;
+    unsigned long vr;
+    int retval = -ENOENT;
+
+    if (xbee == NULL)
+    {
+        return -EINVAL;
+    }
+
+    f = fopen( path ? path : XBEE_DEV_CACHE_PATH, "r");
+    if (f == NULL)
+    {
+        return -ENOENT;
+    }
+
+    while (fgets( line, sizeof line, f) != NULL)
+    {
+        if (sscanf( line, "%39s %23s %x %x %lx %x %x %x %x", device, ieee,
+                &hv, &hs, &vr, &np, &gt, &ct, &cc) != 9
+            || strcmp( device, xbee->serport.device) != 0
+            || addr64_parse( &xbee->wpan_dev.address.ieee, ieee) != 0)
+        {
+            continue;
+        }
+
+        xbee->hardware_version = (uint16_t) hv;
+        xbee->hardware_series = (uint16_t) hs;
+        xbee->firmware_version = (uint32_t) vr;
+        xbee->wpan_dev.payload = (uint16_t) np;
+        #ifdef XBEE_DEVICE_ENABLE_ATMODE
+            xbee->guard_time = (uint16_t) gt;
+            xbee->idle_timeout = (uint16_t) ct;
+            xbee->escape_char = (char) cc;
+        #endif
+        xbee->flags |= XBEE_DEV_FLAG_QUERY_BEGIN | XBEE_DEV_FLAG_QUERY_DONE
+                        | XBEE_DEV_FLAG_QUERY_CACHED;
+        retval = 0;
+        break;
+    }
+    fclose( f);
+
+    #ifdef XBEE_DEVICE_VERBOSE
+        printf( "%s: %s cache entry for %s\n", __FUNCTION__,
+            retval ? "no" : "loaded", xbee->serport.device);
+    #endif
+
+    return retval;
+}
+
+/**
+    @brief
+    Save \a xbee's query results to the cache, replacing any previous entry
+    for the same serial port.
+
+    Only call this once xbee_cmd_query_status() has returned 0 and
+    #XBEE_DEV_FLAG_QUERY_CACHED is clear, so the values came from the module.
+    The file is replaced atomically.
+
+    @param[in] xbee  device to save
+    @param[in] path  cache file, or NULL for #XBEE_DEV_CACHE_PATH
+
+    @retval  0        entry saved
+    @retval  -EINVAL  \a xbee is NULL or hasn't completed a query
+    @retval  -EIO     couldn't write the cache file
+*/
+int xbee_dev_cache_save( const xbee_dev_t *xbee, const char *path)
+{
+    FILE *in, *out;
+    char line[XBEE_DEV_CACHE_LINE_MAX];
+    char device[sizeof xbee->serport.device];
+    char temp_path[FILENAME_MAX];
+    char ieee[ADDR64_STRING_LENGTH];
+    unsigned gt = 0, ct = 0, cc = 0;
+    int error;
+
+    if (xbee == NULL || ! (xbee->flags & XBEE_DEV_FLAG_QUERY_DONE)
+        || strchr( xbee->serport.device, ' ') != NULL)
+    {
+        return -EINVAL;
+    }
+
+    if (path == NULL)
+    {
+        path = XBEE_DEV_CACHE_PATH;
+    }
+    if (snprintf( temp_path, sizeof temp_path, "%s.tmp", path)
+        >= (int) sizeof temp_path)
+    {
+        return -EINVAL;
+    }
+
+    out = fopen( temp_path, "w");
+    if (out == NULL)
+    {
+        return -EIO;
+    }
+
+    // copy entries for other serial ports
+    in = fopen( path, "r");
+    if (in != NULL)
+    {
+        while (fgets( line, sizeof line, in) != NULL)
+        {
+            if (sscanf( line, "%39s", device) == 1
+                && strcmp( device, xbee->serport.device) != 0)
+            {
+                fputs( line, out);
+            }
+        }
+        fclose( in);
+    }
+
+    #ifdef XBEE_DEVICE_ENABLE_ATMODE
+        gt = xbee->guard_time;
+        ct = xbee->idle_timeout;
+        cc = (uint8_t) xbee->escape_char;
+    #endif
+    fprintf( out, "%s %s %x %x %" PRIx32 " %x %x %x %x\n",
+        xbee->serport.device,
+        addr64_format( ieee, &xbee->wpan_dev.address.ieee),
+        xbee->hardware_version, xbee->hardware_series,
+        xbee->firmware_version, xbee->wpan_dev.payload, gt, ct, cc);
+
+    error = ferror( out);
+    if (fclose( out) != 0 || error || rename( temp_path, path) != 0)
+    {
+        remove( temp_path);
+        return -EIO;
+    }
+
+    return 0;
+}
+
+///@}
@@ -0,0 +1,278 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+    @addtogroup hal_posix
+    @{
+    @file xbee_reactor_posix.c
+    Multi-device event loop using epoll (Linux).
+
+    Serial ports are registered level-triggered.  A device that still has
+    buffered bytes after its tick is reported ready again on the next poll.
+    Nothing is lost when a round stops early to give other devices a turn.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "xbee/reactor.h"
+#include "xbee/atcmd.h"
+
+/**
+    @brief
+    Initialize a reactor with no devices.
+
+    @param[out] reactor  reactor to initialize
+
+    @retval  0        reactor ready
+    @retval  -EINVAL  \a reactor is NULL
+    @retval  <0       couldn't create the epoll instance (-errno)
+*/
+int xbee_reactor_init( xbee_reactor_t *reactor)
+{
+    if (reactor == NULL)
+    {
+        return -EINVAL;
+    }
+
+    memset( reactor, 0, sizeof *reactor);
+    reactor->epoll_fd = epoll_create1( EPOLL_CLOEXEC);
+
+    return reactor->epoll_fd < 0 ? -errno : 0;
+}
+
+/**
+    @brief
+    Release the reactor's resources.  Registered devices are left open.
+
+    @param[in,out] reactor  reactor to close
+*/
+void xbee_reactor_close( xbee_reactor_t *reactor)
+{
+    if (reactor != NULL && reactor->epoll_fd >= 0)
+    {
+        close( reactor->epoll_fd);
+        memset( reactor, 0, sizeof *reactor);
+        reactor->epoll_fd = -1;
+    }
+}
+
+/**
+    @brief
+    Register a device (already initialized with xbee_dev_init()) with the
+    reactor.
+
+    @param[in,out] reactor  reactor to add \a xbee to
+    @param[in]     xbee     device to add
+
+    @retval  >=0      index of the device in the reactor's stats table
+    @retval  -EINVAL  NULL parameter or \a xbee's serial port isn't open
+    @retval  -EEXIST  \a xbee is already registered
+    @retval  -ENOSPC  reactor already has #XBEE_REACTOR_MAX_DEVICES devices
+    @retval  <0       epoll_ctl() failed (-errno)
+*/
+int xbee_reactor_add( xbee_reactor_t *reactor, xbee_dev_t *xbee)
+{
+    struct epoll_event event;
+    int i, index = -1;
+
+    if (reactor == NULL || xbee == NULL || xbee->serport.fd < 0)
+    {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < XBEE_REACTOR_MAX_DEVICES; ++i)
+    {
+        if (reactor->device[i] == xbee)
+        {
+            return -EEXIST;
+        }
+        if (index < 0 && reactor->device[i] == NULL)
+        {
+            index = i;
+        }
+    }
+    if (index < 0)
+    {
+        return -ENOSPC;
+    }
+
+    memset( &event, 0, sizeof event);
+    event.events = EPOLLIN;
+    event.data.u32 = (uint32_t) index;
+    if (epoll_ctl( reactor->epoll_fd, EPOLL_CTL_ADD, xbee->serport.fd,
+        &event) != 0)
+    {
+        return -errno;
+    }
+
+    reactor->device[index] = xbee;
+    memset( &reactor->stats[index], 0, sizeof reactor->stats[index]);
+    if (index >= reactor->count)
+    {
+        reactor->count = (uint8_t)(index + 1);
+    }
+
+    return index;
+}
+
+/**
+    @brief
+    Unregister a device from the reactor.
+
+    @param[in,out] reactor  reactor to remove \a xbee from
+    @param[in]     xbee     device to remove
+
+    @retval  0        device removed
+    @retval  -EINVAL  NULL parameter
+    @retval  -ENOENT  \a xbee isn't registered with \a reactor
+*/
+int xbee_reactor_remove( xbee_reactor_t *reactor, xbee_dev_t *xbee)
+{
+    int i;
+
+    if (reactor == NULL || xbee == NULL)
+    {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < reactor->count; ++i)
+    {
+        if (reactor->device[i] == xbee)
+        {
+            // fails harmlessly if the serial port was already closed
+            epoll_ctl( reactor->epoll_fd, EPOLL_CTL_DEL, xbee->serport.fd,
+                NULL);
+            reactor->device[i] = NULL;
+            while (reactor->count && reactor->device[reactor->count - 1] == NULL)
+            {
+                --reactor->count;
+            }
+            return 0;
+        }
+    }
+
+    return -ENOENT;
+}
+
+/**
+    @brief
+    Wait for any registered device to have data, then tick each ready device
+    once.  Also expires outstanding AT command requests.
+
+    @param[in,out] reactor     reactor to service
+    @param[in]     timeout_ms  milliseconds to wait for data, 0 to return
+                               immediately or -1 to wait forever
+
+    @retval  >=0      number of frames dispatched across all devices
+    @retval  -EINVAL  \a reactor is NULL or not initialized
+    @retval  <0       epoll_wait() failed (-errno)
+*/
+int xbee_reactor_poll( xbee_reactor_t *reactor, int timeout_ms)
+{
+    struct epoll_event events[XBEE_REACTOR_MAX_DEVICES];
+    uint8_t ready[XBEE_REACTOR_MAX_DEVICES];
+    xbee_reactor_stats_t *stats;
+    xbee_dev_t *xbee;
+    int count, i, index, result, frames = 0;
+
+    if (reactor == NULL || reactor->epoll_fd < 0)
+    {
+        return -EINVAL;
+    }
+
+    count = epoll_wait( reactor->epoll_fd, events, XBEE_REACTOR_MAX_DEVICES,
+        timeout_ms);
+    if (count < 0)
+    {
+        return errno == EINTR ? 0 : -errno;
+    }
+
+    memset( ready, 0, sizeof ready);
+    for (i = 0; i < count; ++i)
+    {
+        if (events[i].data.u32 < XBEE_REACTOR_MAX_DEVICES)
+        {
+            ready[events[i].data.u32] = 1;
+        }
+    }
+
+    // visit ready devices round-robin, starting after last round's first
+    for (i = 0; count && i < reactor->count; ++i)
+    {
+        index = (reactor->next + i) % reactor->count;
+        xbee = reactor->device[index];
+        if (! ready[index] || xbee == NULL)
+        {
+            continue;
+        }
+
+        stats = &reactor->stats[index];
+        ++stats->wakeups;
+        ++stats->ticks;
+        result = xbee_dev_tick( xbee);
+        if (result < 0)
+        {
+            if (result != -EBUSY)
+            {
+                ++stats->errors;
+            }
+            continue;
+        }
+        if (result > 0)
+        {
+            stats->frames += (uint32_t) result;
+            stats->last_frame_ms = xbee_millisecond_timer();
+            frames += result;
+        }
+        if (result >= XBEE_DEV_MAX_DISPATCH_PER_TICK)
+        {
+            // more frames waiting, picked up on the next poll
+            ++stats->deferred;
+        }
+    }
+    if (reactor->count)
+    {
+        reactor->next = (uint8_t)((reactor->next + 1) % reactor->count);
+    }
+
+    xbee_cmd_tick();
+
+    return frames;
+}
+
+/**
+    @brief
+    Get the counters the reactor keeps for a device.
+
+    @param[in] reactor  reactor \a xbee is registered with
+    @param[in] xbee     device to look up
+
+    @return  pointer to the device's stats, or NULL if \a xbee isn't
+             registered with \a reactor
+*/
+const xbee_reactor_stats_t *xbee_reactor_stats( const xbee_reactor_t *reactor,
+    const xbee_dev_t *xbee)
+{
+    int i;
+
+    if (reactor != NULL && xbee != NULL)
+    {
+        for (i = 0; i < reactor->count; ++i)
+        {
+            if (reactor->device[i] == xbee)
+            {
+                return &reactor->stats[i];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+///@}
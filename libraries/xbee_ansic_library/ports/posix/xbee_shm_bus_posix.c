@@ -0,0 +1,384 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+    @addtogroup hal_posix
+    @{
+    @file xbee_shm_bus_posix.c
+    Shared-memory frame bus (POSIX Platform).  See xbee/shm_bus.h for an
+    overview.
+
+    Each slot is a sequence lock with a single writer.  The publisher stores
+    an odd sequence, copies the frame and stores the next even sequence
+    with release ordering.  A reader expecting frame n accepts the slot
+    only if its sequence is 2 * n + 2 both before and after using the data.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "xbee/shm_bus.h"
+
+#define XBEE_SHM_BUS_MAGIC       0x58425342     // "XBSB"
+#define XBEE_SHM_BUS_VERSION     1
+
+#define _LOAD_ACQUIRE(p)         __atomic_load_n( p, __ATOMIC_ACQUIRE)
+#define _STORE_RELEASE(p, v)     __atomic_store_n( p, v, __ATOMIC_RELEASE)
+
+/**
+    @brief
+    Create a bus (replacing any existing bus with the same name) and become
+    its only publisher.
+
+    @param[out] bus     bus to initialize
+    @param[in]  name    shared memory object name, such as "/xbee0"
+    @param[in]  slots   frames the ring holds, a power of 2; 0 for
+                        #XBEE_SHM_BUS_SLOTS
+
+    @retval  0        bus ready
+    @retval  -EINVAL  invalid parameter
+    @retval  <0       couldn't create or map the object (-errno)
+*/
+int xbee_shm_bus_create( xbee_shm_bus_t *bus, const char *name,
+    uint32_t slots)
+{
+    void *map;
+    int fd, error = 0;
+
+    if (slots == 0)
+    {
+        slots = XBEE_SHM_BUS_SLOTS;
+    }
+    if (bus == NULL || name == NULL || name[0] != '/'
+        || strlen( name) >= sizeof bus->name || (slots & (slots - 1)))
+    {
+        return -EINVAL;
+    }
+
+    memset( bus, 0, sizeof *bus);
+    strcpy( bus->name, name);
+    bus->size = sizeof *bus->header + slots * sizeof *bus->slot;
+
+    // start from a fresh object so old readers don't see a size change
+    shm_unlink( name);
+    fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    if (ftruncate( fd, bus->size) != 0)
+    {
+        error = -errno;
+    }
+    else
+    {
+        map = mmap( NULL, bus->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+            0);
+        if (map == MAP_FAILED)
+        {
+            error = -errno;
+        }
+        else
+        {
+            // a new object is zero-filled, so every slot starts empty
+            bus->header = map;
+            bus->slot = (xbee_shm_bus_slot_t *)(bus->header + 1);
+            bus->header->version = XBEE_SHM_BUS_VERSION;
+            bus->header->slot_size = sizeof *bus->slot;
+            bus->header->slots = slots;
+            bus->header->publisher_pid = (uint32_t) getpid();
+            _STORE_RELEASE( &bus->header->magic, XBEE_SHM_BUS_MAGIC);
+        }
+    }
+    close( fd);
+
+    if (error)
+    {
+        shm_unlink( name);
+    }
+
+    return error;
+}
+
+/**
+    @brief
+    Unmap and remove the bus.  Attached readers keep their mapping but see
+    no new frames.
+
+    @param[in,out] bus  bus from xbee_shm_bus_create()
+*/
+void xbee_shm_bus_destroy( xbee_shm_bus_t *bus)
+{
+    if (bus != NULL && bus->header != NULL)
+    {
+        munmap( bus->header, bus->size);
+        shm_unlink( bus->name);
+        memset( bus, 0, sizeof *bus);
+    }
+}
+
+/**
+    @brief
+    Copy a frame into the next slot.  Never blocks; the oldest frame is
+    overwritten.
+
+    @param[in,out] bus     bus from xbee_shm_bus_create()
+    @param[in]     frame   frame, starting with the frame type
+    @param[in]     length  bytes in \a frame
+
+    @retval  0           frame published
+    @retval  -EMSGSIZE   \a length is larger than #XBEE_SHM_BUS_FRAME_MAX
+*/
+int xbee_shm_bus_publish( xbee_shm_bus_t *bus, const void FAR *frame,
+    uint16_t length)
+{
+    uint64_t n = bus->header->published;
+    xbee_shm_bus_slot_t *slot = &bus->slot[n & (bus->header->slots - 1)];
+
+    if (length > XBEE_SHM_BUS_FRAME_MAX)
+    {
+        return -EMSGSIZE;
+    }
+
+    __atomic_store_n( &slot->sequence, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence( __ATOMIC_RELEASE);
+    slot->timestamp_ms = xbee_millisecond_timer();
+    slot->length = length;
+    memcpy( slot->data, frame, length);
+    _STORE_RELEASE( &slot->sequence, 2 * n + 2);
+    _STORE_RELEASE( &bus->header->published, n + 1);
+
+    return 0;
+}
+
+/**
+    @brief
+    Frame handler that publishes every frame to the bus in its context.
+    Use XBEE_SHM_BUS_FRAME_HANDLER() to add it to a dispatch table.
+
+    @see xbee_frame_handler_fn()
+*/
+int xbee_shm_bus_frame_handler( xbee_dev_t *xbee, const void FAR *frame,
+    uint16_t length, void FAR *context)
+{
+    XBEE_UNUSED_PARAMETER( xbee);
+
+    return xbee_shm_bus_publish( context, frame, length);
+}
+
+/**
+    @brief
+    Map a bus read-only.  The reader starts with the next frame published.
+
+    @param[out] reader  reader to initialize
+    @param[in]  name    name passed to xbee_shm_bus_create()
+
+    @retval  0         attached
+    @retval  -EINVAL   invalid parameter
+    @retval  -EAGAIN   the publisher hasn't finished creating the bus
+    @retval  -EILSEQ   not a bus, or a different version or slot layout
+    @retval  <0        couldn't open or map the object (-errno)
+*/
+int xbee_shm_bus_attach( xbee_shm_bus_reader_t *reader, const char *name)
+{
+    const xbee_shm_bus_header_t *header;
+    struct stat st;
+    void *map;
+    int fd, error = 0;
+
+    if (reader == NULL || name == NULL)
+    {
+        return -EINVAL;
+    }
+    memset( reader, 0, sizeof *reader);
+
+    fd = shm_open( name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    if (fstat( fd, &st) != 0)
+    {
+        error = -errno;
+    }
+    else if ((size_t) st.st_size < sizeof *header)
+    {
+        error = -EAGAIN;
+    }
+    else
+    {
+        map = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            error = -errno;
+        }
+        else
+        {
+            reader->size = st.st_size;
+            reader->header = header = map;
+        }
+    }
+    close( fd);
+    if (error)
+    {
+        return error;
+    }
+
+    if (_LOAD_ACQUIRE( &header->magic) != XBEE_SHM_BUS_MAGIC)
+    {
+        error = -EAGAIN;
+    }
+    else if (header->version != XBEE_SHM_BUS_VERSION
+        || header->slot_size != sizeof *reader->slot
+        || header->slots == 0 || (header->slots & (header->slots - 1))
+        || sizeof *header + (size_t) header->slots * sizeof *reader->slot
+            > reader->size)
+    {
+        error = -EILSEQ;
+    }
+    if (error)
+    {
+        xbee_shm_bus_detach( reader);
+        return error;
+    }
+
+    reader->slot = (const xbee_shm_bus_slot_t *)(header + 1);
+    reader->next = _LOAD_ACQUIRE( &header->published);
+
+    return 0;
+}
+
+/**
+    @brief
+    Unmap a bus.  The publisher isn't affected.
+
+    @param[in,out] reader  reader from xbee_shm_bus_attach()
+*/
+void xbee_shm_bus_detach( xbee_shm_bus_reader_t *reader)
+{
+    if (reader != NULL && reader->header != NULL)
+    {
+        munmap( (void *) reader->header, reader->size);
+        memset( reader, 0, sizeof *reader);
+    }
+}
+
+/**
+    @brief
+    Get the next frame in place, without copying it.
+
+    If the publisher has lapped the reader, skips to the oldest frame still
+    in the ring and adds the skipped frames to \c reader->lost.
+
+    @param[in,out] reader  reader from xbee_shm_bus_attach()
+
+    @return  slot holding the frame (pass it to xbee_shm_bus_release() when
+             done), or NULL if there are no new frames
+*/
+const xbee_shm_bus_slot_t *xbee_shm_bus_peek( xbee_shm_bus_reader_t *reader)
+{
+    const xbee_shm_bus_slot_t *slot;
+    uint64_t sequence, published;
+    uint32_t slots = reader->header->slots;
+
+    for (;;)
+    {
+        slot = &reader->slot[reader->next & (slots - 1)];
+        sequence = _LOAD_ACQUIRE( &slot->sequence);
+        if (sequence == 2 * reader->next + 2)
+        {
+            return slot;
+        }
+        if (sequence < 2 * reader->next + 2)
+        {
+            return NULL;         // not published yet (or being written)
+        }
+
+        // overwritten; resume with the oldest frame the ring still holds
+        published = _LOAD_ACQUIRE( &reader->header->published);
+        if (published - reader->next > slots - 1)
+        {
+            reader->lost += published - (slots - 1) - reader->next;
+            reader->next = published - (slots - 1);
+        }
+        else
+        {
+            ++reader->lost;
+            ++reader->next;
+        }
+    }
+}
+
+/**
+    @brief
+    Finish with the frame from xbee_shm_bus_peek() and move to the next.
+
+    @param[in,out] reader  reader from xbee_shm_bus_attach()
+
+    @retval  0         the frame was intact the whole time it was in use
+    @retval  -ESTALE   the publisher overwrote the frame while it was in
+                       use; discard anything derived from it
+*/
+int xbee_shm_bus_release( xbee_shm_bus_reader_t *reader)
+{
+    const xbee_shm_bus_slot_t *slot =
+        &reader->slot[reader->next & (reader->header->slots - 1)];
+    uint64_t expected = 2 * reader->next + 2;
+
+    __atomic_thread_fence( __ATOMIC_ACQUIRE);
+    ++reader->next;
+    if (__atomic_load_n( &slot->sequence, __ATOMIC_RELAXED) != expected)
+    {
+        ++reader->lost;
+        return -ESTALE;
+    }
+
+    return 0;
+}
+
+/**
+    @brief
+    Copy the next frame into \a buffer.
+
+    @param[in,out] reader  reader from xbee_shm_bus_attach()
+    @param[out]    buffer  destination for the frame
+    @param[in]     size    bytes available in \a buffer
+
+    @retval  >0          bytes copied to \a buffer
+    @retval  0           no new frames
+    @retval  -EMSGSIZE   frame is larger than \a size; it's skipped
+*/
+int xbee_shm_bus_read( xbee_shm_bus_reader_t *reader, void *buffer,
+    uint16_t size)
+{
+    const xbee_shm_bus_slot_t *slot;
+    uint16_t length;
+
+    while ((slot = xbee_shm_bus_peek( reader)) != NULL)
+    {
+        length = slot->length;
+        if (length > sizeof slot->data)
+        {
+            length = sizeof slot->data;      // torn; release() will catch it
+        }
+        if (length <= size)
+        {
+            memcpy( buffer, slot->data, length);
+        }
+        if (xbee_shm_bus_release( reader) == 0)
+        {
+            return length <= size ? length : -EMSGSIZE;
+        }
+    }
+
+    return 0;
+}
+
+///@}
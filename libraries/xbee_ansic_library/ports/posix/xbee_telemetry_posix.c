@@ -0,0 +1,664 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+    @addtogroup hal_posix
+    @{
+    @file xbee_telemetry_posix.c
+    Columnar telemetry store (POSIX Platform).  See xbee/telemetry.h for an
+    overview.
+
+    All values in both files are little-endian.  The data file starts with
+    an 8-byte header:
+
+    @code
+    "XBTM" <version:1> <channels:1> <chunk rows:2>
+    @endcode
+
+    followed by chunks:
+
+    @code
+    <rows:2> <columns:1> <reserved:1> <column offset:4> * columns
+    column: <first value:4> <width:1> <packed zigzag deltas>
+    @endcode
+
+    Column offsets are from the start of the chunk.  The index file is an
+    array of xbee_telemetry_index_t, written after each chunk, so a chunk is
+    only visible to readers once it's complete.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "xbee/telemetry.h"
+#include "xbee/byteorder.h"
+
+#define XBEE_TELEMETRY_MAGIC        "XBTM"
+#define XBEE_TELEMETRY_VERSION      1
+#define XBEE_TELEMETRY_HEADER_SIZE  8
+
+// bytes for a column of <rows> values packed at <width> bits
+#define XBEE_TELEMETRY_COLUMN_SIZE(rows, width) \
+    (5 + ((uint32_t)(width) * ((rows) - 1) + 7) / 8)
+
+/**
+    @brief
+    Decode a telemetry record from an RF payload.
+
+    @param[in]  payload  received payload
+    @param[in]  length   bytes in \a payload
+    @param[out] record   decoded record
+
+    @retval  0          \a record is valid
+    @retval  -EBADMSG   \a payload isn't a telemetry record
+*/
+int xbee_telemetry_decode( const void FAR *payload, uint16_t length,
+    xbee_telemetry_record_t *record)
+{
+    const xbee_telemetry_wire_t FAR *wire = payload;
+    uint_fast8_t i;
+
+    if (length < offsetof( xbee_telemetry_wire_t, value_be)
+        || wire->type != XBEE_TELEMETRY_WIRE_TYPE
+        || wire->channels == 0
+        || wire->channels > XBEE_TELEMETRY_MAX_CHANNELS
+        || length != offsetof( xbee_telemetry_wire_t, value_be)
+                        + wire->channels * sizeof(int32_t))
+    {
+        return -EBADMSG;
+    }
+
+    record->timestamp = be32toh( wire->timestamp_be);
+    record->channels = wire->channels;
+    for (i = 0; i < record->channels; ++i)
+    {
+        record->value[i] = (int32_t) be32toh( wire->value_be[i]);
+    }
+
+    return 0;
+}
+
+static int _xbee_telemetry_write( int fd, const void *buffer, size_t length)
+{
+    const uint8_t *p = buffer;
+    ssize_t written;
+
+    while (length)
+    {
+        written = write( fd, p, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        p += written;
+        length -= written;
+    }
+
+    return 0;
+}
+
+static void _xbee_telemetry_put32( uint8_t *p, uint32_t value)
+{
+    value = htole32( value);
+    memcpy( p, &value, 4);
+}
+
+static uint32_t _xbee_telemetry_get32( const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy( &value, p, 4);
+    return le32toh( value);
+}
+
+static uint32_t _xbee_telemetry_zigzag( int32_t previous, int32_t value)
+{
+    uint32_t delta = (uint32_t) value - (uint32_t) previous;
+
+    return (delta << 1) ^ (uint32_t)((int32_t) delta >> 31);
+}
+
+// Bits needed for the largest delta in a column.
+static uint_fast8_t _xbee_telemetry_width( const int32_t *value,
+    uint16_t rows)
+{
+    uint32_t bits = 0;
+    uint_fast8_t width = 0;
+    uint16_t i;
+
+    for (i = 1; i < rows; ++i)
+    {
+        bits |= _xbee_telemetry_zigzag( value[i - 1], value[i]);
+    }
+    while (bits)
+    {
+        ++width;
+        bits >>= 1;
+    }
+
+    return width;
+}
+
+// Encode a column into <out>, which must hold XBEE_TELEMETRY_COLUMN_SIZE().
+static size_t _xbee_telemetry_pack( uint8_t *out, const int32_t *value,
+    uint16_t rows, uint_fast8_t width)
+{
+    uint8_t *p = out + 5;
+    uint64_t bits = 0;
+    uint_fast8_t count = 0;
+    uint16_t i;
+
+    _xbee_telemetry_put32( out, (uint32_t) value[0]);
+    out[4] = (uint8_t) width;
+    if (width)
+    {
+        for (i = 1; i < rows; ++i)
+        {
+            bits |= (uint64_t) _xbee_telemetry_zigzag( value[i - 1], value[i])
+                << count;
+            for (count += width; count >= 8; count -= 8)
+            {
+                *p++ = (uint8_t) bits;
+                bits >>= 8;
+            }
+        }
+        if (count)
+        {
+            *p++ = (uint8_t) bits;
+        }
+    }
+
+    return p - out;
+}
+
+/**
+    @brief
+    Create (or truncate) a store and its index.
+
+    @param[out] store     store to initialize
+    @param[in]  path      data file; the index is \a path with ".idx" added
+    @param[in]  channels  sensor channels in each record
+
+    @retval  0        store ready for xbee_telemetry_append()
+    @retval  -EINVAL  invalid parameter
+    @retval  <0       couldn't create a file (-errno)
+*/
+int xbee_telemetry_create( xbee_telemetry_t *store, const char *path,
+    uint8_t channels)
+{
+    char index_path[PATH_MAX];
+    uint8_t header[XBEE_TELEMETRY_HEADER_SIZE];
+    int error;
+
+    if (store == NULL || path == NULL || channels == 0
+        || channels > XBEE_TELEMETRY_MAX_CHANNELS
+        || snprintf( index_path, sizeof index_path, "%s.idx", path)
+            >= (int) sizeof index_path)
+    {
+        return -EINVAL;
+    }
+
+    memset( store, 0, offsetof( xbee_telemetry_t, column));
+    store->channels = channels;
+    store->fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (store->fd < 0)
+    {
+        return -errno;
+    }
+    store->index_fd = open( index_path,
+        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (store->index_fd < 0)
+    {
+        error = -errno;
+        close( store->fd);
+        return error;
+    }
+
+    memcpy( header, XBEE_TELEMETRY_MAGIC, 4);
+    header[4] = XBEE_TELEMETRY_VERSION;
+    header[5] = channels;
+    header[6] = (uint8_t) XBEE_TELEMETRY_CHUNK_ROWS;
+    header[7] = (uint8_t)(XBEE_TELEMETRY_CHUNK_ROWS >> 8);
+    error = _xbee_telemetry_write( store->fd, header, sizeof header);
+    if (error)
+    {
+        close( store->fd);
+        close( store->index_fd);
+        return error;
+    }
+    store->offset = sizeof header;
+
+    return 0;
+}
+
+/**
+    @brief
+    Write buffered rows as a chunk, even if the chunk isn't full.
+
+    @param[in,out] store  store to flush
+
+    @retval  0     rows written (or none were buffered)
+    @retval  <0    write error (-errno); the rows stay buffered
+*/
+int xbee_telemetry_flush( xbee_telemetry_t *store)
+{
+    uint8_t header[4 + 4 * (XBEE_TELEMETRY_MAX_CHANNELS + 1)];
+    uint8_t column[XBEE_TELEMETRY_COLUMN_SIZE( XBEE_TELEMETRY_CHUNK_ROWS, 32)];
+    uint_fast8_t width[XBEE_TELEMETRY_MAX_CHANNELS + 1];
+    uint_fast8_t columns = store->channels + 1;
+    uint_fast8_t i;
+    uint32_t offset, index[4];
+    size_t header_size = 4 + 4 * columns;
+    off_t rewind_to = store->offset;
+    int error;
+
+    if (store->rows == 0)
+    {
+        return 0;
+    }
+
+    header[0] = (uint8_t) store->rows;
+    header[1] = (uint8_t)(store->rows >> 8);
+    header[2] = (uint8_t) columns;
+    header[3] = 0;
+    offset = header_size;
+    for (i = 0; i < columns; ++i)
+    {
+        width[i] = _xbee_telemetry_width( store->column[i], store->rows);
+        _xbee_telemetry_put32( &header[4 + 4 * i], offset);
+        offset += XBEE_TELEMETRY_COLUMN_SIZE( store->rows, width[i]);
+    }
+
+    error = _xbee_telemetry_write( store->fd, header, header_size);
+    for (i = 0; ! error && i < columns; ++i)
+    {
+        error = _xbee_telemetry_write( store->fd, column,
+            _xbee_telemetry_pack( column, store->column[i], store->rows,
+                width[i]));
+    }
+    if (! error)
+    {
+        index[0] = htole32( (uint32_t) store->column[0][0]);
+        index[1] = htole32( (uint32_t) store->column[0][store->rows - 1]);
+        index[2] = htole32( store->offset);
+        index[3] = htole32( offset);
+        error = _xbee_telemetry_write( store->index_fd, index, sizeof index);
+    }
+    if (error)
+    {
+        // drop the partial chunk so a retry starts from a clean file
+        if (ftruncate( store->fd, rewind_to) == 0)
+        {
+            lseek( store->fd, rewind_to, SEEK_SET);
+        }
+        return error;
+    }
+
+    store->offset += offset;
+    ++store->chunks;
+    store->rows = 0;
+
+    return 0;
+}
+
+/**
+    @brief
+    Add a record to the store.  Rows are written a chunk at a time.
+
+    @param[in,out] store   store from xbee_telemetry_create()
+    @param[in]     record  record to add; timestamps must not go backwards
+
+    @retval  0        record added
+    @retval  -EINVAL  \a record has a different number of channels
+    @retval  -ERANGE  \a record is older than the previous record
+    @retval  <0       error writing a full chunk (-errno)
+*/
+int xbee_telemetry_append( xbee_telemetry_t *store,
+    const xbee_telemetry_record_t *record)
+{
+    uint_fast8_t i;
+    int error;
+
+    if (record->channels != store->channels)
+    {
+        return -EINVAL;
+    }
+    // compare with the last record, even if it's already in a chunk
+    if (record->timestamp < store->last)
+    {
+        return -ERANGE;
+    }
+
+    if (store->rows == XBEE_TELEMETRY_CHUNK_ROWS)
+    {
+        error = xbee_telemetry_flush( store);
+        if (error)
+        {
+            return error;
+        }
+    }
+
+    store->column[0][store->rows] = (int32_t) record->timestamp;
+    for (i = 0; i < store->channels; ++i)
+    {
+        store->column[i + 1][store->rows] = record->value[i];
+    }
+    ++store->rows;
+    store->last = record->timestamp;
+
+    return 0;
+}
+
+/**
+    @brief
+    Flush buffered rows and close the store's files.
+
+    @param[in,out] store  store to close
+
+    @retval  0     store closed
+    @retval  <0    error writing the last chunk (-errno); files are closed
+*/
+int xbee_telemetry_close( xbee_telemetry_t *store)
+{
+    int error = xbee_telemetry_flush( store);
+
+    close( store->fd);
+    close( store->index_fd);
+    store->fd = store->index_fd = -1;
+
+    return error;
+}
+
+static const void *_xbee_telemetry_map( const char *path, size_t *size)
+{
+    struct stat st;
+    void *map = NULL;
+    int fd;
+
+    *size = 0;
+    fd = open( path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return MAP_FAILED;
+    }
+    if (fstat( fd, &st) != 0)
+    {
+        map = MAP_FAILED;
+    }
+    else if (st.st_size > 0)
+    {
+        *size = st.st_size;
+        map = mmap( NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close( fd);
+
+    return map;
+}
+
+/**
+    @brief
+    Map a store for queries.  Chunks written after this call aren't seen.
+
+    @param[out] reader  reader to initialize
+    @param[in]  path    data file passed to xbee_telemetry_create()
+
+    @retval  0          reader ready
+    @retval  -EINVAL    invalid parameter
+    @retval  -EILSEQ    not a telemetry store, or written with a larger
+                        #XBEE_TELEMETRY_CHUNK_ROWS
+    @retval  <0         couldn't map a file (-errno)
+*/
+int xbee_telemetry_open( xbee_telemetry_reader_t *reader, const char *path)
+{
+    char index_path[PATH_MAX];
+    const void *map;
+    int error;
+
+    if (reader == NULL || path == NULL
+        || snprintf( index_path, sizeof index_path, "%s.idx", path)
+            >= (int) sizeof index_path)
+    {
+        return -EINVAL;
+    }
+    memset( reader, 0, sizeof *reader);
+
+    map = _xbee_telemetry_map( path, &reader->data_size);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    reader->data = map;
+    if (reader->data_size < XBEE_TELEMETRY_HEADER_SIZE
+        || memcmp( reader->data, XBEE_TELEMETRY_MAGIC, 4) != 0
+        || reader->data[4] != XBEE_TELEMETRY_VERSION
+        || reader->data[5] == 0
+        || reader->data[5] > XBEE_TELEMETRY_MAX_CHANNELS
+        || (reader->data[6] | reader->data[7] << 8)
+            > XBEE_TELEMETRY_CHUNK_ROWS)
+    {
+        xbee_telemetry_reader_close( reader);
+        return -EILSEQ;
+    }
+    reader->channels = reader->data[5];
+
+    map = _xbee_telemetry_map( index_path, &reader->index_size);
+    if (map == MAP_FAILED)
+    {
+        error = -errno;
+        xbee_telemetry_reader_close( reader);
+        return error;
+    }
+    reader->index = map;
+    reader->chunks = reader->index_size / sizeof *reader->index;
+
+    return 0;
+}
+
+/**
+    @brief
+    Unmap a store opened with xbee_telemetry_open().
+
+    @param[in,out] reader  reader to close
+*/
+void xbee_telemetry_reader_close( xbee_telemetry_reader_t *reader)
+{
+    if (reader->data != NULL)
+    {
+        munmap( (void *) reader->data, reader->data_size);
+    }
+    if (reader->index != NULL)
+    {
+        munmap( (void *) reader->index, reader->index_size);
+    }
+    memset( reader, 0, sizeof *reader);
+}
+
+/**
+    @brief
+    Find the first chunk that could hold rows at or after \a timestamp.
+
+    @param[in] reader      reader from xbee_telemetry_open()
+    @param[in] timestamp   time to search for
+
+    @return  chunk number, or \c reader->chunks if every row is older than
+             \a timestamp
+*/
+int32_t xbee_telemetry_find( const xbee_telemetry_reader_t *reader,
+    uint32_t timestamp)
+{
+    uint32_t low = 0, high = reader->chunks, middle;
+
+    // binary search on the last timestamp of each chunk
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        if (le32toh( reader->index[middle].last) < timestamp)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (int32_t) low;
+}
+
+/**
+    @brief
+    Decode one column of one chunk.
+
+    @param[in]  reader  reader from xbee_telemetry_open()
+    @param[in]  chunk   chunk number, less than \c reader->chunks
+    @param[in]  column  sensor channel (0 is the first), or
+                        #XBEE_TELEMETRY_TIME for the timestamps
+    @param[out] values  receives up to #XBEE_TELEMETRY_CHUNK_ROWS values
+
+    @retval  >0         number of rows in the chunk
+    @retval  -EINVAL    invalid chunk or column
+    @retval  -EILSEQ    chunk is corrupt
+*/
+int xbee_telemetry_read_column( const xbee_telemetry_reader_t *reader,
+    uint32_t chunk, uint8_t column, int32_t *values)
+{
+    const uint8_t *start, *p;
+    uint32_t offset, length, packed, mask, u;
+    uint64_t bits = 0;
+    uint_fast8_t width, count = 0, columns;
+    uint16_t rows, i;
+
+    if (chunk >= reader->chunks)
+    {
+        return -EINVAL;
+    }
+    column = column == XBEE_TELEMETRY_TIME ? 0 : column + 1;
+    if (column > reader->channels)
+    {
+        return -EINVAL;
+    }
+
+    offset = le32toh( reader->index[chunk].offset);
+    length = le32toh( reader->index[chunk].length);
+    if (offset < XBEE_TELEMETRY_HEADER_SIZE
+        || length < 4 || offset + length > reader->data_size
+        || offset + length < offset)
+    {
+        return -EILSEQ;
+    }
+    start = reader->data + offset;
+    rows = start[0] | start[1] << 8;
+    columns = start[2];
+    if (rows == 0 || rows > XBEE_TELEMETRY_CHUNK_ROWS
+        || columns != reader->channels + 1 || length < 4u + 4 * columns)
+    {
+        return -EILSEQ;
+    }
+
+    offset = _xbee_telemetry_get32( start + 4 + 4 * column);
+    if (offset > length - 5)
+    {
+        return -EILSEQ;
+    }
+    p = start + offset;
+    width = p[4];
+    packed = XBEE_TELEMETRY_COLUMN_SIZE( rows, width) - 5;
+    if (width > 32 || packed > length - offset - 5)
+    {
+        return -EILSEQ;
+    }
+
+    values[0] = (int32_t) _xbee_telemetry_get32( p);
+    p += 5;
+    mask = width == 32 ? 0xFFFFFFFF : ((uint32_t) 1 << width) - 1;
+    for (i = 1; i < rows; ++i)
+    {
+        while (count < width)
+        {
+            bits |= (uint64_t) *p++ << count;
+            count += 8;
+        }
+        u = (uint32_t) bits & mask;
+        bits >>= width;
+        count -= width;
+        values[i] = (int32_t)((uint32_t) values[i - 1]
+            + ((u >> 1) ^ (0 - (u & 1))));
+    }
+
+    return rows;
+}
+
+/**
+    @brief
+    Read one channel for every row with a timestamp from \a from to \a to,
+    decoding only the chunks and columns involved.
+
+    @param[in]  reader      reader from xbee_telemetry_open()
+    @param[in]  from        first timestamp to include
+    @param[in]  to          last timestamp to include
+    @param[in]  channel     sensor channel (0 is the first)
+    @param[out] timestamps  timestamp of each row, or NULL
+    @param[out] values      \a channel's value in each row, or NULL
+    @param[in]  max         entries in \a timestamps and \a values
+
+    @retval  >=0        rows stored (stops at \a max)
+    @retval  <0         error from xbee_telemetry_read_column()
+*/
+int xbee_telemetry_range( const xbee_telemetry_reader_t *reader,
+    uint32_t from, uint32_t to, uint8_t channel, uint32_t *timestamps,
+    int32_t *values, int max)
+{
+    int32_t time[XBEE_TELEMETRY_CHUNK_ROWS];
+    int32_t value[XBEE_TELEMETRY_CHUNK_ROWS];
+    uint32_t chunk;
+    int rows, i, found = 0;
+
+    for (chunk = xbee_telemetry_find( reader, from);
+        chunk < reader->chunks && found < max
+            && le32toh( reader->index[chunk].first) <= to;
+        ++chunk)
+    {
+        rows = xbee_telemetry_read_column( reader, chunk, XBEE_TELEMETRY_TIME,
+            time);
+        if (rows > 0 && values != NULL)
+        {
+            rows = xbee_telemetry_read_column( reader, chunk, channel, value);
+        }
+        if (rows < 0)
+        {
+            return rows;
+        }
+        for (i = 0; i < rows && found < max; ++i)
+        {
+            if ((uint32_t) time[i] >= from && (uint32_t) time[i] <= to)
+            {
+                if (timestamps != NULL)
+                {
+                    timestamps[found] = (uint32_t) time[i];
+                }
+                if (values != NULL)
+                {
+                    values[found] = value[i];
+                }
+                ++found;
+            }
+        }
+    }
+
+    return found;
+}
+
+///@}
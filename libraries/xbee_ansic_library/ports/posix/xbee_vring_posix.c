@@ -0,0 +1,437 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+    @addtogroup hal_posix
+    @{
+    @file xbee_vring_posix.c
+    Double-mapped circular buffer (Linux).
+
+    The buffer is a memfd mapped twice into one reserved region of twice its
+    size.  A write that runs past the end of the first mapping lands at the
+    start of the buffer, and a read past the end sees those same bytes, so
+    no caller ever has to split a copy at the wrap point.
+*/
+
+#define _GNU_SOURCE           // memfd_create()
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "xbee/vring.h"
+#include "xbee/cbuf_spsc.h"
+
+/**
+    @brief
+    Create a double-mapped circular buffer.
+
+    @param[out] vring   buffer to initialize
+    @param[in]  size    minimum capacity in bytes; rounded up to a power of
+                        2 of at least one page
+
+    @retval  0        buffer ready
+    @retval  -EINVAL  \a vring is NULL, or \a size is too large to round up
+                      to a power of 2
+    @retval  <0       couldn't create or map the buffer (-errno)
+*/
+int xbee_vring_init( xbee_vring_t *vring, unsigned int size)
+{
+    unsigned int page = (unsigned int) sysconf( _SC_PAGESIZE);
+    uint8_t *base;
+    int fd, error = 0;
+
+    if (vring == NULL || size > UINT_MAX / 2 + 1)
+    {
+        return -EINVAL;
+    }
+    memset( vring, 0, sizeof *vring);
+
+    // a power of 2, so the free-running indexes stay valid when they wrap
+    while (page < size)
+    {
+        page <<= 1;
+    }
+    size = page;
+
+    fd = memfd_create( "xbee_vring", MFD_CLOEXEC);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    if (ftruncate( fd, size) != 0)
+    {
+        error = -errno;
+        close( fd);
+        return error;
+    }
+
+    // reserve the whole range first so nothing else can claim the upper half
+    base = mmap( NULL, 2 * (size_t) size, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        error = -errno;
+    }
+    else if (mmap( base, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap( base + size, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        error = -errno;
+        munmap( base, 2 * (size_t) size);
+    }
+
+    // the mappings keep the memory alive
+    close( fd);
+
+    if (error == 0)
+    {
+        vring->base = base;
+        vring->size = size;
+    }
+
+    return error;
+}
+
+/**
+    @brief
+    Unmap a buffer created by xbee_vring_init().
+
+    @param[in,out] vring  buffer to release
+*/
+void xbee_vring_close( xbee_vring_t *vring)
+{
+    if (vring != NULL && vring->base != NULL)
+    {
+        munmap( vring->base, 2 * (size_t) vring->size);
+        memset( vring, 0, sizeof *vring);
+    }
+}
+
+/**
+    @brief
+    Number of bytes in the buffer.
+
+    @param[in] vring  circular buffer
+*/
+unsigned int xbee_vring_used( xbee_vring_t *vring)
+{
+    return XBEE_CBUF_SPSC_LOAD_ACQUIRE( &vring->tail)
+        - XBEE_CBUF_SPSC_LOAD_ACQUIRE( &vring->head);
+}
+
+/**
+    @brief
+    Number of bytes that can be added to the buffer.
+
+    @param[in] vring  circular buffer
+*/
+unsigned int xbee_vring_free( xbee_vring_t *vring)
+{
+    return vring->size - xbee_vring_used( vring);
+}
+
+/**
+    @brief
+    Get the free space as one contiguous region (producer).  Nothing is
+    visible to the consumer until xbee_vring_commit().
+
+    @param[in,out] vring    circular buffer
+    @param[out]    length   bytes available at the returned address
+
+    @return  address to write to, or NULL if the buffer is full
+*/
+void *xbee_vring_reserve( xbee_vring_t *vring, unsigned int *length)
+{
+    unsigned int tail = vring->tail;
+
+    *length = vring->size
+        - (tail - XBEE_CBUF_SPSC_LOAD_ACQUIRE( &vring->head));
+
+    return *length ? vring->base + (tail & (vring->size - 1)) : NULL;
+}
+
+/**
+    @brief
+    Publish bytes written to a region from xbee_vring_reserve().
+
+    @param[in,out] vring    circular buffer
+    @param[in]     length   bytes written, no more than reserved
+*/
+void xbee_vring_commit( xbee_vring_t *vring, unsigned int length)
+{
+    XBEE_CBUF_SPSC_STORE_RELEASE( &vring->tail, vring->tail + length);
+}
+
+/**
+    @brief
+    Get every buffered byte as one contiguous region, without removing
+    them (consumer).
+
+    @param[in,out] vring    circular buffer
+    @param[out]    length   bytes available at the returned address
+
+    @return  address of the oldest byte, or NULL if the buffer is empty
+*/
+const void *xbee_vring_peek( xbee_vring_t *vring, unsigned int *length)
+{
+    unsigned int head = vring->head;
+
+    *length = XBEE_CBUF_SPSC_LOAD_ACQUIRE( &vring->tail) - head;
+
+    return *length ? vring->base + (head & (vring->size - 1)) : NULL;
+}
+
+/**
+    @brief
+    Remove bytes examined with xbee_vring_peek().
+
+    @param[in,out] vring    circular buffer
+    @param[in]     length   bytes to remove, no more than peeked
+*/
+void xbee_vring_consume( xbee_vring_t *vring, unsigned int length)
+{
+    XBEE_CBUF_SPSC_STORE_RELEASE( &vring->head, vring->head + length);
+}
+
+/**
+    @brief
+    Append bytes to the buffer (producer).
+
+    @param[in,out] vring    circular buffer
+    @param[in]     buffer   data to append
+    @param[in]     length   number of bytes in \a buffer
+
+    @return  number of bytes appended (less than \a length if the buffer
+             filled up)
+*/
+unsigned int xbee_vring_put( xbee_vring_t *vring, const void *buffer,
+    unsigned int length)
+{
+    unsigned int room;
+    void *p = xbee_vring_reserve( vring, &room);
+
+    if (length > room)
+    {
+        length = room;
+    }
+    if (length)
+    {
+        memcpy( p, buffer, length);
+        xbee_vring_commit( vring, length);
+    }
+
+    return length;
+}
+
+/**
+    @brief
+    Remove bytes from the buffer (consumer).
+
+    @param[in,out] vring    circular buffer
+    @param[out]    buffer   destination for the bytes
+    @param[in]     length   maximum bytes to remove
+
+    @return  number of bytes removed
+*/
+unsigned int xbee_vring_get( xbee_vring_t *vring, void *buffer,
+    unsigned int length)
+{
+    unsigned int avail;
+    const void *p = xbee_vring_peek( vring, &avail);
+
+    if (length > avail)
+    {
+        length = avail;
+    }
+    if (length)
+    {
+        memcpy( buffer, p, length);
+        xbee_vring_consume( vring, length);
+    }
+
+    return length;
+}
+
+/**
+    @brief
+    Fill the buffer with a single read() from a file descriptor (producer).
+
+    @param[in,out] vring  circular buffer
+    @param[in]     fd     non-blocking descriptor, such as a serial port
+
+    @retval  >0       bytes added to the buffer
+    @retval  0        buffer full, or nothing to read
+    @retval  -EPIPE   end of file
+    @retval  <0       read() error (-errno)
+*/
+int xbee_vring_read( xbee_vring_t *vring, int fd)
+{
+    unsigned int room;
+    void *p = xbee_vring_reserve( vring, &room);
+    ssize_t result;
+
+    if (p == NULL)
+    {
+        return 0;
+    }
+
+    result = read( fd, p, room);
+    if (result > 0)
+    {
+        xbee_vring_commit( vring, (unsigned int) result);
+        return (int) result;
+    }
+    if (result == 0)
+    {
+        return -EPIPE;
+    }
+
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -errno;
+}
+
+/**
+    @brief
+    Find the next complete API frame in the buffer (consumer).
+
+    Bytes before a start-of-frame (0x7E) and frames with invalid lengths or
+    bad checksums are removed from the buffer and counted in \c skipped and
+    \c bad_frames.  A good frame stays in the buffer until
+    xbee_vring_frame_done(), so the returned pointer can be handed straight
+    to a frame handler.
+
+    @param[in,out] vring    circular buffer
+    @param[out]    length   bytes in the frame, starting with the frame type
+                            and not including the checksum
+
+    @return  address of the frame type byte, or NULL if the buffer doesn't
+             hold a complete frame yet
+*/
+const uint8_t *xbee_vring_frame( xbee_vring_t *vring, uint16_t *length)
+{
+    const uint8_t *p, *start;
+    unsigned int avail;
+    uint16_t frame_length;
+
+    for (;;)
+    {
+        p = xbee_vring_peek( vring, &avail);
+        if (p == NULL)
+        {
+            return NULL;
+        }
+
+        if (*p != 0x7E)
+        {
+            start = memchr( p, 0x7E, avail);
+            avail = start ? (unsigned int)(start - p) : avail;
+            vring->skipped += avail;
+            xbee_vring_consume( vring, avail);
+            continue;
+        }
+        if (avail < 3)
+        {
+            return NULL;
+        }
+
+        frame_length = (p[1] << 8) | p[2];
+        if (frame_length > XBEE_MAX_RX_FRAME_LEN || frame_length < 2)
+        {
+            // not a start-of-frame, or a duplicate; resync from the next byte
+            #ifdef XBEE_DEVICE_VERBOSE
+                printf( "%s: bad frame length %u\n", __FUNCTION__,
+                    frame_length);
+            #endif
+            vring->skipped += 1;
+            xbee_vring_consume( vring, 1);
+            continue;
+        }
+        if (avail < frame_length + 4u)
+        {
+            return NULL;
+        }
+
+        if (_xbee_checksum( p + 3, frame_length + 1, 0xFF))
+        {
+            #ifdef XBEE_DEVICE_VERBOSE
+                printf( "%s: checksum failed\n", __FUNCTION__);
+            #endif
+            ++vring->bad_frames;
+            xbee_vring_consume( vring, frame_length + 4);
+            continue;
+        }
+
+        *length = frame_length;
+        return p + 3;
+    }
+}
+
+/**
+    @brief
+    Remove a frame returned by xbee_vring_frame().
+
+    @param[in,out] vring    circular buffer
+    @param[in]     length   frame length from xbee_vring_frame()
+*/
+void xbee_vring_frame_done( xbee_vring_t *vring, uint16_t length)
+{
+    // start-of-frame, 2-byte length, frame and checksum
+    xbee_vring_consume( vring, length + 4);
+}
+
+/**
+    @brief
+    Replacement for xbee_dev_tick() that reads the serial port into a
+    double-mapped buffer and dispatches frames in place, without copying
+    them into \c xbee->rx.
+
+    Use one buffer per device, and don't mix calls with xbee_dev_tick()
+    on the same device.
+
+    @param[in]     xbee   XBee device to read from
+    @param[in,out] vring  receive buffer for \a xbee
+
+    @retval  >=0      number of frames dispatched (at most
+                      #XBEE_DEV_MAX_DISPATCH_PER_TICK)
+    @retval  -EINVAL  invalid parameter
+    @retval  -EBUSY   called from a frame handler
+    @retval  <0       error reading from the serial port
+*/
+int xbee_vring_dev_tick( xbee_dev_t *xbee, xbee_vring_t *vring)
+{
+    const uint8_t *frame;
+    uint16_t length;
+    int dispatched = 0;
+    int result;
+
+    if (xbee == NULL || vring == NULL || vring->base == NULL)
+    {
+        return -EINVAL;
+    }
+    if (xbee->flags & XBEE_DEV_FLAG_IN_TICK)
+    {
+        return -EBUSY;
+    }
+    xbee->flags |= XBEE_DEV_FLAG_IN_TICK;
+
+    result = xbee_vring_read( vring, xbee->serport.fd);
+    while (dispatched < XBEE_DEV_MAX_DISPATCH_PER_TICK
+        && (frame = xbee_vring_frame( vring, &length)) != NULL)
+    {
+        _xbee_frame_dispatch( xbee, frame, length);
+        xbee_vring_frame_done( vring, length);
+        ++dispatched;
+    }
+
+    xbee->flags &= ~XBEE_DEV_FLAG_IN_TICK;
+
+    return result < 0 && result != -EPIPE ? result : dispatched;
+}
+
+///@}
@@ -504,121 +504,103 @@ void walker_print_attribute_header( const zcl_rec_attrib_report_t *attr)
       le16toh( attr->id_le), attr->type, zcl_type_name( attr->type));
 }
 
-int walker_process_read_attr_resp( wpan_conversation_t FAR *conversation,
-   const wpan_envelope_t FAR *envelope)
-{
-   zcl_rec_attrib_report_t          FAR   *attr;      // attribute requested
-   zcl_command_t                          zcl;
-   const zcl_rec_read_attrib_resp_t FAR   *resp;
+// Reads of the current cluster's attributes, sent as a batch.
+zcl_batch_t walker_batch;
+zcl_batch_read_t walker_read;
 
-   attr = conversation->context;
-   walker_print_attribute_header( attr);
+enum walker_status_t walker_read_attribute_req( void)
+{
+   uint_fast8_t i;
 
-   if (envelope == NULL)
+   if (walker.attribute.index == walker.attribute.count)
    {
-      puts( " Read Timeout");
+      // done walking this collection, go get more
+      return WALKER_DISCOVER_ATTR_REQ;
    }
-   else if (zcl_command_build( &zcl, envelope, NULL) == 0)
-   {
-      resp = zcl.zcl_payload;
-
-      // make sure the response is for the correct ID
-      if (resp->id_le != attr->id_le)
-      {
-         printf( "\nERROR: Read Attr Resp has wrong ID (0x%04x)\n",
-            le16toh( resp->id_le));
-      }
-      else if (resp->status != ZCL_STATUS_SUCCESS)
-      {
-         printf( " Read Error: %s\n", zcl_status_text( resp->status));
-      }
-      else
-      {
-         zcl_print_attribute_value( resp->type, resp->value,
-            zcl.length - offsetof( zcl_rec_read_attrib_resp_t, value));
 
-         // the response should match the ID and TYPE of the one we requested
-         if (resp->type != attr->type)
-         {
-            printf( "WARNING: Read Attr Resp had different type (0x%02x)",
-               resp->type);
-         }
-      }
+   for (i = 0; i < walker.attribute.count; ++i)
+   {
+      walker.attribute.read_list[i] =
+         le16toh( walker.attribute.list[i].id_le);
    }
-
-   // read next attribute
-   walker.status = WALKER_READ_ATTR_REQ;
-
-   return WPAN_CONVERSATION_END;
-}
-
-int walker_send_read_attr( zcl_rec_attrib_report_t *attr)
-{
-   wpan_envelope_t envelope;
-   XBEE_PACKED(, {
-      zcl_header_nomfg_t      header;
-      uint16_t                attr_id_le;
-   }) zcl;
-   int trans;
-   int retval;
-
-   walker_zcl_init( &envelope, &zcl.header, sizeof zcl);
-   zcl.header.command = ZCL_CMD_READ_ATTRIB;
+   walker.attribute.read_list[i] = ZCL_ATTRIBUTE_END_OF_LIST;
 
    // Endpoint's profile_id and cluster's ID still set from Discover Attributes
-
-   trans = wpan_conversation_register( &zcl_ep_state,
-      walker_process_read_attr_resp, attr, WALKER_ZCL_TIMEOUT);
-
-   if (trans < 0)
+   memset( &walker_read, 0, sizeof walker_read);
+   walker_read.node = walker.target;
+   walker_read.endpoint = walker.current_endpoint;
+   if (walker.cluster.index >= walker.cluster.out_index)
    {
-      return trans;
+      walker_read.flags = ZCL_BATCH_READ_FLAG_CLIENT;
    }
+   walker_read.cluster_id = walker.cluster.list[walker.cluster.index];
+   walker_read.mfg_id = ZCL_MFG_NONE;
+   walker_read.attribute_list = walker.attribute.read_list;
+   walker_read.results = walker.attribute.results;
 
-   zcl.header.sequence = (uint8_t) trans;
-   zcl.attr_id_le = attr->id_le;
-
-   retval = wpan_envelope_send( &envelope);
-
-   if (retval != 0)
+   if (zcl_batch_read_start( &walker_batch, walker.dev, &sample_endpoints.zcl,
+      &walker_read, 1) != 0)
    {
-      // TODO: find a way to delete the conversation here!
+      puts( "Error: couldn't start reading attributes");
+      return WALKER_ERROR;
    }
+   walker_batch.timeout = WALKER_ZCL_TIMEOUT;
 
-   return retval;
+   return WALKER_READ_ATTR_RSP;
 }
 
-enum walker_status_t walker_read_attribute_req( void)
+enum walker_status_t walker_read_attribute_rsp( void)
 {
-   zcl_rec_attrib_report_t *attr;
-   enum walker_status_t new_state = WALKER_READ_ATTR_REQ;
+   const zcl_rec_attrib_report_t *attr;      // attribute requested
+   const zcl_batch_attr_t *result;
+   uint_fast8_t i;
 
-   if (walker.attribute.index == walker.attribute.count)
+   if (zcl_batch_read_tick( &walker_batch) == -EBUSY)
    {
-      // done walking this collection, go get more
-      return WALKER_DISCOVER_ATTR_REQ;
+      return WALKER_READ_ATTR_RSP;
    }
 
-   attr = &walker.attribute.list[walker.attribute.index];
-   if (1)            // option to read each attribute
+   attr = walker.attribute.list;
+   result = walker.attribute.results;
+   for (i = walker.attribute.count; i; ++attr, ++result, --i)
    {
-      if (walker_send_read_attr( attr) != 0)
+      walker_print_attribute_header( attr);
+
+      if (result->status == ZCL_BATCH_STATUS_TIMEOUT)
       {
-         // send failed, don't advance state machine
-         return WALKER_READ_ATTR_REQ;
+         puts( " Read Timeout");
+      }
+      else if (result->status != ZCL_STATUS_SUCCESS)
+      {
+         printf( " Read Error: %s\n", zcl_status_text( result->status));
+      }
+      else
+      {
+         zcl_print_attribute_value( result->type, result->value,
+            result->length > ZCL_BATCH_VALUE_MAX ? ZCL_BATCH_VALUE_MAX
+                                                 : result->length);
+         if (result->length > ZCL_BATCH_VALUE_MAX)
+         {
+            printf( "      (first %u of %u bytes)\n", ZCL_BATCH_VALUE_MAX,
+               result->length);
+         }
+
+         // the response should match the TYPE of the one we requested
+         if (result->type != attr->type)
+         {
+            printf( "WARNING: Read Attr Resp had different type (0x%02x)\n",
+               result->type);
+         }
       }
-      new_state = WALKER_WAIT;
-   }
-   else
-   {
-      walker_print_attribute_header( attr);
-      // append a newline to the attribute id/type since there
-      // isn't any additional information to display
-      puts( "");
    }
 
-   ++walker.attribute.index;
-   return new_state;
+   #ifdef WALKER_DEBUG
+      printf( "read %u attributes with %u requests\n", walker.attribute.count,
+         walker_batch.requests);
+   #endif
+
+   walker.attribute.index = walker.attribute.count;
+   return WALKER_DISCOVER_ATTR_REQ;
 }
 
 enum walker_status_t walker_tick( void)
@@ -699,6 +681,10 @@ enum walker_status_t walker_tick( void)
          walker.status = walker_read_attribute_req();
          break;
 
+      case WALKER_READ_ATTR_RSP:
+         walker.status = walker_read_attribute_rsp();
+         break;
+
       case WALKER_WAIT:
       case WALKER_DONE:
       case WALKER_ERROR:
@@ -18,20 +18,23 @@
    clusters for that endpoint.  Then, for each cluster, uses ZCL Discover
    Attributes requests to build up a list of attributes.
 
-   Finally, uses ZCL Read Attributes requests to get each attribute so it
-   can display the type and value.
+   Finally, reads the discovered attributes with a batch of ZCL Read
+   Attributes requests (see zcl_batch_read_start()) so it can display each
+   attribute's type and value.
 */
 
 #ifndef _ZIGBEE_WALKER_H
 #define _ZIGBEE_WALKER_H
 
-#define WALKER_VER         0x0103
-#define WALKER_VER_STR     "1.03"
+#define WALKER_VER         0x0104
+#define WALKER_VER_STR     "1.04"
 
 #include <time.h>
 #include "xbee/platform.h"
+#include "xbee/device.h"
 #include "wpan/aps.h"
 #include "zigbee/zcl.h"
+#include "zigbee/zcl_client.h"
 
 #define SAMPLE_ENDPOINT 1
 
@@ -42,6 +45,7 @@ struct _endpoints {
 };
 
 extern struct _endpoints sample_endpoints;
+extern const xbee_dispatch_table_entry_t xbee_frame_handlers[];
 
 enum walker_status_t {
    WALKER_INIT,
@@ -52,7 +56,8 @@ enum walker_status_t {
 
    WALKER_DISCOVER_ATTR_REQ,  ///< send a ZCL Discover Attributes request
 
-   WALKER_READ_ATTR_REQ,      ///< send a ZCL Read Attributes request
+   WALKER_READ_ATTR_REQ,      ///< start reading the discovered attributes
+   WALKER_READ_ATTR_RSP,      ///< waiting for ZCL Read Attributes responses
    WALKER_WAIT,               ///< waiting for a response or timeout
    WALKER_DONE,
    WALKER_ERROR
@@ -130,6 +135,10 @@ typedef struct walker_state_t {
 
       uint_fast8_t            index;
 
+      // IDs from list[] to read, and the values read
+      uint16_t                read_list[WALKER_MAX_ATTRIB + 1];
+      zcl_batch_attr_t        results[WALKER_MAX_ATTRIB];
+
       // FALSE if we need to discover more attributes
       bool_t                  discovery_complete;
    } attribute;
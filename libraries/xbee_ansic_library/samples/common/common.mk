@@ -137,7 +137,7 @@ transparent_client : $(transparent_client_OBJECTS)
 
 install_ebin_OBJECTS += $(xbee_OBJECTS) install_ebin.o \
 	xbee_bl_gen3.o \
-	crc16buypass.o
+	crc16buypass.o crc16fold.o
 
 install_ebin: $(install_ebin_OBJECTS)
 	$(CC) $(LDFLAGS) $^ $(LDLIBS) -o $@
@@ -145,7 +145,7 @@ install_ebin: $(install_ebin_OBJECTS)
 install_ebl_OBJECTS += $(xbee_OBJECTS) install_ebl.o \
 	xbee_atmode.o \
 	xbee_firmware.o \
-	xbee_xmodem.o xmodem_crc16.o
+	xbee_xmodem.o xmodem_crc16.o crc16fold.o
 
 install_ebl: $(install_ebl_OBJECTS)
 	$(CC) $(LDFLAGS) $^ $(LDLIBS) -o $@
@@ -168,8 +168,8 @@ xbee3_secure_session_OBJECTS = $(xbee_OBJECTS) $(atinter_OBJECTS) \
 xbee3_secure_session : $(xbee3_secure_session_OBJECTS)
 	$(CC) $(LDFLAGS) $^ $(LDLIBS) -o $@
 
-mbedtls_OBJECTS = aes.o bignum.o ctr_drbg.o entropy.o entropy_poll.o sha256.o \
-            mbedtls_util.o xbee_random_mbedtls.o
+mbedtls_OBJECTS = aes.o aesce.o aesni.o bignum.o ctr_drbg.o entropy.o \
+            entropy_poll.o sha256.o mbedtls_util.o xbee_random_mbedtls.o
 xbee3_srp_verifier_OBJECTS = $(mbedtls_OBJECTS) $(xbee_OBJECTS) $(atinter_OBJECTS) \
             srp.o xbee3_srp_verifier.o sample_cli.o
 xbee3_srp_verifier : $(xbee3_srp_verifier_OBJECTS)
@@ -76,7 +76,8 @@ int main( int argc, char *argv[])
    parse_args( argc, argv);
 
    // initialize the serial and device layer for this XBee device
-   if (xbee_dev_init( &my_xbee, &XBEE_SERPORT, NULL, NULL))
+   if (xbee_dev_init( &my_xbee, &XBEE_SERPORT, NULL, NULL,
+      xbee_frame_handlers))
    {
       printf( "Failed to initialize XBee device.\n");
       return -1;
@@ -0,0 +1,165 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/*
+   Stage a firmware image in the General Purpose Memory of several remote
+   nodes at once, using xbee_gpm_ota_*, then verify and install it.
+
+   Usage: ./gpm_ota /dev/ttySxx [baud] image.bin 00-13-A2-00-xx-xx-xx-xx ...
+
+   Addresses must use the hyphenated (or colon-separated) format, so they
+   aren't mistaken for a baud rate.  The image is mapped into memory and
+   shared by all of the transfers.
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "xbee/atcmd.h"
+#include "xbee/device.h"
+#include "xbee/gpm_ota.h"
+#include "xbee/wpan.h"
+#include "parse_serial_args.h"
+
+#define MAX_NODES    32
+
+const xbee_dispatch_table_entry_t xbee_frame_handlers[] =
+{
+   XBEE_FRAME_HANDLE_LOCAL_AT,
+   XBEE_FRAME_HANDLE_RX_EXPLICIT,
+   XBEE_FRAME_TABLE_END
+};
+
+xbee_gpm_ota_t ota;
+xbee_gpm_ota_node_t nodes[MAX_NODES];
+
+// must be sorted by cluster ID
+const wpan_cluster_table_entry_t digi_device_clusters[] =
+{
+   XBEE_GPM_OTA_CLUST_ENTRY( ota),
+
+   WPAN_CLUST_ENTRY_LIST_END
+};
+
+const wpan_endpoint_table_entry_t sample_endpoints[] = {
+   {  WPAN_ENDPOINT_DIGI_DEVICE,    // endpoint
+      WPAN_PROFILE_DIGI,            // profile ID
+      NULL,                         // endpoint handler
+      NULL,                         // ep_state
+      0x0000,                       // device ID
+      0x00,                         // version
+      digi_device_clusters          // clusters
+   },
+
+   { WPAN_ENDPOINT_END_OF_LIST }
+};
+
+int main( int argc, char *argv[])
+{
+   xbee_dev_t my_xbee;
+   xbee_serial_t XBEE_SERPORT;
+   const char *filename = NULL;
+   struct stat st;
+   void *image;
+   uint32_t last_report, t;
+   int fd, i, status, node_count = 0;
+
+   for (i = 1; i < argc; ++i)
+   {
+      if ((strchr( argv[i], '-') != NULL || strchr( argv[i], ':') != NULL)
+         && node_count < MAX_NODES
+         && addr64_parse( &nodes[node_count].ieee, argv[i]) == 0)
+      {
+         ++node_count;
+      }
+      else if (strncmp( argv[i], "/dev", 4) != 0
+         && strtoul( argv[i], NULL, 0) == 0)
+      {
+         filename = argv[i];
+      }
+   }
+   if (filename == NULL || node_count == 0)
+   {
+      puts( "Error: pass an image file and at least one node address");
+      return EXIT_FAILURE;
+   }
+
+   fd = open( filename, O_RDONLY);
+   if (fd < 0 || fstat( fd, &st) != 0 || st.st_size == 0)
+   {
+      printf( "Error: can't open '%s'\n", filename);
+      return EXIT_FAILURE;
+   }
+   image = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (image == MAP_FAILED)
+   {
+      printf( "Error: can't map '%s'\n", filename);
+      return EXIT_FAILURE;
+   }
+
+   parse_serial_arguments( argc, argv, &XBEE_SERPORT);
+
+   // initialize the serial and device layer for this XBee device
+   if (xbee_dev_init( &my_xbee, &XBEE_SERPORT, NULL, NULL,
+      xbee_frame_handlers))
+   {
+      printf( "Failed to initialize device.\n");
+      return EXIT_FAILURE;
+   }
+
+   xbee_wpan_init( &my_xbee, sample_endpoints);
+
+   // the device's ATNP sets the largest write
+   xbee_cmd_init_device( &my_xbee);
+   printf( "Waiting for driver to query the XBee device...\n");
+   do {
+      xbee_dev_tick( &my_xbee);
+      status = xbee_cmd_query_status( &my_xbee);
+   } while (status == -EBUSY);
+   if (status)
+   {
+      printf( "Error %d waiting for query to complete.\n", status);
+   }
+
+   status = xbee_gpm_ota_start( &ota, &my_xbee.wpan_dev, image,
+      (uint32_t) st.st_size, nodes, node_count, XBEE_GPM_OTA_FLAG_INSTALL);
+   if (status)
+   {
+      printf( "Error %d starting update.\n", status);
+      return EXIT_FAILURE;
+   }
+
+   printf( "Sending %u bytes to %d node(s)...\n", (unsigned) st.st_size,
+      node_count);
+   last_report = xbee_millisecond_timer();
+   do {
+      if (xbee_dev_tick( &my_xbee) < 0)
+      {
+         break;
+      }
+      status = xbee_gpm_ota_tick( &ota);
+
+      t = xbee_millisecond_timer();
+      if (t - last_report > 5000)
+      {
+         last_report = t;
+         xbee_gpm_ota_report( &ota);
+         puts( "");
+      }
+   } while (status == -EBUSY);
+
+   xbee_gpm_ota_report( &ota);
+
+   munmap( image, st.st_size);
+   close( fd);
+   xbee_ser_close( &my_xbee.serport);
+
+   return status ? EXIT_FAILURE : EXIT_SUCCESS;
+}
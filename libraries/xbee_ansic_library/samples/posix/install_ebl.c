@@ -14,8 +14,12 @@
     Install firmware updates on XBee modules that use .EBL/.GBL firmware files.
 */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "xbee/device.h"
 #include "xbee/firmware.h"
@@ -30,27 +34,16 @@ const xbee_dispatch_table_entry_t xbee_frame_handlers[] =
 #include "parse_serial_args.h"
 
 /*
-    Sample code to read firmware from a file, used to demonstrate
+    Sample code to install firmware from a file, used to demonstrate
     new non-blocking firmware update API.
 
-    Note that the S2 doesn't actually need a seek function.  Maybe that should
-    just be removed (set to NULL)?  We may need it in the future, so leave it in?
-    There are benefits to not having it though -- can install updates straight
-    from an HTTP download.
+    The file is mapped into memory and sent with xbee_fw_buffer_init(), so
+    Xmodem blocks are copied straight from the page cache instead of going
+    through stdio for every block.
 */
 
 xbee_dev_t my_xbee;
 
-int fw_seek( void FAR *context, uint32_t offset)
-{
-    return fseek( (FILE FAR *)context, offset, SEEK_SET);
-}
-
-int fw_read( void FAR *context, void FAR *buffer, int16_t bytes)
-{
-    return fread( buffer, 1, bytes, (FILE FAR *)context);
-}
-
 void manual_xbee_reset(xbee_dev_t *xbee, int reset)
 {
     static int state = 0;           // assume released
@@ -72,8 +65,11 @@ void manual_xbee_reset(xbee_dev_t *xbee, int reset)
 
 int main( int argc, char *argv[])
 {
-    xbee_fw_source_t fw = { 0 };
-    FILE *file = NULL;
+    xbee_fw_buffer_t fw_buffer = { { 0 } };
+    xbee_fw_source_t *fw = &fw_buffer.source;
+    struct stat st;
+    void *image = MAP_FAILED;
+    int fd = -1;
     char buffer[80];
     uint32_t t;
     int result;
@@ -87,17 +83,21 @@ int main( int argc, char *argv[])
 
     if (argc > 1)
     {
-        file = fopen( argv[1], "rb");
+        fd = open( argv[1], O_RDONLY);
+    }
+    if (fd >= 0 && fstat( fd, &st) == 0 && st.st_size > 0)
+    {
+        image = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     }
-    if (! file)
+    if (image == MAP_FAILED)
     {
         printf( "Error: pass path to .EBL or .GBL file as first parameter\n");
         exit( -1);
     }
+    // file is read front to back, once
+    madvise( image, st.st_size, MADV_SEQUENTIAL);
 
-    fw.context = file;
-    fw.seek = fw_seek;
-    fw.read = fw_read;
+    xbee_fw_buffer_init( &fw_buffer, st.st_size, image);
 
     parse_serial_arguments( argc, argv, &XBEE_SERPORT);
 
@@ -107,25 +107,25 @@ int main( int argc, char *argv[])
         return 0;
     }
 
-    xbee_fw_install_init( &my_xbee, NULL, &fw);
+    xbee_fw_install_init( &my_xbee, NULL, fw);
     do
     {
         t = xbee_millisecond_timer();
-        last_state = xbee_fw_install_ebl_state( &fw);
-        result = xbee_fw_install_ebl_tick( &fw);
+        last_state = xbee_fw_install_ebl_state( fw);
+        result = xbee_fw_install_ebl_tick( fw);
         t = xbee_millisecond_timer() - t;
 #ifdef BLOCKING_WARNING
         if (t > 50)
         {
             printf( "!!! blocked for %ums in state 0x%04X (now state 0x%04X)\n",
-                t, last_state, xbee_fw_install_ebl_state( &fw));
+                t, last_state, xbee_fw_install_ebl_state( fw));
         }
 #endif
-        if (last_state != xbee_fw_install_ebl_state( &fw))
+        if (last_state != xbee_fw_install_ebl_state( fw))
         {
             // print new status
             printf( " %" PRIsFAR "                          \r",
-                xbee_fw_status_ebl( &fw, buffer));
+                xbee_fw_status_ebl( fw, buffer));
             fflush( stdout);
         }
     } while (result == 0);
@@ -148,7 +148,8 @@ int main( int argc, char *argv[])
         putchar('\n');
     }
 
-    fclose( file);
+    munmap( image, st.st_size);
+    close( fd);
 
     xbee_ser_close( &my_xbee.serport);
 
@@ -44,6 +44,9 @@
 #if defined(MBEDTLS_AESNI_C)
 #include "mbedtls/aesni.h"
 #endif
+#if defined(MBEDTLS_AESCE_C)
+#include "mbedtls/aesce.h"
+#endif
 
 #if defined(MBEDTLS_SELF_TEST)
 #if defined(MBEDTLS_PLATFORM_C)
@@ -588,7 +591,7 @@ int mbedtls_aes_setkey_enc( mbedtls_aes_context *ctx, const unsigned char *key,
 #endif
     ctx->rk = RK = ctx->buf;
 
-#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64)
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
     if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
         return( mbedtls_aesni_setkey_enc( (unsigned char *) ctx->rk, key, keybits ) );
 #endif
@@ -698,7 +701,7 @@ int mbedtls_aes_setkey_dec( mbedtls_aes_context *ctx, const unsigned char *key,
 
     ctx->nr = cty.nr;
 
-#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64)
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
     if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
     {
         mbedtls_aesni_inverse_key( (unsigned char *) ctx->rk,
@@ -1013,11 +1016,16 @@ int mbedtls_aes_crypt_ecb( mbedtls_aes_context *ctx,
     AES_VALIDATE_RET( mode == MBEDTLS_AES_ENCRYPT ||
                       mode == MBEDTLS_AES_DECRYPT );
 
-#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64)
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
     if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
         return( mbedtls_aesni_crypt_ecb( ctx, mode, input, output ) );
 #endif
 
+#if defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_AESCE_HAVE_CODE)
+    if( mbedtls_aesce_has_support() )
+        return( mbedtls_aesce_crypt_ecb( ctx, mode, input, output ) );
+#endif
+
 #if defined(MBEDTLS_PADLOCK_C) && defined(MBEDTLS_HAVE_X86)
     if( aes_padlock_ace )
     {
@@ -1036,6 +1044,46 @@ int mbedtls_aes_crypt_ecb( mbedtls_aes_context *ctx,
         return( mbedtls_internal_aes_decrypt( ctx, input, output ) );
 }
 
+/*
+ * AES-ECB encryption/decryption of several blocks
+ */
+int mbedtls_aes_crypt_ecb_blocks( mbedtls_aes_context *ctx,
+                                  int mode,
+                                  size_t length,
+                                  const unsigned char *input,
+                                  unsigned char *output )
+{
+    AES_VALIDATE_RET( ctx != NULL );
+    AES_VALIDATE_RET( mode == MBEDTLS_AES_ENCRYPT ||
+                      mode == MBEDTLS_AES_DECRYPT );
+    AES_VALIDATE_RET( length == 0 || input != NULL );
+    AES_VALIDATE_RET( length == 0 || output != NULL );
+
+    if( length % 16 )
+        return( MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH );
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
+    if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
+    {
+        mbedtls_aesni_crypt_ecb_blocks( ctx, mode, length / 16, input, output );
+        return( 0 );
+    }
+#endif
+
+#if defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_AESCE_HAVE_CODE)
+    if( mbedtls_aesce_has_support() )
+    {
+        mbedtls_aesce_crypt_ecb_blocks( ctx, mode, length / 16, input, output );
+        return( 0 );
+    }
+#endif
+
+    for( ; length > 0; length -= 16, input += 16, output += 16 )
+        mbedtls_aes_crypt_ecb( ctx, mode, input, output );
+
+    return( 0 );
+}
+
 #if defined(MBEDTLS_CIPHER_MODE_CBC)
 /*
  * AES-CBC buffer encryption/decryption
@@ -1420,6 +1468,52 @@ int mbedtls_aes_crypt_ofb( mbedtls_aes_context *ctx,
 #endif /* MBEDTLS_CIPHER_MODE_OFB */
 
 #if defined(MBEDTLS_CIPHER_MODE_CTR)
+/*
+ * AES-CTR on whole blocks.  Hardware AES builds the counter blocks in
+ * registers and works on several at once.
+ */
+static void aes_crypt_ctr_blocks( mbedtls_aes_context *ctx,
+                                  size_t blocks,
+                                  unsigned char nonce_counter[16],
+                                  const unsigned char *input,
+                                  unsigned char *output )
+{
+    unsigned char stream_block[16];
+    int i;
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
+    if( mbedtls_aesni_has_support( MBEDTLS_AESNI_AES ) )
+    {
+        mbedtls_aesni_crypt_ctr_blocks( ctx, blocks, nonce_counter,
+                                        input, output );
+        return;
+    }
+#endif
+
+#if defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_AESCE_HAVE_CODE)
+    if( mbedtls_aesce_has_support() )
+    {
+        mbedtls_aesce_crypt_ctr_blocks( ctx, blocks, nonce_counter,
+                                        input, output );
+        return;
+    }
+#endif
+
+    for( ; blocks > 0; blocks--, input += 16, output += 16 )
+    {
+        mbedtls_aes_crypt_ecb( ctx, MBEDTLS_AES_ENCRYPT, nonce_counter, stream_block );
+
+        for( i = 16; i > 0; i-- )
+            if( ++nonce_counter[i - 1] != 0 )
+                break;
+
+        for( i = 0; i < 16; i++ )
+            output[i] = (unsigned char)( input[i] ^ stream_block[i] );
+    }
+
+    mbedtls_platform_zeroize( stream_block, sizeof( stream_block ) );
+}
+
 /*
  * AES-CTR buffer encryption/decryption
  */
@@ -1432,7 +1526,7 @@ int mbedtls_aes_crypt_ctr( mbedtls_aes_context *ctx,
                        unsigned char *output )
 {
     int c, i;
-    size_t n;
+    size_t n, blocks;
 
     AES_VALIDATE_RET( ctx != NULL );
     AES_VALIDATE_RET( nc_off != NULL );
@@ -1446,6 +1540,26 @@ int mbedtls_aes_crypt_ctr( mbedtls_aes_context *ctx,
     if ( n > 0x0F )
         return( MBEDTLS_ERR_AES_BAD_INPUT_DATA );
 
+    /* Use up the key stream left over from the previous call */
+    while( n != 0 && length > 0 )
+    {
+        c = *input++;
+        *output++ = (unsigned char)( c ^ stream_block[n] );
+
+        n = ( n + 1 ) & 0x0F;
+        length--;
+    }
+
+    /* Whole blocks */
+    blocks = length / 16;
+    if( blocks > 0 )
+    {
+        aes_crypt_ctr_blocks( ctx, blocks, nonce_counter, input, output );
+        input += 16 * blocks;
+        output += 16 * blocks;
+        length -= 16 * blocks;
+    }
+
     while( length-- )
     {
         if( n == 0 ) {
@@ -0,0 +1,247 @@
+/*
+ *  Armv8-A Cryptographic Extension support functions for Aarch64
+ *
+ *  Copyright The Mbed TLS Contributors
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// Backported from Mbed TLS 3.x for XBee Host C Library; see aesce.h.
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_AESCE_C)
+
+#include "mbedtls/aesce.h"
+
+#if defined(MBEDTLS_AESCE_HAVE_CODE)
+
+/* Build this file for the crypto extension even if the rest of the
+ * library targets plain Armv8-A; aes.c checks for it at run time. */
+#if ! defined(__ARM_FEATURE_CRYPTO) && ! defined(__ARM_FEATURE_AES)
+#pragma GCC push_options
+#pragma GCC target ("arch=armv8-a+crypto")
+#define MBEDTLS_POP_TARGET_PRAGMA
+#endif
+
+#include <string.h>
+#include <arm_neon.h>
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+int mbedtls_aesce_has_support( void )
+{
+#if defined(__linux__)
+    static int supported = -1;
+
+    if( supported < 0 )
+        supported = ( getauxval( AT_HWCAP ) & HWCAP_AES ) != 0;
+
+    return( supported );
+#else
+    /* Without a way to ask the kernel, trust the compiler's target. */
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)
+    return( 1 );
+#else
+    return( 0 );
+#endif
+#endif
+}
+
+static inline uint8x16_t aesce_encrypt_block( uint8x16_t b,
+                                              const unsigned char *rk,
+                                              int nr )
+{
+    int i;
+
+    for( i = 0; i < nr - 1; i++, rk += 16 )
+        b = vaesmcq_u8( vaeseq_u8( b, vld1q_u8( rk ) ) );
+    b = vaeseq_u8( b, vld1q_u8( rk ) );
+
+    return( veorq_u8( b, vld1q_u8( rk + 16 ) ) );
+}
+
+static inline uint8x16_t aesce_decrypt_block( uint8x16_t b,
+                                              const unsigned char *rk,
+                                              int nr )
+{
+    int i;
+
+    for( i = 0; i < nr - 1; i++, rk += 16 )
+        b = vaesimcq_u8( vaesdq_u8( b, vld1q_u8( rk ) ) );
+    b = vaesdq_u8( b, vld1q_u8( rk ) );
+
+    return( veorq_u8( b, vld1q_u8( rk + 16 ) ) );
+}
+
+int mbedtls_aesce_crypt_ecb( mbedtls_aes_context *ctx,
+                             int mode,
+                             const unsigned char input[16],
+                             unsigned char output[16] )
+{
+    const unsigned char *rk = (const unsigned char *) ctx->rk;
+    uint8x16_t b = vld1q_u8( input );
+
+    if( mode == MBEDTLS_AES_ENCRYPT )
+        b = aesce_encrypt_block( b, rk, ctx->nr );
+    else
+        b = aesce_decrypt_block( b, rk, ctx->nr );
+
+    vst1q_u8( output, b );
+
+    return( 0 );
+}
+
+/*
+ * Run four independent blocks through the rounds together to hide the
+ * latency of AESE/AESD.
+ */
+static inline void aesce_crypt4( const mbedtls_aes_context *ctx, int mode,
+                                 uint8x16_t b[4] )
+{
+    const unsigned char *rk = (const unsigned char *) ctx->rk;
+    uint8x16_t k;
+    int i;
+
+    if( mode == MBEDTLS_AES_ENCRYPT )
+    {
+        for( i = 0; i < ctx->nr - 1; i++, rk += 16 )
+        {
+            k = vld1q_u8( rk );
+            b[0] = vaesmcq_u8( vaeseq_u8( b[0], k ) );
+            b[1] = vaesmcq_u8( vaeseq_u8( b[1], k ) );
+            b[2] = vaesmcq_u8( vaeseq_u8( b[2], k ) );
+            b[3] = vaesmcq_u8( vaeseq_u8( b[3], k ) );
+        }
+        k = vld1q_u8( rk );
+        b[0] = vaeseq_u8( b[0], k );
+        b[1] = vaeseq_u8( b[1], k );
+        b[2] = vaeseq_u8( b[2], k );
+        b[3] = vaeseq_u8( b[3], k );
+    }
+    else
+    {
+        for( i = 0; i < ctx->nr - 1; i++, rk += 16 )
+        {
+            k = vld1q_u8( rk );
+            b[0] = vaesimcq_u8( vaesdq_u8( b[0], k ) );
+            b[1] = vaesimcq_u8( vaesdq_u8( b[1], k ) );
+            b[2] = vaesimcq_u8( vaesdq_u8( b[2], k ) );
+            b[3] = vaesimcq_u8( vaesdq_u8( b[3], k ) );
+        }
+        k = vld1q_u8( rk );
+        b[0] = vaesdq_u8( b[0], k );
+        b[1] = vaesdq_u8( b[1], k );
+        b[2] = vaesdq_u8( b[2], k );
+        b[3] = vaesdq_u8( b[3], k );
+    }
+
+    k = vld1q_u8( rk + 16 );
+    b[0] = veorq_u8( b[0], k );
+    b[1] = veorq_u8( b[1], k );
+    b[2] = veorq_u8( b[2], k );
+    b[3] = veorq_u8( b[3], k );
+}
+
+void mbedtls_aesce_crypt_ecb_blocks( mbedtls_aes_context *ctx,
+                                     int mode,
+                                     size_t blocks,
+                                     const unsigned char *input,
+                                     unsigned char *output )
+{
+    uint8x16_t b[4];
+
+    for( ; blocks >= 4; blocks -= 4, input += 64, output += 64 )
+    {
+        b[0] = vld1q_u8( input );
+        b[1] = vld1q_u8( input + 16 );
+        b[2] = vld1q_u8( input + 32 );
+        b[3] = vld1q_u8( input + 48 );
+        aesce_crypt4( ctx, mode, b );
+        vst1q_u8( output, b[0] );
+        vst1q_u8( output + 16, b[1] );
+        vst1q_u8( output + 32, b[2] );
+        vst1q_u8( output + 48, b[3] );
+    }
+
+    for( ; blocks > 0; blocks--, input += 16, output += 16 )
+        mbedtls_aesce_crypt_ecb( ctx, mode, input, output );
+}
+
+/*
+ * Counter block for the 128-bit big-endian counter hi:lo
+ */
+static inline uint8x16_t aesce_counter( uint64_t hi, uint64_t lo )
+{
+    return( vreinterpretq_u8_u64( vcombine_u64(
+                vcreate_u64( __builtin_bswap64( hi ) ),
+                vcreate_u64( __builtin_bswap64( lo ) ) ) ) );
+}
+
+void mbedtls_aesce_crypt_ctr_blocks( mbedtls_aes_context *ctx,
+                                     size_t blocks,
+                                     unsigned char nonce_counter[16],
+                                     const unsigned char *input,
+                                     unsigned char *output )
+{
+    uint8x16_t b[4];
+    uint64_t hi, lo;
+    int i = 4;
+
+    memcpy( &hi, nonce_counter, 8 );
+    memcpy( &lo, nonce_counter + 8, 8 );
+    hi = __builtin_bswap64( hi );
+    lo = __builtin_bswap64( lo );
+
+    while( blocks > 0 )
+    {
+        for( i = 0; i < 4; i++ )
+        {
+            b[i] = aesce_counter( hi, lo );
+            if( ++lo == 0 )
+                hi++;
+        }
+        aesce_crypt4( ctx, MBEDTLS_AES_ENCRYPT, b );
+
+        for( i = 0; i < 4 && blocks > 0;
+             i++, blocks--, input += 16, output += 16 )
+            vst1q_u8( output, veorq_u8( b[i], vld1q_u8( input ) ) );
+    }
+
+    /* the last batch may have counted past the blocks actually used */
+    for( ; i < 4; i++ )
+        if( lo-- == 0 )
+            hi--;
+
+    hi = __builtin_bswap64( hi );
+    lo = __builtin_bswap64( lo );
+    memcpy( nonce_counter, &hi, 8 );
+    memcpy( nonce_counter + 8, &lo, 8 );
+}
+
+#if defined(MBEDTLS_POP_TARGET_PRAGMA)
+#pragma GCC pop_options
+#undef MBEDTLS_POP_TARGET_PRAGMA
+#endif
+
+#endif /* MBEDTLS_AESCE_HAVE_CODE */
+
+#endif /* MBEDTLS_AESCE_C */
@@ -0,0 +1,388 @@
+/*
+ *  AES-NI support functions
+ *
+ *  Copyright (C) 2006-2015, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  This file is part of Mbed TLS (https://tls.mbed.org)
+ */
+
+/*
+ * [AES-WP] http://software.intel.com/en-us/articles/intel-advanced-encryption-standard-aes-instructions-set
+ */
+
+// Modified for XBee Host C Library: rewritten with compiler intrinsics
+// (following the key expansion in [AES-WP]) and four-way multi-block ECB
+// and CTR routines.  Each function is compiled for AES-NI with a target attribute, so
+// the rest of the library doesn't need -maes; aes.c only calls in here after
+// mbedtls_aesni_has_support() finds the instructions at run time.
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_AESNI_C)
+
+#include "mbedtls/aesni.h"
+
+#if defined(MBEDTLS_AESNI_HAVE_CODE)
+
+#include <string.h>
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define AESNI_TARGET    __attribute__((target("aes,sse2")))
+
+/*
+ * AES-NI support detection routine
+ */
+int mbedtls_aesni_has_support( unsigned int what )
+{
+    static int done = 0;
+    static unsigned int c = 0;
+
+    if( ! done )
+    {
+        unsigned int a, b, d;
+
+        if( __get_cpuid( 1, &a, &b, &c, &d ) == 0 )
+            c = 0;
+        done = 1;
+    }
+
+    return( ( c & what ) != 0 );
+}
+
+/*
+ * AES-NI AES-ECB block en(de)cryption
+ */
+AESNI_TARGET
+int mbedtls_aesni_crypt_ecb( mbedtls_aes_context *ctx,
+                             int mode,
+                             const unsigned char input[16],
+                             unsigned char output[16] )
+{
+    const __m128i *rk = (const __m128i *) ctx->rk;
+    __m128i b = _mm_xor_si128( _mm_loadu_si128( (const __m128i *) input ),
+                               _mm_loadu_si128( rk ) );
+    int i;
+
+    if( mode == MBEDTLS_AES_ENCRYPT )
+    {
+        for( i = 1; i < ctx->nr; i++ )
+            b = _mm_aesenc_si128( b, _mm_loadu_si128( rk + i ) );
+        b = _mm_aesenclast_si128( b, _mm_loadu_si128( rk + i ) );
+    }
+    else
+    {
+        for( i = 1; i < ctx->nr; i++ )
+            b = _mm_aesdec_si128( b, _mm_loadu_si128( rk + i ) );
+        b = _mm_aesdeclast_si128( b, _mm_loadu_si128( rk + i ) );
+    }
+
+    _mm_storeu_si128( (__m128i *) output, b );
+
+    return( 0 );
+}
+
+/*
+ * Run four independent blocks through the rounds together.  Each
+ * AESENC/AESDEC has a latency of several cycles but the CPU can start one
+ * every cycle, so this keeps the AES unit busy.
+ */
+AESNI_TARGET
+static inline void aesni_crypt4( const mbedtls_aes_context *ctx, int mode,
+                                 __m128i b[4] )
+{
+    const __m128i *rk = (const __m128i *) ctx->rk;
+    __m128i k = _mm_loadu_si128( rk );
+    int i;
+
+    b[0] = _mm_xor_si128( b[0], k );
+    b[1] = _mm_xor_si128( b[1], k );
+    b[2] = _mm_xor_si128( b[2], k );
+    b[3] = _mm_xor_si128( b[3], k );
+
+    if( mode == MBEDTLS_AES_ENCRYPT )
+    {
+        for( i = 1; i < ctx->nr; i++ )
+        {
+            k = _mm_loadu_si128( rk + i );
+            b[0] = _mm_aesenc_si128( b[0], k );
+            b[1] = _mm_aesenc_si128( b[1], k );
+            b[2] = _mm_aesenc_si128( b[2], k );
+            b[3] = _mm_aesenc_si128( b[3], k );
+        }
+        k = _mm_loadu_si128( rk + i );
+        b[0] = _mm_aesenclast_si128( b[0], k );
+        b[1] = _mm_aesenclast_si128( b[1], k );
+        b[2] = _mm_aesenclast_si128( b[2], k );
+        b[3] = _mm_aesenclast_si128( b[3], k );
+    }
+    else
+    {
+        for( i = 1; i < ctx->nr; i++ )
+        {
+            k = _mm_loadu_si128( rk + i );
+            b[0] = _mm_aesdec_si128( b[0], k );
+            b[1] = _mm_aesdec_si128( b[1], k );
+            b[2] = _mm_aesdec_si128( b[2], k );
+            b[3] = _mm_aesdec_si128( b[3], k );
+        }
+        k = _mm_loadu_si128( rk + i );
+        b[0] = _mm_aesdeclast_si128( b[0], k );
+        b[1] = _mm_aesdeclast_si128( b[1], k );
+        b[2] = _mm_aesdeclast_si128( b[2], k );
+        b[3] = _mm_aesdeclast_si128( b[3], k );
+    }
+}
+
+/*
+ * AES-NI AES-ECB en(de)cryption of several blocks
+ */
+AESNI_TARGET
+void mbedtls_aesni_crypt_ecb_blocks( mbedtls_aes_context *ctx,
+                                     int mode,
+                                     size_t blocks,
+                                     const unsigned char *input,
+                                     unsigned char *output )
+{
+    const __m128i *in = (const __m128i *) input;
+    __m128i *out = (__m128i *) output;
+    __m128i b[4];
+
+    for( ; blocks >= 4; blocks -= 4, in += 4, out += 4 )
+    {
+        b[0] = _mm_loadu_si128( in );
+        b[1] = _mm_loadu_si128( in + 1 );
+        b[2] = _mm_loadu_si128( in + 2 );
+        b[3] = _mm_loadu_si128( in + 3 );
+        aesni_crypt4( ctx, mode, b );
+        _mm_storeu_si128( out, b[0] );
+        _mm_storeu_si128( out + 1, b[1] );
+        _mm_storeu_si128( out + 2, b[2] );
+        _mm_storeu_si128( out + 3, b[3] );
+    }
+
+    for( ; blocks > 0; blocks--, in++, out++ )
+        mbedtls_aesni_crypt_ecb( ctx, mode, (const unsigned char *) in,
+                                 (unsigned char *) out );
+}
+
+/*
+ * Counter block for the 128-bit big-endian counter hi:lo
+ */
+AESNI_TARGET
+static inline __m128i aesni_counter( uint64_t hi, uint64_t lo )
+{
+    return( _mm_set_epi64x( (long long) __builtin_bswap64( lo ),
+                            (long long) __builtin_bswap64( hi ) ) );
+}
+
+/*
+ * AES-NI AES-CTR en(de)cryption of whole blocks.  The counter is kept in
+ * two integers and the counter blocks are built in registers.
+ */
+AESNI_TARGET
+void mbedtls_aesni_crypt_ctr_blocks( mbedtls_aes_context *ctx,
+                                     size_t blocks,
+                                     unsigned char nonce_counter[16],
+                                     const unsigned char *input,
+                                     unsigned char *output )
+{
+    const __m128i *in = (const __m128i *) input;
+    __m128i *out = (__m128i *) output;
+    __m128i b[4];
+    uint64_t hi, lo;
+    int i = 4;
+
+    memcpy( &hi, nonce_counter, 8 );
+    memcpy( &lo, nonce_counter + 8, 8 );
+    hi = __builtin_bswap64( hi );
+    lo = __builtin_bswap64( lo );
+
+    while( blocks > 0 )
+    {
+        for( i = 0; i < 4; i++ )
+        {
+            b[i] = aesni_counter( hi, lo );
+            if( ++lo == 0 )
+                hi++;
+        }
+        aesni_crypt4( ctx, MBEDTLS_AES_ENCRYPT, b );
+
+        for( i = 0; i < 4 && blocks > 0; i++, blocks--, in++, out++ )
+            _mm_storeu_si128( out, _mm_xor_si128( b[i],
+                                                  _mm_loadu_si128( in ) ) );
+    }
+
+    /* the last batch may have counted past the blocks actually used */
+    for( ; i < 4; i++ )
+        if( lo-- == 0 )
+            hi--;
+
+    hi = __builtin_bswap64( hi );
+    lo = __builtin_bswap64( lo );
+    memcpy( nonce_counter, &hi, 8 );
+    memcpy( nonce_counter + 8, &lo, 8 );
+}
+
+/*
+ * Compute decryption round keys from encryption round keys
+ */
+AESNI_TARGET
+void mbedtls_aesni_inverse_key( unsigned char *invkey,
+                                const unsigned char *fwdkey,
+                                int nr )
+{
+    __m128i *ik = (__m128i *) invkey;
+    const __m128i *fk = (const __m128i *) fwdkey + nr;
+
+    _mm_storeu_si128( ik, _mm_loadu_si128( fk ) );
+
+    for( fk--, ik++; fk > (const __m128i *) fwdkey; fk--, ik++ )
+        _mm_storeu_si128( ik, _mm_aesimc_si128( _mm_loadu_si128( fk ) ) );
+
+    _mm_storeu_si128( ik, _mm_loadu_si128( fk ) );
+}
+
+/*
+ * XOR each 32-bit word of x into all the words above it
+ */
+AESNI_TARGET
+static inline __m128i aesni_prefix_xor( __m128i x )
+{
+    x = _mm_xor_si128( x, _mm_slli_si128( x, 4 ) );
+    return( _mm_xor_si128( x, _mm_slli_si128( x, 8 ) ) );
+}
+
+/*
+ * Key expansion, 128-bit case
+ */
+#define AESNI_EXPAND128( rcon )                                         \
+    k = _mm_xor_si128( aesni_prefix_xor( k ), _mm_shuffle_epi32(        \
+            _mm_aeskeygenassist_si128( k, rcon ), 0xFF ) );             \
+    _mm_storeu_si128( rk++, k )
+
+AESNI_TARGET
+static void aesni_setkey_enc_128( __m128i *rk, const unsigned char *key )
+{
+    __m128i k = _mm_loadu_si128( (const __m128i *) key );
+
+    _mm_storeu_si128( rk++, k );
+    AESNI_EXPAND128( 0x01 );
+    AESNI_EXPAND128( 0x02 );
+    AESNI_EXPAND128( 0x04 );
+    AESNI_EXPAND128( 0x08 );
+    AESNI_EXPAND128( 0x10 );
+    AESNI_EXPAND128( 0x20 );
+    AESNI_EXPAND128( 0x40 );
+    AESNI_EXPAND128( 0x80 );
+    AESNI_EXPAND128( 0x1B );
+    AESNI_EXPAND128( 0x36 );
+}
+
+/*
+ * Key expansion, 192-bit case.  Each step makes six new words: four in k
+ * and two in the low half of k2.  Round keys straddle the steps, so the
+ * schedule is written out 24 bytes at a time.
+ */
+#define AESNI_EXPAND192( rcon )                                         \
+    k = _mm_xor_si128( aesni_prefix_xor( k ), _mm_shuffle_epi32(        \
+            _mm_aeskeygenassist_si128( k2, rcon ), 0x55 ) );            \
+    k2 = _mm_xor_si128( k2, _mm_slli_si128( k2, 4 ) );                  \
+    k2 = _mm_xor_si128( k2, _mm_shuffle_epi32( k, 0xFF ) );             \
+    _mm_storeu_si128( (__m128i *) rk, k );                              \
+    _mm_storel_epi64( (__m128i *) ( rk + 16 ), k2 );                    \
+    rk += 24
+
+AESNI_TARGET
+static void aesni_setkey_enc_192( unsigned char *rk, const unsigned char *key )
+{
+    __m128i k = _mm_loadu_si128( (const __m128i *) key );
+    __m128i k2 = _mm_loadl_epi64( (const __m128i *) ( key + 16 ) );
+
+    _mm_storeu_si128( (__m128i *) rk, k );
+    _mm_storel_epi64( (__m128i *) ( rk + 16 ), k2 );
+    rk += 24;
+    AESNI_EXPAND192( 0x01 );
+    AESNI_EXPAND192( 0x02 );
+    AESNI_EXPAND192( 0x04 );
+    AESNI_EXPAND192( 0x08 );
+    AESNI_EXPAND192( 0x10 );
+    AESNI_EXPAND192( 0x20 );
+    AESNI_EXPAND192( 0x40 );
+
+    /* the last round key only needs the first four words of step 8 */
+    k = _mm_xor_si128( aesni_prefix_xor( k ), _mm_shuffle_epi32(
+            _mm_aeskeygenassist_si128( k2, 0x80 ), 0x55 ) );
+    _mm_storeu_si128( (__m128i *) rk, k );
+}
+
+/*
+ * Key expansion, 256-bit case.  Even round keys use RotWord/SubWord/Rcon
+ * of the previous key's last word, odd ones only SubWord.
+ */
+#define AESNI_EXPAND256( rcon )                                         \
+    k = _mm_xor_si128( aesni_prefix_xor( k ), _mm_shuffle_epi32(        \
+            _mm_aeskeygenassist_si128( k2, rcon ), 0xFF ) );            \
+    _mm_storeu_si128( rk++, k );                                        \
+    k2 = _mm_xor_si128( aesni_prefix_xor( k2 ), _mm_shuffle_epi32(      \
+            _mm_aeskeygenassist_si128( k, 0x00 ), 0xAA ) );             \
+    _mm_storeu_si128( rk++, k2 )
+
+AESNI_TARGET
+static void aesni_setkey_enc_256( __m128i *rk, const unsigned char *key )
+{
+    __m128i k = _mm_loadu_si128( (const __m128i *) key );
+    __m128i k2 = _mm_loadu_si128( (const __m128i *) ( key + 16 ) );
+
+    _mm_storeu_si128( rk++, k );
+    _mm_storeu_si128( rk++, k2 );
+    AESNI_EXPAND256( 0x01 );
+    AESNI_EXPAND256( 0x02 );
+    AESNI_EXPAND256( 0x04 );
+    AESNI_EXPAND256( 0x08 );
+    AESNI_EXPAND256( 0x10 );
+    AESNI_EXPAND256( 0x20 );
+
+    k = _mm_xor_si128( aesni_prefix_xor( k ), _mm_shuffle_epi32(
+            _mm_aeskeygenassist_si128( k2, 0x40 ), 0xFF ) );
+    _mm_storeu_si128( rk, k );
+}
+
+/*
+ * Key expansion, wrapper
+ */
+int mbedtls_aesni_setkey_enc( unsigned char *rk,
+                              const unsigned char *key,
+                              size_t bits )
+{
+    switch( bits )
+    {
+        case 128: aesni_setkey_enc_128( (__m128i *) rk, key ); break;
+        case 192: aesni_setkey_enc_192( rk, key ); break;
+        case 256: aesni_setkey_enc_256( (__m128i *) rk, key ); break;
+        default : return( MBEDTLS_ERR_AES_INVALID_KEY_LENGTH );
+    }
+
+    return( 0 );
+}
+
+#endif /* MBEDTLS_AESNI_HAVE_CODE */
+
+#endif /* MBEDTLS_AESNI_C */
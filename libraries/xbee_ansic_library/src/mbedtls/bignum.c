@@ -19,6 +19,10 @@
  *  This file is part of mbed TLS (https://tls.mbed.org)
  */
 
+// Modified for XBee Host C Library: a single-pass Montgomery multiplication
+// for full-width operands, and fixed-base comb exponentiation
+// (mbedtls_mpi_comb_setup() and mbedtls_mpi_exp_mod_comb()).
+
 /*
  *  The following sources were referenced in the design of this Multi-precision
  *  Integer library:
@@ -1862,6 +1866,65 @@ static void mpi_montg_init( mbedtls_mpi_uint *mm, const mbedtls_mpi *N )
     *mm = ~x + 1;
 }
 
+#if defined(MBEDTLS_HAVE_UDBL)
+/*
+ * Return the low limb of x * y + z + *c and leave the high limb in *c
+ */
+static inline mbedtls_mpi_uint mpi_muladd( mbedtls_mpi_uint x,
+                                           mbedtls_mpi_uint y,
+                                           mbedtls_mpi_uint z,
+                                           mbedtls_mpi_uint *c )
+{
+    mbedtls_t_udbl r = (mbedtls_t_udbl) x * y;
+    mbedtls_mpi_uint r0 = (mbedtls_mpi_uint) r;
+    mbedtls_mpi_uint r1 = (mbedtls_mpi_uint) ( r >> biL );
+
+    r0 += z;  r1 += ( r0 < z );
+    r0 += *c; r1 += ( r0 < *c );
+    *c = r1;
+
+    return( r0 );
+}
+
+/*
+ * d = (a * b + k * N) / 2^(n * biL), where k makes the division exact.
+ * Each limb of a takes a single pass that adds a[i] * b and u * N together
+ * and shifts down a limb (CIOS), instead of two passes of mpi_mul_hlp()
+ * with their carry loops.  d must hold n + 1 zeroed limbs.
+ */
+static void mpi_montmul_hlp( size_t n, const mbedtls_mpi_uint *a,
+                             const mbedtls_mpi_uint *b,
+                             const mbedtls_mpi_uint *N,
+                             mbedtls_mpi_uint mm, mbedtls_mpi_uint *d )
+{
+    mbedtls_mpi_uint ai, u, c1, c2, t;
+    size_t i, j;
+
+    for( i = 0; i < n; i++ )
+    {
+        ai = a[i];
+        c1 = 0;
+        c2 = 0;
+        t = mpi_muladd( ai, b[0], d[0], &c1 );
+        u = t * mm;
+        (void) mpi_muladd( u, N[0], t, &c2 );
+
+        for( j = 1; j < n; j++ )
+        {
+            t = mpi_muladd( ai, b[j], d[j], &c1 );
+            d[j - 1] = mpi_muladd( u, N[j], t, &c2 );
+        }
+
+        t = d[n] + c1;
+        c1 = ( t < c1 );
+        t += c2;
+        c1 += ( t < c2 );
+        d[n - 1] = t;
+        d[n] = c1;
+    }
+}
+#endif /* MBEDTLS_HAVE_UDBL */
+
 /*
  * Montgomery multiplication: A = A * B * R^-1 mod N  (HAC 14.36)
  */
@@ -1880,6 +1943,11 @@ static int mpi_montmul( mbedtls_mpi *A, const mbedtls_mpi *B, const mbedtls_mpi
     n = N->n;
     m = ( B->n < n ) ? B->n : n;
 
+#if defined(MBEDTLS_HAVE_UDBL)
+    if( m == n )
+        mpi_montmul_hlp( n, A->p, B->p, N->p, mm, d );
+    else
+#endif
     for( i = 0; i < n; i++ )
     {
         /*
@@ -2137,6 +2205,226 @@ int mbedtls_mpi_exp_mod( mbedtls_mpi *X, const mbedtls_mpi *A,
     return( ret );
 }
 
+/*
+ * Constant-time table lookup: S = T[idx], touching every entry of T
+ */
+static void mpi_comb_select( mbedtls_mpi *S, const mbedtls_mpi *T,
+                             size_t count, size_t idx, size_t limbs )
+{
+    size_t i, j;
+    mbedtls_mpi_uint mask;
+
+    memset( S->p, 0, S->n * ciL );
+
+    for( i = 0; i < count; i++ )
+    {
+        /* all ones when i == idx, zero otherwise, without a branch */
+        mask = (mbedtls_mpi_uint) 0 -
+               (mbedtls_mpi_uint) ( ( ( i ^ idx ) - 1 ) >>
+                                    ( sizeof( size_t ) * 8 - 1 ) );
+
+        for( j = 0; j < limbs; j++ )
+            S->p[j] |= T[i].p[j] & mask;
+    }
+}
+
+void mbedtls_mpi_comb_init( mbedtls_mpi_comb *comb )
+{
+    MPI_VALIDATE( comb != NULL );
+
+    mbedtls_mpi_init( &comb->G );
+    mbedtls_mpi_init( &comb->N );
+    mbedtls_mpi_init( &comb->RR );
+    comb->mm = 0;
+    comb->teeth = 0;
+    comb->spacing = 0;
+    comb->T = NULL;
+}
+
+void mbedtls_mpi_comb_free( mbedtls_mpi_comb *comb )
+{
+    size_t i;
+
+    if( comb == NULL )
+        return;
+
+    if( comb->T != NULL )
+    {
+        for( i = 0; i < ( (size_t) 1 << comb->teeth ); i++ )
+            mbedtls_mpi_free( &comb->T[i] );
+
+        mbedtls_free( comb->T );
+    }
+
+    mbedtls_mpi_free( &comb->G );
+    mbedtls_mpi_free( &comb->N );
+    mbedtls_mpi_free( &comb->RR );
+    comb->mm = 0;
+    comb->teeth = 0;
+    comb->spacing = 0;
+    comb->T = NULL;
+}
+
+/*
+ * Fixed-base comb precomputation (HAC 14.117, one table): with
+ * d = ceil(max_bits / teeth), T[b] = G^(sum of 2^(j * d) for each bit j
+ * set in b), kept in Montgomery form.
+ */
+int mbedtls_mpi_comb_setup( mbedtls_mpi_comb *comb, const mbedtls_mpi *G,
+                            const mbedtls_mpi *N, size_t max_bits )
+{
+    int ret;
+    size_t i, j, top, count, limbs;
+    mbedtls_mpi T;
+
+    MPI_VALIDATE_RET( comb != NULL );
+    MPI_VALIDATE_RET( G != NULL );
+    MPI_VALIDATE_RET( N != NULL );
+
+    if( mbedtls_mpi_cmp_int( N, 0 ) <= 0 || ( N->p[0] & 1 ) == 0 ||
+        max_bits == 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    mbedtls_mpi_comb_free( comb );
+    mbedtls_mpi_init( &T );
+
+    count = (size_t) 1 << MBEDTLS_MPI_COMB_TEETH;
+    comb->T = mbedtls_calloc( count, sizeof( mbedtls_mpi ) );
+    if( comb->T == NULL )
+        return( MBEDTLS_ERR_MPI_ALLOC_FAILED );
+
+    for( i = 0; i < count; i++ )
+        mbedtls_mpi_init( &comb->T[i] );
+
+    comb->teeth = MBEDTLS_MPI_COMB_TEETH;
+    comb->spacing = ( max_bits + comb->teeth - 1 ) / comb->teeth;
+    limbs = N->n + 1;
+
+    mpi_montg_init( &comb->mm, N );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->N, N ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &comb->G, G, N ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, limbs * 2 ) );
+
+    /*
+     * RR = R^2 mod N, as in mbedtls_mpi_exp_mod()
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_lset( &comb->RR, 1 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_shift_l( &comb->RR, N->n * 2 * biL ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_mod_mpi( &comb->RR, &comb->RR, N ) );
+
+    /*
+     * T[0] = R mod N (one), T[1] = G * R mod N
+     */
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &comb->T[0], limbs ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[0], &comb->RR ) );
+    MBEDTLS_MPI_CHK( mpi_montred( &comb->T[0], N, comb->mm, &T ) );
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &comb->T[1], limbs ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[1], &comb->G ) );
+    MBEDTLS_MPI_CHK( mpi_montmul( &comb->T[1], &comb->RR, N, comb->mm, &T ) );
+
+    /*
+     * T[2^j] = T[2^(j-1)]^(2^d)
+     */
+    for( j = 1; j < comb->teeth; j++ )
+    {
+        top = (size_t) 1 << j;
+        MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &comb->T[top], limbs ) );
+        MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[top],
+                                           &comb->T[top >> 1] ) );
+
+        for( i = 0; i < comb->spacing; i++ )
+            MBEDTLS_MPI_CHK( mpi_montmul( &comb->T[top], &comb->T[top],
+                                          N, comb->mm, &T ) );
+    }
+
+    /*
+     * T[b] = T[b - top] * T[top], top being the highest bit of b
+     */
+    for( top = 2; top < count; top <<= 1 )
+    {
+        for( i = top + 1; i < ( top << 1 ); i++ )
+        {
+            MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &comb->T[i], limbs ) );
+            MBEDTLS_MPI_CHK( mbedtls_mpi_copy( &comb->T[i],
+                                               &comb->T[i - top] ) );
+            MBEDTLS_MPI_CHK( mpi_montmul( &comb->T[i], &comb->T[top],
+                                          N, comb->mm, &T ) );
+        }
+    }
+
+cleanup:
+
+    mbedtls_mpi_free( &T );
+
+    if( ret != 0 )
+        mbedtls_mpi_comb_free( comb );
+
+    return( ret );
+}
+
+/*
+ * Fixed-base comb exponentiation: X = G^E mod N  (HAC 14.117)
+ */
+int mbedtls_mpi_exp_mod_comb( mbedtls_mpi *X, const mbedtls_mpi_comb *comb,
+                              const mbedtls_mpi *E )
+{
+    int ret;
+    size_t i, j, idx, count, limbs;
+    mbedtls_mpi S, T;
+
+    MPI_VALIDATE_RET( X != NULL );
+    MPI_VALIDATE_RET( comb != NULL );
+    MPI_VALIDATE_RET( E != NULL );
+
+    if( comb->T == NULL || mbedtls_mpi_cmp_int( E, 0 ) < 0 )
+        return( MBEDTLS_ERR_MPI_BAD_INPUT_DATA );
+
+    /*
+     * Exponents wider than the comb take the sliding window, which can
+     * still reuse the comb's R^2 mod N.
+     */
+    if( mbedtls_mpi_bitlen( E ) > comb->teeth * comb->spacing )
+        return( mbedtls_mpi_exp_mod( X, &comb->G, E, &comb->N,
+                                     (mbedtls_mpi *) &comb->RR ) );
+
+    mbedtls_mpi_init( &S );
+    mbedtls_mpi_init( &T );
+
+    count = (size_t) 1 << comb->teeth;
+    limbs = comb->N.n + 1;
+
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &S, limbs ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( &T, limbs * 2 ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_grow( X, limbs ) );
+    MBEDTLS_MPI_CHK( mbedtls_mpi_copy( X, &comb->T[0] ) );
+
+    /*
+     * Column i of the comb holds bits i, i + d, i + 2d, ... of E
+     */
+    for( i = comb->spacing; i-- > 0; )
+    {
+        MBEDTLS_MPI_CHK( mpi_montmul( X, X, &comb->N, comb->mm, &T ) );
+
+        idx = 0;
+        for( j = 0; j < comb->teeth; j++ )
+            idx |= (size_t) mbedtls_mpi_get_bit( E, i + j * comb->spacing )
+                   << j;
+
+        mpi_comb_select( &S, comb->T, count, idx, limbs );
+        MBEDTLS_MPI_CHK( mpi_montmul( X, &S, &comb->N, comb->mm, &T ) );
+    }
+
+    MBEDTLS_MPI_CHK( mpi_montred( X, &comb->N, comb->mm, &T ) );
+
+cleanup:
+
+    mbedtls_mpi_free( &S );
+    mbedtls_mpi_free( &T );
+
+    return( ret );
+}
+
 /*
  * Greatest common divisor: G = gcd(A, B)  (HAC 14.54)
  */
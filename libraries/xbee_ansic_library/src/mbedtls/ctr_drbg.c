@@ -18,6 +18,10 @@
  *
  *  This file is part of mbed TLS (https://tls.mbed.org)
  */
+
+// Modified for XBee Host C Library: whole output blocks are generated with
+// one mbedtls_aes_crypt_ctr() call, so AES-NI and the Armv8-A Cryptographic
+// Extension work on several counter blocks in parallel.
 /*
  *  The NIST SP 800-90 DRBGs are described in the following publication.
  *
@@ -502,6 +506,37 @@ int mbedtls_ctr_drbg_random_with_add( void *p_rng,
             goto exit;
     }
 
+#if defined(MBEDTLS_CIPHER_MODE_CTR)
+    /*
+     * Whole blocks: E(V + 1), E(V + 2), ... is the AES-CTR key stream that
+     * starts at V + 1, so encrypt zeros in place and step V back by one
+     * from the counter that mbedtls_aes_crypt_ctr() leaves.
+     */
+    use_len = output_len - output_len % MBEDTLS_CTR_DRBG_BLOCKSIZE;
+    if( use_len > 0 )
+    {
+        size_t nc_off = 0;
+
+        for( i = MBEDTLS_CTR_DRBG_BLOCKSIZE; i > 0; i-- )
+            if( ++ctx->counter[i - 1] != 0 )
+                break;
+
+        memset( p, 0, use_len );
+        if( ( ret = mbedtls_aes_crypt_ctr( &ctx->aes_ctx, use_len, &nc_off,
+                                           ctx->counter, tmp, p, p ) ) != 0 )
+        {
+            goto exit;
+        }
+
+        for( i = MBEDTLS_CTR_DRBG_BLOCKSIZE; i > 0; i-- )
+            if( ctx->counter[i - 1]-- != 0 )
+                break;
+
+        p += use_len;
+        output_len -= use_len;
+    }
+#endif /* MBEDTLS_CIPHER_MODE_CTR */
+
     while( output_len > 0 )
     {
         /*
@@ -24,6 +24,10 @@
  *  http://csrc.nist.gov/publications/fips/fips180-2/fips180-2.pdf
  */
 
+// Modified for XBee Host C Library: SHA-NI (x86) and Armv8-A Cryptographic
+// Extension block functions chosen at run time, and
+// mbedtls_sha256_ret_multi() to hash independent messages in SIMD lanes.
+
 #if !defined(MBEDTLS_CONFIG_FILE)
 #include "mbedtls/config.h"
 #else
@@ -37,6 +41,42 @@
 
 #include <string.h>
 
+#if !defined(MBEDTLS_SHA256_ALT) && !defined(MBEDTLS_SHA256_PROCESS_ALT)
+
+#if defined(MBEDTLS_SHA256_USE_SHA_NI_IF_PRESENT) && defined(__GNUC__) && \
+    ( defined(__x86_64__) || defined(__i386__) )
+#define MBEDTLS_SHA256_HAVE_SHA_NI
+#endif
+
+#if defined(MBEDTLS_SHA256_USE_ARMV8_A_CRYPTO_IF_PRESENT) && \
+    defined(__GNUC__) && defined(__aarch64__)
+#define MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO
+#endif
+
+/* GCC vector extensions give 4 (SSE2, NEON) or 8 (AVX2) lanes for
+ * mbedtls_sha256_ret_multi(). */
+#if defined(__GNUC__) && \
+    ( defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) )
+#define MBEDTLS_SHA256_HAVE_LANES
+#endif
+
+#endif /* !MBEDTLS_SHA256_ALT && !MBEDTLS_SHA256_PROCESS_ALT */
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(MBEDTLS_SHA256_HAVE_SHA_NI) || defined(MBEDTLS_SHA256_HAVE_LANES)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO)
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
 #if defined(MBEDTLS_SELF_TEST)
 #if defined(MBEDTLS_PLATFORM_C)
 #include "mbedtls/platform.h"
@@ -198,16 +238,13 @@ static const uint32_t K[] =
         (d) += temp1; (h) = temp1 + temp2;              \
     } while( 0 )
 
-int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
-                                const unsigned char data[64] )
+static void sha256_process_c( mbedtls_sha256_context *ctx,
+                              const unsigned char data[64] )
 {
     uint32_t temp1, temp2, W[64];
     uint32_t A[8];
     unsigned int i;
 
-    SHA256_VALIDATE_RET( ctx != NULL );
-    SHA256_VALIDATE_RET( (const unsigned char *)data != NULL );
-
     for( i = 0; i < 8; i++ )
         A[i] = ctx->state[i];
 
@@ -255,6 +292,294 @@ int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
 
     for( i = 0; i < 8; i++ )
         ctx->state[i] += A[i];
+}
+
+#if defined(MBEDTLS_SHA256_HAVE_SHA_NI)
+
+#ifndef bit_SHA
+#define bit_SHA         ( 1 << 29 )
+#endif
+
+#define SHA_NI_TARGET   __attribute__((target("sha,sse4.1")))
+
+static int sha256_has_sha_ni( void )
+{
+    static int supported = -1;
+
+    if( supported < 0 )
+    {
+        unsigned int a, b, c, d;
+
+        supported = 0;
+        if( __get_cpuid_max( 0, NULL ) >= 7 )
+        {
+            __cpuid_count( 7, 0, a, b, c, d );
+            if( b & bit_SHA )
+            {
+                __cpuid( 1, a, b, c, d );
+                supported = ( c & bit_SSE4_1 ) != 0;
+            }
+        }
+    }
+
+    return( supported );
+}
+
+/*
+ * Rounds t to t + 3: SHA256RNDS2 does two rounds with the low half of msg.
+ */
+#define SHA_NI_ROUNDS( t, w )                                               \
+    do                                                                      \
+    {                                                                       \
+        msg = _mm_add_epi32( w, _mm_loadu_si128( (const __m128i *) &K[t] ) ); \
+        cdgh = _mm_sha256rnds2_epu32( cdgh, abef, msg );                    \
+        msg = _mm_shuffle_epi32( msg, 0x0E );                               \
+        abef = _mm_sha256rnds2_epu32( abef, cdgh, msg );                    \
+    } while( 0 )
+
+/*
+ * Replace W[t-16..t-13] in w0 with W[t..t+3]; w1, w2 and w3 hold
+ * W[t-12..t-1].
+ */
+#define SHA_NI_SCHEDULE( w0, w1, w2, w3 )                                   \
+    do                                                                      \
+    {                                                                       \
+        w0 = _mm_sha256msg1_epu32( w0, w1 );                                \
+        w0 = _mm_add_epi32( w0, _mm_alignr_epi8( w3, w2, 4 ) );             \
+        w0 = _mm_sha256msg2_epu32( w0, w3 );                                \
+    } while( 0 )
+
+SHA_NI_TARGET
+static void sha256_process_many_sha_ni( uint32_t state[8],
+                                        const unsigned char *data,
+                                        size_t blocks )
+{
+    const __m128i bswap = _mm_set_epi64x( 0x0C0D0E0F08090A0BULL,
+                                          0x0405060700010203ULL );
+    __m128i abef, cdgh, abef_save, cdgh_save, msg, tmp;
+    __m128i w0, w1, w2, w3;
+    unsigned int t;
+
+    /* SHA256RNDS2 wants the state as ABEF and CDGH */
+    tmp  = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i *) &state[0] ),
+                              0xB1 );
+    cdgh = _mm_shuffle_epi32( _mm_loadu_si128( (const __m128i *) &state[4] ),
+                              0x1B );
+    abef = _mm_alignr_epi8( tmp, cdgh, 8 );
+    cdgh = _mm_blend_epi16( cdgh, tmp, 0xF0 );
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        abef_save = abef;
+        cdgh_save = cdgh;
+
+        w0 = _mm_shuffle_epi8(
+                _mm_loadu_si128( (const __m128i *) ( data +  0 ) ), bswap );
+        w1 = _mm_shuffle_epi8(
+                _mm_loadu_si128( (const __m128i *) ( data + 16 ) ), bswap );
+        w2 = _mm_shuffle_epi8(
+                _mm_loadu_si128( (const __m128i *) ( data + 32 ) ), bswap );
+        w3 = _mm_shuffle_epi8(
+                _mm_loadu_si128( (const __m128i *) ( data + 48 ) ), bswap );
+
+        SHA_NI_ROUNDS(  0, w0 );
+        SHA_NI_ROUNDS(  4, w1 );
+        SHA_NI_ROUNDS(  8, w2 );
+        SHA_NI_ROUNDS( 12, w3 );
+
+        for( t = 16; t < 64; t += 16 )
+        {
+            SHA_NI_SCHEDULE( w0, w1, w2, w3 );
+            SHA_NI_ROUNDS( t +  0, w0 );
+            SHA_NI_SCHEDULE( w1, w2, w3, w0 );
+            SHA_NI_ROUNDS( t +  4, w1 );
+            SHA_NI_SCHEDULE( w2, w3, w0, w1 );
+            SHA_NI_ROUNDS( t +  8, w2 );
+            SHA_NI_SCHEDULE( w3, w0, w1, w2 );
+            SHA_NI_ROUNDS( t + 12, w3 );
+        }
+
+        abef = _mm_add_epi32( abef, abef_save );
+        cdgh = _mm_add_epi32( cdgh, cdgh_save );
+    }
+
+    /* back to ABCD and EFGH */
+    tmp  = _mm_shuffle_epi32( abef, 0x1B );
+    cdgh = _mm_shuffle_epi32( cdgh, 0xB1 );
+    _mm_storeu_si128( (__m128i *) &state[0], _mm_blend_epi16( tmp, cdgh, 0xF0 ) );
+    _mm_storeu_si128( (__m128i *) &state[4], _mm_alignr_epi8( cdgh, tmp, 8 ) );
+}
+
+
+#endif /* MBEDTLS_SHA256_HAVE_SHA_NI */
+
+#if defined(MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO)
+
+/* Build the kernel for the crypto extension even if the rest of the
+ * library targets plain Armv8-A; sha256_has_armv8_a_crypto() checks for
+ * it at run time. */
+#define ARMV8_A_CRYPTO_TARGET   __attribute__((target("arch=armv8-a+crypto")))
+
+static int sha256_has_armv8_a_crypto( void )
+{
+#if defined(__linux__)
+    static int supported = -1;
+
+    if( supported < 0 )
+        supported = ( getauxval( AT_HWCAP ) & HWCAP_SHA2 ) != 0;
+
+    return( supported );
+#elif defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)
+    return( 1 );
+#else
+    return( 0 );
+#endif
+}
+
+/*
+ * Rounds t to t + 3
+ */
+#define ARMV8_ROUNDS( t, w )                                                \
+    do                                                                      \
+    {                                                                       \
+        tmp = vaddq_u32( w, vld1q_u32( &K[t] ) );                           \
+        abcd_prev = abcd;                                                   \
+        abcd = vsha256hq_u32( abcd_prev, efgh, tmp );                       \
+        efgh = vsha256h2q_u32( efgh, abcd_prev, tmp );                      \
+    } while( 0 )
+
+ARMV8_A_CRYPTO_TARGET
+static void sha256_process_many_armv8_a_crypto( uint32_t state[8],
+                                                const unsigned char *data,
+                                                size_t blocks )
+{
+    uint32x4_t abcd = vld1q_u32( &state[0] );
+    uint32x4_t efgh = vld1q_u32( &state[4] );
+    uint32x4_t abcd_save, efgh_save, abcd_prev, tmp;
+    uint32x4_t w0, w1, w2, w3;
+    unsigned int t;
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        abcd_save = abcd;
+        efgh_save = efgh;
+
+        w0 = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data +  0 ) ) );
+        w1 = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + 16 ) ) );
+        w2 = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + 32 ) ) );
+        w3 = vreinterpretq_u32_u8( vrev32q_u8( vld1q_u8( data + 48 ) ) );
+
+        ARMV8_ROUNDS(  0, w0 );
+        ARMV8_ROUNDS(  4, w1 );
+        ARMV8_ROUNDS(  8, w2 );
+        ARMV8_ROUNDS( 12, w3 );
+
+        for( t = 16; t < 64; t += 16 )
+        {
+            w0 = vsha256su1q_u32( vsha256su0q_u32( w0, w1 ), w2, w3 );
+            ARMV8_ROUNDS( t +  0, w0 );
+            w1 = vsha256su1q_u32( vsha256su0q_u32( w1, w2 ), w3, w0 );
+            ARMV8_ROUNDS( t +  4, w1 );
+            w2 = vsha256su1q_u32( vsha256su0q_u32( w2, w3 ), w0, w1 );
+            ARMV8_ROUNDS( t +  8, w2 );
+            w3 = vsha256su1q_u32( vsha256su0q_u32( w3, w0 ), w1, w2 );
+            ARMV8_ROUNDS( t + 12, w3 );
+        }
+
+        abcd = vaddq_u32( abcd, abcd_save );
+        efgh = vaddq_u32( efgh, efgh_save );
+    }
+
+    vst1q_u32( &state[0], abcd );
+    vst1q_u32( &state[4], efgh );
+}
+
+#endif /* MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO */
+
+#if defined(MBEDTLS_SHA256_HAVE_LANES)
+
+/*
+ * The same rounds on 4 or 8 independent messages at once, one per vector
+ * lane.  S0..S3, F0, F1, R and P above work unchanged on GCC vectors.
+ * state holds word i of lane j at state[i * lanes + j].
+ */
+#define SHA256_LANES_KERNEL( name, vec, lanes, target )                     \
+target                                                                      \
+static void name( uint32_t *state, const unsigned char * const *data )      \
+{                                                                           \
+    vec temp1, temp2, W[64];                                                \
+    vec A[8], S[8];                                                         \
+    unsigned int i, j;                                                      \
+                                                                            \
+    for( i = 0; i < 8; i++ )                                                \
+    {                                                                       \
+        memcpy( &S[i], state + i * (lanes), sizeof( vec ) );                \
+        A[i] = S[i];                                                        \
+    }                                                                       \
+                                                                            \
+    for( i = 0; i < 16; i++ )                                               \
+        for( j = 0; j < (lanes); j++ )                                      \
+            GET_UINT32_BE( W[i][j], data[j], 4 * i );                       \
+                                                                            \
+    for( i = 0; i < 64; i += 8 )                                            \
+    {                                                                       \
+        if( i >= 16 )                                                       \
+            for( j = i; j < i + 8; j++ )                                    \
+                R( j );                                                     \
+        P( A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7], W[i+0], K[i+0] ); \
+        P( A[7], A[0], A[1], A[2], A[3], A[4], A[5], A[6], W[i+1], K[i+1] ); \
+        P( A[6], A[7], A[0], A[1], A[2], A[3], A[4], A[5], W[i+2], K[i+2] ); \
+        P( A[5], A[6], A[7], A[0], A[1], A[2], A[3], A[4], W[i+3], K[i+3] ); \
+        P( A[4], A[5], A[6], A[7], A[0], A[1], A[2], A[3], W[i+4], K[i+4] ); \
+        P( A[3], A[4], A[5], A[6], A[7], A[0], A[1], A[2], W[i+5], K[i+5] ); \
+        P( A[2], A[3], A[4], A[5], A[6], A[7], A[0], A[1], W[i+6], K[i+6] ); \
+        P( A[1], A[2], A[3], A[4], A[5], A[6], A[7], A[0], W[i+7], K[i+7] ); \
+    }                                                                       \
+                                                                            \
+    for( i = 0; i < 8; i++ )                                                \
+    {                                                                       \
+        A[i] += S[i];                                                       \
+        memcpy( state + i * (lanes), &A[i], sizeof( vec ) );                \
+    }                                                                       \
+}
+
+typedef uint32_t sha256_vec4 __attribute__((vector_size(16)));
+
+#if defined(__x86_64__) || defined(__i386__)
+typedef uint32_t sha256_vec8 __attribute__((vector_size(32)));
+
+SHA256_LANES_KERNEL( sha256_lanes4, sha256_vec4, 4,
+                     __attribute__((target("sse2"))) )
+SHA256_LANES_KERNEL( sha256_lanes8, sha256_vec8, 8,
+                     __attribute__((target("avx2"))) )
+#else
+SHA256_LANES_KERNEL( sha256_lanes4, sha256_vec4, 4, )
+#endif
+
+#endif /* MBEDTLS_SHA256_HAVE_LANES */
+
+int mbedtls_internal_sha256_process( mbedtls_sha256_context *ctx,
+                                const unsigned char data[64] )
+{
+    SHA256_VALIDATE_RET( ctx != NULL );
+    SHA256_VALIDATE_RET( (const unsigned char *)data != NULL );
+
+#if defined(MBEDTLS_SHA256_HAVE_SHA_NI)
+    if( sha256_has_sha_ni() )
+    {
+        sha256_process_many_sha_ni( ctx->state, data, 1 );
+        return( 0 );
+    }
+#endif
+#if defined(MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO)
+    if( sha256_has_armv8_a_crypto() )
+    {
+        sha256_process_many_armv8_a_crypto( ctx->state, data, 1 );
+        return( 0 );
+    }
+#endif
+
+    sha256_process_c( ctx, data );
 
     return( 0 );
 }
@@ -268,6 +593,40 @@ void mbedtls_sha256_process( mbedtls_sha256_context *ctx,
 #endif
 #endif /* !MBEDTLS_SHA256_PROCESS_ALT */
 
+/*
+ * Process whole blocks, handing them all to the hardware at once if the
+ * CPU has SHA-256 instructions
+ */
+static int sha256_process_blocks( mbedtls_sha256_context *ctx,
+                                  const unsigned char *data,
+                                  size_t blocks )
+{
+    int ret;
+
+#if defined(MBEDTLS_SHA256_HAVE_SHA_NI)
+    if( sha256_has_sha_ni() )
+    {
+        sha256_process_many_sha_ni( ctx->state, data, blocks );
+        return( 0 );
+    }
+#endif
+#if defined(MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO)
+    if( sha256_has_armv8_a_crypto() )
+    {
+        sha256_process_many_armv8_a_crypto( ctx->state, data, blocks );
+        return( 0 );
+    }
+#endif
+
+    for( ; blocks > 0; blocks--, data += 64 )
+    {
+        if( ( ret = mbedtls_internal_sha256_process( ctx, data ) ) != 0 )
+            return( ret );
+    }
+
+    return( 0 );
+}
+
 /*
  * SHA-256 process buffer
  */
@@ -306,13 +665,13 @@ int mbedtls_sha256_update_ret( mbedtls_sha256_context *ctx,
         left = 0;
     }
 
-    while( ilen >= 64 )
+    if( ilen >= 64 )
     {
-        if( ( ret = mbedtls_internal_sha256_process( ctx, input ) ) != 0 )
+        if( ( ret = sha256_process_blocks( ctx, input, ilen / 64 ) ) != 0 )
             return( ret );
 
-        input += 64;
-        ilen  -= 64;
+        input += ilen & ~(size_t) 0x3F;
+        ilen  &= 0x3F;
     }
 
     if( ilen > 0 )
@@ -438,6 +797,202 @@ int mbedtls_sha256_ret( const unsigned char *input,
     return( ret );
 }
 
+#if defined(MBEDTLS_SHA256_HAVE_LANES)
+
+#define SHA256_MAX_LANES    8
+
+/*
+ * One message in a lane: its whole blocks straight from the input, then
+ * one or two blocks with the leftover bytes, padding and length.
+ */
+typedef struct
+{
+    const unsigned char *input;     /* next whole block of input         */
+    size_t blocks;                  /* whole blocks left in input        */
+    const unsigned char *pad_next;  /* next block of pad                 */
+    size_t pad_blocks;              /* blocks left in pad                */
+    size_t msg;                     /* message in this lane (or count)   */
+    unsigned char pad[128];
+}
+sha256_lane;
+
+static void sha256_lane_start( sha256_lane *lane,
+                               const unsigned char *input,
+                               size_t ilen,
+                               size_t msg )
+{
+    size_t left = ilen & 0x3F;
+    uint32_t high = (uint32_t) ( (uint64_t) ilen >> 29 );
+    uint32_t low  = (uint32_t) ( ilen << 3 );
+
+    lane->input = input;
+    lane->blocks = ilen / 64;
+    lane->pad_next = lane->pad;
+    lane->pad_blocks = left < 56 ? 1 : 2;
+    lane->msg = msg;
+
+    memset( lane->pad, 0, sizeof( lane->pad ) );
+    if( left > 0 )
+        memcpy( lane->pad, input + ilen - left, left );
+    lane->pad[left] = 0x80;
+    PUT_UINT32_BE( high, lane->pad, 64 * lane->pad_blocks - 8 );
+    PUT_UINT32_BE( low,  lane->pad, 64 * lane->pad_blocks - 4 );
+}
+
+static const unsigned char *sha256_lane_next( sha256_lane *lane )
+{
+    const unsigned char *block;
+
+    if( lane->blocks > 0 )
+    {
+        block = lane->input;
+        lane->input += 64;
+        lane->blocks--;
+    }
+    else
+    {
+        block = lane->pad_next;
+        lane->pad_next += 64;
+        lane->pad_blocks--;
+    }
+
+    return( block );
+}
+
+static int sha256_has_hardware( void )
+{
+#if defined(MBEDTLS_SHA256_HAVE_SHA_NI)
+    if( sha256_has_sha_ni() )
+        return( 1 );
+#endif
+#if defined(MBEDTLS_SHA256_HAVE_ARMV8_A_CRYPTO)
+    if( sha256_has_armv8_a_crypto() )
+        return( 1 );
+#endif
+
+    return( 0 );
+}
+
+/*
+ * Feed the messages through the lanes of kernel, starting the next message
+ * in a lane as soon as the previous one finishes.  Idle lanes hash a dummy
+ * block.
+ */
+static void sha256_multi_lanes( const unsigned char * const input[],
+                                const size_t ilen[],
+                                unsigned char * const output[],
+                                size_t count,
+                                int is224,
+                                size_t lanes,
+                                void (*kernel)( uint32_t *,
+                                                const unsigned char * const * ) )
+{
+    static const unsigned char idle[64];
+    sha256_lane lane[SHA256_MAX_LANES];
+    const unsigned char *data[SHA256_MAX_LANES];
+    uint32_t state[8 * SHA256_MAX_LANES];
+    mbedtls_sha256_context iv;
+    size_t next, busy, i, j;
+
+    mbedtls_sha256_starts_ret( &iv, is224 );
+
+    for( next = 0, busy = 0, j = 0; j < lanes; j++ )
+    {
+        for( i = 0; i < 8; i++ )
+            state[i * lanes + j] = iv.state[i];
+        if( next < count )
+        {
+            sha256_lane_start( &lane[j], input[next], ilen[next], next );
+            next++;
+            busy++;
+        }
+        else
+            lane[j].msg = count;
+    }
+
+    while( busy > 0 )
+    {
+        for( j = 0; j < lanes; j++ )
+            data[j] = lane[j].msg < count ? sha256_lane_next( &lane[j] )
+                                          : idle;
+
+        kernel( state, data );
+
+        for( j = 0; j < lanes; j++ )
+        {
+            if( lane[j].msg == count ||
+                lane[j].blocks > 0 || lane[j].pad_blocks > 0 )
+                continue;
+
+            for( i = 0; i < ( is224 ? 7 : 8 ); i++ )
+                PUT_UINT32_BE( state[i * lanes + j], output[lane[j].msg], 4 * i );
+
+            for( i = 0; i < 8; i++ )
+                state[i * lanes + j] = iv.state[i];
+            if( next < count )
+            {
+                sha256_lane_start( &lane[j], input[next], ilen[next], next );
+                next++;
+            }
+            else
+            {
+                lane[j].msg = count;
+                busy--;
+            }
+        }
+    }
+
+    mbedtls_platform_zeroize( lane, sizeof( lane ) );
+    mbedtls_platform_zeroize( state, sizeof( state ) );
+}
+
+#endif /* MBEDTLS_SHA256_HAVE_LANES */
+
+/*
+ * output[i] = SHA-256( input[i] ) for count messages
+ */
+int mbedtls_sha256_ret_multi( const unsigned char * const input[],
+                              const size_t ilen[],
+                              unsigned char * const output[],
+                              size_t count,
+                              int is224 )
+{
+    int ret;
+    size_t i;
+
+    SHA256_VALIDATE_RET( is224 == 0 || is224 == 1 );
+    SHA256_VALIDATE_RET( count == 0 || input != NULL );
+    SHA256_VALIDATE_RET( count == 0 || ilen != NULL );
+    SHA256_VALIDATE_RET( count == 0 || output != NULL );
+
+#if defined(MBEDTLS_SHA256_HAVE_LANES)
+    /* One message at a time is faster with SHA-256 instructions. */
+    if( count > 1 && ! sha256_has_hardware() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if( count > 4 && __builtin_cpu_supports( "avx2" ) )
+        {
+            sha256_multi_lanes( input, ilen, output, count, is224,
+                                8, sha256_lanes8 );
+            return( 0 );
+        }
+#endif
+        sha256_multi_lanes( input, ilen, output, count, is224,
+                            4, sha256_lanes4 );
+        return( 0 );
+    }
+#endif /* MBEDTLS_SHA256_HAVE_LANES */
+
+    for( i = 0; i < count; i++ )
+    {
+        ret = mbedtls_sha256_ret( input[i], ilen[i], output[i], is224 );
+        if( ret != 0 )
+            return( ret );
+    }
+
+    return( 0 );
+}
+
 #if !defined(MBEDTLS_DEPRECATED_REMOVED)
 void mbedtls_sha256( const unsigned char *input,
                      size_t ilen,
@@ -0,0 +1,222 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_xmodem
+   @{
+   @file crc16fold.c
+   Fold a buffer into a CRC-16 remainder 16 bytes at a time with carry-less
+   multiplies.
+
+   A 128-bit block A = H * x^64 + L that is followed by n more bits of
+   message contributes A * x^n, which is congruent (mod P) to
+   H * (x^(n+64) mod P) + L * (x^n mod P).  Both products are at most 79
+   bits wide, so XORing them into the next block keeps a 128-bit value with
+   the same remainder as everything folded so far.  Four blocks are folded
+   in parallel to hide multiply latency.  The last 128-bit value and any
+   trailing bytes are then run through the caller's table, which performs
+   the final reduction without a Barrett step.
+*/
+
+#include "util/crc16fold.h"
+
+#ifdef CRC16_FOLD
+
+#if defined __x86_64__ || defined __i386__
+
+#include <immintrin.h>
+
+typedef __m128i crc16_fold_vec_t;
+
+#define _CRC16_FOLD_TARGET    __attribute__((target("pclmul,ssse3")))
+
+_CRC16_FOLD_TARGET
+static inline crc16_fold_vec_t _crc16_fold_load( const uint8_t *p)
+{
+   // byte 0 of the message becomes the most significant byte
+   const __m128i reverse =
+      _mm_set_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+   return _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) p), reverse);
+}
+
+_CRC16_FOLD_TARGET
+static inline void _crc16_fold_store( uint8_t *p, crc16_fold_vec_t a)
+{
+   const __m128i reverse =
+      _mm_set_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+   _mm_storeu_si128( (__m128i *) p, _mm_shuffle_epi8( a, reverse));
+}
+
+_CRC16_FOLD_TARGET
+static inline crc16_fold_vec_t _crc16_fold_k( uint16_t hi, uint16_t lo)
+{
+   return _mm_set_epi32( 0, hi, 0, lo);
+}
+
+_CRC16_FOLD_TARGET
+static inline crc16_fold_vec_t _crc16_fold_crc( uint16_t crc)
+{
+   return _mm_set_epi32( (int) ((uint32_t) crc << 16), 0, 0, 0);
+}
+
+// a * x^n + b, given k = { x^(n+64) mod P, x^n mod P }
+_CRC16_FOLD_TARGET
+static inline crc16_fold_vec_t _crc16_fold_step( crc16_fold_vec_t a,
+   crc16_fold_vec_t k, crc16_fold_vec_t b)
+{
+   return _mm_xor_si128( _mm_xor_si128( _mm_clmulepi64_si128( a, k, 0x11),
+      _mm_clmulepi64_si128( a, k, 0x00)), b);
+}
+
+#define _crc16_fold_xor(a, b)    _mm_xor_si128( a, b)
+
+bool_t crc16_fold_available( void)
+{
+   static int available = -1;
+
+   if (available < 0)
+   {
+      __builtin_cpu_init();
+      available = __builtin_cpu_supports( "pclmul")
+         && __builtin_cpu_supports( "ssse3");
+   }
+
+   return available;
+}
+
+#else    // AArch64
+
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+typedef poly64x2_t crc16_fold_vec_t;
+
+#define _CRC16_FOLD_TARGET
+
+static inline crc16_fold_vec_t _crc16_fold_load( const uint8_t *p)
+{
+   // byte 0 of the message becomes the most significant byte of lane 1
+   uint8x16_t v = vrev64q_u8( vld1q_u8( p));
+
+   return vreinterpretq_p64_u8( vextq_u8( v, v, 8));
+}
+
+static inline void _crc16_fold_store( uint8_t *p, crc16_fold_vec_t a)
+{
+   uint8x16_t v = vrev64q_u8( vreinterpretq_u8_p64( a));
+
+   vst1q_u8( p, vextq_u8( v, v, 8));
+}
+
+static inline crc16_fold_vec_t _crc16_fold_k( uint16_t hi, uint16_t lo)
+{
+   return vcombine_p64( vcreate_p64( lo), vcreate_p64( hi));
+}
+
+static inline crc16_fold_vec_t _crc16_fold_crc( uint16_t crc)
+{
+   return vcombine_p64( vcreate_p64( 0), vcreate_p64( (uint64_t) crc << 48));
+}
+
+static inline crc16_fold_vec_t _crc16_fold_xor( crc16_fold_vec_t a,
+   crc16_fold_vec_t b)
+{
+   return vreinterpretq_p64_u8( veorq_u8( vreinterpretq_u8_p64( a),
+      vreinterpretq_u8_p64( b)));
+}
+
+// a * x^n + b, given k = { x^n mod P, x^(n+64) mod P }
+static inline crc16_fold_vec_t _crc16_fold_step( crc16_fold_vec_t a,
+   crc16_fold_vec_t k, crc16_fold_vec_t b)
+{
+   poly128_t hi = vmull_high_p64( a, k);
+   poly128_t lo = vmull_p64( vgetq_lane_p64( a, 0), vgetq_lane_p64( k, 0));
+
+   return _crc16_fold_xor( _crc16_fold_xor( vreinterpretq_p64_p128( hi),
+      vreinterpretq_p64_p128( lo)), b);
+}
+
+bool_t crc16_fold_available( void)
+{
+   static int available = -1;
+
+   if (available < 0)
+   {
+      available = (getauxval( AT_HWCAP) & HWCAP_PMULL) != 0;
+   }
+
+   return available;
+}
+
+#endif
+
+/**
+   @brief
+   Calculate a non-reflected CRC-16 with carry-less multiplies.
+
+   Only call this function if crc16_fold_available() returns TRUE.
+
+   @param[in]  crc   CRC of the preceding data
+   @param[in]  mem   data to add to the CRC
+   @param[in]  len   bytes in \a mem
+   @param[in]  fold  constants and table routine for the polynomial
+
+   @return  same CRC as \c fold->table( crc, mem, len)
+*/
+_CRC16_FOLD_TARGET
+uint16_t crc16_fold( uint16_t crc, const void *mem, size_t len,
+   const crc16_fold_t *fold)
+{
+   const uint8_t *p = mem;
+   crc16_fold_vec_t a0, a1, a2, a3, k;
+   uint8_t remainder[16];
+
+   if (len < CRC16_FOLD_MIN)
+   {
+      return fold->table( crc, mem, len);
+   }
+
+   a0 = _crc16_fold_xor( _crc16_fold_load( p), _crc16_fold_crc( crc));
+   a1 = _crc16_fold_load( p + 16);
+   a2 = _crc16_fold_load( p + 32);
+   a3 = _crc16_fold_load( p + 48);
+   p += 64;
+   len -= 64;
+
+   k = _crc16_fold_k( fold->k576, fold->k512);
+   while (len >= 64)
+   {
+      a0 = _crc16_fold_step( a0, k, _crc16_fold_load( p));
+      a1 = _crc16_fold_step( a1, k, _crc16_fold_load( p + 16));
+      a2 = _crc16_fold_step( a2, k, _crc16_fold_load( p + 32));
+      a3 = _crc16_fold_step( a3, k, _crc16_fold_load( p + 48));
+      p += 64;
+      len -= 64;
+   }
+
+   k = _crc16_fold_k( fold->k192, fold->k128);
+   a0 = _crc16_fold_step( a0, k, a1);
+   a0 = _crc16_fold_step( a0, k, a2);
+   a0 = _crc16_fold_step( a0, k, a3);
+   while (len >= 16)
+   {
+      a0 = _crc16_fold_step( a0, k, _crc16_fold_load( p));
+      p += 16;
+      len -= 16;
+   }
+
+   _crc16_fold_store( remainder, a0);
+   crc = fold->table( 0, remainder, sizeof remainder);
+
+   return fold->table( crc, p, len);
+}
+
+#endif   // CRC16_FOLD
+
+///@}
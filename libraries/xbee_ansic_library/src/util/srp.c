@@ -297,6 +297,11 @@ static int calculate_M( unsigned char *dest, const char *I, mbedtls_mpi *s,
     unsigned char H_I[ SRP_HASH_LEN ];
     unsigned char H_xor[ SRP_HASH_LEN ];
     mbedtls_sha256_context state;
+    const unsigned char * input[3];
+    size_t        ilen[3];
+    unsigned char * output[3] = { H_N, H_g, H_I };
+    unsigned char * bin_n = NULL;
+    unsigned char * bin_g = NULL;
     int           i = 0;
     int           hash_len = SRP_HASH_LEN;
 
@@ -310,9 +315,23 @@ static int calculate_M( unsigned char *dest, const char *I, mbedtls_mpi *s,
         goto cleanup_and_exit;
     }
 
-    if ((result = hash_num(&n, H_N)) ||
-        (result = hash_num(&g, H_g)) ||
-        (result = hash((const unsigned char *)I, strlen(I), H_I)))
+    ilen[0] = mbedtls_mpi_size(&n);
+    ilen[1] = mbedtls_mpi_size(&g);
+    ilen[2] = strlen(I);
+    bin_n = (unsigned char *) malloc(ilen[0]);
+    bin_g = (unsigned char *) malloc(ilen[1]);
+    if (!bin_n || !bin_g) {
+        result = MBEDTLS_ERR_MPI_ALLOC_FAILED;
+        goto cleanup_and_exit;
+    }
+    input[0] = bin_n;
+    input[1] = bin_g;
+    input[2] = (const unsigned char *)I;
+
+    // H(N), H(g) and H(I) are independent, so hash them together
+    if ((result = mbedtls_mpi_write_binary(&n, bin_n, ilen[0])) ||
+        (result = mbedtls_mpi_write_binary(&g, bin_g, ilen[1])) ||
+        (result = mbedtls_sha256_ret_multi(input, ilen, output, 3, 0)))
     {
         goto cleanup_and_exit;
     }
@@ -336,6 +355,8 @@ static int calculate_M( unsigned char *dest, const char *I, mbedtls_mpi *s,
     hash_final( &state, dest );
 
 cleanup_and_exit:
+    free(bin_n);
+    free(bin_g);
     mpi_free_multi(&n, &g, NULL);
     return result;
 }
@@ -358,6 +379,62 @@ static int calculate_H_AMK( unsigned char *dest, mbedtls_mpi *A, const unsigned
 }
 
 
+/* Every exponentiation uses the same modulus, and three of them the same
+ * base, so keep R^2 mod n and a fixed-base comb for g (one squaring and one
+ * multiplication per MBEDTLS_MPI_COMB_TEETH exponent bits, instead of the
+ * sliding window's squaring per bit).  Built once and only read afterwards.
+ */
+static struct
+{
+    int                 ready;
+    mbedtls_mpi         n, g, RR;
+    mbedtls_mpi_comb    comb;
+} srp_group;
+
+int srp_group_init( void )
+{
+    int result;
+
+    if (srp_group.ready)
+        return 0;
+
+    mpi_init_multi(&srp_group.n, &srp_group.g, &srp_group.RR, NULL);
+    mbedtls_mpi_comb_init(&srp_group.comb);
+
+    // exponents for g are 256-bit random values or SHA-256 hashes
+    if ((result = mbedtls_mpi_read_string(&srp_group.n, 16, global_Ng_constant.n_hex)) ||
+        (result = mbedtls_mpi_read_string(&srp_group.g, 16, global_Ng_constant.g_hex)) ||
+        (result = mbedtls_mpi_comb_setup(&srp_group.comb, &srp_group.g,
+                                         &srp_group.n, SRP_HASH_LEN * 8)) ||
+        (result = mbedtls_mpi_copy(&srp_group.RR, &srp_group.comb.RR)))
+    {
+        mpi_free_multi(&srp_group.n, &srp_group.g, &srp_group.RR, NULL);
+        mbedtls_mpi_comb_free(&srp_group.comb);
+        return result;
+    }
+
+    srp_group.ready = 1;
+    return 0;
+}
+
+/* X = g^E mod n */
+static int exp_mod_g( mbedtls_mpi *X, const mbedtls_mpi *E )
+{
+    int result = srp_group_init();
+
+    return result ? result : mbedtls_mpi_exp_mod_comb(X, &srp_group.comb, E);
+}
+
+/* X = A^E mod n, for any other base */
+static int exp_mod_n( mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E )
+{
+    int result = srp_group_init();
+
+    return result ? result
+                  : mbedtls_mpi_exp_mod(X, A, E, &srp_group.n, &srp_group.RR);
+}
+
+
 /***********************************************************************************************************
  *
  *  Exported Functions
@@ -388,7 +465,7 @@ int srp_create_salted_verification_key( const char * username,
     if ((result = mbedtls_mpi_read_string(&n, 16, global_Ng_constant.n_hex)) ||
         (result = mbedtls_mpi_read_string(&g, 16, global_Ng_constant.g_hex)) ||
 
-        (result = mbedtls_mpi_exp_mod(&v, &g, &x, &n, NULL)))
+        (result = exp_mod_g(&v, &x)))
     {
         goto cleanup_and_exit;
     }
@@ -493,7 +570,7 @@ struct SRPVerifier *  srp_verifier_new( const char * username,
 
         /* B = kv + g^b */
         mbedtls_mpi_mul_mpi(&tmp1, &k, &v) ||
-        mbedtls_mpi_exp_mod(&tmp2, &g, &b, &n, NULL) ||
+        exp_mod_g(&tmp2, &b) ||
         mbedtls_mpi_add_mpi(&tmp3, &tmp1, &tmp2) ||
         mbedtls_mpi_mod_mpi(&B, &tmp3, &n) )
     {
@@ -522,9 +599,9 @@ struct SRPVerifier *  srp_verifier_new( const char * username,
     if (H_nn(&u, &A, &B) ||
 
         /* S = (A *(v^u)) ^ b */
-        mbedtls_mpi_exp_mod(&tmp1, &v, &u, &n, NULL) ||
+        exp_mod_n(&tmp1, &v, &u) ||
         mbedtls_mpi_mul_mpi(&tmp2, &A, &tmp1) ||
-        mbedtls_mpi_exp_mod(&S, &tmp2, &b, &n, NULL) ||
+        exp_mod_n(&S, &tmp2, &b) ||
 
         hash_num(&S, ver->session_key) ||
 
@@ -731,7 +808,7 @@ int srp_user_start_authentication(struct SRPUser * usr, const char ** username,
 
     // eight rand digits, each digit is 32 bits, 256 bits of random
     if ((result = mp_rand(&usr->a, 8)) ||
-        (result = mbedtls_mpi_exp_mod(&usr->A, &usr->g, &usr->a, &usr->n, NULL)))
+        (result = exp_mod_g(&usr->A, &usr->a)))
     {
         return result;
     }
@@ -805,13 +882,12 @@ int srp_user_process_challenge(struct SRPUser * usr,
         if ((result = mbedtls_mpi_mul_mpi(&tmp1, &u, &x)) ||          // tmp1 = u * x
             (result = mbedtls_mpi_add_mpi(&tmp2, &tmp1, &usr->a)) ||  // tmp2 = (a + (u * x)
 
-            (result = mbedtls_mpi_exp_mod(&tmp1, &usr->g, &x, &usr->n, NULL)) ||
+            (result = exp_mod_g(&tmp1, &x)) ||
 
             (result = mbedtls_mpi_mul_mpi(&tmp3, &k, &tmp1)) ||      // tmp3 = k*(g^x
             (result = mbedtls_mpi_sub_mpi(&tmp1, &B, &tmp3)) ||      // tmp1 = (B - K*(g^x)
 
-            (result = mbedtls_mpi_exp_mod(&usr->S, &tmp1, &tmp2,
-                                          &usr->n, NULL)) ||
+            (result = exp_mod_n(&usr->S, &tmp1, &tmp2)) ||
 
             (result = hash_num(&usr->S, usr->session_key)) ||
             (result = calculate_M(usr->M, usr->username, &s, &usr->A, &B, usr->session_key)) ||
@@ -12,6 +12,11 @@
 
 /*
     Implementation of xbee_random() API using mbedtls CTR-DRBG module.
+
+    Each xbee_random_stream_t is its own CTR-DRBG, so threads with their own
+    stream only meet at the shared entropy source, when seeding or reseeding.
+    Streams generate XBEE_RANDOM_BUFFER_SIZE bytes at a time (one AES-CTR
+    pass) and hand them out with memcpy(), wiping each byte as it goes.
 */
 
 #include <string.h>
@@ -22,49 +27,151 @@
 #include "mbedtls/config.h"
 #include "mbedtls/entropy.h"
 #include "mbedtls/ctr_drbg.h"
+#include "mbedtls/platform_util.h"
 
-static mbedtls_ctr_drbg_context ctr_drbg;
 static mbedtls_entropy_context entropy;
+static bool_t entropy_ready = FALSE;
+static uint8_t entropy_lock;
+
+#ifdef XBEE_RANDOM_THREAD_LOCAL
+static XBEE_RANDOM_THREAD_LOCAL xbee_random_stream_t shared_stream;
+#else
+static xbee_random_stream_t shared_stream;
+static uint8_t shared_stream_lock;
+#endif
+
+// f_entropy for each stream's CTR-DRBG: the shared entropy source, locked
+static int xbee_random_entropy(void *unused, unsigned char *output,
+                               size_t output_len)
+{
+    int ret;
+
+    XBEE_RANDOM_LOCK(entropy_lock);
+    if (!entropy_ready) {
+        mbedtls_entropy_init(&entropy);
+        entropy_ready = TRUE;
+    }
+    ret = mbedtls_entropy_func(&entropy, output, output_len);
+    XBEE_RANDOM_UNLOCK(entropy_lock);
+
+    return ret;
+}
 
-static int xbee_random_init(const char *seed)
+static int xbee_random_seed(xbee_random_stream_t *stream)
 {
+    static const char label[] = "xbee_ansic_library";
+    uint8_t custom[sizeof label + sizeof stream];
     int ret;
 
-    mbedtls_entropy_init(&entropy);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
+    // Personalize with the stream's address, so streams seeded with the
+    // same entropy would still differ.
+    memcpy(custom, label, sizeof label);
+    memcpy(&custom[sizeof label], &stream, sizeof stream);
 
-    ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
-                                (const uint8_t *)seed, strlen(seed));
+    mbedtls_ctr_drbg_init(&stream->drbg);
+    ret = mbedtls_ctr_drbg_seed(&stream->drbg, xbee_random_entropy, NULL,
+                                custom, sizeof custom);
 
     if (ret != 0) {
         // TODO: Consider mapping some MBEDTLS_ERR_xxx values to platform's
         // error codes.  For now use a generic error.
+        mbedtls_ctr_drbg_free(&stream->drbg);
         return -EIO;
     }
 
+    stream->avail = 0;
+    stream->seeded = TRUE;
+
     return 0;
 }
 
-int xbee_random(void *output, size_t output_len)
+/**
+    @brief
+    Generate a sequence of random bytes from a caller's stream.
+
+    Requests are served from the stream's buffer, which is refilled
+    XBEE_RANDOM_BUFFER_SIZE bytes at a time.  Only the stream's owner may
+    use it, but no lock is taken unless the DRBG needs (re)seeding.
+
+    @param[in,out] stream       Stream to draw from (zeroed before first use).
+    @param[out]    output       Location to store random bytes.
+    @param[in]     output_len   Number of bytes to generate.
+
+    @retval     0       Success
+    @retval     -EIO    Couldn't seed or run the DRBG
+*/
+int xbee_random_stream(xbee_random_stream_t *stream,
+                       void *output, size_t output_len)
 {
-    static bool_t needs_init = TRUE;
+    uint8_t *out = output;
+    uint8_t *src;
+    size_t chunk;
     int ret;
 
-    if (needs_init) {
-        ret = xbee_random_init("xbee_ansic_library");
+    if (!stream->seeded) {
+        ret = xbee_random_seed(stream);
         if (ret) {
             return ret;
         }
-        needs_init = FALSE;
     }
 
-    ret = mbedtls_ctr_drbg_random(&ctr_drbg, output, output_len);
+    while (output_len > 0) {
+        if (stream->avail == 0) {
+            // Large requests bypass the buffer.
+            chunk = output_len < XBEE_RANDOM_BUFFER_SIZE ? 0
+                : XBEE_RANDOM_BUFFER_SIZE;
+            ret = mbedtls_ctr_drbg_random(&stream->drbg,
+                                          chunk ? out : stream->buffer,
+                                          XBEE_RANDOM_BUFFER_SIZE);
+            if (ret != 0) {
+                return -EIO;
+            }
+            if (chunk) {
+                out += chunk;
+                output_len -= chunk;
+                continue;
+            }
+            stream->avail = XBEE_RANDOM_BUFFER_SIZE;
+        }
 
-    if (ret != 0) {
-        // TODO: Consider mapping some MBEDTLS_ERR_xxx values to platform's
-        // error codes.  For now use a generic error.
-        return -EIO;
+        chunk = output_len < stream->avail ? output_len : stream->avail;
+        src = &stream->buffer[XBEE_RANDOM_BUFFER_SIZE - stream->avail];
+        memcpy(out, src, chunk);
+        memset(src, 0, chunk);          // don't keep bytes once handed out
+        stream->avail -= (uint16_t) chunk;
+        out += chunk;
+        output_len -= chunk;
     }
 
     return 0;
 }
+
+/**
+    @brief
+    Wipe a stream's DRBG state and buffer, for example when a thread exits.
+    The stream is reseeded if used again.
+
+    @param[in,out] stream       Stream to wipe.
+*/
+void xbee_random_stream_free(xbee_random_stream_t *stream)
+{
+    if (stream->seeded) {
+        mbedtls_ctr_drbg_free(&stream->drbg);
+    }
+    mbedtls_platform_zeroize(stream, sizeof *stream);
+}
+
+int xbee_random(void *output, size_t output_len)
+{
+#ifdef XBEE_RANDOM_THREAD_LOCAL
+    return xbee_random_stream(&shared_stream, output, output_len);
+#else
+    int ret;
+
+    XBEE_RANDOM_LOCK(shared_stream_lock);
+    ret = xbee_random_stream(&shared_stream, output, output_len);
+    XBEE_RANDOM_UNLOCK(shared_stream_lock);
+
+    return ret;
+#endif
+}
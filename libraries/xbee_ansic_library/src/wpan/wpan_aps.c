@@ -35,6 +35,28 @@
 #else
    #define wpan_aps_debug     __nodebug
 #endif
+
+#if WPAN_APS_INDEX_SLOTS
+   // buckets of (endpoint, cluster) pairs, each with its own displacement
+   #define _WPAN_APS_INDEX_BUCKETS  (WPAN_APS_INDEX_SLOTS / 4 + 1)
+
+   // Pairs that can be indexed; a perfect hash can't reliably be found
+   // for a full table.
+   #define _WPAN_APS_INDEX_MAX \
+      (WPAN_APS_INDEX_SLOTS - WPAN_APS_INDEX_SLOTS / 8)
+
+   // bucket and slot for a pair's hash (see _wpan_aps_index_hash)
+   #define _WPAN_APS_INDEX_BUCKET(h)   ((uint_fast8_t) \
+      (((h) >> 20) % _WPAN_APS_INDEX_BUCKETS))
+   #define _WPAN_APS_INDEX_SLOT(h, d)  ((uint_fast8_t) \
+      (((h) + (uint32_t) (d) * (((h) >> 8) | 1)) & (WPAN_APS_INDEX_SLOTS - 1)))
+
+   // the index is only good for the table it was built from
+   #define _WPAN_APS_INDEXED(dev) \
+      ((dev)->index.table != NULL \
+         && (dev)->index.table == (dev)->endpoint_table \
+         && (dev)->endpoint_get_next == NULL)
+#endif
 /*** EndHeader */
 
 /*** BeginHeader wpan_cluster_match */
@@ -80,6 +102,251 @@ const wpan_cluster_table_entry_t *wpan_cluster_match( uint16_t match,
 }
 
 
+/*** BeginHeader _wpan_aps_index_hash */
+#if WPAN_APS_INDEX_SLOTS
+uint32_t _wpan_aps_index_hash( uint16_t cluster_id, uint_fast8_t ep_pos,
+   uint32_t seed);
+#endif
+/*** EndHeader */
+#if WPAN_APS_INDEX_SLOTS
+/**
+   @internal @brief
+   Hash an (endpoint, cluster) pair for the index built by
+   wpan_aps_index_build().
+
+   @param[in]  cluster_id  cluster ID
+   @param[in]  ep_pos      position of the endpoint in the endpoint table
+   @param[in]  seed        seed picked by wpan_aps_index_build()
+
+   @retval  hash of the pair, split into a bucket and slot by
+            _WPAN_APS_INDEX_BUCKET() and _WPAN_APS_INDEX_SLOT()
+*/
+wpan_aps_debug
+uint32_t _wpan_aps_index_hash( uint16_t cluster_id, uint_fast8_t ep_pos,
+   uint32_t seed)
+{
+   uint32_t h;
+
+   h = (((uint32_t) ep_pos << 16 | cluster_id) ^ seed) * 0x9E3779B1UL;
+   return h ^ (h >> 15);
+}
+#endif
+
+
+/*** BeginHeader wpan_aps_index_build */
+/*** EndHeader */
+#if WPAN_APS_INDEX_SLOTS
+// Try to place the (endpoint, cluster) pairs in <key> into the cluster slots
+// of <index>, hashing with <seed>.  Fills the largest buckets first, while
+// the table is emptiest, finding a displacement for each bucket that puts
+// all of its pairs in empty slots.
+static bool_t _wpan_aps_index_place( wpan_aps_index_t *index,
+   const wpan_aps_index_slot_t *key, uint_fast8_t count, uint32_t seed)
+{
+   uint8_t bucket[WPAN_APS_INDEX_SLOTS];
+   uint8_t size[_WPAN_APS_INDEX_BUCKETS];
+   uint_fast8_t i, j, b, max, slot;
+   uint_fast16_t d;
+   uint32_t h;
+
+   memset( index->cluster, 0, sizeof index->cluster);
+   memset( index->disp, 0, sizeof index->disp);
+   memset( size, 0, sizeof size);
+
+   max = 0;
+   for (i = 0; i < count; ++i)
+   {
+      b = _WPAN_APS_INDEX_BUCKET( _wpan_aps_index_hash( key[i].cluster_id,
+         key[i].ep_pos, seed));
+      bucket[i] = (uint8_t) b;
+      if (++size[b] > max)
+      {
+         max = size[b];
+      }
+   }
+
+   for (; max; --max)
+   {
+      for (b = 0; b < _WPAN_APS_INDEX_BUCKETS; ++b)
+      {
+         if (size[b] != max)
+         {
+            continue;
+         }
+         for (d = 0; d < 256; ++d)
+         {
+            for (i = 0; i < count; ++i)
+            {
+               if (bucket[i] == b)
+               {
+                  h = _wpan_aps_index_hash( key[i].cluster_id,
+                     key[i].ep_pos, seed);
+                  slot = _WPAN_APS_INDEX_SLOT( h, d);
+                  if (index->cluster[slot].clust_pos)
+                  {
+                     break;
+                  }
+                  index->cluster[slot] = key[i];
+               }
+            }
+            if (i == count)
+            {
+               break;            // whole bucket placed
+            }
+
+            // take back the pairs from this bucket that did fit
+            for (j = 0; j < i; ++j)
+            {
+               if (bucket[j] == b)
+               {
+                  h = _wpan_aps_index_hash( key[j].cluster_id,
+                     key[j].ep_pos, seed);
+                  index->cluster[_WPAN_APS_INDEX_SLOT( h, d)].clust_pos = 0;
+               }
+            }
+         }
+         if (d == 256)
+         {
+            return FALSE;
+         }
+         index->disp[b] = (uint8_t) d;
+      }
+   }
+
+   return TRUE;
+}
+#endif
+
+/** @brief
+   Build a lookup index over a device's endpoint table, so
+   wpan_endpoint_match() and wpan_envelope_dispatch() can find an endpoint
+   and its cluster handler without walking the tables.
+
+   Endpoints are mapped directly by endpoint number, and the clusters of
+   every endpoint go in a perfect hash with #WPAN_APS_INDEX_SLOTS slots,
+   holding up to 7/8 that many (endpoint, cluster) pairs.  xbee_wpan_init()
+   calls this function; call it again after changing the contents of the
+   endpoint or cluster tables.  The index is ignored if
+   \c dev->endpoint_table changes, or if the device walks its endpoints with
+   a custom \c endpoint_get_next function.
+
+   @param[in,out] dev   device to index
+
+   @retval  0        built the index
+   @retval  -EINVAL  \a dev is NULL, has no endpoint table or uses a custom
+                     \c endpoint_get_next function
+   @retval  -ENOSPC  too many clusters for #WPAN_APS_INDEX_SLOTS; only
+                     endpoints are indexed, and clusters are searched
+                     linearly
+*/
+wpan_aps_debug
+int wpan_aps_index_build( wpan_dev_t *dev)
+{
+#if WPAN_APS_INDEX_SLOTS
+   wpan_aps_index_t *index;
+   const wpan_endpoint_table_entry_t *ep;
+   const wpan_cluster_table_entry_t *clust;
+   wpan_aps_index_slot_t key[WPAN_APS_INDEX_SLOTS];
+   uint_fast8_t count, i;
+   uint_fast16_t ep_pos, clust_pos;
+   bool_t overflow;
+   uint32_t seed;
+
+   if (dev == NULL)
+   {
+      return -EINVAL;
+   }
+
+   index = &dev->index;
+   memset( index, 0, sizeof *index);
+   if (dev->endpoint_table == NULL || dev->endpoint_get_next != NULL)
+   {
+      return -EINVAL;
+   }
+
+   count = 0;
+   overflow = FALSE;
+   ep = dev->endpoint_table;
+   for (ep_pos = 0; ep->endpoint != WPAN_ENDPOINT_END_OF_LIST; ++ep_pos, ++ep)
+   {
+      if (ep_pos == 255)
+      {
+         memset( index, 0, sizeof *index);
+         return -ENOSPC;
+      }
+      if (index->endpoint[ep->endpoint] == 0)
+      {
+         index->endpoint[ep->endpoint] = (uint8_t) (ep_pos + 1);
+      }
+
+      clust = ep->cluster_table;
+      for (clust_pos = 0; ! overflow && clust != NULL
+         && clust->cluster_id != WPAN_CLUSTER_END_OF_LIST; ++clust_pos, ++clust)
+      {
+         // only index the entries _wpan_endpoint_dispatch() would match
+         if (! (clust->flags & WPAN_CLUST_FLAG_INOUT))
+         {
+            continue;
+         }
+
+         // ...and only the first one for each cluster ID
+         for (i = 0; i < count; ++i)
+         {
+            if (key[i].ep_pos == ep_pos
+               && key[i].cluster_id == clust->cluster_id)
+            {
+               break;
+            }
+         }
+         if (i < count)
+         {
+            continue;
+         }
+
+         if (count == _WPAN_APS_INDEX_MAX || clust_pos == 255)
+         {
+            overflow = TRUE;
+            break;
+         }
+         key[count].cluster_id = clust->cluster_id;
+         key[count].ep_pos = (uint8_t) ep_pos;
+         key[count].clust_pos = (uint8_t) (clust_pos + 1);
+         ++count;
+      }
+   }
+   index->table = dev->endpoint_table;
+
+   if (! overflow)
+   {
+      // a few tries with different seeds, in case a bucket can't be placed
+      for (i = 1; i <= 16; ++i)
+      {
+         seed = (uint32_t) (0x7FEB352DUL * i);
+         if (_wpan_aps_index_place( index, key, count, seed))
+         {
+            index->seed = seed;
+            #ifdef WPAN_APS_VERBOSE
+               printf( "%s: indexed %u clusters, seed 0x%08" PRIx32 "\n",
+                  __FUNCTION__, count, seed);
+            #endif
+            return 0;
+         }
+      }
+   }
+
+   memset( index->cluster, 0, sizeof index->cluster);
+   #ifdef WPAN_APS_VERBOSE
+      printf( "%s: clusters not indexed\n", __FUNCTION__);
+   #endif
+   return -ENOSPC;
+#else
+   XBEE_UNUSED_PARAMETER( dev);
+
+   return -ENOSPC;
+#endif
+}
+
+
 /*** BeginHeader wpan_endpoint_get_next */
 /*** EndHeader */
 /** @brief
@@ -166,6 +433,30 @@ const wpan_endpoint_table_entry_t *wpan_endpoint_match( wpan_dev_t *dev,
    // wpan_endpoint_get_next tests for NULL dev
 
    matchany = (profile_id == WPAN_APS_PROFILE_ANY);
+
+#if WPAN_APS_INDEX_SLOTS
+   if (dev != NULL && _WPAN_APS_INDEXED( dev))
+   {
+      if (endpoint == WPAN_ENDPOINT_END_OF_LIST
+         || dev->index.endpoint[endpoint] == 0)
+      {
+         return NULL;
+      }
+
+      // entries before the first one for this endpoint can't match
+      for (ep = &dev->endpoint_table[dev->index.endpoint[endpoint] - 1];
+         ep->endpoint != WPAN_ENDPOINT_END_OF_LIST; ++ep)
+      {
+         if (endpoint == ep->endpoint &&
+            (matchany || profile_id == ep->profile_id))
+         {
+            return ep;
+         }
+      }
+      return NULL;
+   }
+#endif
+
    ep = NULL;
    while ( (ep = wpan_endpoint_get_next( dev, ep)) != NULL)
    {
@@ -499,6 +790,55 @@ uint8_t wpan_endpoint_next_trans( const wpan_endpoint_table_entry_t *ep)
    return ++(ep->ep_state->last_transaction);
 }
 
+/*** BeginHeader _wpan_endpoint_cluster */
+const wpan_cluster_table_entry_t *_wpan_endpoint_cluster( wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep, uint16_t cluster_id);
+/*** EndHeader */
+/**
+   @internal @brief
+   Find the entry for a received frame's cluster in an endpoint's cluster
+   table, using the device's index if there is one.
+
+   Same as wpan_cluster_match( \a cluster_id, #WPAN_CLUST_FLAG_INOUT,
+   \a ep->cluster_table).
+
+   @param[in]  dev         device that received the frame
+   @param[in]  ep          entry from \a dev's endpoint table
+   @param[in]  cluster_id  cluster ID to look up
+
+   @retval  NULL  no entry for \a cluster_id
+   @retval  !NULL matching entry from \a ep's cluster table
+*/
+wpan_aps_debug
+const wpan_cluster_table_entry_t *_wpan_endpoint_cluster( wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep, uint16_t cluster_id)
+{
+#if WPAN_APS_INDEX_SLOTS
+   const wpan_aps_index_slot_t *slot;
+   uint_fast8_t ep_pos;
+   uint32_t h;
+
+   if (dev != NULL && dev->index.seed != 0 && _WPAN_APS_INDEXED( dev))
+   {
+      ep_pos = (uint_fast8_t) (ep - dev->endpoint_table);
+      h = _wpan_aps_index_hash( cluster_id, ep_pos, dev->index.seed);
+      slot = &dev->index.cluster[_WPAN_APS_INDEX_SLOT( h,
+         dev->index.disp[_WPAN_APS_INDEX_BUCKET( h)])];
+      if (slot->clust_pos != 0 && slot->ep_pos == ep_pos
+         && slot->cluster_id == cluster_id)
+      {
+         return &ep->cluster_table[slot->clust_pos - 1];
+      }
+      return NULL;
+   }
+#else
+   XBEE_UNUSED_PARAMETER( dev);
+#endif
+
+   return wpan_cluster_match( cluster_id, WPAN_CLUST_FLAG_INOUT,
+      ep->cluster_table);
+}
+
 /*** BeginHeader wpan_envelope_dispatch */
 /*** EndHeader */
 /**
@@ -531,8 +871,7 @@ int _wpan_endpoint_dispatch( wpan_envelope_t *envelope,
    #endif
    // Match either an input or an output cluster, since the ZigBee layer
    // doesn't contain information on the direction of the frame.
-   clust = wpan_cluster_match( envelope->cluster_id, WPAN_CLUST_FLAG_INOUT,
-      ep->cluster_table);
+   clust = _wpan_endpoint_cluster( envelope->dev, ep, envelope->cluster_id);
    if (clust)
    {
       // If ZCL cluster requires encryption, make sure frame was encrypted.
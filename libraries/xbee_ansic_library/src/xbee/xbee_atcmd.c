@@ -65,6 +65,26 @@
 /// Table used to keep track of outstanding requests.
 FAR xbee_cmd_request_t xbee_cmd_request_table[XBEE_CMD_REQUEST_TABLESIZE];
 
+/// Head of the list of empty entries in xbee_cmd_request_table[] (1-based
+/// index, 0 if the table is full).  Valid once _xbee_cmd_table_init() runs.
+static uint8_t _xbee_cmd_free_head;
+
+/**   @internal
+   Clear the request table and chain every entry onto the free list.
+*/
+_xbee_atcmd_debug
+static void _xbee_cmd_table_init( void)
+{
+   uint_fast8_t i;
+
+   _f_memset( xbee_cmd_request_table, 0, sizeof(xbee_cmd_request_table));
+   for (i = 0; i < XBEE_CMD_REQUEST_TABLESIZE - 1; ++i)
+   {
+      xbee_cmd_request_table[i].next = (uint8_t)(i + 2);
+   }
+   _xbee_cmd_free_head = 1;
+}
+
 
 /*** BeginHeader xbee_cmd_tick */
 /*** EndHeader */
@@ -534,7 +554,9 @@ enum xbee_command_list_status (xbee_cmd_list_status)(
    @param[in]  xbee  XBee device on which to enable the AT Command layer.
                      This function will automatically call
                xbee_cmd_query_device if it hasn't already been called for this
-               device.
+               device.  If the device's settings were loaded from a cache
+               (#XBEE_DEV_FLAG_QUERY_CACHED), it instead starts checking the
+               cached values in the background.
 
    @retval  0  the XBee device was successfully configured to send and
                      receive AT commands
@@ -564,9 +586,14 @@ int xbee_cmd_init_device( xbee_dev_t *xbee)
 
    xbee->flags |= XBEE_DEV_FLAG_CMD_INIT;
 
-   // automatically query device if it hasn't been queried yet
-   if (! (xbee->flags & XBEE_DEV_FLAG_QUERY_BEGIN))
+   if (xbee->flags & XBEE_DEV_FLAG_QUERY_CACHED)
+   {
+      // values were loaded from a cache, check them in the background
+      retval = _xbee_cmd_verify_cached( xbee);
+   }
+   else if (! (xbee->flags & XBEE_DEV_FLAG_QUERY_BEGIN))
    {
+      // automatically query device if it hasn't been queried yet
       retval = xbee_cmd_query_device( xbee, 0);
    }
 
@@ -719,6 +746,7 @@ const xbee_atcmd_reg_t _xbee_atcmd_query_regs[] = {
    XBEE_ATCMD_REG( 'C', 'T', XBEE_CLT_COPY_BE, xbee_dev_t, idle_timeout),
    XBEE_ATCMD_REG( 'C', 'C', XBEE_CLT_COPY, xbee_dev_t, escape_char),
 #endif
+   // Start here after confirming values loaded from a cache.
    XBEE_ATCMD_REG_CB( 'E', 'O', _xbee_cmd_query_handle_eo, 0),
    XBEE_ATCMD_REG_CB( 'A', 'I', _xbee_cmd_query_handle_ai, 0),
    // Start here when refreshing values after MODEM_STATUS changes to JOINED.
@@ -739,6 +767,53 @@ xbee_command_list_context_t _xbee_atcmd_query_regs_head;
    #define XBEE_ATCMD_REG_REFRESH_IDX  7
 #endif
 
+/// Offset into _xbee_atcmd_query_regs to use once cached values have been
+/// confirmed, to read the registers that aren't cached (EO and AI update
+/// the wpan_dev_t flags).
+#define XBEE_ATCMD_REG_VERIFIED_IDX    (XBEE_ATCMD_REG_REFRESH_IDX - 2)
+
+/**   @internal
+   Start querying the registers in _xbee_atcmd_query_regs, beginning with
+   entry \a first.
+
+   @retval  0        started querying device (or a query is already running)
+   @retval  <0       error from xbee_cmd_list_execute()
+*/
+_xbee_atcmd_debug
+static int _xbee_cmd_query_start( xbee_dev_t *xbee, uint_fast8_t first)
+{
+   int error;
+
+   if (xbee->flags & XBEE_DEV_FLAG_QUERY_INPROGRESS)
+   {
+      #ifdef XBEE_ATCMD_VERBOSE
+         printf( "%s: aborting; query already in progress\n", __FUNCTION__);
+      #endif
+      // note that if we were trying to refresh, we've set a flag
+      // (QUERY_REFRESH) and can restart the refresh after the current
+      // pass finishes
+      return 0;
+   }
+
+   error = xbee_cmd_list_execute(xbee,
+                           &_xbee_atcmd_query_regs_head,
+                           _xbee_atcmd_query_regs + first,
+                           xbee, NULL);
+
+   // successfully started query
+   if (error == 0)
+   {
+      xbee->flags |= XBEE_DEV_FLAG_QUERY_BEGIN |
+                     XBEE_DEV_FLAG_QUERY_INPROGRESS;
+      xbee->flags &=
+         ~(XBEE_DEV_FLAG_QUERY_ERROR
+            | XBEE_DEV_FLAG_QUERY_DONE
+            | XBEE_DEV_FLAG_QUERY_REFRESH);
+   }
+
+   return error;
+}
+
 /**
    @brief
    Learn about the underlying device by sending a series of
@@ -753,7 +828,8 @@ xbee_command_list_context_t _xbee_atcmd_query_regs_head;
    @param[in,out] xbee  XBee device to query.
    @param[in]     refresh  if non-zero, just refresh the volatile values
                            (e.g., network settings, as opposed to device
-                           serial number)
+                           serial number); while cached values are being
+                           revalidated, the refresh that follows covers it
 
    @retval  0        Started querying device.
    @retval  -EBUSY   Transmit serial buffer is full, or XBee is not accepting
@@ -765,8 +841,6 @@ xbee_command_list_context_t _xbee_atcmd_query_regs_head;
 _xbee_atcmd_debug
 int xbee_cmd_query_device( xbee_dev_t *xbee, uint_fast8_t refresh)
 {
-   int error;
-
    if (xbee == NULL)
    {
       return -EINVAL;
@@ -776,37 +850,117 @@ int xbee_cmd_query_device( xbee_dev_t *xbee, uint_fast8_t refresh)
    {
       // set flag indicating that we need to refresh the registers
       xbee->flags |= XBEE_DEV_FLAG_QUERY_REFRESH;
+      if (xbee->flags & XBEE_DEV_FLAG_QUERY_CACHED)
+      {
+         // the refresh that follows confirming the cache covers this
+         return 0;
+      }
       refresh = XBEE_ATCMD_REG_REFRESH_IDX;
    }
 
-   if (xbee->flags & XBEE_DEV_FLAG_QUERY_INPROGRESS)
+   return _xbee_cmd_query_start( xbee, refresh);
+}
+
+/**   @internal
+   Values read back from the XBee to confirm that cached settings still
+   belong to the attached module.
+*/
+typedef struct _xbee_cmd_verify_t {
+   xbee_dev_t     *xbee;         ///< device being verified, NULL if idle
+   uint16_t       hardware_version;
+   uint32_t       firmware_version;
+   addr64         ieee;
+} _xbee_cmd_verify_t;
+
+_xbee_atcmd_debug
+void _xbee_cmd_verify_handle_end(
+         const xbee_cmd_response_t FAR *response,
+         const struct xbee_atcmd_reg_t FAR   *reg,
+         void FAR                            *base
+         )
+{
+   _xbee_cmd_verify_t FAR *verify = base;
+   xbee_dev_t *xbee = verify->xbee;
+
+   verify->xbee = NULL;
+   xbee->flags &= ~XBEE_DEV_FLAG_QUERY_CACHED;
+
+   if (reg && ! (response->flags & XBEE_CMD_RESP_FLAG_TIMEOUT)
+      && verify->hardware_version == xbee->hardware_version
+      && verify->firmware_version == xbee->firmware_version
+      && addr64_equal( &verify->ieee, &xbee->wpan_dev.address.ieee))
    {
       #ifdef XBEE_ATCMD_VERBOSE
-         printf( "%s: aborting; query already in progress\n", __FUNCTION__);
+         printf( "%s: cached values confirmed\n", __FUNCTION__);
       #endif
-      // note that if we were trying to refresh, we've set a flag
-      // (QUERY_REFRESH) and can restart the refresh after the current
-      // pass finishes
-      return 0;
+      // same module and firmware; read the settings that aren't cached
+      xbee->flags |= XBEE_DEV_FLAG_QUERY_REFRESH;
+      _xbee_cmd_query_start( xbee, XBEE_ATCMD_REG_VERIFIED_IDX);
+   }
+   else
+   {
+      #ifdef XBEE_ATCMD_VERBOSE
+         printf( "%s: cache is stale, querying device\n", __FUNCTION__);
+      #endif
+      xbee->flags &= ~XBEE_DEV_FLAG_QUERY_DONE;
+      xbee_cmd_query_device( xbee, 0);
    }
+}
 
-   error = xbee_cmd_list_execute(xbee,
-                           &_xbee_atcmd_query_regs_head,
-                           _xbee_atcmd_query_regs + refresh,
-                           xbee, NULL);
+/**   @internal
+   Registers compared against cached values in the xbee_dev_t.
+*/
+const xbee_atcmd_reg_t _xbee_atcmd_verify_regs[] = {
+   XBEE_ATCMD_REG( 'H', 'V', XBEE_CLT_COPY_BE, _xbee_cmd_verify_t, hardware_version),
+   XBEE_ATCMD_REG( 'V', 'R', XBEE_CLT_COPY_BE, _xbee_cmd_verify_t, firmware_version),
+   XBEE_ATCMD_REG( 'S', 'H', XBEE_CLT_COPY_PAD_LEFT, _xbee_cmd_verify_t, ieee.l[0]),
+   XBEE_ATCMD_REG( 'S', 'L', XBEE_CLT_COPY_PAD_LEFT, _xbee_cmd_verify_t, ieee.l[1]),
+   XBEE_ATCMD_REG_END_CB(_xbee_cmd_verify_handle_end, 0)
+};
 
-   // successfully started query
-   if (error == 0)
+static _xbee_cmd_verify_t _xbee_cmd_verify;
+static xbee_command_list_context_t _xbee_cmd_verify_head;
+
+/**   @internal
+   @brief
+   Start revalidating an xbee_dev_t whose hardware/firmware versions and
+   IEEE address were loaded from a cache (see xbee_dev_cache_load()).
+
+   Until the check completes, xbee_cmd_query_status() reports the query
+   as done so the application can start immediately.  If the attached
+   module doesn't match the cache, the device is queried from scratch.
+
+   @param[in]  xbee  device with #XBEE_DEV_FLAG_QUERY_CACHED set
+
+   @retval  0        check (or full query) started
+   @retval  -EINVAL  \a xbee is NULL
+   @retval  <0       error from xbee_cmd_query_device()
+*/
+_xbee_atcmd_debug
+int _xbee_cmd_verify_cached( xbee_dev_t *xbee)
+{
+   int error;
+
+   if (xbee == NULL)
    {
-      xbee->flags |= XBEE_DEV_FLAG_QUERY_BEGIN |
-                     XBEE_DEV_FLAG_QUERY_INPROGRESS;
-      xbee->flags &=
-         ~(XBEE_DEV_FLAG_QUERY_ERROR
-            | XBEE_DEV_FLAG_QUERY_DONE
-            | XBEE_DEV_FLAG_QUERY_REFRESH);
+      return -EINVAL;
    }
 
-   return error;
+   if (_xbee_cmd_verify.xbee == NULL)
+   {
+      _xbee_cmd_verify.xbee = xbee;
+      error = xbee_cmd_list_execute( xbee, &_xbee_cmd_verify_head,
+         _xbee_atcmd_verify_regs, &_xbee_cmd_verify, NULL);
+      if (error == 0)
+      {
+         return 0;
+      }
+      _xbee_cmd_verify.xbee = NULL;
+   }
+
+   // can't verify the cache, fall back to a full query
+   xbee->flags &= ~(XBEE_DEV_FLAG_QUERY_CACHED | XBEE_DEV_FLAG_QUERY_DONE);
+   return xbee_cmd_query_device( xbee, 0);
 }
 
 /**
@@ -816,7 +970,8 @@ int xbee_cmd_query_device( xbee_dev_t *xbee, uint_fast8_t refresh)
 
    @param[in]  xbee  device to check
 
-   @retval  0           query completed
+   @retval  0           query completed, or the device is using values
+                        loaded from a cache while they are revalidated
    @retval  -EINVAL     \a xbee is NULL
    @retval  -EBUSY      query underway
    @retval  -ETIMEDOUT  query timed out
@@ -833,6 +988,14 @@ int xbee_cmd_query_status( xbee_dev_t *xbee)
 
    xbee_cmd_tick();
 
+   if ((xbee->flags & (XBEE_DEV_FLAG_QUERY_CACHED
+                        | XBEE_DEV_FLAG_QUERY_INPROGRESS))
+      == XBEE_DEV_FLAG_QUERY_CACHED)
+   {
+      // using cached values while they're revalidated in the background
+      return 0;
+   }
+
    return xbee_cmd_list_status(&_xbee_atcmd_query_regs_head);
 }
 
@@ -882,7 +1045,7 @@ int16_t xbee_cmd_create( xbee_dev_t *xbee, const char FAR command[3])
    if (! initialized)
    {
       initialized = 1;
-      _f_memset( xbee_cmd_request_table, 0, sizeof(xbee_cmd_request_table));
+      _xbee_cmd_table_init();
    }
 
    if (! (xbee->flags & XBEE_DEV_FLAG_CMD_INIT))
@@ -891,16 +1054,7 @@ int16_t xbee_cmd_create( xbee_dev_t *xbee, const char FAR command[3])
       xbee_cmd_init_device( xbee);
    }
 
-   request = xbee_cmd_request_table;
-   for (index = 0; index < XBEE_CMD_REQUEST_TABLESIZE; ++request, ++index)
-   {
-      if (request->device == NULL)
-      {
-         break;
-      }
-   }
-
-   if (index == XBEE_CMD_REQUEST_TABLESIZE)
+   if (_xbee_cmd_free_head == 0)
    {
       // all slots in table are in use
 
@@ -917,13 +1071,22 @@ int16_t xbee_cmd_create( xbee_dev_t *xbee, const char FAR command[3])
       return -ENOSPC;
    }
 
+   // pop the first entry off of the free list
+   index = _xbee_cmd_free_head - 1;
+   request = &xbee_cmd_request_table[index];
+   _xbee_cmd_free_head = request->next;
+
    handle = (index << 8) | request->sequence;
 
    // clear out most of the entry (preserve sequence)
    _f_memset( &request->timeout, 0,
                sizeof(*request) - offsetof(xbee_cmd_request_t, timeout));
 
+   // and push it onto the device's list of outstanding requests
    request->device = xbee;
+   request->next = xbee->cmd_active;
+   xbee->cmd_active = (uint8_t)(index + 1);
+   ++xbee->cmd_active_count;
    // allow 2 seconds to finish building command and successfully send it
    request->timeout = XBEE_SET_TIMEOUT_SEC(2);
    request->command.w = xbee_get_unaligned16( command);
@@ -957,14 +1120,36 @@ int16_t xbee_cmd_create( xbee_dev_t *xbee, const char FAR command[3])
 _xbee_atcmd_debug
 int _xbee_cmd_release_request( xbee_cmd_request_t FAR *request)
 {
-   if (! request)
+   uint8_t entry;
+   uint8_t FAR *link;
+   xbee_dev_t *xbee;
+
+   if (! (request && request->device))
    {
       return -EINVAL;
    }
 
+   // unlink entry from the device's list of outstanding requests
+   xbee = request->device;
+   entry = (uint8_t)(request - xbee_cmd_request_table + 1);
+   for (link = &xbee->cmd_active; *link;
+      link = &xbee_cmd_request_table[*link - 1].next)
+   {
+      if (*link == entry)
+      {
+         *link = request->next;
+         --xbee->cmd_active_count;
+         break;
+      }
+   }
+
    request->device = NULL;       // free up entry in the table
    ++request->sequence;          // alter sequence to expire old handles
 
+   // return entry to the free list
+   request->next = _xbee_cmd_free_head;
+   _xbee_cmd_free_head = entry;
+
    return 0;
 }
 
@@ -990,6 +1175,38 @@ int xbee_cmd_release_handle( int16_t handle)
    return _xbee_cmd_release_request( _xbee_cmd_handle_to_address( handle));
 }
 
+/*** BeginHeader xbee_cmd_release_device */
+/*** EndHeader */
+/**
+   @brief
+   Release every outstanding request for a device, without calling their
+   callbacks.  Use before freeing or re-initializing an xbee_dev_t that
+   might still have requests in the table.
+
+   @param[in]  xbee  device whose requests should be released
+
+   @retval  >=0      number of requests released
+   @retval  -EINVAL  \a xbee is NULL
+*/
+_xbee_atcmd_debug
+int xbee_cmd_release_device( xbee_dev_t *xbee)
+{
+   int count = 0;
+
+   if (xbee == NULL)
+   {
+      return -EINVAL;
+   }
+
+   while (xbee->cmd_active)
+   {
+      _xbee_cmd_release_request( &xbee_cmd_request_table[xbee->cmd_active - 1]);
+      ++count;
+   }
+
+   return count;
+}
+
 /*** BeginHeader xbee_cmd_set_command */
 /*** EndHeader */
 /**
@@ -1248,6 +1465,43 @@ int xbee_cmd_clear_flags( int16_t handle, uint16_t flags)
 }
 
 
+/*** BeginHeader xbee_cmd_set_timeout */
+/*** EndHeader */
+/**
+   @brief
+   Override how long to wait for a response to a given AT Command request.
+
+   Useful for remote requests to nodes that are known to be awake, where
+   the default #XBEE_CMD_REMOTE_TIMEOUT (which allows for sleeping end
+   devices) would hold the request for minutes.
+
+   @param[in]  handle
+               Handle to the request, as returned by xbee_cmd_create().
+   @param[in]  seconds  seconds to wait after sending the request, or 0 to
+                        restore the default
+
+   @retval  0        timeout set
+   @retval  -EINVAL  \a handle is not valid
+
+   @see  xbee_cmd_send()
+*/
+_xbee_atcmd_debug
+int xbee_cmd_set_timeout( int16_t handle, uint16_t seconds)
+{
+   xbee_cmd_request_t FAR *request;
+
+   request = _xbee_cmd_handle_to_address( handle);
+   if (! request)
+   {
+      return -EINVAL;
+   }
+
+   request->response_timeout = seconds;
+
+   return 0;
+}
+
+
 /*** BeginHeader xbee_cmd_set_param */
 /*** EndHeader */
 /**
@@ -1469,13 +1723,20 @@ int xbee_cmd_send( int16_t handle)
       if (request->frame_id != 0)
       {
          // we're expecting a response, so update the timeout value
-         request->timeout =
+         if (request->response_timeout)
+         {
+            request->timeout = XBEE_SET_TIMEOUT_SEC( request->response_timeout);
+         }
+         else
+         {
+            request->timeout =
 #ifdef XBEE_CMD_DISABLE_REMOTE
-            XBEE_SET_TIMEOUT_SEC( XBEE_CMD_LOCAL_TIMEOUT);
+               XBEE_SET_TIMEOUT_SEC( XBEE_CMD_LOCAL_TIMEOUT);
 #else
-            XBEE_SET_TIMEOUT_SEC( request->flags & XBEE_CMD_FLAG_REMOTE
-                  ? XBEE_CMD_REMOTE_TIMEOUT : XBEE_CMD_LOCAL_TIMEOUT);
+               XBEE_SET_TIMEOUT_SEC( request->flags & XBEE_CMD_FLAG_REMOTE
+                     ? XBEE_CMD_REMOTE_TIMEOUT : XBEE_CMD_LOCAL_TIMEOUT);
 #endif
+         }
       }
       else if (! (request->flags & XBEE_CMD_FLAG_REUSE_HANDLE))
       {
@@ -1570,13 +1831,14 @@ int _xbee_cmd_handle_response( xbee_dev_t *xbee, const void FAR *rawframe,
    // local.frame_id and remote.frame_id are at the same offset in the struct
    frame_id = frame->local.header.frame_id;
 
-   // Look for the frame in the table of pending requests.
-   request = xbee_cmd_request_table;
-   for (index = 0; index < XBEE_CMD_REQUEST_TABLESIZE; ++request, ++index)
+   // Look for the frame in this device's list of pending requests.
+   request = NULL;
+   for (index = xbee->cmd_active; index; index = request->next)
    {
-      // Match device, frame_id, command and local/remote
-      if (request->device == xbee &&            // sent on this device
-         request->frame_id == frame_id &&       // frame ID matches
+      request = &xbee_cmd_request_table[index - 1];
+
+      // Match frame_id, command and local/remote
+      if (request->frame_id == frame_id &&       // frame ID matches
 #ifndef XBEE_CMD_DISABLE_REMOTE
          is_local == !(request->flags & XBEE_CMD_FLAG_REMOTE) &&
 #endif
@@ -1586,7 +1848,7 @@ int _xbee_cmd_handle_response( xbee_dev_t *xbee, const void FAR *rawframe,
       }
    }
 
-   if (index == XBEE_CMD_REQUEST_TABLESIZE)
+   if (index == 0)
    {
       // didn't find request in table
       #ifdef XBEE_ATCMD_VERBOSE
@@ -1612,6 +1874,9 @@ int _xbee_cmd_handle_response( xbee_dev_t *xbee, const void FAR *rawframe,
       return 0;
    }
 
+   // convert 1-based list link to table index
+   --index;
+
    #ifdef XBEE_ATCMD_VERBOSE
       printf( "%s: response matched request %d\n", __FUNCTION__, index);
    #endif
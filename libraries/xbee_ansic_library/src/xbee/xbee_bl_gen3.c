@@ -28,6 +28,12 @@
     for further firmware updates.  See xbee/firmware.h and xbee_firmware.c
     for .gbl and Gecko bootloader support.
 
+    The 'I' command starts the upload with the module's application flash
+    erased, so pages of the new image that are all 0xFF are skipped, but
+    every other page has to be sent.  The bootloader has no command to read
+    back or checksum the pages already on the module, so there's no way to
+    skip pages that haven't changed since the last update.
+
     Define XBEE_BL_GEN3_VERBOSE for debugging messages.
 */
 
@@ -154,6 +160,7 @@ static int _load_page(xbee_gen3_update_t *source)
                    source->page_num);
 #endif
             ++source->page_num;
+            ++source->pages_skipped;
             continue;
         }
 
@@ -203,7 +210,7 @@ static void _send_page(xbee_gen3_update_t *source)
         xbee_ser_rx_flush(serport);
 
         if (source->flags & XBEE_GEN3_BL_FLAG_PROTO1) {         // CRC16
-            uint16_t crc16 = crc16buypass_byte(0, source->buffer,
+            uint16_t crc16 = crc16buypass_word(0, source->buffer,
                                                XBEE_GEN3_UPLOAD_PAGE_SIZE);
             xbee_ser_putchar(serport, (uint8_t)crc16);
             xbee_ser_putchar(serport, (uint8_t)(crc16 >> 8));
@@ -528,7 +535,8 @@ const char *xbee_bl_gen3_install_status(xbee_gen3_update_t *source,
         return "Retrieved extended version.";
 
     case XBEE_GEN3_STATE_SEND_PAGE:          // send the current page
-        sprintf(buffer, "Sending page %u.", source->page_num);
+        sprintf(buffer, "Sending page %u (%u blank skipped).",
+                source->page_num, source->pages_skipped);
         return buffer;
 
     case XBEE_GEN3_STATE_LOAD_PAGE:          // on success, load next page or verify
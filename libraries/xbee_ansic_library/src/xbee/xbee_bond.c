@@ -0,0 +1,540 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_wpan
+   @{
+   @file xbee_bond.c
+   Stripe one data stream across several XBee radios and put it back in
+   order on the receiving side.  See xbee/bond.h for an overview.
+*/
+
+/*** BeginHeader */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/bond.h"
+#include "xbee/byteorder.h"
+
+#ifndef __DC__
+   #define _xbee_bond_debug
+#elif defined XBEE_BOND_DEBUG
+   #define _xbee_bond_debug  __debug
+#else
+   #define _xbee_bond_debug  __nodebug
+#endif
+/*** EndHeader */
+
+/*** BeginHeader xbee_bond_init */
+/*** EndHeader */
+/**
+   @brief
+   Initialize a bond with no links.
+
+   @param[out] bond           bond to initialize
+   @param[in]  ieee_address   destination of payloads sent with
+                              xbee_bond_send(), or NULL for a bond that
+                              only receives
+   @param[in]  deliver        called with each received payload, in order,
+                              or NULL for a bond that only sends
+   @param[in]  context        passed to \a deliver
+
+   @retval  0        success
+   @retval  -EINVAL  \a bond is NULL
+*/
+_xbee_bond_debug
+int xbee_bond_init( xbee_bond_t *bond, const addr64 FAR *ieee_address,
+   xbee_bond_deliver_fn deliver, void FAR *context)
+{
+   if (bond == NULL)
+   {
+      return -EINVAL;
+   }
+
+   memset( bond, 0, sizeof *bond);
+   if (ieee_address != NULL)
+   {
+      bond->ieee_address = *ieee_address;
+   }
+   bond->deliver = deliver;
+   bond->context = context;
+
+   return 0;
+}
+
+/*** BeginHeader xbee_bond_add_link */
+/*** EndHeader */
+/**
+   @brief
+   Add a radio to a bond.
+
+   The radio's frame handler table must include
+   XBEE_BOND_FRAME_HANDLE_TRANSMIT_STATUS() for \a bond.
+
+   @param[in,out] bond  bond to add the radio to
+   @param[in]     xbee  initialized XBee device
+
+   @retval  >=0      index of the link in \c bond->link
+   @retval  -EINVAL  NULL parameter
+   @retval  -EEXIST  \a xbee is already part of \a bond
+   @retval  -ENOSPC  \a bond already has #XBEE_BOND_MAX_LINKS links
+*/
+_xbee_bond_debug
+int xbee_bond_add_link( xbee_bond_t *bond, xbee_dev_t *xbee)
+{
+   xbee_bond_link_t *link;
+   uint_fast8_t i;
+
+   if (bond == NULL || xbee == NULL)
+   {
+      return -EINVAL;
+   }
+
+   for (i = 0; i < bond->link_count; ++i)
+   {
+      if (bond->link[i].xbee == xbee)
+      {
+         return -EEXIST;
+      }
+   }
+   if (bond->link_count == XBEE_BOND_MAX_LINKS)
+   {
+      return -ENOSPC;
+   }
+
+   link = &bond->link[bond->link_count];
+   memset( link, 0, sizeof *link);
+   link->xbee = xbee;
+   link->window_start_ms = xbee_millisecond_timer();
+
+   return bond->link_count++;
+}
+
+/*** BeginHeader _xbee_bond_credit */
+int _xbee_bond_credit( const xbee_bond_link_t *link);
+/*** EndHeader */
+/**
+   @internal
+   Number of additional frames a link may send.  Lossy links get a smaller
+   window so more of the stream goes to the links that are delivering.
+*/
+_xbee_bond_debug
+int _xbee_bond_credit( const xbee_bond_link_t *link)
+{
+   int window;
+
+   window = XBEE_BOND_WINDOW
+      - (XBEE_BOND_WINDOW - 1) * link->loss_permille / 1000;
+
+   return window - link->outstanding;
+}
+
+/*** BeginHeader _xbee_bond_account */
+void _xbee_bond_account( xbee_bond_link_t *link, xbee_bond_pending_t *pending,
+   bool_t success);
+/*** EndHeader */
+/**
+   @internal
+   Record the outcome of a frame and return its credit to the link.
+*/
+_xbee_bond_debug
+void _xbee_bond_account( xbee_bond_link_t *link, xbee_bond_pending_t *pending,
+   bool_t success)
+{
+   // moving average, each frame has 1/8 weight
+   link->loss_permille -= link->loss_permille / 8;
+   if (success)
+   {
+      ++link->delivered;
+      link->bytes_delivered += pending->length;
+      link->window_bytes += pending->length;
+   }
+   else
+   {
+      ++link->failed;
+      link->loss_permille += 1000 / 8;
+   }
+
+   pending->frame_id = 0;
+   --link->outstanding;
+}
+
+/*** BeginHeader xbee_bond_send */
+/*** EndHeader */
+/**
+   @brief
+   Send a payload on the bond's least-loaded link.
+
+   @param[in,out] bond     bond to send on
+   @param[in]     payload  data to send
+   @param[in]     length   bytes in \a payload, up to #XBEE_BOND_MAX_PAYLOAD
+
+   @retval  >=0        index of the link used
+   @retval  -EINVAL    invalid parameter or \a bond has no links
+   @retval  -EMSGSIZE  \a length is more than #XBEE_BOND_MAX_PAYLOAD
+   @retval  -EBUSY     every link is waiting on its full window of
+                       Transmit Status frames; try again after ticking
+                       the devices
+   @retval  <0         error from xbee_frame_write()
+*/
+_xbee_bond_debug
+int xbee_bond_send( xbee_bond_t *bond, const void FAR *payload,
+   uint16_t length)
+{
+   XBEE_PACKED(, {
+      xbee_header_transmit_explicit_t  explicit;
+      xbee_bond_header_t               bond;
+   }) header;
+   xbee_bond_link_t *link;
+   xbee_bond_pending_t *pending;
+   int i, index, best = -1, best_credit = 0, credit, error;
+
+   if (bond == NULL || bond->link_count == 0 || (length && payload == NULL))
+   {
+      return -EINVAL;
+   }
+   if (length > XBEE_BOND_MAX_PAYLOAD)
+   {
+      return -EMSGSIZE;
+   }
+
+   // most credit wins; ties go to the first link after the last one used
+   for (i = 0; i < bond->link_count; ++i)
+   {
+      index = (bond->next_link + i) % bond->link_count;
+      credit = _xbee_bond_credit( &bond->link[index]);
+      if (credit > best_credit)
+      {
+         best = index;
+         best_credit = credit;
+      }
+   }
+   if (best < 0)
+   {
+      return -EBUSY;
+   }
+
+   link = &bond->link[best];
+   for (pending = link->pending; pending->frame_id; ++pending)
+   {
+      // credit > 0 guarantees a free entry
+   }
+
+   header.explicit.frame_type = (uint8_t) XBEE_FRAME_TRANSMIT_EXPLICIT;
+   header.explicit.frame_id = xbee_next_frame_id( link->xbee);
+   header.explicit.ieee_address = bond->ieee_address;
+   header.explicit.network_address_be = htobe16( WPAN_NET_ADDR_UNDEFINED);
+   header.explicit.source_endpoint = WPAN_ENDPOINT_DIGI_DATA;
+   header.explicit.dest_endpoint = WPAN_ENDPOINT_DIGI_DATA;
+   header.explicit.cluster_id_be = htobe16( XBEE_BOND_CLUSTER);
+   header.explicit.profile_id_be = htobe16( WPAN_PROFILE_DIGI);
+   header.explicit.broadcast_radius = 0;
+   header.explicit.options = 0;
+   header.bond.sequence_be = htobe16( bond->tx_sequence);
+
+   error = xbee_frame_write( link->xbee, &header, sizeof header,
+      payload, length, 0);
+   if (error)
+   {
+      return error;
+   }
+
+   #ifdef XBEE_BOND_VERBOSE
+      printf( "%s: seq %u on link %d (id 0x%02x, credit %d)\n", __FUNCTION__,
+         bond->tx_sequence, best, header.explicit.frame_id, best_credit);
+   #endif
+
+   pending->frame_id = header.explicit.frame_id;
+   pending->length = length;
+   pending->sent_ms = xbee_millisecond_timer();
+   ++link->outstanding;
+   ++link->sent;
+   ++bond->tx_sequence;
+   bond->next_link = (uint8_t)((best + 1) % bond->link_count);
+
+   return best;
+}
+
+/*** BeginHeader xbee_bond_handle_transmit_status */
+/*** EndHeader */
+// documented in xbee/bond.h
+_xbee_bond_debug
+int xbee_bond_handle_transmit_status( xbee_dev_t *xbee,
+   const void FAR *payload, uint16_t length, void FAR *context)
+{
+   const xbee_frame_transmit_status_t FAR *frame = payload;
+   xbee_bond_t *bond = context;
+   xbee_bond_link_t *link;
+   uint_fast8_t i, j;
+
+   if (bond == NULL || frame == NULL || length < sizeof *frame)
+   {
+      return -EINVAL;
+   }
+
+   for (i = 0; i < bond->link_count; ++i)
+   {
+      link = &bond->link[i];
+      if (link->xbee != xbee)
+      {
+         continue;
+      }
+      for (j = 0; j < XBEE_BOND_WINDOW; ++j)
+      {
+         if (link->pending[j].frame_id == frame->frame_id)
+         {
+            #ifdef XBEE_BOND_VERBOSE
+               printf( "%s: link %u id 0x%02x delivery 0x%02x retries %u\n",
+                  __FUNCTION__, i, frame->frame_id, frame->delivery,
+                  frame->retries);
+            #endif
+            _xbee_bond_account( link, &link->pending[j],
+               frame->delivery == XBEE_TX_DELIVERY_SUCCESS);
+            break;
+         }
+      }
+      break;
+   }
+
+   // status for a frame sent outside the bond is silently ignored
+   return 0;
+}
+
+/*** BeginHeader _xbee_bond_rx_advance */
+void _xbee_bond_rx_advance( xbee_bond_t *bond);
+/*** EndHeader */
+/**
+   @internal
+   Deliver \c rx_next if it is held (or count it as skipped), then move on
+   to the next sequence number.
+*/
+_xbee_bond_debug
+void _xbee_bond_rx_advance( xbee_bond_t *bond)
+{
+   uint_fast8_t index = bond->rx_next % XBEE_BOND_REORDER;
+
+   if (bond->rx_slot[index].used && bond->rx_slot[index].sequence == bond->rx_next)
+   {
+      if (bond->deliver != NULL)
+      {
+         bond->deliver( bond->context, bond->rx_slot[index].data,
+            bond->rx_slot[index].length);
+      }
+      bond->rx_slot[index].used = 0;
+      --bond->rx_held;
+      ++bond->rx_delivered;
+   }
+   else
+   {
+      ++bond->rx_skipped;
+   }
+   ++bond->rx_next;
+}
+
+/*** BeginHeader _xbee_bond_rx_drain */
+void _xbee_bond_rx_drain( xbee_bond_t *bond);
+/*** EndHeader */
+/**
+   @internal
+   Deliver held payloads that are now in order.
+*/
+_xbee_bond_debug
+void _xbee_bond_rx_drain( xbee_bond_t *bond)
+{
+   uint_fast8_t index;
+
+   for (;;)
+   {
+      index = bond->rx_next % XBEE_BOND_REORDER;
+      if (! bond->rx_slot[index].used
+         || bond->rx_slot[index].sequence != bond->rx_next)
+      {
+         break;
+      }
+      _xbee_bond_rx_advance( bond);
+   }
+
+   // restart the gap timer for the new head of line
+   bond->rx_gap_ms = xbee_millisecond_timer();
+}
+
+/*** BeginHeader xbee_bond_receive */
+/*** EndHeader */
+/**
+   @brief
+   Process a bonded payload (sequence number followed by data) received on
+   any of the bond's radios.  Called by xbee_bond_cluster_handler(); use it
+   directly if bonded payloads arrive some other way.
+
+   @param[in,out] bond     bond that receives the payload
+   @param[in]     payload  bonded payload, starting with an
+                           xbee_bond_header_t
+   @param[in]     length   bytes in \a payload
+
+   A sequence more than 2 * #XBEE_BOND_REORDER behind the next one expected
+   means the sender restarted; the receiver drops any payloads it was
+   holding and continues from that sequence.
+
+   @retval  0           payload delivered, held for reordering or dropped
+                        as a duplicate
+   @retval  -EINVAL     invalid parameter or payload too short
+   @retval  -EMSGSIZE   payload larger than #XBEE_BOND_MAX_PAYLOAD
+*/
+_xbee_bond_debug
+int xbee_bond_receive( xbee_bond_t *bond, const void FAR *payload,
+   uint16_t length)
+{
+   const xbee_bond_header_t FAR *header = payload;
+   uint16_t sequence;
+   uint_fast8_t index;
+
+   if (bond == NULL || payload == NULL || length < sizeof *header)
+   {
+      return -EINVAL;
+   }
+   length -= sizeof *header;
+   if (length > XBEE_BOND_MAX_PAYLOAD)
+   {
+      return -EMSGSIZE;
+   }
+
+   sequence = be16toh( header->sequence_be);
+   if (! bond->rx_synced)
+   {
+      // start from whatever the sender is up to
+      bond->rx_next = sequence;
+      bond->rx_synced = TRUE;
+   }
+
+   if ((int16_t)(sequence - bond->rx_next) < 0)
+   {
+      if ((int16_t)(sequence - bond->rx_next) >= -2 * XBEE_BOND_REORDER)
+      {
+         ++bond->rx_duplicates;
+         return 0;
+      }
+
+      // too far back to be a late copy: the sender restarted, so give up
+      // on payloads held from its old stream and follow the new one
+      for (index = 0; index < XBEE_BOND_REORDER; ++index)
+      {
+         bond->rx_slot[index].used = 0;
+      }
+      bond->rx_skipped += bond->rx_held;
+      bond->rx_held = 0;
+      bond->rx_next = sequence;
+      ++bond->rx_resyncs;
+   }
+
+   // too far ahead to hold: give up on the oldest missing sequences
+   while ((int16_t)(sequence - bond->rx_next) >= XBEE_BOND_REORDER)
+   {
+      _xbee_bond_rx_advance( bond);
+   }
+
+   index = sequence % XBEE_BOND_REORDER;
+   if (bond->rx_slot[index].used)
+   {
+      ++bond->rx_duplicates;
+      return 0;
+   }
+   bond->rx_slot[index].used = 1;
+   bond->rx_slot[index].sequence = sequence;
+   bond->rx_slot[index].length = length;
+   _f_memcpy( bond->rx_slot[index].data, header + 1, length);
+   if (! bond->rx_held++)
+   {
+      bond->rx_gap_ms = xbee_millisecond_timer();
+   }
+
+   if (bond->rx_slot[bond->rx_next % XBEE_BOND_REORDER].used)
+   {
+      _xbee_bond_rx_drain( bond);
+   }
+
+   return 0;
+}
+
+/*** BeginHeader xbee_bond_cluster_handler */
+/*** EndHeader */
+// documented in xbee/bond.h
+_xbee_bond_debug
+int xbee_bond_cluster_handler( const wpan_envelope_t FAR *envelope,
+   void FAR *context)
+{
+   if (envelope == NULL)
+   {
+      return -EINVAL;
+   }
+
+   return xbee_bond_receive( context, envelope->payload, envelope->length);
+}
+
+/*** BeginHeader xbee_bond_tick */
+/*** EndHeader */
+/**
+   @brief
+   Expire frames that never got a Transmit Status, update each link's
+   throughput and skip over sequence numbers the receiver has waited too
+   long for.  Call periodically on both ends.
+
+   @param[in,out] bond  bond to service
+
+   @retval  >=0      frames waiting for a Transmit Status on all links
+   @retval  -EINVAL  \a bond is NULL
+*/
+_xbee_bond_debug
+int xbee_bond_tick( xbee_bond_t *bond)
+{
+   xbee_bond_link_t *link;
+   uint32_t now, elapsed;
+   uint_fast8_t i, j;
+   int outstanding = 0;
+
+   if (bond == NULL)
+   {
+      return -EINVAL;
+   }
+
+   now = xbee_millisecond_timer();
+   for (i = 0; i < bond->link_count; ++i)
+   {
+      link = &bond->link[i];
+      for (j = 0; j < XBEE_BOND_WINDOW; ++j)
+      {
+         if (link->pending[j].frame_id
+            && (int32_t)(now - link->pending[j].sent_ms)
+               >= XBEE_BOND_TX_TIMEOUT_MS)
+         {
+            _xbee_bond_account( link, &link->pending[j], FALSE);
+         }
+      }
+      outstanding += link->outstanding;
+
+      elapsed = now - link->window_start_ms;
+      if (elapsed >= 1000)
+      {
+         link->bytes_per_sec = link->window_bytes * 1000 / elapsed;
+         link->window_bytes = 0;
+         link->window_start_ms = now;
+      }
+   }
+
+   if (bond->rx_held && (int32_t)(now - bond->rx_gap_ms) >= XBEE_BOND_GAP_MS)
+   {
+      // skip the gap, up to the next payload we're holding
+      do {
+         _xbee_bond_rx_advance( bond);
+      } while (! bond->rx_slot[bond->rx_next % XBEE_BOND_REORDER].used);
+      _xbee_bond_rx_drain( bond);
+   }
+
+   return outstanding;
+}
+
+///@}
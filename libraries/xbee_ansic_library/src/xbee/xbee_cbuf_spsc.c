@@ -0,0 +1,228 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_cbuf
+   @{
+   @file xbee_cbuf_spsc.c
+
+   Lock-free single-producer, single-consumer circular buffer.
+
+   Write to tail, read from head.  Each side reads the other side's index
+   only when its cached copy says there isn't enough room (or data).
+*/
+/*** BeginHeader */
+#include <errno.h>
+#include <string.h>
+
+#include "xbee/cbuf_spsc.h"
+/*** EndHeader */
+
+/*    Functions are documented in xbee/cbuf_spsc.h      */
+
+/*** BeginHeader xbee_cbuf_spsc_init */
+/*** EndHeader */
+int xbee_cbuf_spsc_init( xbee_cbuf_spsc_t *cbuf, void FAR *data,
+   unsigned int size)
+{
+   if (! cbuf || ! data || (size < 2) || (size & (size - 1)))
+   {
+      return -EINVAL;
+   }
+
+   memset( cbuf, 0, sizeof *cbuf);
+   cbuf->mask = size - 1;
+   cbuf->data = data;
+
+   return 0;
+}
+
+/*** BeginHeader xbee_cbuf_spsc_used */
+/*** EndHeader */
+unsigned int xbee_cbuf_spsc_used( xbee_cbuf_spsc_t *cbuf)
+{
+   return XBEE_CBUF_SPSC_LOAD_ACQUIRE( &cbuf->tail)
+      - XBEE_CBUF_SPSC_LOAD_ACQUIRE( &cbuf->head);
+}
+
+/*** BeginHeader xbee_cbuf_spsc_free */
+/*** EndHeader */
+unsigned int xbee_cbuf_spsc_free( xbee_cbuf_spsc_t *cbuf)
+{
+   return cbuf->mask + 1 - xbee_cbuf_spsc_used( cbuf);
+}
+
+/*** BeginHeader _xbee_cbuf_spsc_room */
+unsigned int _xbee_cbuf_spsc_room( xbee_cbuf_spsc_t *cbuf,
+   unsigned int wanted);
+/*** EndHeader */
+/**
+   @internal
+   Free space as seen by the producer, reloading \c head only if the cached
+   copy shows less than \a wanted bytes free.
+*/
+unsigned int _xbee_cbuf_spsc_room( xbee_cbuf_spsc_t *cbuf,
+   unsigned int wanted)
+{
+   unsigned int room;
+
+   room = cbuf->mask + 1 - (cbuf->tail - cbuf->head_cache);
+   if (room < wanted)
+   {
+      cbuf->head_cache = XBEE_CBUF_SPSC_LOAD_ACQUIRE( &cbuf->head);
+      room = cbuf->mask + 1 - (cbuf->tail - cbuf->head_cache);
+   }
+
+   return room;
+}
+
+/*** BeginHeader _xbee_cbuf_spsc_avail */
+unsigned int _xbee_cbuf_spsc_avail( xbee_cbuf_spsc_t *cbuf,
+   unsigned int wanted);
+/*** EndHeader */
+/**
+   @internal
+   Buffered bytes as seen by the consumer, reloading \c tail only if the
+   cached copy shows fewer than \a wanted bytes.
+*/
+unsigned int _xbee_cbuf_spsc_avail( xbee_cbuf_spsc_t *cbuf,
+   unsigned int wanted)
+{
+   unsigned int avail;
+
+   avail = cbuf->tail_cache - cbuf->head;
+   if (avail < wanted)
+   {
+      cbuf->tail_cache = XBEE_CBUF_SPSC_LOAD_ACQUIRE( &cbuf->tail);
+      avail = cbuf->tail_cache - cbuf->head;
+   }
+
+   return avail;
+}
+
+/*** BeginHeader xbee_cbuf_spsc_put */
+/*** EndHeader */
+unsigned int xbee_cbuf_spsc_put( xbee_cbuf_spsc_t *cbuf,
+   const void FAR *buffer, unsigned int length)
+{
+   unsigned int room, t, copy;
+
+   room = _xbee_cbuf_spsc_room( cbuf, length);
+   if (length > room)
+   {
+      length = room;
+   }
+   if (length == 0)
+   {
+      return 0;
+   }
+
+   t = cbuf->tail & cbuf->mask;
+   copy = cbuf->mask + 1 - t;       // bytes before wrapping
+   if (copy > length)
+   {
+      copy = length;
+   }
+   _f_memcpy( &cbuf->data[t], buffer, copy);
+   if (copy < length)
+   {
+      _f_memcpy( cbuf->data, (const uint8_t FAR *) buffer + copy,
+         length - copy);
+   }
+   XBEE_CBUF_SPSC_STORE_RELEASE( &cbuf->tail, cbuf->tail + length);
+
+   return length;
+}
+
+/*** BeginHeader xbee_cbuf_spsc_get */
+/*** EndHeader */
+unsigned int xbee_cbuf_spsc_get( xbee_cbuf_spsc_t *cbuf, void FAR *buffer,
+   unsigned int length)
+{
+   unsigned int avail, h, copy;
+
+   avail = _xbee_cbuf_spsc_avail( cbuf, length);
+   if (length > avail)
+   {
+      length = avail;
+   }
+   if (length == 0)
+   {
+      return 0;
+   }
+
+   h = cbuf->head & cbuf->mask;
+   copy = cbuf->mask + 1 - h;       // bytes before wrapping
+   if (copy > length)
+   {
+      copy = length;
+   }
+   _f_memcpy( buffer, &cbuf->data[h], copy);
+   if (copy < length)
+   {
+      _f_memcpy( (uint8_t FAR *) buffer + copy, cbuf->data, length - copy);
+   }
+   XBEE_CBUF_SPSC_STORE_RELEASE( &cbuf->head, cbuf->head + length);
+
+   return length;
+}
+
+/*** BeginHeader xbee_cbuf_spsc_reserve */
+/*** EndHeader */
+void FAR *xbee_cbuf_spsc_reserve( xbee_cbuf_spsc_t *cbuf,
+   unsigned int *length)
+{
+   unsigned int room, t, contiguous;
+
+   room = _xbee_cbuf_spsc_room( cbuf, *length ? *length : cbuf->mask + 1);
+   t = cbuf->tail & cbuf->mask;
+   contiguous = cbuf->mask + 1 - t;
+   if (contiguous > room)
+   {
+      contiguous = room;
+   }
+   if (*length == 0 || *length > contiguous)
+   {
+      *length = contiguous;
+   }
+
+   return contiguous ? &cbuf->data[t] : NULL;
+}
+
+/*** BeginHeader xbee_cbuf_spsc_commit */
+/*** EndHeader */
+void xbee_cbuf_spsc_commit( xbee_cbuf_spsc_t *cbuf, unsigned int length)
+{
+   XBEE_CBUF_SPSC_STORE_RELEASE( &cbuf->tail, cbuf->tail + length);
+}
+
+/*** BeginHeader xbee_cbuf_spsc_peek */
+/*** EndHeader */
+const void FAR *xbee_cbuf_spsc_peek( xbee_cbuf_spsc_t *cbuf,
+   unsigned int *length)
+{
+   unsigned int avail, h, contiguous;
+
+   avail = _xbee_cbuf_spsc_avail( cbuf, cbuf->mask + 1);
+   h = cbuf->head & cbuf->mask;
+   contiguous = cbuf->mask + 1 - h;
+   if (contiguous > avail)
+   {
+      contiguous = avail;
+   }
+   *length = contiguous;
+
+   return contiguous ? &cbuf->data[h] : NULL;
+}
+
+/*** BeginHeader xbee_cbuf_spsc_consume */
+/*** EndHeader */
+void xbee_cbuf_spsc_consume( xbee_cbuf_spsc_t *cbuf, unsigned int length)
+{
+   XBEE_CBUF_SPSC_STORE_RELEASE( &cbuf->head, cbuf->head + length);
+}
+
+///@}
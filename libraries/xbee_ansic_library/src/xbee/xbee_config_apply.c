@@ -0,0 +1,408 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_atcmd
+   @{
+   @file xbee_config_apply.c
+   Read-compare-write engine for applying a profile of AT command settings.
+
+   Every register in the profile is read with requests that are all in
+   flight at once (limited only by free entries in the AT command request
+   table), then only the registers that differ are written, with changes
+   queued until a final ATAC.  ATWR is only sent if something changed, which
+   saves startup time and flash wear on modules that are already configured.
+*/
+
+/*** BeginHeader */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/config_apply.h"
+
+#ifndef __DC__
+   #define _xbee_config_apply_debug
+#elif defined XBEE_CONFIG_APPLY_DEBUG
+   #define _xbee_config_apply_debug  __debug
+#else
+   #define _xbee_config_apply_debug  __nodebug
+#endif
+/*** EndHeader */
+
+/*** BeginHeader xbee_config_apply_start */
+/*** EndHeader */
+
+/**   @internal
+   Callback for every request sent by the config engine.  Records the result
+   in the matching xbee_config_result_t entry.
+*/
+_xbee_config_apply_debug
+static int _xbee_config_apply_callback(
+   const xbee_cmd_response_t FAR *response)
+{
+   xbee_config_apply_t *apply = response->context;
+   xbee_config_result_t *result;
+   uint_fast8_t i;
+   uint8_t at_status;
+   bool_t success;
+
+   if (response->flags & XBEE_CMD_RESP_FLAG_TIMEOUT)
+   {
+      at_status = XBEE_CONFIG_AT_STATUS_TIMEOUT;
+      success = FALSE;
+   }
+   else
+   {
+      at_status = (uint8_t)(response->flags & XBEE_CMD_RESP_MASK_STATUS);
+      success = (at_status == XBEE_AT_RESP_SUCCESS);
+   }
+
+   if (apply->outstanding)
+   {
+      --apply->outstanding;
+   }
+
+   if (apply->state == XBEE_CONFIG_STATE_SAVE)
+   {
+      // ATWR or ATAC response
+      if (! success)
+      {
+         #ifdef XBEE_CONFIG_APPLY_VERBOSE
+            printf( "%s: AT%.2s failed (0x%02X)\n", __FUNCTION__,
+               response->command.str, at_status);
+         #endif
+         // keep running until the other request (ATAC) is done
+         apply->save_failed = TRUE;
+      }
+      return XBEE_ATCMD_DONE;
+   }
+
+   for (i = 0, result = apply->results; i < apply->count; ++i, ++result)
+   {
+      if (result->handle == response->handle)
+      {
+         break;
+      }
+   }
+   if (i == apply->count)
+   {
+      // not one of ours (stale response after a restart)
+      return XBEE_ATCMD_DONE;
+   }
+
+   result->handle = -1;
+   result->at_status = at_status;
+   if (! success)
+   {
+      result->status = XBEE_CONFIG_FAILED;
+      ++apply->failed;
+   }
+   else if (apply->state == XBEE_CONFIG_STATE_QUERY)
+   {
+      result->previous = response->value;
+      if (response->value_length <= 4
+         && response->value == apply->settings[i].value)
+      {
+         result->status = XBEE_CONFIG_MATCHED;
+         ++apply->matched;
+      }
+      else
+      {
+         result->status = XBEE_CONFIG_DIFFERS;
+         ++apply->differs;
+      }
+   }
+   else
+   {
+      result->status = XBEE_CONFIG_CHANGED;
+      ++apply->changed;
+   }
+
+   #ifdef XBEE_CONFIG_APPLY_VERBOSE
+      printf( "%s: AT%.2s status %u (was 0x%" PRIX32 ", want 0x%" PRIX32
+         ")\n", __FUNCTION__, response->command.str, result->status,
+         result->previous, apply->settings[i].value);
+   #endif
+
+   return XBEE_ATCMD_DONE;
+}
+
+/**   @internal
+   Create and send a single request for the config engine.
+
+   @param[in]  apply    state of the configuration being applied
+   @param[in]  command  two-letter AT command
+   @param[in]  value    pointer to value to set, or NULL to read the register
+
+   @retval  >=0      handle of the request sent
+   @retval  -ENOSPC  AT command table is full, try again later
+   @retval  -EBUSY   serial port is busy, try again later
+   @retval  <0       other error from the xbee_cmd_* functions
+*/
+_xbee_config_apply_debug
+static int16_t _xbee_config_apply_send( xbee_config_apply_t *apply,
+   const char FAR *command, const uint32_t *value)
+{
+   int16_t handle;
+   int error;
+
+   handle = xbee_cmd_create( apply->xbee, command);
+   if (handle < 0)
+   {
+      return handle;
+   }
+
+   error = xbee_cmd_set_callback( handle, _xbee_config_apply_callback, apply);
+#ifndef XBEE_CMD_DISABLE_REMOTE
+   if (! error && (apply->flags & XBEE_CONFIG_FLAG_REMOTE))
+   {
+      error = xbee_cmd_set_target( handle, &apply->address.ieee,
+         apply->address.network);
+   }
+#endif
+   if (! error && apply->timeout)
+   {
+      error = xbee_cmd_set_timeout( handle, apply->timeout);
+   }
+   if (! error && value != NULL)
+   {
+      // queue the change until ATAC so settings are applied together
+      error = xbee_cmd_set_param( handle, *value);
+      if (! error)
+      {
+         error = xbee_cmd_set_flags( handle, XBEE_CMD_FLAG_QUEUE_CHANGE);
+      }
+   }
+   if (! error)
+   {
+      error = xbee_cmd_send( handle);
+   }
+   if (error)
+   {
+      xbee_cmd_release_handle( handle);
+      return (int16_t) error;
+   }
+
+   ++apply->outstanding;
+   return handle;
+}
+
+/**
+   @brief
+   Start applying a profile of AT command settings to an XBee module.
+
+   After calling this function, call xbee_config_apply_tick() (along with
+   xbee_dev_tick()) until it stops returning -EBUSY.
+
+   @param[out] apply    state of the configuration; must remain valid until
+                        the process completes
+   @param[in]  xbee     device to configure (or to send remote commands
+                        through)
+   @param[in]  settings profile of registers and desired values
+   @param[out] results  array of \a count entries to hold per-setting results
+   @param[in]  count    number of entries in \a settings and \a results
+   @param[in]  address  remote device to configure, or NULL for the local
+                        device
+   @param[in]  flags    0 or a combination of #XBEE_CONFIG_FLAG_VERIFY_ONLY
+                        and #XBEE_CONFIG_FLAG_NO_SAVE
+
+   @retval  0        started
+   @retval  -EINVAL  invalid parameter
+   @retval  -ENOSYS  remote \a address used with XBEE_CMD_DISABLE_REMOTE
+
+   @see  xbee_config_apply_tick(), xbee_config_apply_status()
+*/
+_xbee_config_apply_debug
+int xbee_config_apply_start( xbee_config_apply_t *apply, xbee_dev_t *xbee,
+   const xbee_config_setting_t FAR *settings, xbee_config_result_t *results,
+   uint_fast8_t count, const wpan_address_t FAR *address, uint16_t flags)
+{
+   uint_fast8_t i;
+
+   if (apply == NULL || xbee == NULL || (count && !(settings && results)))
+   {
+      return -EINVAL;
+   }
+
+   memset( apply, 0, sizeof *apply);
+   apply->xbee = xbee;
+   apply->settings = settings;
+   apply->results = results;
+   apply->count = (uint8_t) count;
+   apply->flags = flags & (XBEE_CONFIG_FLAG_VERIFY_ONLY
+                           | XBEE_CONFIG_FLAG_NO_SAVE);
+   if (address != NULL)
+   {
+#ifdef XBEE_CMD_DISABLE_REMOTE
+      return -ENOSYS;
+#else
+      apply->address = *address;
+      apply->flags |= XBEE_CONFIG_FLAG_REMOTE;
+#endif
+   }
+
+   for (i = 0; i < count; ++i)
+   {
+      memset( &results[i], 0, sizeof results[i]);
+      results[i].handle = -1;
+   }
+
+   apply->state = XBEE_CONFIG_STATE_QUERY;
+   apply->status = -EBUSY;
+
+   return 0;
+}
+
+/*** BeginHeader xbee_config_apply_tick */
+/*** EndHeader */
+/**
+   @brief
+   Drive the configuration process started by xbee_config_apply_start().
+
+   Sends as many requests as the AT command table allows on each call, so
+   all registers are read (and then written) in a single pipelined burst.
+
+   @param[in,out] apply state of the configuration
+
+   @retval  -EBUSY   still running
+   @retval  0        done; every register matched or was written
+   @retval  -EIO     done, but at least one register failed (see the
+                     \c results array) or ATWR/ATAC failed
+   @retval  -EINVAL  \a apply is NULL
+*/
+_xbee_config_apply_debug
+int xbee_config_apply_tick( xbee_config_apply_t *apply)
+{
+   xbee_config_result_t *result;
+   int16_t handle;
+   uint32_t value;
+
+   if (apply == NULL)
+   {
+      return -EINVAL;
+   }
+
+   // expire requests that didn't get a response
+   xbee_cmd_tick();
+
+   switch (apply->state)
+   {
+      case XBEE_CONFIG_STATE_QUERY:
+      case XBEE_CONFIG_STATE_WRITE:
+         for (; apply->next < apply->count; ++apply->next)
+         {
+            result = &apply->results[apply->next];
+            if (apply->state == XBEE_CONFIG_STATE_QUERY)
+            {
+               handle = _xbee_config_apply_send( apply,
+                  apply->settings[apply->next].command, NULL);
+            }
+            else if (result->status == XBEE_CONFIG_DIFFERS)
+            {
+               value = apply->settings[apply->next].value;
+               handle = _xbee_config_apply_send( apply,
+                  apply->settings[apply->next].command, &value);
+            }
+            else
+            {
+               continue;
+            }
+
+            if (handle == -ENOSPC || handle == -EBUSY)
+            {
+               // out of resources, pick up here on the next tick
+               break;
+            }
+            if (handle < 0)
+            {
+               result->status = XBEE_CONFIG_FAILED;
+               ++apply->failed;
+            }
+            else
+            {
+               result->handle = handle;
+            }
+         }
+
+         if (apply->next < apply->count || apply->outstanding)
+         {
+            break;
+         }
+
+         apply->next = 0;
+         if (apply->state == XBEE_CONFIG_STATE_QUERY
+            && apply->differs
+            && ! (apply->flags & XBEE_CONFIG_FLAG_VERIFY_ONLY))
+         {
+            apply->state = XBEE_CONFIG_STATE_WRITE;
+         }
+         else if (apply->state == XBEE_CONFIG_STATE_WRITE && apply->changed)
+         {
+            apply->state = XBEE_CONFIG_STATE_SAVE;
+         }
+         else
+         {
+            apply->state = XBEE_CONFIG_STATE_DONE;
+         }
+         break;
+
+      case XBEE_CONFIG_STATE_SAVE:
+         // .next tracks progress: 0 = send ATWR, 1 = send ATAC, 2 = waiting
+         if (apply->next == 0)
+         {
+            if (apply->flags & XBEE_CONFIG_FLAG_NO_SAVE)
+            {
+               apply->next = 1;
+            }
+            else
+            {
+               handle = _xbee_config_apply_send( apply, "WR", NULL);
+               if (handle >= 0)
+               {
+                  apply->flags |= XBEE_CONFIG_FLAG_SAVED;
+                  apply->next = 1;
+               }
+               else if (handle != -ENOSPC && handle != -EBUSY)
+               {
+                  apply->save_failed = TRUE;
+                  apply->next = 1;
+               }
+            }
+         }
+         if (apply->next == 1)
+         {
+            handle = _xbee_config_apply_send( apply, "AC", NULL);
+            if (handle >= 0)
+            {
+               apply->next = 2;
+            }
+            else if (handle != -ENOSPC && handle != -EBUSY)
+            {
+               apply->save_failed = TRUE;
+               apply->next = 2;
+            }
+         }
+         if (apply->next == 2 && apply->outstanding == 0)
+         {
+            apply->state = XBEE_CONFIG_STATE_DONE;
+         }
+         break;
+
+      default:
+         break;
+   }
+
+   if (apply->state == XBEE_CONFIG_STATE_DONE && apply->status == -EBUSY)
+   {
+      apply->status = (apply->failed || apply->save_failed) ? -EIO : 0;
+   }
+
+   return apply->status;
+}
+
+///@}
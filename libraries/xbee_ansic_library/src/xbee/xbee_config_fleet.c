@@ -0,0 +1,350 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_atcmd
+   @{
+   @file xbee_config_fleet.c
+   Configure many remote XBee modules concurrently.
+
+   Up to #XBEE_CONFIG_FLEET_PARALLEL nodes run the read-compare-write engine
+   from xbee_config_apply.c at the same time, each with every request in
+   flight at once, so configuring the whole fleet takes about as long as
+   configuring the slowest node.  Nodes that time out are retried, and
+   the per-setting results for each node make up a diff report.
+*/
+
+/*** BeginHeader */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/config_fleet.h"
+
+#ifndef __DC__
+   #define _xbee_config_fleet_debug
+#elif defined XBEE_CONFIG_FLEET_DEBUG
+   #define _xbee_config_fleet_debug  __debug
+#else
+   #define _xbee_config_fleet_debug  __nodebug
+#endif
+/*** EndHeader */
+
+/*** BeginHeader xbee_config_fleet_start */
+/*** EndHeader */
+/**
+   @brief
+   Start applying a profile of AT command settings to a list of remote
+   XBee modules.
+
+   After calling this function, optionally adjust the \c timeout,
+   \c parallel and \c retries fields of \a fleet, then call
+   xbee_config_fleet_tick() (along with xbee_dev_tick()) until it stops
+   returning -EBUSY.  The \a xbee device's frame handler table must include
+   #XBEE_FRAME_HANDLE_REMOTE_AT.
+
+   @param[out] fleet       state of the configuration; must remain valid
+                           until the process completes
+   @param[in]  xbee        local device to send Remote AT Commands through
+   @param[in]  settings    profile of registers and desired values
+   @param[in]  count       number of entries in \a settings
+   @param[in,out] nodes    nodes to configure, with \c ieee and \c results
+                           set by the caller
+   @param[in]  node_count  number of entries in \a nodes
+   @param[in]  flags       0 or a combination of
+                           #XBEE_CONFIG_FLAG_VERIFY_ONLY and
+                           #XBEE_CONFIG_FLAG_NO_SAVE
+
+   @retval  0        started
+   @retval  -EINVAL  invalid parameter
+   @retval  -ENOSYS  built with XBEE_CMD_DISABLE_REMOTE
+
+   @see  xbee_config_fleet_tick(), xbee_config_fleet_report()
+*/
+_xbee_config_fleet_debug
+int xbee_config_fleet_start( xbee_config_fleet_t *fleet, xbee_dev_t *xbee,
+   const xbee_config_setting_t FAR *settings, uint_fast8_t count,
+   xbee_config_node_t *nodes, uint_fast8_t node_count, uint16_t flags)
+{
+   uint_fast8_t i;
+
+#ifdef XBEE_CMD_DISABLE_REMOTE
+   return -ENOSYS;
+#endif
+
+   if (fleet == NULL || xbee == NULL || (count && settings == NULL)
+      || (node_count && nodes == NULL))
+   {
+      return -EINVAL;
+   }
+   for (i = 0; i < node_count; ++i)
+   {
+      if (count && nodes[i].results == NULL)
+      {
+         return -EINVAL;
+      }
+   }
+
+   memset( fleet, 0, sizeof *fleet);
+   fleet->xbee = xbee;
+   fleet->settings = settings;
+   fleet->nodes = nodes;
+   fleet->count = (uint8_t) count;
+   fleet->node_count = (uint8_t) node_count;
+   fleet->flags = flags;
+   fleet->timeout = XBEE_CONFIG_FLEET_TIMEOUT;
+   fleet->parallel = XBEE_CONFIG_FLEET_PARALLEL;
+   fleet->retries = XBEE_CONFIG_FLEET_RETRIES;
+   memset( fleet->slot_node, XBEE_CONFIG_FLEET_SLOT_IDLE,
+      sizeof fleet->slot_node);
+
+   for (i = 0; i < node_count; ++i)
+   {
+      nodes[i].status = -EBUSY;
+      nodes[i].attempts = nodes[i].changed = nodes[i].failed = 0;
+   }
+
+   fleet->status = -EBUSY;
+
+   return 0;
+}
+
+/*** BeginHeader xbee_config_fleet_tick */
+/*** EndHeader */
+
+/**   @internal
+   Start (or restart) the configuration of a node in one of the fleet's
+   slots.
+
+   @retval  0     started
+   @retval  <0    error from xbee_config_apply_start()
+*/
+_xbee_config_fleet_debug
+static int _xbee_config_fleet_start_node( xbee_config_fleet_t *fleet,
+   uint_fast8_t slot)
+{
+   xbee_config_node_t *node = &fleet->nodes[fleet->slot_node[slot]];
+   wpan_address_t address;
+   int error;
+
+   address.ieee = node->ieee;
+   address.network = WPAN_NET_ADDR_UNDEFINED;
+
+   ++node->attempts;
+   error = xbee_config_apply_start( &fleet->slot[slot], fleet->xbee,
+      fleet->settings, node->results, fleet->count, &address, fleet->flags);
+   if (! error)
+   {
+      fleet->slot[slot].timeout = fleet->timeout;
+   }
+
+   return error;
+}
+
+/**   @internal
+   Check whether a node that finished with errors should be tried again:
+   only failures caused by the node not responding (timeouts and transmit
+   failures) are worth retrying.
+*/
+_xbee_config_fleet_debug
+static bool_t _xbee_config_fleet_unreachable( const xbee_config_fleet_t *fleet,
+   const xbee_config_node_t *node)
+{
+   const xbee_config_result_t *result;
+   uint_fast8_t i;
+
+   for (i = 0, result = node->results; i < fleet->count; ++i, ++result)
+   {
+      if (result->status == XBEE_CONFIG_FAILED
+         && (result->at_status == XBEE_CONFIG_AT_STATUS_TIMEOUT
+            || XBEE_AT_RESP_STATUS( result->at_status)
+               == XBEE_AT_RESP_TX_FAIL))
+      {
+         return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+/**
+   @brief
+   Drive the fleet configuration started by xbee_config_fleet_start().
+
+   @param[in,out] fleet   state of the configuration
+
+   @retval  -EBUSY   still running
+   @retval  0        done; every node was configured
+   @retval  -EIO     done, but at least one node failed (see the \c status
+                     field of each node)
+   @retval  -EINVAL  \a fleet is NULL
+*/
+_xbee_config_fleet_debug
+int xbee_config_fleet_tick( xbee_config_fleet_t *fleet)
+{
+   xbee_config_apply_t *apply;
+   xbee_config_node_t *node;
+   uint_fast8_t slot, parallel;
+   int status;
+
+   if (fleet == NULL)
+   {
+      return -EINVAL;
+   }
+   if (fleet->status != -EBUSY)
+   {
+      return fleet->status;
+   }
+
+   parallel = fleet->parallel;
+   if (parallel == 0 || parallel > XBEE_CONFIG_FLEET_PARALLEL)
+   {
+      parallel = XBEE_CONFIG_FLEET_PARALLEL;
+   }
+
+   for (slot = 0, apply = fleet->slot; slot < XBEE_CONFIG_FLEET_PARALLEL;
+      ++slot, ++apply)
+   {
+      if (fleet->slot_node[slot] != XBEE_CONFIG_FLEET_SLOT_IDLE)
+      {
+         status = xbee_config_apply_tick( apply);
+         if (status == -EBUSY)
+         {
+            continue;
+         }
+
+         node = &fleet->nodes[fleet->slot_node[slot]];
+         node->changed = apply->changed;
+         node->failed = apply->failed;
+         if (status == 0)
+         {
+            node->status = 0;
+         }
+         else if (_xbee_config_fleet_unreachable( fleet, node))
+         {
+            node->status = -ETIMEDOUT;
+            if (node->attempts <= fleet->retries
+               && _xbee_config_fleet_start_node( fleet, slot) == 0)
+            {
+               #ifdef XBEE_CONFIG_FLEET_VERBOSE
+                  printf( "%s: retrying node %u (attempt %u)\n", __FUNCTION__,
+                     fleet->slot_node[slot], node->attempts);
+               #endif
+               node->status = -EBUSY;
+               continue;
+            }
+         }
+         else
+         {
+            node->status = -EIO;
+         }
+
+         #ifdef XBEE_CONFIG_FLEET_VERBOSE
+            printf( "%s: node %u finished (%d)\n", __FUNCTION__,
+               fleet->slot_node[slot], node->status);
+         #endif
+         if (node->status == 0)
+         {
+            ++fleet->succeeded;
+         }
+         else
+         {
+            ++fleet->failed;
+         }
+         fleet->slot_node[slot] = XBEE_CONFIG_FLEET_SLOT_IDLE;
+      }
+
+      // hand the idle slot to the next node, if allowed
+      while (slot < parallel && fleet->next_node < fleet->node_count
+         && fleet->slot_node[slot] == XBEE_CONFIG_FLEET_SLOT_IDLE)
+      {
+         fleet->slot_node[slot] = fleet->next_node++;
+         status = _xbee_config_fleet_start_node( fleet, slot);
+         if (status)
+         {
+            node = &fleet->nodes[fleet->slot_node[slot]];
+            node->status = status;
+            ++fleet->failed;
+            fleet->slot_node[slot] = XBEE_CONFIG_FLEET_SLOT_IDLE;
+         }
+      }
+   }
+
+   if (fleet->succeeded + fleet->failed == fleet->node_count)
+   {
+      fleet->status = fleet->failed ? -EIO : 0;
+   }
+
+   return fleet->status;
+}
+
+/*** BeginHeader xbee_config_fleet_report */
+/*** EndHeader */
+/**
+   @brief
+   Print a report of each node's result, listing the settings that
+   differed from the profile along with their previous values.
+
+   @param[in]  fleet   fleet configuration to report on
+*/
+_xbee_config_fleet_debug
+void xbee_config_fleet_report( const xbee_config_fleet_t *fleet)
+{
+   const xbee_config_node_t *node;
+   const xbee_config_result_t *result;
+   const xbee_config_setting_t FAR *setting;
+   uint_fast8_t i, n;
+   char buffer[ADDR64_STRING_LENGTH];
+
+   if (fleet == NULL)
+   {
+      return;
+   }
+
+   for (n = 0, node = fleet->nodes; n < fleet->node_count; ++n, ++node)
+   {
+      printf( "%s: ", addr64_format( buffer, &node->ieee));
+      switch (node->status)
+      {
+         case 0:
+            printf( "OK, %u of %u changed", node->changed, fleet->count);
+            break;
+         case -EBUSY:
+            printf( "in progress");
+            break;
+         case -ETIMEDOUT:
+            printf( "no response");
+            break;
+         default:
+            printf( "%u of %u failed", node->failed, fleet->count);
+            break;
+      }
+      printf( " (%u attempt%s)\n", node->attempts,
+         node->attempts == 1 ? "" : "s");
+
+      for (i = 0, result = node->results, setting = fleet->settings;
+         i < fleet->count; ++i, ++result, ++setting)
+      {
+         switch (result->status)
+         {
+            case XBEE_CONFIG_CHANGED:
+            case XBEE_CONFIG_DIFFERS:
+               printf( "  %" PRIsFAR ": 0x%" PRIX32 " -> 0x%" PRIX32 "%s\n",
+                  setting->command, result->previous, setting->value,
+                  result->status == XBEE_CONFIG_DIFFERS ? " (not written)"
+                                                        : "");
+               break;
+            case XBEE_CONFIG_FAILED:
+               printf( "  %" PRIsFAR ": failed (status 0x%02X)\n",
+                  setting->command, result->at_status);
+               break;
+         }
+      }
+   }
+}
+
+///@}
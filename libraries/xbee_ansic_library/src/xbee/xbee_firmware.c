@@ -351,7 +351,16 @@ int xbee_fw_install_ebl_tick( xbee_fw_source_t *source)
             xbee_xmodem_set_source( &source->u.xbxm, source->buffer,
                source->read, source->context);
             result = xbee_xmodem_tx_init( &source->u.xbxm,
-               XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_FORCE_CRC);
+               XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_FORCE_CRC
+#ifdef XBEE_FW_XMODEM_1K
+               | XBEE_XMODEM_FLAG_AUTO_1K
+#endif
+               );
+            if (result == 0)
+            {
+               // read the next block while waiting for each ACK
+               xbee_xmodem_set_prefetch( &source->u.xbxm, source->next_buffer);
+            }
             source->state =
                result ? XBEE_FW_STATE_FAILURE : XBEE_FW_STATE_XMODEM_SEND;
             return result;
@@ -0,0 +1,571 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @file xbee_gpm_ota.c
+   Stage a firmware image in the GPM of many remote nodes concurrently.
+
+   Each node gets a platform info request (for its block size), an erase of
+   its whole GPM, then the image as a stream of GPM writes with up to
+   #XBEE_GPM_OTA_WINDOW of them in flight.  A response to a write frees its
+   slot and immediately sends the next piece of the image, so the radio
+   doesn't sit idle waiting for round trips.  Pieces that are all 0xFF are
+   left to the erase.  Once every write is acknowledged the node verifies
+   the image, and installs it if #XBEE_GPM_OTA_FLAG_INSTALL is set.
+
+   Up to \c parallel nodes are updated at a time, all reading from the one
+   image in memory (for example, a mapped file).  Writes that time out or
+   come back with an error are each resent up to \c retries times.  A node
+   that stops responding is dropped with -ETIMEDOUT, and one that keeps
+   rejecting a write with -EIO, without holding up the others.
+*/
+
+/*** BeginHeader */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/byteorder.h"
+#include "xbee/gpm_ota.h"
+
+#ifndef __DC__
+   #define _xbee_gpm_ota_debug
+#elif defined XBEE_GPM_OTA_DEBUG
+   #define _xbee_gpm_ota_debug   __debug
+#else
+   #define _xbee_gpm_ota_debug   __nodebug
+#endif
+/*** EndHeader */
+
+/*** BeginHeader xbee_gpm_ota_start */
+/*** EndHeader */
+/**
+   @brief
+   Start staging a firmware image on a list of remote nodes.
+
+   After calling this function, optionally adjust the \c timeout,
+   \c chunk_size, \c parallel, \c window and \c retries fields of \a ota,
+   then call xbee_gpm_ota_tick() (along with wpan_tick()) until it stops
+   returning -EBUSY.  The WPAN_ENDPOINT_DIGI_DEVICE endpoint's cluster
+   table must include XBEE_GPM_OTA_CLUST_ENTRY( \a ota).
+
+   @param[out] ota         state of the update; must remain valid until the
+                           process completes
+   @param[in]  dev         local device to send GPM requests through
+   @param[in]  image       firmware image to send; must remain valid until
+                           the process completes
+   @param[in]  length      number of bytes in \a image
+   @param[in,out] nodes    nodes to update, with \c ieee set by the caller
+   @param[in]  node_count  number of entries in \a nodes
+   @param[in]  flags       0 or #XBEE_GPM_OTA_FLAG_INSTALL
+
+   @retval  0        started
+   @retval  -EINVAL  invalid parameter
+
+   @see  xbee_gpm_ota_tick(), xbee_gpm_ota_report()
+*/
+_xbee_gpm_ota_debug
+int xbee_gpm_ota_start( xbee_gpm_ota_t *ota, wpan_dev_t *dev,
+   const void FAR *image, uint32_t length,
+   xbee_gpm_ota_node_t *nodes, uint_fast8_t node_count, uint16_t flags)
+{
+   addr64 ieee;
+   uint_fast8_t i;
+
+   if (ota == NULL || dev == NULL || image == NULL || length == 0
+      || (node_count && nodes == NULL))
+   {
+      return -EINVAL;
+   }
+
+   memset( ota, 0, sizeof *ota);
+   ota->dev = dev;
+   ota->image = image;
+   ota->length = length;
+   ota->nodes = nodes;
+   ota->node_count = (uint8_t) node_count;
+   ota->flags = flags;
+   ota->timeout = XBEE_GPM_OTA_TIMEOUT;
+   ota->chunk_size = xbee_gpm_max_write( dev);
+   ota->parallel = XBEE_GPM_OTA_PARALLEL;
+   ota->window = XBEE_GPM_OTA_WINDOW;
+   ota->retries = XBEE_GPM_OTA_RETRIES;
+
+   for (i = 0; i < node_count; ++i)
+   {
+      ieee = nodes[i].ieee;
+      memset( &nodes[i], 0, sizeof nodes[i]);
+      nodes[i].ieee = ieee;
+      nodes[i].status = -EBUSY;
+   }
+
+   ota->status = node_count ? -EBUSY : 0;
+
+   return 0;
+}
+
+/*** BeginHeader xbee_gpm_ota_tick */
+/*** EndHeader */
+
+/**   @internal
+   Record the final status of a node.  A node that failed keeps the state
+   it failed in, for xbee_gpm_ota_report().
+*/
+_xbee_gpm_ota_debug
+static void _xbee_gpm_ota_finish( xbee_gpm_ota_t *ota,
+   xbee_gpm_ota_node_t *node, int status)
+{
+   #ifdef XBEE_GPM_OTA_VERBOSE
+      printf( "%s: node %u finished in state %u (%d)\n", __FUNCTION__,
+         (unsigned) (node - ota->nodes), node->state, status);
+   #endif
+
+   node->status = status;
+   --ota->active;
+   if (status == 0)
+   {
+      node->state = XBEE_GPM_OTA_STATE_DONE;
+      ++ota->succeeded;
+   }
+   else
+   {
+      ++ota->failed;
+   }
+}
+
+/**   @internal
+   Move a node to a state that sends a single command and waits for its
+   response.  The command goes out on the next tick.
+*/
+_xbee_gpm_ota_debug
+static void _xbee_gpm_ota_set_state( xbee_gpm_ota_node_t *node, uint8_t state)
+{
+   node->state = state;
+   node->tries = 0;
+}
+
+/**   @internal
+   Send (or resend) the command for a node's current state, if it hasn't
+   gone out yet or its response is overdue.
+*/
+_xbee_gpm_ota_debug
+static void _xbee_gpm_ota_command( xbee_gpm_ota_t *ota,
+   xbee_gpm_ota_node_t *node)
+{
+   wpan_envelope_t envelope;
+   uint32_t now = xbee_millisecond_timer();
+   uint32_t timeout;
+   int error;
+
+   timeout = (node->state == XBEE_GPM_OTA_STATE_ERASE)
+      ? XBEE_GPM_OTA_ERASE_TIMEOUT : ota->timeout;
+   if (node->tries && now - node->sent < timeout)
+   {
+      return;
+   }
+   if (node->tries > ota->retries)
+   {
+      _xbee_gpm_ota_finish( ota, node, -ETIMEDOUT);
+      return;
+   }
+
+   xbee_gpm_envelope_create( &envelope, ota->dev, &node->ieee);
+   switch (node->state)
+   {
+      case XBEE_GPM_OTA_STATE_INFO:
+         error = xbee_gpm_get_flash_info( &envelope);
+         break;
+      case XBEE_GPM_OTA_STATE_ERASE:
+         error = xbee_gpm_erase_flash( &envelope);
+         break;
+      case XBEE_GPM_OTA_STATE_VERIFY:
+         error = xbee_gpm_firmware_verify( &envelope);
+         break;
+      default:
+         error = xbee_gpm_firmware_install( &envelope);
+         break;
+   }
+
+   if (error == -EBUSY)
+   {
+      return;              // serial port is busy; try again next tick
+   }
+   ++node->tries;
+   node->sent = now;
+}
+
+/**   @internal
+   Fill a node's free write slots with the next pieces of the image, and
+   send any writes that are new, were rejected or have timed out.  Pieces
+   never cross a GPM block boundary.
+*/
+_xbee_gpm_ota_debug
+static void _xbee_gpm_ota_write( xbee_gpm_ota_t *ota,
+   xbee_gpm_ota_node_t *node)
+{
+   wpan_envelope_t envelope;
+   xbee_gpm_ota_write_t *w;
+   uint32_t now = xbee_millisecond_timer();
+   uint32_t offset;
+   uint16_t length;
+   uint_fast8_t i, window, in_flight = 0;
+   int error;
+
+   window = ota->window;
+   if (window == 0 || window > XBEE_GPM_OTA_WINDOW)
+   {
+      window = XBEE_GPM_OTA_WINDOW;
+   }
+
+   xbee_gpm_envelope_create( &envelope, ota->dev, &node->ieee);
+
+   for (i = 0, w = node->window; i < window; ++i, ++w)
+   {
+      // find the next piece of the image that isn't left to the erase
+      while (w->length == 0 && node->next_offset < ota->length)
+      {
+         offset = node->next_offset;
+         length = node->block_size - (uint16_t) (offset % node->block_size);
+         if (length > ota->chunk_size)
+         {
+            length = ota->chunk_size;
+         }
+         if (length > ota->length - offset)
+         {
+            length = (uint16_t) (ota->length - offset);
+         }
+         node->next_offset += length;
+
+         if (memcheck( &ota->image[offset], 0xFF, length) == 0)
+         {
+            node->written += length;
+         }
+         else
+         {
+            w->offset = offset;
+            w->length = length;
+            w->tries = w->rejects = 0;
+            w->pending = TRUE;
+         }
+      }
+
+      if (w->length == 0)
+      {
+         continue;
+      }
+      ++in_flight;
+      if (! w->pending && now - w->sent < ota->timeout)
+      {
+         continue;
+      }
+      // rejections and lost responses have separate limits
+      if (w->rejects > ota->retries)
+      {
+         _xbee_gpm_ota_finish( ota, node, -EIO);
+         return;
+      }
+      if (w->tries - w->rejects > ota->retries)
+      {
+         _xbee_gpm_ota_finish( ota, node, -ETIMEDOUT);
+         return;
+      }
+
+      error = xbee_gpm_write( &envelope,
+         (uint16_t) (w->offset / node->block_size),
+         (uint16_t) (w->offset % node->block_size), w->length,
+         &ota->image[w->offset]);
+      if (error == -EBUSY)
+      {
+         return;           // serial port is busy; try again next tick
+      }
+      else if (error)
+      {
+         _xbee_gpm_ota_finish( ota, node, error);
+         return;
+      }
+      if (w->tries++)
+      {
+         ++node->resends;
+      }
+      w->sent = now;
+      w->pending = FALSE;
+   }
+
+   if (in_flight == 0)
+   {
+      _xbee_gpm_ota_set_state( node, XBEE_GPM_OTA_STATE_VERIFY);
+   }
+}
+
+/**
+   @brief
+   Drive the update started by xbee_gpm_ota_start().
+
+   @param[in,out] ota   state of the update
+
+   @retval  -EBUSY   still running
+   @retval  0        done; every node took the image
+   @retval  -EIO     done, but at least one node failed (see the \c status
+                     field of each node)
+   @retval  -EINVAL  \a ota is NULL
+*/
+_xbee_gpm_ota_debug
+int xbee_gpm_ota_tick( xbee_gpm_ota_t *ota)
+{
+   xbee_gpm_ota_node_t *node;
+   uint_fast8_t i, parallel;
+
+   if (ota == NULL)
+   {
+      return -EINVAL;
+   }
+   if (ota->status != -EBUSY)
+   {
+      return ota->status;
+   }
+
+   parallel = ota->parallel ? ota->parallel : 1;
+   while (ota->active < parallel && ota->next_node < ota->node_count)
+   {
+      node = &ota->nodes[ota->next_node++];
+      _xbee_gpm_ota_set_state( node, XBEE_GPM_OTA_STATE_INFO);
+      ++ota->active;
+   }
+
+   for (i = 0, node = ota->nodes; i < ota->next_node; ++i, ++node)
+   {
+      if (node->status != -EBUSY)
+      {
+         continue;
+      }
+      switch (node->state)
+      {
+         case XBEE_GPM_OTA_STATE_INFO:
+         case XBEE_GPM_OTA_STATE_ERASE:
+         case XBEE_GPM_OTA_STATE_VERIFY:
+         case XBEE_GPM_OTA_STATE_INSTALL:
+            _xbee_gpm_ota_command( ota, node);
+            break;
+
+         case XBEE_GPM_OTA_STATE_WRITE:
+            _xbee_gpm_ota_write( ota, node);
+            break;
+      }
+   }
+
+   if (ota->succeeded + ota->failed == ota->node_count)
+   {
+      ota->status = ota->failed ? -EIO : 0;
+   }
+
+   return ota->status;
+}
+
+/*** BeginHeader xbee_gpm_ota_response */
+/*** EndHeader */
+/**
+   @brief
+   Cluster handler for GPM responses to an update started by
+   xbee_gpm_ota_start().  Use XBEE_GPM_OTA_CLUST_ENTRY() to add it to the
+   cluster table of the WPAN_ENDPOINT_DIGI_DEVICE endpoint.
+
+   @param[in]  envelope    GPM response
+   @param[in]  context     the xbee_gpm_ota_t
+
+   @retval  0        response processed, or not from a node being updated
+   @retval  -EINVAL  invalid parameter
+*/
+_xbee_gpm_ota_debug
+int xbee_gpm_ota_response( const wpan_envelope_t FAR *envelope,
+   void FAR *context)
+{
+   xbee_gpm_ota_t *ota = context;
+   const xbee_gpm_frame_t FAR *frame;
+   xbee_gpm_ota_node_t *node;
+   xbee_gpm_ota_write_t *w;
+   uint32_t offset;
+   uint16_t blocks;
+   bool_t error;
+   uint_fast8_t i;
+
+   if (envelope == NULL || ota == NULL)
+   {
+      return -EINVAL;
+   }
+   if (envelope->length < sizeof frame->header.response)
+   {
+      return 0;
+   }
+
+   for (i = 0, node = ota->nodes; i < ota->next_node; ++i, ++node)
+   {
+      if (node->status == -EBUSY
+         && addr64_equal( &envelope->ieee_address, &node->ieee))
+      {
+         break;
+      }
+   }
+   if (i == ota->next_node)
+   {
+      return 0;            // not a node being updated
+   }
+
+   frame = envelope->payload;
+   error = (frame->header.response.status & XBEE_GPM_STATUS_ERROR_FLAG) != 0;
+
+   switch (frame->header.response.cmd_id)
+   {
+      case XBEE_GPM_CMD_PLATFORM_INFO_RESP:
+         if (node->state != XBEE_GPM_OTA_STATE_INFO)
+         {
+            break;
+         }
+         blocks = be16toh( frame->header.response.block_num_be);
+         node->block_size = be16toh( frame->header.response.start_index_be);
+         if (error)
+         {
+            _xbee_gpm_ota_finish( ota, node, -EIO);
+         }
+         else if (node->block_size == 0
+            || (uint32_t) blocks * node->block_size < ota->length)
+         {
+            _xbee_gpm_ota_finish( ota, node, -ENOSPC);
+         }
+         else
+         {
+            _xbee_gpm_ota_set_state( node, XBEE_GPM_OTA_STATE_ERASE);
+         }
+         break;
+
+      case XBEE_GPM_CMD_ERASE_RESP:
+         if (node->state != XBEE_GPM_OTA_STATE_ERASE)
+         {
+            break;
+         }
+         if (error)
+         {
+            _xbee_gpm_ota_finish( ota, node, -EIO);
+         }
+         else
+         {
+            node->state = XBEE_GPM_OTA_STATE_WRITE;
+            node->next_offset = node->written = 0;
+            _xbee_gpm_ota_write( ota, node);
+         }
+         break;
+
+      case XBEE_GPM_CMD_WRITE_RESP:
+         if (node->state != XBEE_GPM_OTA_STATE_WRITE)
+         {
+            break;
+         }
+         offset = (uint32_t) be16toh( frame->header.response.block_num_be)
+            * node->block_size
+            + be16toh( frame->header.response.start_index_be);
+         for (i = 0, w = node->window; i < XBEE_GPM_OTA_WINDOW; ++i, ++w)
+         {
+            if (w->length && ! w->pending && w->offset == offset)
+            {
+               if (error)
+               {
+                  ++w->rejects;
+                  w->pending = TRUE;
+               }
+               else
+               {
+                  node->written += w->length;
+                  w->length = 0;
+               }
+               // keep the window full
+               _xbee_gpm_ota_write( ota, node);
+               break;
+            }
+         }
+         break;
+
+      case XBEE_GPM_CMD_FIRMWARE_VERIFY_RESP:
+         if (node->state != XBEE_GPM_OTA_STATE_VERIFY)
+         {
+            break;
+         }
+         if (error)
+         {
+            _xbee_gpm_ota_finish( ota, node, -EIO);
+         }
+         else if (ota->flags & XBEE_GPM_OTA_FLAG_INSTALL)
+         {
+            _xbee_gpm_ota_set_state( node, XBEE_GPM_OTA_STATE_INSTALL);
+         }
+         else
+         {
+            _xbee_gpm_ota_finish( ota, node, 0);
+         }
+         break;
+
+      case XBEE_GPM_CMD_FIRMWARE_INSTALL_RESP:
+         if (node->state == XBEE_GPM_OTA_STATE_INSTALL)
+         {
+            _xbee_gpm_ota_finish( ota, node, error ? -EIO : 0);
+         }
+         break;
+   }
+
+   return 0;
+}
+
+/*** BeginHeader xbee_gpm_ota_report */
+/*** EndHeader */
+/**
+   @brief
+   Print each node's progress or result.
+
+   @param[in]  ota   update to report on
+*/
+_xbee_gpm_ota_debug
+void xbee_gpm_ota_report( const xbee_gpm_ota_t *ota)
+{
+   static const char *state_name[] = {
+      "waiting", "platform info", "erasing", "writing", "verifying",
+      "installing", "done"
+   };
+   const xbee_gpm_ota_node_t *node;
+   uint_fast8_t n;
+   char buffer[ADDR64_STRING_LENGTH];
+
+   if (ota == NULL)
+   {
+      return;
+   }
+
+   for (n = 0, node = ota->nodes; n < ota->node_count; ++n, ++node)
+   {
+      printf( "%s: %3u%% ", addr64_format( buffer, &node->ieee),
+         (unsigned) (node->written * 100 / ota->length));
+      switch (node->status)
+      {
+         case 0:
+            printf( "OK");
+            break;
+         case -EBUSY:
+            printf( "%s", state_name[node->state]);
+            break;
+         case -ETIMEDOUT:
+            printf( "no response while %s", state_name[node->state]);
+            break;
+         case -ENOSPC:
+            printf( "image too large for GPM");
+            break;
+         case -EIO:
+            printf( "error while %s", state_name[node->state]);
+            break;
+         default:
+            printf( "failed (%d)", node->status);
+            break;
+      }
+      printf( " (%u resent)\n", node->resends);
+   }
+}
@@ -0,0 +1,369 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup xbee_wpan
+   @{
+   @file xbee_link_adapt.c
+   AIMD controller for send rate, payload size and broadcast/unicast mode.
+   See xbee/link_adapt.h for an overview.
+*/
+
+/*** BeginHeader */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/link_adapt.h"
+#include "xbee/atcmd.h"
+
+#ifndef __DC__
+   #define _xbee_link_adapt_debug
+#elif defined XBEE_LINK_ADAPT_DEBUG
+   #define _xbee_link_adapt_debug  __debug
+#else
+   #define _xbee_link_adapt_debug  __nodebug
+#endif
+/*** EndHeader */
+
+/*** BeginHeader _xbee_link_adapt_payload_max */
+uint16_t _xbee_link_adapt_payload_max( const xbee_link_adapt_t *adapt);
+/*** EndHeader */
+/**
+   @internal
+   Largest payload the device can send, from \c ATNP if it has been read.
+*/
+_xbee_link_adapt_debug
+uint16_t _xbee_link_adapt_payload_max( const xbee_link_adapt_t *adapt)
+{
+   uint16_t np = adapt->xbee->wpan_dev.payload;
+
+   return np >= XBEE_LINK_ADAPT_PAYLOAD_MIN ? np : XBEE_LINK_ADAPT_PAYLOAD_MAX;
+}
+
+/*** BeginHeader xbee_link_adapt_init */
+/*** EndHeader */
+/**
+   @brief
+   Initialize a link controller for a device.
+
+   The controller starts at #XBEE_LINK_ADAPT_RATE_START sends per second and
+   the largest payload the device supports, in unicast mode.
+
+   @param[out] adapt   controller to initialize
+   @param[in]  xbee    device whose sends the controller paces
+
+   @retval  0        success
+   @retval  -EINVAL  NULL parameter
+*/
+_xbee_link_adapt_debug
+int xbee_link_adapt_init( xbee_link_adapt_t *adapt, xbee_dev_t *xbee)
+{
+   if (adapt == NULL || xbee == NULL)
+   {
+      return -EINVAL;
+   }
+
+   memset( adapt, 0, sizeof *adapt);
+   adapt->xbee = xbee;
+   adapt->rate = XBEE_LINK_ADAPT_RATE_START;
+   adapt->payload_max = _xbee_link_adapt_payload_max( adapt);
+   adapt->payload = adapt->payload_max;
+   adapt->db_handle = -1;
+   adapt->last_send_ms = adapt->last_db_ms = xbee_millisecond_timer();
+
+   return 0;
+}
+
+/*** BeginHeader _xbee_link_adapt_shrink_payload */
+void _xbee_link_adapt_shrink_payload( xbee_link_adapt_t *adapt);
+/*** EndHeader */
+/// @internal Halve the payload, down to #XBEE_LINK_ADAPT_PAYLOAD_MIN.
+_xbee_link_adapt_debug
+void _xbee_link_adapt_shrink_payload( xbee_link_adapt_t *adapt)
+{
+   adapt->payload /= 2;
+   if (adapt->payload < XBEE_LINK_ADAPT_PAYLOAD_MIN)
+   {
+      adapt->payload = XBEE_LINK_ADAPT_PAYLOAD_MIN;
+   }
+}
+
+/*** BeginHeader xbee_link_adapt_tx_status */
+/*** EndHeader */
+/**
+   @brief
+   Feed the result of one transmission to the controller.  Called by
+   xbee_link_adapt_handle_transmit_status(); use it directly to account for
+   results from another source.
+
+   @param[in,out] adapt     controller to update
+   @param[in]     delivery  delivery status (XBEE_TX_DELIVERY_*)
+   @param[in]     retries   retries the module needed
+*/
+_xbee_link_adapt_debug
+void xbee_link_adapt_tx_status( xbee_link_adapt_t *adapt, uint8_t delivery,
+   uint8_t retries)
+{
+   if (adapt == NULL)
+   {
+      return;
+   }
+
+   // moving averages, each frame has 1/8 weight
+   adapt->loss_permille -= adapt->loss_permille / 8;
+   adapt->retries_x16 -= adapt->retries_x16 / 8;
+   adapt->retries_x16 += retries * 16 / 8;
+
+   if (delivery == XBEE_TX_DELIVERY_SUCCESS)
+   {
+      ++adapt->delivered;
+      adapt->consecutive_failures = 0;
+
+      // hold steady while the module needs 2+ retries per frame
+      if (adapt->retries_x16 >= 2 * 16)
+      {
+         adapt->clean = 0;
+      }
+      else if (++adapt->clean >= XBEE_LINK_ADAPT_INCREASE_AFTER)
+      {
+         adapt->clean = 0;
+         ++adapt->increases;
+         adapt->rate += XBEE_LINK_ADAPT_RATE_STEP;
+         if (adapt->rate > XBEE_LINK_ADAPT_RATE_MAX)
+         {
+            adapt->rate = XBEE_LINK_ADAPT_RATE_MAX;
+         }
+         if (adapt->rssi < XBEE_LINK_ADAPT_WEAK_RSSI)
+         {
+            adapt->payload += XBEE_LINK_ADAPT_PAYLOAD_STEP;
+            if (adapt->payload > adapt->payload_max)
+            {
+               adapt->payload = adapt->payload_max;
+            }
+         }
+      }
+      return;
+   }
+
+   ++adapt->failed;
+   ++adapt->decreases;
+   adapt->loss_permille += 1000 / 8;
+   adapt->clean = 0;
+   adapt->rate /= 2;
+   if (adapt->rate < XBEE_LINK_ADAPT_RATE_MIN)
+   {
+      adapt->rate = XBEE_LINK_ADAPT_RATE_MIN;
+   }
+   _xbee_link_adapt_shrink_payload( adapt);
+
+   if (! adapt->broadcast
+      && ++adapt->consecutive_failures >= XBEE_LINK_ADAPT_BROADCAST_AFTER)
+   {
+      #ifdef XBEE_LINK_ADAPT_VERBOSE
+         printf( "%s: %u failures, switching to broadcast\n", __FUNCTION__,
+            adapt->consecutive_failures);
+      #endif
+      adapt->broadcast = TRUE;
+      adapt->broadcast_ms = xbee_millisecond_timer();
+   }
+}
+
+/*** BeginHeader xbee_link_adapt_handle_transmit_status */
+/*** EndHeader */
+// documented in xbee/link_adapt.h
+_xbee_link_adapt_debug
+int xbee_link_adapt_handle_transmit_status( xbee_dev_t *xbee,
+   const void FAR *payload, uint16_t length, void FAR *context)
+{
+   const xbee_frame_transmit_status_t FAR *frame = payload;
+   xbee_link_adapt_t *adapt = context;
+
+   if (adapt == NULL || frame == NULL || length < sizeof *frame)
+   {
+      return -EINVAL;
+   }
+   if (adapt->xbee == xbee)
+   {
+      xbee_link_adapt_tx_status( adapt, frame->delivery, frame->retries);
+   }
+
+   return 0;
+}
+
+/*** BeginHeader xbee_link_adapt_rssi */
+/*** EndHeader */
+/**
+   @brief
+   Feed a received signal strength reading to the controller.  Called with
+   each \c ATDB response requested by xbee_link_adapt_tick().
+
+   A weak signal halves the payload so each frame spends less time on the
+   air, and stops the payload from growing until the signal recovers.
+
+   @param[in,out] adapt  controller to update
+   @param[in]     rssi   signal strength in -dBm (\c ATDB value)
+*/
+_xbee_link_adapt_debug
+void xbee_link_adapt_rssi( xbee_link_adapt_t *adapt, uint8_t rssi)
+{
+   if (adapt == NULL)
+   {
+      return;
+   }
+
+   adapt->rssi = rssi;
+   if (rssi >= XBEE_LINK_ADAPT_WEAK_RSSI)
+   {
+      _xbee_link_adapt_shrink_payload( adapt);
+   }
+}
+
+/*** BeginHeader _xbee_link_adapt_db_response */
+int _xbee_link_adapt_db_response( const xbee_cmd_response_t FAR *response);
+/*** EndHeader */
+/// @internal Callback for the \c ATDB request sent by xbee_link_adapt_tick().
+_xbee_link_adapt_debug
+int _xbee_link_adapt_db_response( const xbee_cmd_response_t FAR *response)
+{
+   xbee_link_adapt_t *adapt = response->context;
+
+   // DB is zero (or an error) until something has been received
+   if (! (response->flags & (XBEE_CMD_RESP_FLAG_TIMEOUT
+                             | XBEE_CMD_RESP_MASK_STATUS))
+      && response->value != 0)
+   {
+      xbee_link_adapt_rssi( adapt, (uint8_t) response->value);
+   }
+   adapt->db_handle = -1;
+
+   return XBEE_ATCMD_DONE;
+}
+
+/*** BeginHeader xbee_link_adapt_tick */
+/*** EndHeader */
+/**
+   @brief
+   Query signal strength every #XBEE_LINK_ADAPT_DB_MS and pick up the
+   device's maximum payload once \c ATNP has been read.  Call along with
+   xbee_dev_tick().
+
+   @param[in,out] adapt  controller to service
+
+   @retval  0        success
+   @retval  -EINVAL  \a adapt is NULL
+*/
+_xbee_link_adapt_debug
+int xbee_link_adapt_tick( xbee_link_adapt_t *adapt)
+{
+   uint32_t now;
+   int16_t handle;
+
+   if (adapt == NULL)
+   {
+      return -EINVAL;
+   }
+
+   adapt->payload_max = _xbee_link_adapt_payload_max( adapt);
+   if (adapt->payload > adapt->payload_max)
+   {
+      adapt->payload = adapt->payload_max;
+   }
+
+   now = xbee_millisecond_timer();
+   if (adapt->db_handle < 0
+      && (int32_t)(now - adapt->last_db_ms) >= XBEE_LINK_ADAPT_DB_MS)
+   {
+      adapt->last_db_ms = now;
+      handle = xbee_cmd_create( adapt->xbee, "DB");
+      if (handle >= 0)
+      {
+         xbee_cmd_set_callback( handle, _xbee_link_adapt_db_response, adapt);
+         if (xbee_cmd_send( handle) == 0)
+         {
+            adapt->db_handle = handle;
+         }
+         else
+         {
+            xbee_cmd_release_handle( handle);
+         }
+      }
+   }
+
+   return 0;
+}
+
+/*** BeginHeader xbee_link_adapt_due */
+/*** EndHeader */
+/**
+   @brief
+   Check whether it's time for the next send at the current rate.
+
+   A return value greater than zero claims the send slot: the caller should
+   send up to that many bytes now, as a broadcast if \c adapt->broadcast
+   is set.
+
+   @param[in,out] adapt  controller to check
+
+   @retval  >0       payload size for the send due now
+   @retval  0        not time to send yet
+   @retval  -EINVAL  \a adapt is NULL
+*/
+_xbee_link_adapt_debug
+int xbee_link_adapt_due( xbee_link_adapt_t *adapt)
+{
+   uint32_t now;
+
+   if (adapt == NULL)
+   {
+      return -EINVAL;
+   }
+
+   now = xbee_millisecond_timer();
+   if ((int32_t)(now - adapt->last_send_ms) < 1000 / adapt->rate)
+   {
+      return 0;
+   }
+   adapt->last_send_ms = now;
+
+   if (adapt->broadcast
+      && (int32_t)(now - adapt->broadcast_ms) >= XBEE_LINK_ADAPT_PROBE_MS)
+   {
+      // probe unicast; one more failure switches straight back
+      adapt->broadcast = FALSE;
+      adapt->consecutive_failures = XBEE_LINK_ADAPT_BROADCAST_AFTER - 1;
+   }
+
+   return adapt->payload;
+}
+
+/*** BeginHeader xbee_link_adapt_dump */
+/*** EndHeader */
+/**
+   @brief
+   Print the controller's state to STDOUT, for monitoring.
+
+   @param[in] adapt  controller to dump
+*/
+_xbee_link_adapt_debug
+void xbee_link_adapt_dump( const xbee_link_adapt_t *adapt)
+{
+   if (adapt == NULL)
+   {
+      return;
+   }
+
+   printf( "rate %u/s, payload %u/%u, %s; DB -%u dBm, loss %u.%u%%, "
+      "retries %u.%02u; delivered %" PRIu32 ", failed %" PRIu32 "\n",
+      adapt->rate, adapt->payload, adapt->payload_max,
+      adapt->broadcast ? "broadcast" : "unicast", adapt->rssi,
+      adapt->loss_permille / 10, adapt->loss_permille % 10,
+      adapt->retries_x16 / 16, adapt->retries_x16 % 16 * 100 / 16,
+      adapt->delivered, adapt->failed);
+}
+
+///@}
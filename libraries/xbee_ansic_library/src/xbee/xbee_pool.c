@@ -0,0 +1,337 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+   @addtogroup util_pool
+   @{
+   @file xbee_pool.c
+   Fixed-size block allocator.  See xbee/pool.h for an overview.
+
+   Each free block starts with a pointer to the next free block, so the
+   pool needs no memory beyond the blocks themselves.
+*/
+
+/*** BeginHeader */
+#include <errno.h>
+#include <string.h>
+
+#include "xbee/pool.h"
+
+#ifndef __DC__
+   #define _xbee_pool_debug
+#elif defined XBEE_POOL_DEBUG
+   #define _xbee_pool_debug   __debug
+#else
+   #define _xbee_pool_debug   __nodebug
+#endif
+/*** EndHeader */
+
+/*** BeginHeader xbee_pool_init */
+/*** EndHeader */
+/**
+   @brief
+   Divide \a storage into blocks of \a block_size bytes and mark them free.
+
+   @param[out] pool          pool to initialize
+   @param[in]  storage       memory for the blocks, aligned for a pointer
+                             (use XBEE_POOL_STORAGE() to declare it)
+   @param[in]  size          bytes in \a storage
+   @param[in]  block_size    bytes needed in each block; rounded up to
+                             XBEE_POOL_BLOCK_SIZE()
+
+   @retval  >0       number of blocks in the pool
+   @retval  -EINVAL  invalid parameter, \a block_size rounds up past 65535,
+                     or \a storage too small for one block
+*/
+_xbee_pool_debug
+int xbee_pool_init( xbee_pool_t *pool, void FAR *storage, size_t size,
+   uint16_t block_size)
+{
+   uint8_t FAR *block;
+   size_t count, rounded;
+
+   if (pool == NULL || storage == NULL || block_size == 0)
+   {
+      return -EINVAL;
+   }
+   // sizes just under 64KB round up past what pool->block_size holds
+   rounded = XBEE_POOL_BLOCK_SIZE( (size_t) block_size);
+   if (rounded > 0xFFFF)
+   {
+      return -EINVAL;
+   }
+
+   memset( pool, 0, sizeof *pool);
+   pool->block_size = (uint16_t) rounded;
+   count = size / pool->block_size;
+   if (count == 0)
+   {
+      return -EINVAL;
+   }
+   if (count > 0xFFFF)
+   {
+      count = 0xFFFF;
+   }
+   pool->blocks = (uint16_t) count;
+   pool->start = storage;
+   pool->end = pool->start + count * pool->block_size;
+
+   // chain the blocks in address order
+   for (block = pool->start; block < pool->end; block += pool->block_size)
+   {
+      *(void FAR **) block = block + pool->block_size < pool->end
+         ? block + pool->block_size : NULL;
+   }
+   pool->free_list = pool->start;
+
+   return pool->blocks;
+}
+
+/*** BeginHeader _xbee_pool_take */
+uint_fast8_t _xbee_pool_take( xbee_pool_t *pool, void FAR **block,
+   uint_fast8_t count);
+/*** EndHeader */
+/**
+   @internal
+   Move up to \a count blocks from the pool to \a block[] with one lock.
+
+   @return  number of blocks moved
+*/
+_xbee_pool_debug
+uint_fast8_t _xbee_pool_take( xbee_pool_t *pool, void FAR **block,
+   uint_fast8_t count)
+{
+   uint_fast8_t taken;
+
+   XBEE_POOL_LOCK( pool);
+   for (taken = 0; taken < count && pool->free_list != NULL; ++taken)
+   {
+      block[taken] = pool->free_list;
+      pool->free_list = *(void FAR **) pool->free_list;
+   }
+   pool->in_use += taken;
+   if (pool->in_use > pool->high_water)
+   {
+      pool->high_water = pool->in_use;
+   }
+   if (taken == 0)
+   {
+      ++pool->failures;
+   }
+   XBEE_POOL_UNLOCK( pool);
+
+   return taken;
+}
+
+/*** BeginHeader _xbee_pool_give */
+void _xbee_pool_give( xbee_pool_t *pool, void FAR * const *block,
+   uint_fast8_t count);
+/*** EndHeader */
+/**
+   @internal
+   Return \a count blocks from \a block[] to the pool with one lock.
+*/
+_xbee_pool_debug
+void _xbee_pool_give( xbee_pool_t *pool, void FAR * const *block,
+   uint_fast8_t count)
+{
+   uint_fast8_t i;
+
+   XBEE_POOL_LOCK( pool);
+   for (i = 0; i < count; ++i)
+   {
+      *(void FAR **) block[i] = pool->free_list;
+      pool->free_list = block[i];
+   }
+   pool->in_use -= count;
+   XBEE_POOL_UNLOCK( pool);
+}
+
+/*** BeginHeader xbee_pool_alloc */
+/*** EndHeader */
+/**
+   @brief
+   Allocate a block.  Its contents are undefined.
+
+   @param[in,out] pool    pool to allocate from
+
+   @return  block of at least the \a block_size passed to xbee_pool_init(),
+            or NULL if all blocks are in use
+*/
+_xbee_pool_debug
+void FAR *xbee_pool_alloc( xbee_pool_t *pool)
+{
+   void FAR *block;
+
+   return _xbee_pool_take( pool, &block, 1) ? block : NULL;
+}
+
+/*** BeginHeader xbee_pool_contains */
+/*** EndHeader */
+/**
+   @brief
+   Check whether \a block is the start of a block from \a pool.
+
+   @param[in] pool     pool to check
+   @param[in] block    pointer to check
+
+   @retval  TRUE    \a block belongs to \a pool
+   @retval  FALSE   \a block is NULL, outside the pool, or not the start of
+                    a block
+*/
+_xbee_pool_debug
+bool_t xbee_pool_contains( const xbee_pool_t *pool, const void FAR *block)
+{
+   const uint8_t FAR *p = block;
+
+   return p >= pool->start && p < pool->end
+      && (size_t)(p - pool->start) % pool->block_size == 0;
+}
+
+/*** BeginHeader xbee_pool_free */
+/*** EndHeader */
+/**
+   @brief
+   Return a block to its pool.
+
+   @param[in,out] pool    pool that \a block came from
+   @param[in]     block   block from xbee_pool_alloc(), or NULL
+
+   @retval  0        block freed (or \a block was NULL)
+   @retval  -EINVAL  \a block didn't come from \a pool
+*/
+_xbee_pool_debug
+int xbee_pool_free( xbee_pool_t *pool, void FAR *block)
+{
+   if (block == NULL)
+   {
+      return 0;
+   }
+   if (! xbee_pool_contains( pool, block))
+   {
+      return -EINVAL;
+   }
+
+   _xbee_pool_give( pool, &block, 1);
+
+   return 0;
+}
+
+/*** BeginHeader xbee_pool_available */
+/*** EndHeader */
+/**
+   @brief
+   Number of blocks not allocated and not held by a cache.
+
+   @param[in] pool    pool to check
+*/
+_xbee_pool_debug
+uint16_t xbee_pool_available( const xbee_pool_t *pool)
+{
+   return pool->blocks - pool->in_use;
+}
+
+/*** BeginHeader xbee_pool_cache_init */
+/*** EndHeader */
+/**
+   @brief
+   Set up an empty cache of blocks from \a pool.
+
+   A cache isn't thread-safe; give each thread its own (for example, a
+   \c __thread variable).  Blocks can be freed to a different thread's
+   cache than the one that allocated them.
+
+   @param[out] cache   cache to initialize
+   @param[in]  pool    pool to take blocks from
+*/
+_xbee_pool_debug
+void xbee_pool_cache_init( xbee_pool_cache_t *cache, xbee_pool_t *pool)
+{
+   memset( cache, 0, sizeof *cache);
+   cache->pool = pool;
+}
+
+/*** BeginHeader xbee_pool_cache_alloc */
+/*** EndHeader */
+/**
+   @brief
+   Allocate a block through a cache.  Refills half the cache from the pool
+   when it's empty.
+
+   @param[in,out] cache   cache from xbee_pool_cache_init()
+
+   @return  block, or NULL if the pool is exhausted
+*/
+_xbee_pool_debug
+void FAR *xbee_pool_cache_alloc( xbee_pool_cache_t *cache)
+{
+   if (cache->count == 0)
+   {
+      cache->count = _xbee_pool_take( cache->pool, cache->block,
+         (XBEE_POOL_CACHE_SIZE + 1) / 2);
+      if (cache->count == 0)
+      {
+         return NULL;
+      }
+   }
+
+   return cache->block[--cache->count];
+}
+
+/*** BeginHeader xbee_pool_cache_free */
+/*** EndHeader */
+/**
+   @brief
+   Free a block through a cache.  Returns half the cache to the pool when
+   it's full.
+
+   @param[in,out] cache   cache from xbee_pool_cache_init()
+   @param[in]     block   block from the cache's pool, or NULL
+
+   @retval  0        block freed (or \a block was NULL)
+   @retval  -EINVAL  \a block didn't come from the cache's pool
+*/
+_xbee_pool_debug
+int xbee_pool_cache_free( xbee_pool_cache_t *cache, void FAR *block)
+{
+   uint_fast8_t half = XBEE_POOL_CACHE_SIZE / 2;
+
+   if (block == NULL)
+   {
+      return 0;
+   }
+   if (! xbee_pool_contains( cache->pool, block))
+   {
+      return -EINVAL;
+   }
+
+   if (cache->count == XBEE_POOL_CACHE_SIZE)
+   {
+      cache->count -= half;
+      _xbee_pool_give( cache->pool, &cache->block[cache->count], half);
+   }
+   cache->block[cache->count++] = block;
+
+   return 0;
+}
+
+/*** BeginHeader xbee_pool_cache_flush */
+/*** EndHeader */
+/**
+   @brief
+   Return all of a cache's blocks to its pool, for example when a thread
+   exits.
+
+   @param[in,out] cache   cache to empty
+*/
+_xbee_pool_debug
+void xbee_pool_cache_flush( xbee_pool_cache_t *cache)
+{
+   _xbee_pool_give( cache->pool, cache->block, cache->count);
+   cache->count = 0;
+}
+
+///@}
@@ -175,6 +175,10 @@ int _xbee_wpan_tick( wpan_dev_t *dev)
    @param[in,out] xbee        device to configure
    @param[in]     ep_table    pointer to an endpoint table to use with device
 
+   Also builds the lookup index used to dispatch received frames (see
+   wpan_aps_index_build()); if the table has too many clusters to index,
+   they're searched linearly instead.
+
    @retval  0        success
    @retval  -EINVAL  invalid parameter passed to function
 */
@@ -191,6 +195,7 @@ int xbee_wpan_init( xbee_dev_t *xbee,
    xbee->wpan_dev.tick = _xbee_wpan_tick;
    xbee->wpan_dev.endpoint_send = _xbee_endpoint_send;
    xbee->wpan_dev.endpoint_table = ep_table;
+   wpan_aps_index_build( &xbee->wpan_dev);
 
    return 0;
 }
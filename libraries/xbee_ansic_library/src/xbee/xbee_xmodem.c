@@ -16,6 +16,12 @@
    @file xbee_xmodem.c
    Xmodem send implementation, used for XBee firmware updates.
 
+   With a second buffer (xbee_xmodem_set_prefetch()), the next block is read
+   and checksummed while the current one is still being written or waiting
+   for its ACK, so the ACK is answered with a block that's ready to go.
+   XMODEM only allows one block in flight, so that's as far ahead as the
+   sender can get.
+
    @todo Have timeout values adjust based on link latency.  Start out with a
          high timeout (10 seconds?) and adjust down based on actual response
          time (maybe 150% of last ACK's delay?)  Timeout for EOT should start
@@ -38,6 +44,12 @@
    #define _xmodem_debug __nodebug
 #endif
 
+// values for next_status member of xbee_xmodem_state_t (or <0 for an error
+// reading the next block)
+#define _XMODEM_NEXT_EMPTY    0     // nothing in xbxm->next
+#define _XMODEM_NEXT_READY    1     // next packet assembled in xbxm->next
+#define _XMODEM_NEXT_EOF      2     // no more packets after this one
+
 /*** EndHeader */
 
 /*** BeginHeader _xbee_xmodem_ser_read, _xbee_xmodem_ser_write */
@@ -99,6 +111,23 @@ int xbee_xmodem_set_stream( xbee_xmodem_state_t *xbxm,
    return 0;
 }
 
+/*** BeginHeader xbee_xmodem_set_prefetch */
+/*** EndHeader */
+// documented in xbee/xmodem.h
+_xmodem_debug
+int xbee_xmodem_set_prefetch( xbee_xmodem_state_t *xbxm, void FAR *buffer)
+{
+   if (xbxm == NULL || buffer == NULL)
+   {
+      return -EINVAL;
+   }
+
+   xbxm->next = buffer;
+   xbxm->next_status = _XMODEM_NEXT_EMPTY;
+
+   return 0;
+}
+
 /*** BeginHeader xbee_xmodem_set_source */
 /*** EndHeader */
 // documented in xbee/xmodem.h
@@ -195,6 +224,10 @@ int xbee_xmodem_tx_init( xbee_xmodem_state_t *xbxm, uint16_t flags)
    xbxm->flags = flags & XBEE_XMODEM_FLAG_USER;
    xbxm->packet_num = 0;
    xbxm->state = XBEE_XMODEM_STATE_START;
+   xbxm->next = NULL;
+   xbxm->next_status = _XMODEM_NEXT_EMPTY;
+   xbxm->stash = 0;
+   xbxm->probe_len = 0;
 
    return 0;
 }
@@ -206,12 +239,46 @@ int xbee_xmodem_tx_init( xbee_xmodem_state_t *xbxm, uint16_t flags)
 #ifndef __DC__
    #include "xbee/xmodem_crc16.h"
 #endif
-// <0 for failure, 1 for file done, 0 for OK to send
+// Read block data: first any bytes left in xbxm->next from a 1K block the
+// receiver rejected, then the file.  Returns bytes read (0 at end of file)
+// or <0 for an error.
 _xmodem_debug
-int _assemble_packet( xbee_xmodem_state_t *xbxm, uint16_t block_size)
+int _xbee_xmodem_read( xbee_xmodem_state_t *xbxm, char FAR *dest,
+   uint16_t bytes)
+{
+   uint16_t from_stash = 0;
+   int err;
+
+   if (xbxm->stash)
+   {
+      from_stash = (bytes < xbxm->stash) ? bytes : xbxm->stash;
+      _f_memcpy( dest, &xbxm->next[xbxm->stash_offset], from_stash);
+      xbxm->stash -= from_stash;
+      xbxm->stash_offset += from_stash;
+      if (from_stash == bytes)
+      {
+         return bytes;
+      }
+      dest += from_stash;
+      bytes -= from_stash;
+   }
+
+   err = xbxm->file.read( xbxm->file.context, dest, bytes);
+   if (err == -ENODATA || err == 0)
+   {
+      return from_stash;
+   }
+
+   return (err < 0) ? err : from_stash + err;
+}
+
+// Assemble packet number <packet_num> into <buffer>.
+// <0 for failure, 0 for file done, else bytes of data in the packet
+_xmodem_debug
+int _assemble_packet( xbee_xmodem_state_t *xbxm, char FAR *buffer,
+   uint16_t packet_num, uint16_t block_size)
 {
    int err;
-   uint8_t packet_num;
    uint16_t checksum;
    int ch;
    uint16_t i;
@@ -220,20 +287,16 @@ int _assemble_packet( xbee_xmodem_state_t *xbxm, uint16_t block_size)
    // Assemble a packet to send -- 3-byte header; 64, 128 or 1K xmodem
    // block from source file; and then 1-byte checksum or 2-byte CRC.
 
-   xbxm->tries = 3;
-   xbxm->buffer[0] =
-         (xbxm->flags & XBEE_XMODEM_FLAG_1K) ? XMODEM_STX : XMODEM_SOH;
-   packet_num = (uint8_t) xbxm->packet_num;
-   xbxm->buffer[1] = packet_num;
-   xbxm->buffer[2] = ~packet_num;
-   err = xbxm->file.read( xbxm->file.context, &xbxm->buffer[3], block_size);
-   if (err == -ENODATA || err == 0)
+   buffer[0] = (block_size == 1024) ? XMODEM_STX : XMODEM_SOH;
+   buffer[1] = (uint8_t) packet_num;
+   buffer[2] = ~(uint8_t) packet_num;
+   err = _xbee_xmodem_read( xbxm, &buffer[3], block_size);
+   if (err == 0)
    {
       #ifdef XBEE_XMODEM_VERBOSE
          printf( "%s: reached end of file\n", __FUNCTION__);
       #endif
-      xbxm->state = XBEE_XMODEM_STATE_EOF;
-      return 1;
+      return 0;
    }
    else if (err < 0)
    {
@@ -256,32 +319,67 @@ int _assemble_packet( xbee_xmodem_state_t *xbxm, uint16_t block_size)
 
       // short read, but it's the last block from the file -- set
       // remaining bytes to 0xFF
-      _f_memset( &xbxm->buffer[3 + err], 0xFF, block_size - err);
+      _f_memset( &buffer[3 + err], 0xFF, block_size - err);
    }
 
    if (xbxm->flags & XBEE_XMODEM_FLAG_CRC)
    {
-      checksum = crc16_calc( &xbxm->buffer[3], block_size, 0);
+      checksum = crc16_calc( &buffer[3], block_size, 0);
       // append 16-bit CRC, MSB-first
-      xbxm->buffer[3 + block_size] = checksum >> 8;
-      xbxm->buffer[4 + block_size] = checksum & 0x00FF;
+      buffer[3 + block_size] = checksum >> 8;
+      buffer[4 + block_size] = checksum & 0x00FF;
    }
    else
    {
       checksum = 0;
-      for (p = &xbxm->buffer[3], i = block_size; i; --i)
+      for (p = &buffer[3], i = block_size; i; --i)
       {
          checksum += *p++;
       }
-      xbxm->buffer[3 + block_size] = (uint8_t) checksum;
+      buffer[3 + block_size] = (uint8_t) checksum;
    }
 
-   return 0;
+   return err;
+}
+
+// Assemble the packet after the current one in the second buffer, if there
+// is one and it's free.  Not while the first 1K block is unconfirmed, since
+// the second buffer holds its data if the receiver turns it down.
+_xmodem_debug
+void _xbee_xmodem_prefetch( xbee_xmodem_state_t *xbxm, uint16_t block_size)
+{
+   int retval;
+
+   if (xbxm->next == NULL || xbxm->next_status != _XMODEM_NEXT_EMPTY
+      || xbxm->stash || xbxm->probe_len)
+   {
+      return;
+   }
+
+   retval = _assemble_packet( xbxm, xbxm->next, xbxm->packet_num + 1,
+      block_size);
+   if (retval > 0)
+   {
+      xbxm->next_status = _XMODEM_NEXT_READY;
+   }
+   else if (retval == 0)
+   {
+      xbxm->next_status = _XMODEM_NEXT_EOF;
+   }
+   else
+   {
+      xbxm->next_status = retval;
+   }
 }
 
 _xmodem_debug
 uint16_t _block_size( xbee_xmodem_state_t *xbxm)
 {
+   if (xbxm->flags & XBEE_XMODEM_FLAG_SEND_1K)
+   {
+      return 1024;
+   }
+
    switch (xbxm->flags & XBEE_XMODEM_MASK_BLOCKSIZE)
    {
       case XBEE_XMODEM_FLAG_64:        return 64;
@@ -338,23 +436,41 @@ int xbee_xmodem_tx_tick( xbee_xmodem_state_t *xbxm)
             printf( "%s: starting XMODEM%s\n", __FUNCTION__,
                (ch == XMODEM_CRC) ? "-CRC" : "");
          #endif
+         // XMODEM-1K requires a CRC, and a second buffer for falling back
+         if (ch == XMODEM_CRC && (xbxm->flags & XBEE_XMODEM_FLAG_AUTO_1K)
+            && xbxm->next != NULL)
+         {
+            xbxm->flags |= XBEE_XMODEM_FLAG_SEND_1K;
+            block_size = 1024;
+         }
+
          // got start character, can start sending packets
          xbxm->state = XBEE_XMODEM_STATE_SEND;
          xbxm->packet_num = 1;
          // fall through
 
       case XBEE_XMODEM_STATE_SEND:
-         retval = _assemble_packet( xbxm, block_size);
+         xbxm->tries = 3;
+         retval = _assemble_packet( xbxm, xbxm->buffer, xbxm->packet_num,
+            block_size);
          if (retval < 0)
          {
             err = retval;
             goto failure;
          }
-         else if (retval > 0)
+         else if (retval == 0)
          {
+            xbxm->state = XBEE_XMODEM_STATE_EOF;
             break;         // transfer complete
          }
 
+         if (block_size == 1024 && xbxm->packet_num == 1
+            && (xbxm->flags & XBEE_XMODEM_FLAG_SEND_1K))
+         {
+            // keep the data in case the receiver turns down 1K blocks
+            xbxm->probe_len = (uint16_t) retval;
+         }
+
          while (_xbee_xmodem_getchar( xbxm) != -ENODATA)
          {
             // flush any extra characters received from other end
@@ -387,6 +503,7 @@ int xbee_xmodem_tx_tick( xbee_xmodem_state_t *xbxm)
             }
          #endif
          xbxm->offset = 0;
+         xbxm->state = XBEE_XMODEM_STATE_SENDING;
          // fall through
 
       case XBEE_XMODEM_STATE_SENDING:
@@ -427,6 +544,11 @@ int xbee_xmodem_tx_tick( xbee_xmodem_state_t *xbxm)
             xbxm->state = XBEE_XMODEM_STATE_WAIT_ACK;
             xbxm->timer = (uint16_t) xbee_millisecond_timer();
          }
+         else
+         {
+            // transmit buffer is full; get the next packet ready meanwhile
+            _xbee_xmodem_prefetch( xbxm, block_size);
+         }
          break;
 
       case XBEE_XMODEM_STATE_WAIT_ACK:
@@ -447,15 +569,46 @@ int xbee_xmodem_tx_tick( xbee_xmodem_state_t *xbxm)
                   xbxm->packet_num);
             #endif
             ++xbxm->packet_num;
+            xbxm->probe_len = 0;          // receiver takes 1K blocks
 
-            // read and send the next packet
-            xbxm->state = XBEE_XMODEM_STATE_SEND;
+            if (xbxm->next_status == _XMODEM_NEXT_READY)
+            {
+               // send the packet that's already in the second buffer
+               char FAR *p = xbxm->buffer;
+
+               xbxm->buffer = xbxm->next;
+               xbxm->next = p;
+               xbxm->next_status = _XMODEM_NEXT_EMPTY;
+               xbxm->tries = 3;
+               while (_xbee_xmodem_getchar( xbxm) != -ENODATA)
+               {
+                  // flush any extra characters received from other end
+               }
+               xbxm->state = XBEE_XMODEM_STATE_RESEND;
+            }
+            else if (xbxm->next_status == _XMODEM_NEXT_EOF)
+            {
+               xbxm->next_status = _XMODEM_NEXT_EMPTY;
+               xbxm->tries = 3;
+               xbxm->state = XBEE_XMODEM_STATE_EOF;
+            }
+            else if (xbxm->next_status < 0)
+            {
+               err = xbxm->next_status;
+               goto failure;
+            }
+            else
+            {
+               // read and send the next packet
+               xbxm->state = XBEE_XMODEM_STATE_SEND;
+            }
             return 0;
          }
          else if (ch < 0)
          {
             if ((uint16_t) xbee_millisecond_timer() - xbxm->timer < 10000)
             {
+               _xbee_xmodem_prefetch( xbxm, block_size);
                return 0;
             }
             #ifdef XBEE_XMODEM_VERBOSE
@@ -470,6 +623,22 @@ int xbee_xmodem_tx_tick( xbee_xmodem_state_t *xbxm)
             #endif
          }
 
+         if (xbxm->probe_len)
+         {
+            // Receiver didn't take the first 1K block.  Send its data again
+            // in blocks of the size passed to xbee_xmodem_tx_init().
+            #ifdef XBEE_XMODEM_VERBOSE
+               printf( "%s: falling back from 1K blocks\n", __FUNCTION__);
+            #endif
+            _f_memcpy( xbxm->next, &xbxm->buffer[3], xbxm->probe_len);
+            xbxm->stash = xbxm->probe_len;
+            xbxm->stash_offset = 0;
+            xbxm->probe_len = 0;
+            xbxm->flags &= ~XBEE_XMODEM_FLAG_SEND_1K;
+            xbxm->state = XBEE_XMODEM_STATE_SEND;
+            return 0;
+         }
+
          if (--xbxm->tries)
          {
             xbxm->state = XBEE_XMODEM_STATE_RESEND;
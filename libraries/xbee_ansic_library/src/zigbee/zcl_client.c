@@ -546,6 +546,826 @@ int zcl_send_write_attributes( wpan_envelope_t *envelope,
    return retval;
 }
 
+/*** BeginHeader zcl_batch_read_start, zcl_batch_read_tick,
+                 zcl_batch_read_response, zcl_batch_write_start,
+                 zcl_batch_write_response, zcl_batch_endpoint_handler */
+/*** EndHeader */
+// Device payload to assume if it hasn't been read from the XBee (ATNP).
+#define _ZCL_BATCH_PAYLOAD    64
+
+// Bytes of attribute IDs or write records in each request.
+#define _ZCL_BATCH_RECORDS    (2 * ZCL_BATCH_MAX_ATTRIBS)
+
+/**
+   @internal
+   Number of bytes used by a ZCL value of a given type, including any length
+   prefix.
+
+   @param[in]  type     ZCL_TYPE_* of the value
+   @param[in]  value    start of the value
+   @param[in]  avail    bytes available at \a value
+
+   @retval  >=0      bytes used by the value
+   @retval  -EINVAL  invalid type, or value is longer than \a avail
+*/
+static int _zcl_batch_value_length( uint8_t type, const uint8_t FAR *value,
+   int avail)
+{
+   uint8_t element_type;
+   uint16_t count;
+   int length, element;
+
+   length = zcl_sizeof_type( type);
+   switch (length)
+   {
+      case ZCL_SIZE_INVALID:
+         return -EINVAL;
+
+      case ZCL_SIZE_SHORT:
+         // 1-octet length, 0xFF for invalid
+         if (avail < 1)
+         {
+            return -EINVAL;
+         }
+         length = 1 + (value[0] == 0xFF ? 0 : value[0]);
+         break;
+
+      case ZCL_SIZE_LONG:
+         // 2-octet length, 0xFFFF for invalid
+         if (avail < 2)
+         {
+            return -EINVAL;
+         }
+         count = (uint16_t) (value[0] | (value[1] << 8));
+         length = 2 + (count == 0xFFFF ? 0 : count);
+         break;
+
+      case ZCL_SIZE_VARIABLE:
+         // array, set and bag start with the element type, all of them
+         // have a 2-octet count (0xFFFF for invalid)
+         length = (type == ZCL_TYPE_STRUCT) ? 0 : 1;
+         if (avail < length + 2)
+         {
+            return -EINVAL;
+         }
+         element_type = value[0];
+         count = (uint16_t) (value[length] | (value[length + 1] << 8));
+         length += 2;
+         for (; count != 0xFFFF && count; --count)
+         {
+            if (type == ZCL_TYPE_STRUCT)
+            {
+               // each structure member starts with its own type
+               if (length >= avail)
+               {
+                  return -EINVAL;
+               }
+               element_type = value[length++];
+            }
+            element = _zcl_batch_value_length( element_type, &value[length],
+               avail - length);
+            if (element < 0)
+            {
+               return element;
+            }
+            length += element;
+         }
+         break;
+   }
+
+   return (length > avail) ? -EINVAL : length;
+}
+
+// Common part of zcl_batch_read_start() and zcl_batch_write_start().
+static int _zcl_batch_start( zcl_batch_t *batch, wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep,
+   zcl_batch_read_t *reads, uint_fast8_t read_count, uint8_t command)
+{
+   zcl_batch_read_t *read;
+   zcl_batch_attr_t *attr;
+   const uint16_t FAR *id;
+   uint_fast8_t i;
+   uint16_t payload;
+
+   if (batch == NULL || dev == NULL || ep == NULL || ep->ep_state == NULL
+      || (reads == NULL && read_count != 0))
+   {
+      return -EINVAL;
+   }
+
+   // room for records after the largest (mfg-specific) ZCL header
+   payload = dev->payload ? dev->payload : _ZCL_BATCH_PAYLOAD;
+   if (payload < sizeof(zcl_header_withmfg_t) + 2)
+   {
+      return -EINVAL;            // not even one attribute ID fits
+   }
+   payload -= sizeof(zcl_header_withmfg_t);
+   if (payload > _ZCL_BATCH_RECORDS)
+   {
+      payload = _ZCL_BATCH_RECORDS;
+   }
+
+   for (read = reads, i = read_count; i; ++read, --i)
+   {
+      if (read->attribute_list == NULL || read->results == NULL)
+      {
+         return -EINVAL;
+      }
+      if (command != ZCL_CMD_WRITE_ATTRIB)
+      {
+         continue;
+      }
+
+      // each value must be complete and fit in a request by itself
+      attr = read->results;
+      for (id = read->attribute_list; *id != ZCL_ATTRIBUTE_END_OF_LIST; ++id)
+      {
+         if (attr->length > ZCL_BATCH_VALUE_MAX
+            || 3 + attr->length > payload
+            || _zcl_batch_value_length( attr->type, attr->value,
+               attr->length) != attr->length)
+         {
+            return -EINVAL;
+         }
+         ++attr;
+      }
+   }
+
+   memset( batch, 0, sizeof *batch);
+   batch->dev = dev;
+   batch->ep = ep;
+   batch->reads = reads;
+   batch->read_count = (uint8_t) read_count;
+   batch->command = command;
+   batch->window = ZCL_BATCH_WINDOW;
+   batch->retries = ZCL_BATCH_RETRIES;
+   batch->timeout = ZCL_BATCH_TIMEOUT;
+   batch->space = payload;
+   batch->per_request = (uint8_t) (payload / 2);
+   for (i = 0; i < ZCL_BATCH_MAX_TXN; ++i)
+   {
+      batch->txn[i].batch = batch;
+   }
+
+   for (read = reads, i = read_count; i; ++read, --i)
+   {
+      attr = read->results;
+      for (id = read->attribute_list; *id != ZCL_ATTRIBUTE_END_OF_LIST; ++id)
+      {
+         if (command == ZCL_CMD_READ_ATTRIB)
+         {
+            memset( attr, 0, sizeof *attr);
+         }
+         attr->id = *id;
+         attr->status = ZCL_BATCH_STATUS_PENDING;
+         attr->txn = 0;
+         ++attr;
+      }
+      read->count = (uint16_t) (attr - read->results);
+   }
+
+   batch->status = -EBUSY;
+
+   return 0;
+}
+
+/**
+   @brief
+   Start reading attributes from one or more clusters on one or more nodes.
+
+   zcl_batch_read_tick() packs as many attribute IDs as fit into each Read
+   Attributes request, and keeps up to \c window requests in flight to each
+   node (using conversations on \a ep), so reading a full attribute set
+   takes a few round trips instead of one per cluster or attribute.  Each
+   attribute's status, type and value go in the \c results of its
+   zcl_batch_read_t.
+
+   Responses arrive through the conversation table of \a ep.  Either list
+   each cluster read in \a ep's cluster table (with zcl_general_command()
+   as the handler) or use zcl_batch_endpoint_handler() as \a ep's handler.
+
+   @param[out] batch       state of the reads
+   @param[in]  dev         device to send requests with
+   @param[in]  ep          local endpoint to send from; must have an
+                           \c ep_state and use the profile of the clusters
+                           being read
+   @param[in]  reads       clusters and attributes to read; must stay in
+                           scope until the batch completes
+   @param[in]  read_count  number of entries in \a reads
+
+   @retval  0        started; call zcl_batch_read_tick() until it stops
+                     returning -EBUSY
+   @retval  -EINVAL  invalid parameter, or \a dev's payload can't hold a
+                     Read Attributes request
+*/
+zcl_client_debug
+int zcl_batch_read_start( zcl_batch_t *batch, wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep,
+   zcl_batch_read_t *reads, uint_fast8_t read_count)
+{
+   return _zcl_batch_start( batch, dev, ep, reads, read_count,
+      ZCL_CMD_READ_ATTRIB);
+}
+
+/**
+   @brief
+   Start writing attributes to one or more clusters on one or more nodes.
+
+   Works like zcl_batch_read_start(): zcl_batch_write_tick() packs as many
+   write records as fit into each Write Attributes request and keeps up to
+   \c window requests in flight to each node.  Set the \c type, \c length
+   and \c value (as sent over the air) of each entry in \c results before
+   calling this function.  The \c status of each entry holds the result.
+
+   @param[out] batch       state of the writes
+   @param[in]  dev         device to send requests with
+   @param[in]  ep          local endpoint to send from; must have an
+                           \c ep_state and use the profile of the clusters
+                           being written
+   @param[in]  writes      clusters, attributes and values to write; must
+                           stay in scope until the batch completes
+   @param[in]  write_count number of entries in \a writes
+
+   @retval  0        started; call zcl_batch_write_tick() until it stops
+                     returning -EBUSY
+   @retval  -EINVAL  invalid parameter, a value that doesn't match its
+                     type, or a value that doesn't fit in one request
+*/
+zcl_client_debug
+int zcl_batch_write_start( zcl_batch_t *batch, wpan_dev_t *dev,
+   const wpan_endpoint_table_entry_t *ep,
+   zcl_batch_write_t *writes, uint_fast8_t write_count)
+{
+   return _zcl_batch_start( batch, dev, ep, writes, write_count,
+      ZCL_CMD_WRITE_ATTRIB);
+}
+
+// Delete the conversation waiting for a response to <txn>.
+static void _zcl_batch_forget( zcl_batch_t *batch, zcl_batch_txn_t *txn)
+{
+   wpan_conversation_t FAR *conversation;
+   uint_fast8_t i;
+
+   conversation = batch->ep->ep_state->conversations;
+   for (i = WPAN_MAX_CONVERSATIONS; i; ++conversation, --i)
+   {
+      if ((conversation->handler == zcl_batch_read_response
+            || conversation->handler == zcl_batch_write_response)
+         && conversation->context == txn)
+      {
+         wpan_conversation_delete( conversation);
+      }
+   }
+}
+
+// Set the status of the attributes still waiting on <txn> to <status>.
+static void _zcl_batch_release( zcl_batch_t *batch, zcl_batch_txn_t *txn,
+   uint8_t status)
+{
+   zcl_batch_read_t *read = &batch->reads[txn->read];
+   zcl_batch_attr_t *attr;
+   uint_fast8_t slot = (uint_fast8_t) (txn - batch->txn);
+   uint_fast16_t i;
+
+   for (attr = read->results, i = read->count; i; ++attr, --i)
+   {
+      if (attr->status == ZCL_BATCH_STATUS_SENT && attr->txn == slot)
+      {
+         attr->status = status;
+         if (status == ZCL_BATCH_STATUS_TIMEOUT)
+         {
+            ++batch->timeouts;
+         }
+         else if (status == ZCL_STATUS_SUCCESS)
+         {
+            ++batch->succeeded;
+         }
+         else if (status != ZCL_BATCH_STATUS_PENDING)
+         {
+            ++batch->failed;
+         }
+      }
+   }
+   txn->state = ZCL_BATCH_TXN_IDLE;
+}
+
+// Send (or resend) a Read or Write Attributes request for the attributes
+// assigned to <txn>.
+static int _zcl_batch_send( zcl_batch_t *batch, zcl_batch_txn_t *txn)
+{
+   XBEE_PACKED(, {
+      zcl_header_response_t   header;
+      uint8_t                 records[_ZCL_BATCH_RECORDS];
+   }) zcl_req;
+   const zcl_batch_read_t *read = &batch->reads[txn->read];
+   const zcl_batch_attr_t *attr;
+   const wpan_cluster_table_entry_t *cluster;
+   wpan_envelope_t envelope;
+   uint8_t *request_start, *record;
+   uint8_t direction;
+   uint_fast8_t slot = (uint_fast8_t) (txn - batch->txn);
+   uint_fast8_t count;
+   uint_fast16_t i;
+   int trans, err;
+
+   // attribute IDs to read, or ID, type and value of each to write
+   count = 0;
+   record = zcl_req.records;
+   for (attr = read->results, i = read->count; i; ++attr, --i)
+   {
+      if (attr->status == ZCL_BATCH_STATUS_SENT && attr->txn == slot)
+      {
+         *record++ = (uint8_t) attr->id;
+         *record++ = (uint8_t) (attr->id >> 8);
+         if (batch->command == ZCL_CMD_WRITE_ATTRIB)
+         {
+            *record++ = attr->type;
+            _f_memcpy( record, attr->value, attr->length);
+            record += attr->length;
+         }
+         ++count;
+      }
+   }
+
+   trans = wpan_conversation_register( batch->ep->ep_state,
+      (batch->command == ZCL_CMD_WRITE_ATTRIB)
+         ? zcl_batch_write_response : zcl_batch_read_response,
+      txn, batch->timeout);
+   if (trans < 0)
+   {
+      return trans;
+   }
+
+   direction = (read->flags & ZCL_BATCH_READ_FLAG_CLIENT)
+      ? ZCL_FRAME_SERVER_TO_CLIENT : ZCL_FRAME_CLIENT_TO_SERVER;
+   if (read->mfg_id == ZCL_MFG_NONE)
+   {
+      zcl_req.header.u.std.frame_control = ZCL_FRAME_TYPE_PROFILE |
+         ZCL_FRAME_GENERAL | direction;
+      request_start = &zcl_req.header.u.std.frame_control;
+   }
+   else
+   {
+      zcl_req.header.u.mfg.mfg_code_le = htole16( read->mfg_id);
+      zcl_req.header.u.mfg.frame_control = ZCL_FRAME_TYPE_PROFILE |
+         ZCL_FRAME_MFG_SPECIFIC | direction;
+      request_start = &zcl_req.header.u.mfg.frame_control;
+   }
+   zcl_req.header.sequence = txn->transaction = (uint8_t) trans;
+   zcl_req.header.command = batch->command;
+
+   wpan_envelope_create( &envelope, batch->dev, &read->node.ieee,
+      read->node.network);
+   envelope.source_endpoint = batch->ep->endpoint;
+   envelope.dest_endpoint = read->endpoint;
+   envelope.profile_id = batch->ep->profile_id;
+   envelope.cluster_id = read->cluster_id;
+   envelope.payload = request_start;
+   envelope.length = (uint16_t) (record - request_start);
+
+   // use the local cluster's flags (like encryption) if it's in the table
+   cluster = wpan_cluster_match( read->cluster_id,
+      (read->flags & ZCL_BATCH_READ_FLAG_CLIENT)
+         ? WPAN_CLUST_FLAG_SERVER : WPAN_CLUST_FLAG_CLIENT,
+      batch->ep->cluster_table);
+   if (cluster)
+   {
+      envelope.options = cluster->flags;
+   }
+
+   #ifdef ZCL_CLIENT_VERBOSE
+      printf( "%s: %s %u attributes\n", __FUNCTION__,
+         (batch->command == ZCL_CMD_WRITE_ATTRIB) ? "writing" : "reading",
+         count);
+      wpan_envelope_dump( &envelope);
+   #endif
+
+   err = wpan_envelope_send( &envelope);
+   if (err != 0)
+   {
+      _zcl_batch_forget( batch, txn);
+      return err;
+   }
+
+   txn->state = ZCL_BATCH_TXN_SENT;
+   txn->requested = (uint8_t) count;
+   ++txn->tries;
+   ++batch->requests;
+
+   return 0;
+}
+
+// Assign up to per_request attributes waiting to be read from <read>
+// (or as many write records as fit in a request) to <txn>; returns the
+// number assigned.
+static uint_fast8_t _zcl_batch_assign( zcl_batch_t *batch,
+   zcl_batch_txn_t *txn, uint_fast8_t read_index)
+{
+   zcl_batch_read_t *read = &batch->reads[read_index];
+   zcl_batch_attr_t *attr;
+   uint_fast8_t slot = (uint_fast8_t) (txn - batch->txn);
+   uint_fast8_t count = 0;
+   uint_fast16_t i, used = 0;
+
+   for (attr = read->results, i = read->count;
+      i && count < batch->per_request; ++attr, --i)
+   {
+      if (attr->status == ZCL_BATCH_STATUS_PENDING)
+      {
+         if (batch->command == ZCL_CMD_WRITE_ATTRIB)
+         {
+            used += 3 + attr->length;
+            if (used > batch->space)
+            {
+               break;
+            }
+         }
+         attr->status = ZCL_BATCH_STATUS_SENT;
+         attr->txn = (uint8_t) slot;
+         ++count;
+      }
+   }
+   txn->read = (uint8_t) read_index;
+   txn->tries = 0;
+
+   return count;
+}
+
+// Number of requests in flight to the node of batch->reads[read_index].
+static uint_fast8_t _zcl_batch_in_flight( const zcl_batch_t *batch,
+   uint_fast8_t read_index)
+{
+   const addr64 *ieee = &batch->reads[read_index].node.ieee;
+   uint_fast8_t i, count = 0;
+
+   for (i = 0; i < ZCL_BATCH_MAX_TXN; ++i)
+   {
+      if (batch->txn[i].state != ZCL_BATCH_TXN_IDLE
+         && addr64_equal( &batch->reads[batch->txn[i].read].node.ieee, ieee))
+      {
+         ++count;
+      }
+   }
+
+   return count;
+}
+
+/**
+   @brief
+   Send the Read or Write Attributes requests for a batch started with
+   zcl_batch_read_start() or zcl_batch_write_start(), and resend the ones
+   that time out.
+
+   Call from the main loop, along with wpan_tick() to process the responses.
+
+   @param[in,out] batch   batch to advance
+
+   @retval  -EBUSY      still reading
+   @retval  0           every attribute has a result (which may be an error
+                        status from the node)
+   @retval  -ETIMEDOUT  done, but some nodes didn't respond for some
+                        attributes (\c status of ZCL_BATCH_STATUS_TIMEOUT)
+   @retval  -EINVAL     \a batch is NULL
+*/
+zcl_client_debug
+int zcl_batch_read_tick( zcl_batch_t *batch)
+{
+   zcl_batch_txn_t *txn;
+   zcl_batch_attr_t *attr;
+   uint_fast8_t i, k, r, window;
+   uint_fast16_t a;
+   bool_t busy;
+
+   if (batch == NULL)
+   {
+      return -EINVAL;
+   }
+   if (batch->status != -EBUSY)
+   {
+      return batch->status;
+   }
+
+   // resend requests that timed out, or give up on their attributes
+   for (txn = batch->txn, i = ZCL_BATCH_MAX_TXN; i; ++txn, --i)
+   {
+      if (txn->state == ZCL_BATCH_TXN_RESEND)
+      {
+         if (txn->tries > batch->retries)
+         {
+            _zcl_batch_release( batch, txn, ZCL_BATCH_STATUS_TIMEOUT);
+         }
+         else if (_zcl_batch_send( batch, txn) != 0)
+         {
+            // out of conversations, or send failed; counts as a try
+            ++txn->tries;
+         }
+      }
+   }
+
+   // start new requests in the free slots, spread across the nodes
+   window = (batch->window && batch->window < ZCL_BATCH_WINDOW)
+      ? batch->window : ZCL_BATCH_WINDOW;
+   for (txn = batch->txn, i = ZCL_BATCH_MAX_TXN; i; ++txn, --i)
+   {
+      if (txn->state != ZCL_BATCH_TXN_IDLE)
+      {
+         continue;
+      }
+      for (k = 0; k < batch->read_count; ++k)
+      {
+         r = (batch->next_read + k) % batch->read_count;
+         if (_zcl_batch_in_flight( batch, r) < window
+            && _zcl_batch_assign( batch, txn, r) != 0)
+         {
+            batch->next_read = (uint8_t) (r + 1);
+            break;
+         }
+      }
+      if (k == batch->read_count)
+      {
+         break;                  // nothing left to send
+      }
+      if (_zcl_batch_send( batch, txn) != 0)
+      {
+         // out of conversations, or send failed; counts as a try, so a
+         // send that keeps failing eventually times out
+         txn->state = ZCL_BATCH_TXN_RESEND;
+         ++txn->tries;
+         break;
+      }
+   }
+
+   // done once every attribute has a result
+   busy = FALSE;
+   for (txn = batch->txn, i = ZCL_BATCH_MAX_TXN; i && ! busy; ++txn, --i)
+   {
+      busy = (txn->state != ZCL_BATCH_TXN_IDLE);
+   }
+   for (r = 0; r < batch->read_count && ! busy; ++r)
+   {
+      attr = batch->reads[r].results;
+      for (a = batch->reads[r].count; a && ! busy; ++attr, --a)
+      {
+         busy = (attr->status == ZCL_BATCH_STATUS_PENDING);
+      }
+   }
+   if (! busy)
+   {
+      batch->status = batch->timeouts ? -ETIMEDOUT : 0;
+   }
+
+   return batch->status;
+}
+
+// Common part of the batch conversation handlers: handle a timeout, or a
+// Default Response rejecting the whole request.  Returns 0 if <zcl> holds
+// a response with command <command> for the caller to parse, or the value
+// for the handler to return.
+static int _zcl_batch_response( wpan_conversation_t FAR *conversation,
+   const wpan_envelope_t FAR *envelope, zcl_command_t *zcl, uint8_t command)
+{
+   zcl_batch_txn_t *txn = conversation->context;
+   zcl_batch_t *batch = txn->batch;
+   uint8_t status;
+
+   if (envelope == NULL)
+   {
+      // timed out, resend (or give up) on next tick
+      txn->state = ZCL_BATCH_TXN_RESEND;
+      return WPAN_CONVERSATION_END;
+   }
+
+   if (envelope->cluster_id != batch->reads[txn->read].cluster_id
+      || zcl_command_build( zcl, envelope, NULL) != 0)
+   {
+      return WPAN_CONVERSATION_CONTINUE;
+   }
+
+   if (zcl->command == ZCL_CMD_DEFAULT_RESP && zcl->length >= 2)
+   {
+      // node rejected the whole request
+      status = ((const zcl_default_response_t FAR *) zcl->zcl_payload)->status;
+      _zcl_batch_release( batch, txn,
+         status == ZCL_STATUS_SUCCESS ? ZCL_STATUS_FAILURE : status);
+      return WPAN_CONVERSATION_END;
+   }
+   if (zcl->command != command)
+   {
+      return WPAN_CONVERSATION_CONTINUE;
+   }
+
+   return 0;
+}
+
+/**
+   @brief
+   Conversation handler for the Read Attributes requests sent by
+   zcl_batch_read_tick().
+
+   Saves each attribute record of the response in the batch's results.
+   Requested attributes missing from a response (because they didn't fit)
+   are requested again, and later requests ask for fewer attributes.
+
+   See wpan_response_fn for parameters and return values.
+*/
+zcl_client_debug
+int zcl_batch_read_response( wpan_conversation_t FAR *conversation,
+   const wpan_envelope_t FAR *envelope)
+{
+   zcl_batch_txn_t *txn = conversation->context;
+   zcl_batch_t *batch = txn->batch;
+   zcl_batch_read_t *read = &batch->reads[txn->read];
+   zcl_batch_attr_t *attr;
+   zcl_command_t zcl;
+   const uint8_t FAR *p, FAR *end;
+   uint_fast8_t slot = (uint_fast8_t) (txn - batch->txn);
+   uint_fast8_t records;
+   uint_fast16_t i;
+   uint16_t id;
+   uint8_t status, type;
+   int length, result;
+
+   result = _zcl_batch_response( conversation, envelope, &zcl,
+      ZCL_CMD_READ_ATTRIB_RESP);
+   if (result != 0)
+   {
+      return result;
+   }
+
+   records = 0;
+   p = zcl.zcl_payload;
+   end = p + zcl.length;
+   while (end - p >= 3)
+   {
+      id = (uint16_t) (p[0] | (p[1] << 8));
+      status = p[2];
+      p += 3;
+      type = 0;
+      length = 0;
+      if (status == ZCL_STATUS_SUCCESS)
+      {
+         if (p == end)
+         {
+            break;
+         }
+         type = *p++;
+         length = _zcl_batch_value_length( type, p, (int) (end - p));
+         if (length < 0)
+         {
+            #ifdef ZCL_CLIENT_VERBOSE
+               printf( "%s: can't parse attribute 0x%04x of type 0x%02x\n",
+                  __FUNCTION__, id, type);
+            #endif
+            break;
+         }
+      }
+
+      for (attr = read->results, i = read->count; i; ++attr, --i)
+      {
+         if (attr->status == ZCL_BATCH_STATUS_SENT && attr->txn == slot
+            && attr->id == id)
+         {
+            attr->status = status;
+            attr->type = type;
+            attr->length = (uint16_t) length;
+            _f_memcpy( attr->value, p, (length > ZCL_BATCH_VALUE_MAX)
+               ? ZCL_BATCH_VALUE_MAX : length);
+            if (status == ZCL_STATUS_SUCCESS)
+            {
+               ++batch->succeeded;
+            }
+            else
+            {
+               ++batch->failed;
+            }
+            ++records;
+            break;
+         }
+      }
+      p += length;
+   }
+
+   if (records == 0)
+   {
+      // can't make progress on these attributes
+      _zcl_batch_release( batch, txn, ZCL_STATUS_FAILURE);
+   }
+   else
+   {
+      // response couldn't hold every attribute; ask for the rest again,
+      // and for no more than fit at a time from now on
+      if (records < txn->requested && records < batch->per_request)
+      {
+         batch->per_request = (uint8_t) records;
+      }
+      _zcl_batch_release( batch, txn, ZCL_BATCH_STATUS_PENDING);
+   }
+
+   return WPAN_CONVERSATION_END;
+}
+
+/**
+   @brief
+   Conversation handler for the Write Attributes requests sent by
+   zcl_batch_write_tick().
+
+   Saves the status of each attribute in the batch's results.  The node
+   only lists the attributes it didn't write (or sends a single SUCCESS
+   status if it wrote all of them), so attributes missing from the response
+   were written.
+
+   See wpan_response_fn for parameters and return values.
+*/
+zcl_client_debug
+int zcl_batch_write_response( wpan_conversation_t FAR *conversation,
+   const wpan_envelope_t FAR *envelope)
+{
+   zcl_batch_txn_t *txn = conversation->context;
+   zcl_batch_t *batch = txn->batch;
+   zcl_batch_read_t *write = &batch->reads[txn->read];
+   zcl_batch_attr_t *attr;
+   zcl_command_t zcl;
+   const uint8_t FAR *p, FAR *end;
+   uint_fast8_t slot = (uint_fast8_t) (txn - batch->txn);
+   uint_fast16_t i;
+   uint16_t id;
+   int result;
+
+   result = _zcl_batch_response( conversation, envelope, &zcl,
+      ZCL_CMD_WRITE_ATTRIB_RESP);
+   if (result != 0)
+   {
+      return result;
+   }
+
+   p = zcl.zcl_payload;
+   if (zcl.length < 3)
+   {
+      // a single status without an attribute ID
+      _zcl_batch_release( batch, txn,
+         (zcl.length && *p == ZCL_STATUS_SUCCESS)
+            ? ZCL_STATUS_SUCCESS : ZCL_STATUS_FAILURE);
+      return WPAN_CONVERSATION_END;
+   }
+
+   // status and ID of each attribute that wasn't written
+   for (end = p + zcl.length; end - p >= 3; p += 3)
+   {
+      id = (uint16_t) (p[1] | (p[2] << 8));
+      for (attr = write->results, i = write->count; i; ++attr, --i)
+      {
+         if (attr->status == ZCL_BATCH_STATUS_SENT && attr->txn == slot
+            && attr->id == id)
+         {
+            attr->status = p[0];
+            if (p[0] == ZCL_STATUS_SUCCESS)
+            {
+               ++batch->succeeded;
+            }
+            else
+            {
+               ++batch->failed;
+            }
+            break;
+         }
+      }
+   }
+   _zcl_batch_release( batch, txn, ZCL_STATUS_SUCCESS);
+
+   return WPAN_CONVERSATION_END;
+}
+
+/**
+   @brief
+   Endpoint handler for a ZCL client endpoint used with
+   zcl_batch_read_start() or zcl_batch_write_start(), passing responses
+   for clusters that aren't in the endpoint's cluster table to the
+   endpoint's conversations.
+
+   Other frames go to zcl_invalid_cluster().
+
+   See wpan_ep_handler_fn for parameters and return values.
+*/
+zcl_client_debug
+int zcl_batch_endpoint_handler( const wpan_envelope_t FAR *envelope,
+   wpan_ep_state_t FAR *ep_state)
+{
+   zcl_command_t zcl;
+
+   if (ep_state != NULL
+      && zcl_command_build( &zcl, envelope, NULL) == 0
+      && (zcl.frame_control & ZCL_FRAME_TYPE_MASK) == ZCL_FRAME_TYPE_PROFILE
+      && (zcl.command == ZCL_CMD_READ_ATTRIB_RESP
+         || zcl.command == ZCL_CMD_WRITE_ATTRIB_RESP
+         || zcl.command == ZCL_CMD_DEFAULT_RESP)
+      && wpan_conversation_response( ep_state, zcl.sequence, envelope) == 0)
+   {
+      return 0;
+   }
+
+   return zcl_invalid_cluster( envelope, ep_state);
+}
+
 /*** BeginHeader zcl_format_utctime */
 /*** EndHeader */
 /**
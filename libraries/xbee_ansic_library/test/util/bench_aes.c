@@ -0,0 +1,96 @@
+/*
+	Throughput of the bundled mbedtls AES: one block at a time with
+	mbedtls_aes_crypt_ecb(), several with mbedtls_aes_crypt_ecb_blocks(), and
+	CTR mode, for 128- and 256-bit keys.  Uses AES-NI or the Armv8-A
+	Cryptographic Extension when the CPU has them.
+
+	Usage: bench_aes [megabytes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xbee/platform.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/aesni.h"
+#include "mbedtls/aesce.h"
+
+#define BUFSIZE      4096
+
+static unsigned long total;
+static unsigned char buffer[BUFSIZE];
+
+static double now( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report( const char *name, int bits, double start)
+{
+	char label[40];
+
+	snprintf( label, sizeof label, "%s, %d-bit key", name, bits);
+	printf( "%-32s %8.1f MB/s\n", label, total / (now() - start) / 1e6);
+}
+
+static void bench( int bits)
+{
+	mbedtls_aes_context ctx;
+	unsigned char key[32] = { 0 }, counter[16] = { 0 }, stream[16];
+	unsigned long done;
+	size_t off = 0;
+	double start;
+	int i;
+
+	mbedtls_aes_init( &ctx);
+	mbedtls_aes_setkey_enc( &ctx, key, bits);
+
+	start = now();
+	for (done = 0; done < total; done += BUFSIZE)
+	{
+		for (i = 0; i < BUFSIZE; i += 16)
+		{
+			mbedtls_aes_crypt_ecb( &ctx, MBEDTLS_AES_ENCRYPT, buffer + i,
+				buffer + i);
+		}
+	}
+	report( "ECB, block at a time", bits, start);
+
+	start = now();
+	for (done = 0; done < total; done += BUFSIZE)
+	{
+		mbedtls_aes_crypt_ecb_blocks( &ctx, MBEDTLS_AES_ENCRYPT, BUFSIZE,
+			buffer, buffer);
+	}
+	report( "ECB, batched", bits, start);
+
+	start = now();
+	for (done = 0; done < total; done += BUFSIZE)
+	{
+		mbedtls_aes_crypt_ctr( &ctx, BUFSIZE, &off, counter, stream, buffer,
+			buffer);
+	}
+	report( "CTR", bits, start);
+
+	mbedtls_aes_free( &ctx);
+}
+
+int main( int argc, char *argv[])
+{
+	total = (argc > 1 ? strtoul( argv[1], NULL, 0) : 64) << 20;
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
+	printf( "AES-NI: %s\n",
+		mbedtls_aesni_has_support( MBEDTLS_AESNI_AES) ? "yes" : "no");
+#elif defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_AESCE_HAVE_CODE)
+	printf( "Armv8-A AES: %s\n", mbedtls_aesce_has_support() ? "yes" : "no");
+#endif
+	bench( 128);
+	bench( 256);
+
+	return 0;
+}
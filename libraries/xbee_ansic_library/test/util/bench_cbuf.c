@@ -0,0 +1,183 @@
+/*
+	Throughput of xbee_cbuf_t against xbee_cbuf_spsc_t.  Moves the same
+	number of bytes through each buffer in fixed-size batches, first with
+	put and get on one thread, then (for the SPSC buffer) with the producer
+	and consumer on separate threads.
+
+	Usage: bench_cbuf [megabytes]
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xbee/platform.h"
+#include "xbee/cbuf.h"
+#include "xbee/cbuf_spsc.h"
+
+#define BUFSIZE      4096
+#define BATCH        64
+
+static unsigned long total;
+
+static struct {
+	xbee_cbuf_t	cbuf;
+	uint8_t		space[BUFSIZE - 1];
+} legacy;
+
+static xbee_cbuf_spsc_t spsc;
+static uint8_t spsc_space[BUFSIZE];
+
+static double now( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report( const char *name, double start)
+{
+	double elapsed = now() - start;
+
+	printf( "%-28s %8.1f MB/s\n", name, total / elapsed / 1e6);
+}
+
+static void bench_legacy( void)
+{
+	uint8_t chunk[BATCH] = { 0 };
+	unsigned long moved;
+	double start;
+
+	xbee_cbuf_init( &legacy.cbuf, BUFSIZE - 1);
+	start = now();
+	for (moved = 0; moved < total; moved += BATCH)
+	{
+		xbee_cbuf_put( &legacy.cbuf, chunk, BATCH);
+		xbee_cbuf_get( &legacy.cbuf, chunk, BATCH);
+	}
+	report( "xbee_cbuf, 1 thread", start);
+}
+
+static void bench_spsc( void)
+{
+	uint8_t chunk[BATCH] = { 0 };
+	unsigned long moved;
+	double start;
+
+	xbee_cbuf_spsc_init( &spsc, spsc_space, BUFSIZE);
+	start = now();
+	for (moved = 0; moved < total; moved += BATCH)
+	{
+		xbee_cbuf_spsc_put( &spsc, chunk, BATCH);
+		xbee_cbuf_spsc_get( &spsc, chunk, BATCH);
+	}
+	report( "xbee_cbuf_spsc, 1 thread", start);
+}
+
+static void *producer( void *arg)
+{
+	uint8_t chunk[BATCH] = { 0 };
+	unsigned long sent = 0;
+
+	while (sent < total)
+	{
+		if (xbee_cbuf_spsc_put( &spsc, chunk, BATCH) == 0)
+		{
+			sched_yield();
+		}
+		else
+		{
+			sent += BATCH;
+		}
+	}
+
+	return arg;
+}
+
+static void bench_spsc_threads( void)
+{
+	uint8_t chunk[BATCH];
+	unsigned long received = 0;
+	unsigned int length;
+	pthread_t thread;
+	double start;
+
+	xbee_cbuf_spsc_init( &spsc, spsc_space, BUFSIZE);
+	start = now();
+	pthread_create( &thread, NULL, producer, NULL);
+	while (received < total)
+	{
+		length = xbee_cbuf_spsc_get( &spsc, chunk, BATCH);
+		if (length == 0)
+		{
+			sched_yield();
+		}
+		received += length;
+	}
+	pthread_join( thread, NULL);
+	report( "xbee_cbuf_spsc, 2 threads", start);
+}
+
+static void *producer_reserve( void *arg)
+{
+	unsigned long sent = 0;
+	unsigned int length;
+
+	while (sent < total)
+	{
+		length = BATCH;
+		if (xbee_cbuf_spsc_reserve( &spsc, &length) == NULL)
+		{
+			sched_yield();
+		}
+		else
+		{
+			xbee_cbuf_spsc_commit( &spsc, length);
+			sent += length;
+		}
+	}
+
+	return arg;
+}
+
+static void bench_spsc_zero_copy( void)
+{
+	unsigned long received = 0;
+	unsigned int length;
+	pthread_t thread;
+	double start;
+
+	xbee_cbuf_spsc_init( &spsc, spsc_space, BUFSIZE);
+	start = now();
+	pthread_create( &thread, NULL, producer_reserve, NULL);
+	while (received < total)
+	{
+		if (xbee_cbuf_spsc_peek( &spsc, &length) == NULL)
+		{
+			sched_yield();
+		}
+		else
+		{
+			xbee_cbuf_spsc_consume( &spsc, length);
+			received += length;
+		}
+	}
+	pthread_join( thread, NULL);
+	report( "xbee_cbuf_spsc, zero-copy", start);
+}
+
+int main( int argc, char *argv[])
+{
+	total = (argc > 1 ? strtoul( argv[1], NULL, 0) : 256) * 1000000UL;
+	total -= total % BATCH;
+
+	bench_legacy();
+	bench_spsc();
+	bench_spsc_threads();
+	bench_spsc_zero_copy();
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+	Throughput of the CRC-16 routines over a firmware-sized buffer:
+	crc16buypass_bit/_byte/_word (Gen3 bootloader) and crc16_calc()
+	(XMODEM).  _word and crc16_calc() use carry-less multiplies when the
+	CPU has them, otherwise slicing-by-8.
+
+	Usage: bench_crc16 [megabytes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xbee/platform.h"
+#include "xbee/xmodem_crc16.h"
+#include "util/crc16buypass.h"
+#include "util/crc16fold.h"
+
+#define BLOCK        1024
+
+static unsigned long total;
+static uint8_t block[BLOCK];
+static volatile uint16_t sink;
+
+static double now( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench( const char *name,
+	uint16_t (*fn)( uint16_t crc, const void *mem, size_t len),
+	unsigned long bytes)
+{
+	unsigned long done;
+	uint16_t crc = 0;
+	double start = now();
+
+	for (done = 0; done < bytes; done += BLOCK)
+	{
+		crc = fn( crc, block, BLOCK);
+	}
+	sink = crc;
+	printf( "%-28s %8.1f MB/s\n", name, bytes / (now() - start) / 1e6);
+}
+
+static uint16_t xmodem( uint16_t crc, const void *mem, size_t len)
+{
+	return crc16_calc( mem, (uint16_t) len, crc);
+}
+
+int main( int argc, char *argv[])
+{
+	int i;
+
+	total = (argc > 1 ? strtoul( argv[1], NULL, 0) : 256) << 20;
+	for (i = 0; i < BLOCK; ++i)
+	{
+		block[i] = (uint8_t) rand();
+	}
+
+#ifdef CRC16_FOLD
+	printf( "carry-less multiply: %s\n", crc16_fold_available() ? "yes" : "no");
+#endif
+	bench( "crc16buypass_bit", crc16buypass_bit, total / 16);
+	bench( "crc16buypass_byte", crc16buypass_byte, total);
+	bench( "crc16buypass_word", crc16buypass_word, total);
+	bench( "crc16_calc", xmodem, total);
+
+	return 0;
+}
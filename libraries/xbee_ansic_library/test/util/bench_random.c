@@ -0,0 +1,121 @@
+/*
+	Cost of random bytes in nonce- and salt-sized requests: one CTR-DRBG
+	generate per request (how xbee_random() used to work), xbee_random(),
+	and a caller's own xbee_random_stream_t.  Then the same xbee_random()
+	requests from several threads at once.
+
+	Usage: bench_random [megabytes]
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xbee/platform.h"
+#include "xbee/random.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+
+#define THREADS      4
+
+static unsigned long total;
+
+static double now( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report( const char *name, size_t size, unsigned long bytes,
+	double start)
+{
+	char label[40];
+	double seconds = now() - start;
+
+	snprintf( label, sizeof label, "%s, %u bytes", name, (unsigned) size);
+	printf( "%-32s %8.1f MB/s %8.1f ns/call\n", label,
+		bytes / seconds / 1e6, seconds * 1e9 / (bytes / size));
+}
+
+static void bench( size_t size)
+{
+	static mbedtls_entropy_context entropy;
+	static mbedtls_ctr_drbg_context drbg;
+	static xbee_random_stream_t stream;
+	static int seeded = 0;
+	unsigned char out[64];
+	unsigned long done;
+	double start;
+
+	if (! seeded)
+	{
+		mbedtls_entropy_init( &entropy);
+		mbedtls_ctr_drbg_init( &drbg);
+		mbedtls_ctr_drbg_seed( &drbg, mbedtls_entropy_func, &entropy,
+			(const unsigned char *) "bench", 5);
+		seeded = 1;
+	}
+
+	start = now();
+	for (done = 0; done < total; done += size)
+	{
+		mbedtls_ctr_drbg_random( &drbg, out, size);
+	}
+	report( "ctr_drbg per call", size, done, start);
+
+	start = now();
+	for (done = 0; done < total; done += size)
+	{
+		xbee_random( out, size);
+	}
+	report( "xbee_random", size, done, start);
+
+	start = now();
+	for (done = 0; done < total; done += size)
+	{
+		xbee_random_stream( &stream, out, size);
+	}
+	report( "xbee_random_stream", size, done, start);
+}
+
+static void *draw_thread( void *arg)
+{
+	unsigned char out[16];
+	unsigned long done;
+
+	for (done = 0; done < total / THREADS; done += sizeof out)
+	{
+		xbee_random( out, sizeof out);
+	}
+
+	return NULL;
+}
+
+int main( int argc, char *argv[])
+{
+	pthread_t thread[THREADS];
+	double start;
+	int i;
+
+	total = (argc > 1 ? atoi( argv[1]) : 16) * 1000000UL;
+
+	bench( 16);
+	bench( 32);
+
+	start = now();
+	for (i = 0; i < THREADS; ++i)
+	{
+		pthread_create( &thread[i], NULL, draw_thread, NULL);
+	}
+	for (i = 0; i < THREADS; ++i)
+	{
+		pthread_join( thread[i], NULL);
+	}
+	report( "xbee_random, 4 threads", 16, total, start);
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+	Throughput of the bundled mbedtls SHA-256: one message at a time with
+	mbedtls_sha256_ret(), and eight at once with mbedtls_sha256_ret_multi(),
+	for long messages (firmware images) and short ones (SRP handshakes).
+	Linked with sha256.o it uses SHA-NI or the Armv8-A Cryptographic Extension
+	when the CPU has them; as bench_sha256_sw (with sha256_sw.o) it shows the
+	C code and SIMD lanes.
+
+	Usage: bench_sha256 [megabytes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "xbee/platform.h"
+#include "mbedtls/sha256.h"
+
+#define MESSAGES     8
+
+static unsigned long total;
+static unsigned char buffer[MESSAGES][4096];
+
+static double now( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report( const char *name, size_t size, double start)
+{
+	char label[40];
+
+	snprintf( label, sizeof label, "%s, %u bytes", name, (unsigned) size);
+	printf( "%-32s %8.1f MB/s\n", label, total / (now() - start) / 1e6);
+}
+
+static void bench( size_t size)
+{
+	const unsigned char *input[MESSAGES];
+	unsigned char *output[MESSAGES];
+	unsigned char md[MESSAGES][32];
+	size_t ilen[MESSAGES];
+	unsigned long done;
+	double start;
+	int i;
+
+	for (i = 0; i < MESSAGES; ++i)
+	{
+		input[i] = buffer[i];
+		ilen[i] = size;
+		output[i] = md[i];
+	}
+
+	start = now();
+	for (done = 0; done < total; done += MESSAGES * size)
+	{
+		for (i = 0; i < MESSAGES; ++i)
+		{
+			mbedtls_sha256_ret( input[i], size, md[i], 0);
+		}
+	}
+	report( "one at a time", size, start);
+
+	start = now();
+	for (done = 0; done < total; done += MESSAGES * size)
+	{
+		mbedtls_sha256_ret_multi( input, ilen, output, MESSAGES, 0);
+	}
+	report( "8 messages at once", size, start);
+}
+
+int main( int argc, char *argv[])
+{
+	total = (argc > 1 ? strtoul( argv[1], NULL, 0) : 64) << 20;
+
+	bench( sizeof buffer[0]);
+	bench( 96);
+
+	return 0;
+}
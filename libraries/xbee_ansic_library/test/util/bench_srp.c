@@ -0,0 +1,101 @@
+/*
+	Time to complete SRP handshakes between an SRPUser and an SRPVerifier,
+	split into each side's share of the work, as when bringing up Secure
+	Sessions with a fleet of nodes.
+
+	Usage: bench_srp [handshakes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xbee/platform.h"
+#include "util/srp.h"
+
+#define USERNAME     "xbee"
+#define PASSWORD     "passw0rd"
+
+static double now( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main( int argc, char *argv[])
+{
+	const unsigned char *bytes_s, *bytes_v, *bytes_A, *bytes_B, *bytes_M;
+	const unsigned char *bytes_HAMK;
+	const char *username;
+	struct SRPVerifier *ver;
+	struct SRPUser *usr;
+	int len_s, len_v, len_A, len_B, len_M;
+	int handshakes, i, failures = 0;
+	double start, user = 0, verifier = 0, t;
+
+	handshakes = argc > 1 ? atoi( argv[1]) : 20;
+
+	t = now();
+	srp_group_init();
+	printf( "%-32s %8.2f ms\n", "group tables", (now() - t) * 1e3);
+
+	t = now();
+	srp_create_salted_verification_key( USERNAME,
+		(const unsigned char *) PASSWORD, strlen( PASSWORD),
+		&bytes_s, &len_s, &bytes_v, &len_v);
+	printf( "%-32s %8.2f ms\n", "create verification key",
+		(now() - t) * 1e3);
+
+	start = now();
+	for (i = 0; i < handshakes; ++i)
+	{
+		t = now();
+		usr = srp_user_new( USERNAME, (const unsigned char *) PASSWORD,
+			strlen( PASSWORD));
+		srp_user_start_authentication( usr, &username, &bytes_A, &len_A);
+		user += now() - t;
+
+		t = now();
+		ver = srp_verifier_new( username, bytes_s, len_s, bytes_v, len_v,
+			bytes_A, len_A, &bytes_B, &len_B);
+		verifier += now() - t;
+
+		t = now();
+		srp_user_process_challenge( usr, bytes_s, len_s, bytes_B, len_B,
+			&bytes_M, &len_M);
+		user += now() - t;
+
+		t = now();
+		srp_verifier_verify_session( ver, bytes_M, &bytes_HAMK);
+		verifier += now() - t;
+
+		t = now();
+		srp_user_verify_session( usr, bytes_HAMK);
+		user += now() - t;
+
+		failures += ! srp_user_is_authenticated( usr);
+
+		srp_user_delete( usr);
+		srp_verifier_delete( ver);
+	}
+
+	printf( "%-32s %8.2f ms\n", "handshake, user side",
+		user / handshakes * 1e3);
+	printf( "%-32s %8.2f ms\n", "handshake, verifier side",
+		verifier / handshakes * 1e3);
+	printf( "%-32s %8.2f ms\n", "handshake, total",
+		(now() - start) / handshakes * 1e3);
+
+	free( (void *) bytes_s);
+	free( (void *) bytes_v);
+
+	if (failures)
+	{
+		printf( "%d of %d handshakes failed\n", failures, handshakes);
+	}
+
+	return failures != 0;
+}
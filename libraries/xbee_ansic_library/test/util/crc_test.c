@@ -4,7 +4,19 @@
 #include <time.h>
 #include "crc_test.h"
 
+// Bit-wise XMODEM CRC to check crc16_calc() against.
+static uint16_t xmodem_bit(uint16_t crc, void const *mem, size_t len) {
+    uint8_t const *data = mem;
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (size_t k = 0; k < 8; k++)
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
 int main(void) {
+    int errors = 0;
     unsigned char data[31];
     srandom(time(NULL));
     {
@@ -22,19 +34,51 @@ int main(void) {
     // crc16buypass
     init = crc16buypass_bit(0, NULL, 0);
     if (crc16buypass_bit(init, "123456789", 9) != 0xfee8)
-        fputs("bit-wise mismatch for crc16buypass\n", stderr);
+        errors++, fputs("bit-wise mismatch for crc16buypass\n", stderr);
     crc = crc16buypass_bit(init, data + 1, sizeof(data) - 1);
     if (crc16buypass_bit(init, "\xda", 1) !=
         crc16buypass_rem(crc16buypass_rem(init, 0xda, 3), 0xd0, 5))
-        fputs("small bits mismatch for crc16buypass\n", stderr);
+        errors++, fputs("small bits mismatch for crc16buypass\n", stderr);
     if (crc16buypass_byte(0, NULL, 0) != init ||
         crc16buypass_byte(init, "123456789", 9) != 0xfee8 ||
         crc16buypass_byte(init, data + 1, sizeof(data) - 1) != crc)
-        fputs("byte-wise mismatch for crc16buypass\n", stderr);
+        errors++, fputs("byte-wise mismatch for crc16buypass\n", stderr);
     if (crc16buypass_word(0, NULL, 0) != init ||
         crc16buypass_word(init, "123456789", 9) != 0xfee8 ||
         crc16buypass_word(init, data + 1, sizeof(data) - 1) != crc)
-        fputs("word-wise mismatch for crc16buypass\n", stderr);
+        errors++, fputs("word-wise mismatch for crc16buypass\n", stderr);
+
+    // xmodem
+    if (crc16_calc("123456789", 9, 0) != 0x31c3 ||
+        crc16_calc(data + 1, sizeof(data) - 1, 0) !=
+        xmodem_bit(0, data + 1, sizeof(data) - 1))
+        errors++, fputs("table mismatch for xmodem\n", stderr);
+
+    // long buffers at every alignment, through the slicing and folding paths
+    {
+        static unsigned char big[4096 + 64];
+        size_t n, off, len;
+        for (n = 0; n < sizeof(big); n++)
+            big[n] = random();
+        for (off = 0; off < 16; off++)
+            for (len = 0; len < 600; len += 1 + len / 8) {
+                if (crc16buypass_word(0x1234, big + off, len) !=
+                    crc16buypass_bit(0x1234, big + off, len))
+                    errors++, fprintf(stderr,
+                        "word-wise mismatch for crc16buypass (%zu@%zu)\n",
+                        len, off);
+                if (crc16_calc(big + off, len, 0xffff) !=
+                    xmodem_bit(0xffff, big + off, len))
+                    errors++, fprintf(stderr,
+                        "mismatch for xmodem (%zu@%zu)\n", len, off);
+            }
+        if (crc16buypass_word(0, big + 3, 4096) !=
+            crc16buypass_bit(0, big + 3, 4096) ||
+            crc16_calc(big + 3, 4096, 0) != xmodem_bit(0, big + 3, 4096))
+            errors++, fputs("page-size mismatch\n", stderr);
+    }
 
-    return 0;
+    if (errors == 0)
+        puts("crc_test: all CRCs match");
+    return errors != 0;
 }
@@ -1 +1,2 @@
-#include "crc16buypass.h"
+#include "util/crc16buypass.h"
+#include "xbee/xmodem_crc16.h"
@@ -0,0 +1,8 @@
+// mbedtls configuration for t_sha256_sw: the library's configuration
+// without the SHA-256 instructions, so the tests reach the C block function
+// and the SIMD lanes of mbedtls_sha256_ret_multi() on any CPU.
+
+#include "mbedtls/config.h"
+
+#undef MBEDTLS_SHA256_USE_SHA_NI_IF_PRESENT
+#undef MBEDTLS_SHA256_USE_ARMV8_A_CRYPTO_IF_PRESENT
@@ -0,0 +1,207 @@
+// Known-answer tests for the bundled mbedtls AES (FIPS-197 appendix C and
+// SP 800-38A F.5.1), run through whichever of the table, AES-NI or Armv8-A
+// code paths this CPU selects, plus the multi-block ECB and batched CTR
+// routines against single-block ECB.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/aesni.h"
+#include "mbedtls/aesce.h"
+
+#include "../unittest.h"
+
+static const uint8_t fips_plain[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+
+static const uint8_t fips_cipher[3][16] = {
+    { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+      0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a },     // AES-128
+    { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0,
+      0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 },     // AES-192
+    { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+      0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 },     // AES-256
+};
+
+static const uint8_t ctr_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t ctr_counter[16] = {
+    0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+    0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+
+static const uint8_t ctr_plain[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+    0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+    0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+    0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static const uint8_t ctr_cipher[64] = {
+    0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26,
+    0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+    0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff,
+    0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+    0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e,
+    0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+    0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1,
+    0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+
+void t_fips197( void)
+{
+    mbedtls_aes_context ctx;
+    uint8_t key[32], out[16];
+    int i, bits;
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_AESNI_HAVE_CODE)
+    printf( "AES-NI: %s\n",
+        mbedtls_aesni_has_support( MBEDTLS_AESNI_AES) ? "yes" : "no");
+#elif defined(MBEDTLS_AESCE_C) && defined(MBEDTLS_AESCE_HAVE_CODE)
+    printf( "Armv8-A AES: %s\n", mbedtls_aesce_has_support() ? "yes" : "no");
+#endif
+
+    for (i = 0; i < 32; ++i)
+    {
+        key[i] = i;
+    }
+
+    mbedtls_aes_init( &ctx);
+    for (i = 0; i < 3; ++i)
+    {
+        bits = 128 + 64 * i;
+
+        mbedtls_aes_setkey_enc( &ctx, key, bits);
+        mbedtls_aes_crypt_ecb( &ctx, MBEDTLS_AES_ENCRYPT, fips_plain, out);
+        test_compare( memcmp( out, fips_cipher[i], 16), 0, NULL, "encrypt");
+
+        mbedtls_aes_setkey_dec( &ctx, key, bits);
+        mbedtls_aes_crypt_ecb( &ctx, MBEDTLS_AES_DECRYPT, fips_cipher[i], out);
+        test_compare( memcmp( out, fips_plain, 16), 0, NULL, "decrypt");
+    }
+    test_compare( mbedtls_aes_setkey_enc( &ctx, key, 64),
+        MBEDTLS_ERR_AES_INVALID_KEY_LENGTH, NULL, "bad key length");
+    mbedtls_aes_free( &ctx);
+}
+
+void t_ecb_blocks( void)
+{
+    mbedtls_aes_context enc, dec;
+    uint8_t key[32], in[16 * 9], out[16 * 9], expected[16 * 9];
+    int bits, blocks, i, errors = 0;
+
+    for (i = 0; i < (int) sizeof in; ++i)
+    {
+        in[i] = (uint8_t) rand();
+    }
+    for (i = 0; i < 32; ++i)
+    {
+        key[i] = (uint8_t) rand();
+    }
+
+    mbedtls_aes_init( &enc);
+    mbedtls_aes_init( &dec);
+    for (bits = 128; bits <= 256; bits += 64)
+    {
+        mbedtls_aes_setkey_enc( &enc, key, bits);
+        mbedtls_aes_setkey_dec( &dec, key, bits);
+        for (blocks = 0; blocks <= 9; ++blocks)
+        {
+            for (i = 0; i < blocks; ++i)
+            {
+                mbedtls_aes_crypt_ecb( &enc, MBEDTLS_AES_ENCRYPT, in + 16 * i,
+                    expected + 16 * i);
+            }
+            mbedtls_aes_crypt_ecb_blocks( &enc, MBEDTLS_AES_ENCRYPT,
+                16 * blocks, in, out);
+            errors += memcmp( out, expected, 16 * blocks) != 0;
+
+            // decrypt in place
+            mbedtls_aes_crypt_ecb_blocks( &dec, MBEDTLS_AES_DECRYPT,
+                16 * blocks, out, out);
+            errors += memcmp( out, in, 16 * blocks) != 0;
+        }
+    }
+    test_compare( errors, 0, NULL, "blocks match single-block ECB");
+    test_compare( mbedtls_aes_crypt_ecb_blocks( &enc, MBEDTLS_AES_ENCRYPT, 17,
+        in, out), MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH, NULL,
+        "partial block");
+
+    mbedtls_aes_free( &enc);
+    mbedtls_aes_free( &dec);
+}
+
+void t_ctr( void)
+{
+    mbedtls_aes_context ctx;
+    uint8_t counter[16], stream[16], out[64];
+    uint8_t big[1000], big_out[1000], split_out[1000];
+    size_t off, pos, chunk;
+    int i;
+
+    mbedtls_aes_init( &ctx);
+    mbedtls_aes_setkey_enc( &ctx, ctr_key, 128);
+
+    memcpy( counter, ctr_counter, 16);
+    off = 0;
+    mbedtls_aes_crypt_ctr( &ctx, 64, &off, counter, stream, ctr_plain, out);
+    test_compare( memcmp( out, ctr_cipher, 64), 0, NULL, "SP 800-38A F.5.1");
+    test_compare( off, 0, NULL, "offset");
+
+    // odd-sized pieces give the same stream as one call
+    for (i = 0; i < (int) sizeof big; ++i)
+    {
+        big[i] = (uint8_t) i;
+    }
+    memcpy( counter, ctr_counter, 16);
+    off = 0;
+    mbedtls_aes_crypt_ctr( &ctx, sizeof big, &off, counter, stream, big,
+        big_out);
+    test_compare( off, sizeof big % 16, NULL, "offset after 1000 bytes");
+
+    memcpy( counter, ctr_counter, 16);
+    off = 0;
+    for (pos = 0, chunk = 1; pos < sizeof big; pos += chunk, chunk += 7)
+    {
+        if (chunk > sizeof big - pos)
+        {
+            chunk = sizeof big - pos;
+        }
+        mbedtls_aes_crypt_ctr( &ctx, chunk, &off, counter, stream, big + pos,
+            split_out + pos);
+    }
+    test_compare( memcmp( split_out, big_out, sizeof big), 0, NULL,
+        "split calls");
+
+    // in place, and decrypting restores the plaintext
+    memcpy( counter, ctr_counter, 16);
+    off = 0;
+    mbedtls_aes_crypt_ctr( &ctx, sizeof big, &off, counter, stream, big_out,
+        big_out);
+    test_compare( memcmp( big_out, big, sizeof big), 0, NULL, "round trip");
+
+    mbedtls_aes_free( &ctx);
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_fips197);
+    failures += DO_TEST( t_ecb_blocks);
+    failures += DO_TEST( t_ctr);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,167 @@
+// Test the bundled mbedtls Montgomery multiplication and fixed-base comb
+// exponentiation against the sliding-window mbedtls_mpi_exp_mod(), using
+// the 1024-bit SRP group and a small odd modulus.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "mbedtls/bignum.h"
+
+#include "../unittest.h"
+
+// RFC 5054 1024-bit group, as used by util/srp.c
+static const char srp_n_hex[] =
+    "EEAF0AB9ADB38DD69C33F80AFA8FC5E86072618775FF3C0B9EA2314C9C256576D674DF7496"
+    "EA81D3383B4813D692C6E0E0D5D8E250B98BE48E495C1D6089DAD15DC7D7B46154D6B6CE8E"
+    "F4AD69B15D4982559B297BCF1885C529F566660E57EC68EDBC3C05726CC02FD4CBF4976EAA"
+    "9AFD5138FE8376435B9FC61D2FC0EB06E3";
+
+static int rng( void *ctx, unsigned char *buf, size_t len)
+{
+    while (len--)
+    {
+        *buf++ = (unsigned char) rand();
+    }
+    return 0;
+}
+
+// Compare the comb with mbedtls_mpi_exp_mod() for exponents of 0 to
+// max_bits + 64 bits, the widest ones taking the fallback.
+static int comb_errors( const mbedtls_mpi *G, const mbedtls_mpi *N,
+    size_t max_bits)
+{
+    mbedtls_mpi_comb comb;
+    mbedtls_mpi E, X, Y;
+    size_t bits;
+    int errors = 0;
+
+    mbedtls_mpi_comb_init( &comb);
+    mbedtls_mpi_init( &E);
+    mbedtls_mpi_init( &X);
+    mbedtls_mpi_init( &Y);
+
+    if (mbedtls_mpi_comb_setup( &comb, G, N, max_bits) != 0)
+    {
+        return 1;
+    }
+
+    for (bits = 0; bits <= max_bits + 64; bits += 7)
+    {
+        mbedtls_mpi_fill_random( &E, (bits + 7) / 8, rng, NULL);
+        mbedtls_mpi_shift_r( &E, (8 - bits % 8) % 8);
+        errors += mbedtls_mpi_exp_mod_comb( &X, &comb, &E) != 0;
+        errors += mbedtls_mpi_exp_mod( &Y, G, &E, N, NULL) != 0;
+        errors += mbedtls_mpi_cmp_mpi( &X, &Y) != 0;
+    }
+
+    // all ones, so every lookup takes the last table entry
+    mbedtls_mpi_lset( &E, 1);
+    mbedtls_mpi_shift_l( &E, max_bits);
+    mbedtls_mpi_sub_int( &E, &E, 1);
+    errors += mbedtls_mpi_exp_mod_comb( &X, &comb, &E) != 0;
+    errors += mbedtls_mpi_exp_mod( &Y, G, &E, N, NULL) != 0;
+    errors += mbedtls_mpi_cmp_mpi( &X, &Y) != 0;
+
+    mbedtls_mpi_comb_free( &comb);
+    mbedtls_mpi_free( &E);
+    mbedtls_mpi_free( &X);
+    mbedtls_mpi_free( &Y);
+
+    return errors;
+}
+
+void t_comb_srp( void)
+{
+    mbedtls_mpi G, N;
+
+    mbedtls_mpi_init( &G);
+    mbedtls_mpi_init( &N);
+    mbedtls_mpi_read_string( &N, 16, srp_n_hex);
+
+    mbedtls_mpi_lset( &G, 2);
+    test_compare( comb_errors( &G, &N, 256), 0, NULL, "g = 2, 256 bits");
+
+    // a full-width base, bigger than N so setup has to reduce it
+    mbedtls_mpi_fill_random( &G, 136, rng, NULL);
+    test_compare( comb_errors( &G, &N, 1024), 0, NULL,
+        "random base, 1024 bits");
+
+    mbedtls_mpi_free( &G);
+    mbedtls_mpi_free( &N);
+}
+
+void t_comb_small( void)
+{
+    mbedtls_mpi G, N;
+
+    mbedtls_mpi_init( &G);
+    mbedtls_mpi_init( &N);
+
+    // single-limb modulus, and fewer exponent bits than teeth
+    mbedtls_mpi_lset( &N, 1000003);
+    mbedtls_mpi_lset( &G, 12345);
+    test_compare( comb_errors( &G, &N, 3), 0, NULL, "3 bits");
+    test_compare( comb_errors( &G, &N, 61), 0, NULL, "61 bits");
+
+    mbedtls_mpi_free( &G);
+    mbedtls_mpi_free( &N);
+}
+
+void t_comb_errors( void)
+{
+    mbedtls_mpi_comb comb;
+    mbedtls_mpi G, N, E, X;
+
+    mbedtls_mpi_comb_init( &comb);
+    mbedtls_mpi_init( &G);
+    mbedtls_mpi_init( &N);
+    mbedtls_mpi_init( &E);
+    mbedtls_mpi_init( &X);
+
+    mbedtls_mpi_lset( &G, 2);
+    mbedtls_mpi_lset( &E, 5);
+    test_compare( mbedtls_mpi_exp_mod_comb( &X, &comb, &E),
+        MBEDTLS_ERR_MPI_BAD_INPUT_DATA, "%d", "not set up");
+
+    mbedtls_mpi_lset( &N, 1000000);
+    test_compare( mbedtls_mpi_comb_setup( &comb, &G, &N, 64),
+        MBEDTLS_ERR_MPI_BAD_INPUT_DATA, "%d", "even modulus");
+
+    mbedtls_mpi_lset( &N, 1000003);
+    test_compare( mbedtls_mpi_comb_setup( &comb, &G, &N, 0),
+        MBEDTLS_ERR_MPI_BAD_INPUT_DATA, "%d", "no exponent bits");
+
+    test_compare( mbedtls_mpi_comb_setup( &comb, &G, &N, 64), 0, "%d",
+        "setup");
+    mbedtls_mpi_lset( &E, -5);
+    test_compare( mbedtls_mpi_exp_mod_comb( &X, &comb, &E),
+        MBEDTLS_ERR_MPI_BAD_INPUT_DATA, "%d", "negative exponent");
+
+    // 2^0 and 2^10 mod 1000003
+    mbedtls_mpi_lset( &E, 0);
+    mbedtls_mpi_exp_mod_comb( &X, &comb, &E);
+    test_compare( mbedtls_mpi_cmp_int( &X, 1), 0, NULL, "2^0");
+    mbedtls_mpi_lset( &E, 10);
+    mbedtls_mpi_exp_mod_comb( &X, &comb, &E);
+    test_compare( mbedtls_mpi_cmp_int( &X, 1024), 0, NULL, "2^10");
+
+    mbedtls_mpi_comb_free( &comb);
+    mbedtls_mpi_comb_free( NULL);
+    mbedtls_mpi_free( &G);
+    mbedtls_mpi_free( &N);
+    mbedtls_mpi_free( &E);
+    mbedtls_mpi_free( &X);
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_comb_srp);
+    failures += DO_TEST( t_comb_small);
+    failures += DO_TEST( t_comb_errors);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,133 @@
+// Unit tests for the buffered xbee_random() streams, including several
+// threads drawing from xbee_random() at once.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/random.h"
+#include "../unittest.h"
+
+#define THREADS         4
+#define THREAD_DRAWS    2000
+
+static xbee_random_stream_t stream_a, stream_b;
+
+static bool_t all_zero( const uint8_t *p, size_t len)
+{
+    while (len--)
+    {
+        if (*p++ != 0)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void t_stream( void)
+{
+    static uint8_t a[3000], b[3000];
+    size_t len;
+    int errors = 0;
+
+    test_compare( xbee_random_stream( &stream_a, a, 0), 0, NULL,
+        "empty request");
+    test_bool( stream_a.seeded, "seeded on first use");
+    test_compare( stream_a.avail, 0, NULL, "nothing buffered yet");
+
+    // small requests come from the buffer and wipe what they take
+    test_compare( xbee_random_stream( &stream_a, a, 20), 0, NULL, "20 bytes");
+    test_compare( stream_a.avail, XBEE_RANDOM_BUFFER_SIZE - 20, NULL,
+        "buffer refilled");
+    test_bool( all_zero( stream_a.buffer, 20), "used bytes wiped");
+    test_bool( ! all_zero( a, 20), "output isn't zero");
+
+    // requests that span refills, with and without a buffer's worth
+    for (len = 1; len <= sizeof a; len += len / 2 + 1)
+    {
+        memset( a, 0, sizeof a);
+        errors += xbee_random_stream( &stream_a, a, len) != 0;
+        errors += len >= 16 && all_zero( &a[len - 16], 16);
+    }
+    test_compare( errors, 0, NULL, "assorted lengths");
+    test_bool( stream_a.avail < XBEE_RANDOM_BUFFER_SIZE, "buffer in use");
+    test_bool( all_zero( stream_a.buffer,
+        XBEE_RANDOM_BUFFER_SIZE - stream_a.avail), "all used bytes wiped");
+
+    // separate streams produce separate sequences
+    xbee_random_stream( &stream_a, a, 64);
+    xbee_random_stream( &stream_b, b, 64);
+    test_bool( memcmp( a, b, 64) != 0, "streams differ");
+}
+
+void t_stream_free( void)
+{
+    uint8_t a[32];
+
+    xbee_random_stream( &stream_b, a, sizeof a);
+    xbee_random_stream_free( &stream_b);
+    test_bool( ! stream_b.seeded, "not seeded after free");
+    test_bool( all_zero( (const uint8_t *) &stream_b, sizeof stream_b),
+        "stream wiped");
+    test_compare( xbee_random_stream( &stream_b, a, sizeof a), 0, NULL,
+        "reseeded after free");
+}
+
+static uint8_t first_draw[THREADS][16];
+
+static void *draw_thread( void *arg)
+{
+    uint8_t *first = arg;
+    uint8_t buf[37];
+    intptr_t errors = 0;
+    int i;
+
+    errors += xbee_random( first, 16) != 0;
+    for (i = 0; i < THREAD_DRAWS; ++i)
+    {
+        errors += xbee_random( buf, 1 + i % sizeof buf) != 0;
+    }
+
+    return (void *) errors;
+}
+
+void t_threads( void)
+{
+    pthread_t thread[THREADS];
+    void *result;
+    intptr_t errors = 0;
+    int i, j, same = 0;
+
+    for (i = 0; i < THREADS; ++i)
+    {
+        pthread_create( &thread[i], NULL, draw_thread, first_draw[i]);
+    }
+    for (i = 0; i < THREADS; ++i)
+    {
+        pthread_join( thread[i], &result);
+        errors += (intptr_t) result;
+    }
+    test_compare( errors, 0, NULL, "xbee_random() in threads");
+
+    for (i = 0; i < THREADS; ++i)
+    {
+        for (j = i + 1; j < THREADS; ++j)
+        {
+            same += memcmp( first_draw[i], first_draw[j], 16) == 0;
+        }
+    }
+    test_compare( same, 0, NULL, "threads got different bytes");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_stream);
+    failures += DO_TEST( t_stream_free);
+    failures += DO_TEST( t_threads);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,175 @@
+// Known-answer tests for the bundled mbedtls SHA-256 (FIPS 180-2 examples),
+// run through whichever of the C, SHA-NI or Armv8-A block functions this CPU
+// selects, plus mbedtls_sha256_ret_multi() against one message at a time.
+// Linked with sha256_sw.o as t_sha256_sw, the same tests cover the SIMD lanes
+// used when the CPU doesn't have SHA-256 instructions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "mbedtls/sha256.h"
+
+#include "../unittest.h"
+
+static const uint8_t sha256_abc[32] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+    0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+    0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+
+static const uint8_t sha256_448[32] = {
+    0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+    0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+    0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+    0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+};
+
+static const uint8_t sha256_empty[32] = {
+    0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+    0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+    0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+    0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55
+};
+
+static const uint8_t sha256_million_a[32] = {
+    0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+    0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+    0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+    0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+};
+
+static const uint8_t sha224_abc[28] = {
+    0x23, 0x09, 0x7d, 0x22, 0x34, 0x05, 0xd8, 0x22,
+    0x86, 0x42, 0xa4, 0x77, 0xbd, 0xa2, 0x55, 0xb3,
+    0x2a, 0xad, 0xbc, 0xe4, 0xbd, 0xa0, 0xb3, 0xf7,
+    0xe3, 0x6c, 0x9d, 0xa7
+};
+
+static const char msg_448[] =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+void t_fips180( void)
+{
+    mbedtls_sha256_context ctx;
+    uint8_t md[32], a[1000];
+    int i;
+
+    mbedtls_sha256_ret( (const uint8_t *) "abc", 3, md, 0);
+    test_compare( memcmp( md, sha256_abc, 32), 0, NULL, "abc");
+
+    mbedtls_sha256_ret( (const uint8_t *) msg_448, 56, md, 0);
+    test_compare( memcmp( md, sha256_448, 32), 0, NULL, "448 bits");
+
+    mbedtls_sha256_ret( NULL, 0, md, 0);
+    test_compare( memcmp( md, sha256_empty, 32), 0, NULL, "empty");
+
+    mbedtls_sha256_ret( (const uint8_t *) "abc", 3, md, 1);
+    test_compare( memcmp( md, sha224_abc, 28), 0, NULL, "SHA-224 abc");
+
+    memset( a, 'a', sizeof a);
+    mbedtls_sha256_init( &ctx);
+    mbedtls_sha256_starts_ret( &ctx, 0);
+    for (i = 0; i < 1000; ++i)
+    {
+        mbedtls_sha256_update_ret( &ctx, a, sizeof a);
+    }
+    mbedtls_sha256_finish_ret( &ctx, md);
+    mbedtls_sha256_free( &ctx);
+    test_compare( memcmp( md, sha256_million_a, 32), 0, NULL,
+        "one million a");
+}
+
+void t_split( void)
+{
+    mbedtls_sha256_context ctx;
+    uint8_t data[1000], md[32], expected[32];
+    size_t pos, chunk;
+    int i;
+
+    for (i = 0; i < (int) sizeof data; ++i)
+    {
+        data[i] = (uint8_t) rand();
+    }
+    mbedtls_sha256_ret( data, sizeof data, expected, 0);
+
+    // pieces that start and end everywhere within a block
+    mbedtls_sha256_init( &ctx);
+    mbedtls_sha256_starts_ret( &ctx, 0);
+    for (pos = 0, chunk = 1; pos < sizeof data; pos += chunk, chunk += 13)
+    {
+        if (chunk > sizeof data - pos)
+        {
+            chunk = sizeof data - pos;
+        }
+        mbedtls_sha256_update_ret( &ctx, data + pos, chunk);
+    }
+    mbedtls_sha256_finish_ret( &ctx, md);
+    mbedtls_sha256_free( &ctx);
+    test_compare( memcmp( md, expected, 32), 0, NULL, "split updates");
+}
+
+#define MULTI_COUNT     19
+
+void t_multi( void)
+{
+    static uint8_t data[MULTI_COUNT][300];
+    const unsigned char *input[MULTI_COUNT];
+    unsigned char *output[MULTI_COUNT];
+    uint8_t md[MULTI_COUNT][32], expected[32];
+    size_t ilen[MULTI_COUNT];
+    int count, i, is224, errors = 0;
+
+    for (i = 0; i < MULTI_COUNT; ++i)
+    {
+        memset( data[i], (uint8_t) rand(), sizeof data[i]);
+        input[i] = data[i];
+        output[i] = md[i];
+    }
+
+    // every count from none to more than two rounds of 8 lanes, with
+    // lengths on both sides of the one- and two-block padding cases
+    for (is224 = 0; is224 <= 1; ++is224)
+    {
+        for (count = 0; count <= MULTI_COUNT; ++count)
+        {
+            for (i = 0; i < count; ++i)
+            {
+                ilen[i] = (size_t) (count * 37 + i * 55) % sizeof data[i];
+            }
+            test_compare( mbedtls_sha256_ret_multi( input, ilen, output,
+                count, is224), 0, NULL, "return value");
+            for (i = 0; i < count; ++i)
+            {
+                mbedtls_sha256_ret( input[i], ilen[i], expected, is224);
+                errors += memcmp( md[i], expected, is224 ? 28 : 32) != 0;
+            }
+        }
+    }
+    test_compare( errors, 0, NULL, "multi matches single");
+
+    // known answers through the lanes
+    input[0] = (const uint8_t *) "abc";
+    ilen[0] = 3;
+    input[1] = (const uint8_t *) msg_448;
+    ilen[1] = 56;
+    input[2] = NULL;
+    ilen[2] = 0;
+    mbedtls_sha256_ret_multi( input, ilen, output, 3, 0);
+    test_compare( memcmp( md[0], sha256_abc, 32), 0, NULL, "multi abc");
+    test_compare( memcmp( md[1], sha256_448, 32), 0, NULL, "multi 448 bits");
+    test_compare( memcmp( md[2], sha256_empty, 32), 0, NULL, "multi empty");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_fips180);
+    failures += DO_TEST( t_split);
+    failures += DO_TEST( t_multi);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,148 @@
+// Unit tests for the AT command request table: free list, per-device
+// lists of outstanding requests and handle sequence numbers.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/atcmd.h"
+#include "../unittest.h"
+
+static xbee_dev_t dev_a, dev_b;
+static int16_t handles[XBEE_CMD_REQUEST_TABLESIZE];
+
+static int callback_count;
+static const xbee_dev_t *callback_device;
+
+int count_callback( const xbee_cmd_response_t FAR *response)
+{
+    ++callback_count;
+    callback_device = response->device;
+    return XBEE_ATCMD_DONE;
+}
+
+// Devices that skip xbee_dev_init() and xbee_cmd_init_device(), so nothing
+// is ever written to a serial port.
+void reset_devices( void)
+{
+    memset( &dev_a, 0, sizeof dev_a);
+    memset( &dev_b, 0, sizeof dev_b);
+    dev_a.flags = dev_b.flags = XBEE_DEV_FLAG_CMD_INIT;
+}
+
+void release_all( void)
+{
+    int i;
+
+    for (i = 0; i < XBEE_CMD_REQUEST_TABLESIZE; ++i)
+    {
+        xbee_cmd_release_handle( handles[i]);
+    }
+}
+
+void t_fill_table( void)
+{
+    int i;
+    char errmsg[80];
+
+    reset_devices();
+    for (i = 0; i < XBEE_CMD_REQUEST_TABLESIZE; ++i)
+    {
+        handles[i] = xbee_cmd_create( (i & 1) ? &dev_b : &dev_a, "VR");
+        sprintf( errmsg, "create %d failed (%d)", i, handles[i]);
+        test_bool( handles[i] >= 0, errmsg);
+    }
+    test_compare( xbee_cmd_create( &dev_a, "VR"), -ENOSPC, NULL,
+        "create on full table");
+    test_compare( dev_a.cmd_active_count + dev_b.cmd_active_count,
+        XBEE_CMD_REQUEST_TABLESIZE, NULL, "active count");
+    test_compare( dev_b.cmd_active_count, XBEE_CMD_REQUEST_TABLESIZE / 2,
+        NULL, "dev_b active count");
+
+    test_compare( xbee_cmd_release_device( &dev_b),
+        XBEE_CMD_REQUEST_TABLESIZE / 2, NULL, "release dev_b");
+    test_compare( dev_b.cmd_active, 0, NULL, "dev_b list not empty");
+    test_bool( xbee_cmd_release_handle( handles[1]) == -EINVAL,
+        "dev_b handle still valid");
+
+    release_all();
+    test_compare( dev_a.cmd_active_count, 0, NULL, "dev_a not empty");
+    test_compare( dev_b.cmd_active_count, 0, NULL, "dev_b not empty");
+    test_compare( dev_a.cmd_active, 0, NULL, "dev_a list not empty");
+}
+
+void t_stale_handle( void)
+{
+    int16_t handle, reused;
+
+    reset_devices();
+    handle = xbee_cmd_create( &dev_a, "NI");
+    test_bool( handle >= 0, "create failed");
+    test_compare( xbee_cmd_release_handle( handle), 0, NULL, "release failed");
+    test_compare( xbee_cmd_release_handle( handle), -EINVAL, NULL,
+        "double release allowed");
+    test_compare( xbee_cmd_set_command( handle, "NI"), -EINVAL, NULL,
+        "stale handle accepted");
+    test_compare( xbee_cmd_set_timeout( handle, 5), -EINVAL, NULL,
+        "stale handle accepted by set_timeout");
+
+    // slot goes back to the head of the free list with a new sequence
+    reused = xbee_cmd_create( &dev_b, "NI");
+    test_compare( reused >> 8, handle >> 8, NULL, "slot not reused");
+    test_bool( reused != handle, "sequence not advanced");
+    test_compare( xbee_cmd_release_handle( reused), 0, NULL,
+        "release reused failed");
+}
+
+void t_response_match( void)
+{
+    int16_t handle_a, handle_b;
+    xbee_cmd_request_t FAR *request;
+    xbee_frame_local_at_resp_t frame;
+
+    reset_devices();
+    handle_a = xbee_cmd_create( &dev_a, "NP");
+    handle_b = xbee_cmd_create( &dev_b, "NP");
+    xbee_cmd_set_callback( handle_a, count_callback, NULL);
+    xbee_cmd_set_callback( handle_b, count_callback, NULL);
+
+    // both requests "sent" with the same frame ID on different devices
+    request = _xbee_cmd_handle_to_address( handle_a);
+    request->frame_id = 7;
+    request = _xbee_cmd_handle_to_address( handle_b);
+    request->frame_id = 7;
+
+    memset( &frame, 0, sizeof frame);
+    frame.header.frame_type = XBEE_FRAME_LOCAL_AT_RESPONSE;
+    frame.header.frame_id = 7;
+    frame.header.command.w = request->command.w;
+    frame.header.status = XBEE_AT_RESP_SUCCESS;
+    frame.value[0] = 100;
+
+    callback_count = 0;
+    _xbee_cmd_handle_response( &dev_b, &frame, sizeof frame, NULL);
+    test_compare( callback_count, 1, NULL, "callback not called");
+    test_bool( callback_device == &dev_b, "wrong device matched");
+    test_compare( dev_b.cmd_active_count, 0, NULL, "dev_b request not freed");
+    test_compare( dev_a.cmd_active_count, 1, NULL, "dev_a request freed");
+
+    // no more requests on dev_b, so a duplicate response is ignored
+    _xbee_cmd_handle_response( &dev_b, &frame, sizeof frame, NULL);
+    test_compare( callback_count, 1, NULL, "duplicate response matched");
+
+    _xbee_cmd_handle_response( &dev_a, &frame, sizeof frame, NULL);
+    test_compare( callback_count, 2, NULL, "dev_a response not matched");
+    test_compare( dev_a.cmd_active_count, 0, NULL, "dev_a request not freed");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_fill_table);
+    failures += DO_TEST( t_stale_handle);
+    failures += DO_TEST( t_response_match);
+
+    return test_exit( failures);
+}
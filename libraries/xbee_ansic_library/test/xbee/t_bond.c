@@ -0,0 +1,247 @@
+// Unit tests for link bonding: striping by credit, Transmit Status
+// accounting, in-order reassembly on the receiver and a sender that
+// restarts its sequence numbers.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xbee/platform.h"
+#include "xbee/bond.h"
+#include "../unittest.h"
+
+#define LINKS 2
+
+static xbee_dev_t dev[LINKS];
+static int pipe_fd[LINKS][2];
+static xbee_bond_t bond;
+
+static uint8_t delivered[64];
+static int delivered_count;
+
+void record( void FAR *context, const void FAR *payload, uint16_t length)
+{
+    XBEE_UNUSED_PARAMETER( context);
+
+    if (length && delivered_count < (int) sizeof delivered)
+    {
+        delivered[delivered_count++] = *(const uint8_t *) payload;
+    }
+}
+
+// Bonded payload with sequence number <sequence> and a one-byte body.
+int receive( uint16_t sequence)
+{
+    uint8_t payload[3];
+
+    payload[0] = (uint8_t)(sequence >> 8);
+    payload[1] = (uint8_t) sequence;
+    payload[2] = (uint8_t) sequence;
+
+    return xbee_bond_receive( &bond, payload, sizeof payload);
+}
+
+// Transmit Status for the oldest frame waiting on link <index>.
+void tx_status( int index, uint8_t delivery)
+{
+    xbee_frame_transmit_status_t frame;
+    xbee_bond_link_t *link = &bond.link[index];
+    int i;
+
+    memset( &frame, 0, sizeof frame);
+    frame.frame_type = XBEE_FRAME_TRANSMIT_STATUS;
+    frame.delivery = delivery;
+    for (i = 0; i < XBEE_BOND_WINDOW; ++i)
+    {
+        if (link->pending[i].frame_id)
+        {
+            frame.frame_id = link->pending[i].frame_id;
+            break;
+        }
+    }
+    xbee_bond_handle_transmit_status( link->xbee, &frame, sizeof frame,
+        &bond);
+}
+
+// Devices that write frames into a pipe instead of a serial port.
+void setup( void)
+{
+    static const addr64 dest = { { 0, 0x13, 0xA2, 0, 1, 2, 3, 4 } };
+    int i;
+
+    for (i = 0; i < LINKS; ++i)
+    {
+        memset( &dev[i], 0, sizeof dev[i]);
+        if (pipe( pipe_fd[i]) != 0)
+        {
+            perror( "pipe");
+            return;
+        }
+        dev[i].serport.fd = pipe_fd[i][1];
+    }
+    xbee_bond_init( &bond, &dest, record, NULL);
+    delivered_count = 0;
+}
+
+void teardown( void)
+{
+    int i;
+
+    for (i = 0; i < LINKS; ++i)
+    {
+        close( pipe_fd[i][0]);
+        close( pipe_fd[i][1]);
+    }
+}
+
+void t_stripe( void)
+{
+    static const uint8_t sample[10] = { 0 };
+    uint8_t frame[64];
+    int i, sent[LINKS] = { 0 };
+    char errmsg[80];
+
+    setup();
+    test_compare( xbee_bond_send( &bond, sample, sizeof sample), -EINVAL,
+        NULL, "send without links");
+    test_compare( xbee_bond_add_link( &bond, &dev[0]), 0, NULL, "add 0");
+    test_compare( xbee_bond_add_link( &bond, &dev[1]), 1, NULL, "add 1");
+    test_compare( xbee_bond_add_link( &bond, &dev[1]), -EEXIST, NULL,
+        "add twice");
+
+    // links take turns until both windows are full
+    for (i = 0; i < LINKS * XBEE_BOND_WINDOW; ++i)
+    {
+        int link = xbee_bond_send( &bond, sample, sizeof sample);
+        sprintf( errmsg, "send %d", i);
+        test_bool( link >= 0 && link < LINKS, errmsg);
+        if (link >= 0 && link < LINKS)
+        {
+            ++sent[link];
+        }
+    }
+    test_compare( sent[0], XBEE_BOND_WINDOW, NULL, "frames on link 0");
+    test_compare( sent[1], XBEE_BOND_WINDOW, NULL, "frames on link 1");
+    test_compare( xbee_bond_send( &bond, sample, sizeof sample), -EBUSY,
+        NULL, "send with full windows");
+    test_compare( xbee_bond_send( &bond, sample, XBEE_BOND_MAX_PAYLOAD + 1),
+        -EMSGSIZE, NULL, "oversized payload");
+
+    // first frame on the wire: 0x7E, length, 0x11 header, sequence 0
+    test_compare( read( pipe_fd[0][0], frame, 3 + 20 + 2), 3 + 20 + 2, NULL,
+        "read frame");
+    test_compare( frame[3], XBEE_FRAME_TRANSMIT_EXPLICIT, NULL, "frame type");
+    test_compare( frame[17], XBEE_BOND_CLUSTER >> 8, NULL, "cluster msb");
+    test_compare( frame[18], XBEE_BOND_CLUSTER & 0xFF, NULL, "cluster lsb");
+    test_compare( frame[23] << 8 | frame[24], 0, NULL, "sequence");
+
+    // a delivered frame frees credit on that link only
+    tx_status( 1, XBEE_TX_DELIVERY_SUCCESS);
+    test_compare( bond.link[1].delivered, 1, NULL, "link 1 delivered");
+    test_compare( bond.link[1].bytes_delivered, sizeof sample, NULL,
+        "link 1 bytes");
+    test_compare( xbee_bond_send( &bond, sample, sizeof sample), 1, NULL,
+        "send on freed link");
+
+    // failures shrink a link's window
+    for (i = 0; i < XBEE_BOND_WINDOW; ++i)
+    {
+        tx_status( 0, XBEE_TX_DELIVERY_MAC_ACK_FAIL);
+    }
+    test_compare( bond.link[0].failed, XBEE_BOND_WINDOW, NULL,
+        "link 0 failed");
+    test_bool( bond.link[0].loss_permille > 0, "link 0 loss");
+    sent[0] = 0;
+    while (xbee_bond_send( &bond, sample, sizeof sample) == 0)
+    {
+        ++sent[0];
+    }
+    test_bool( sent[0] < XBEE_BOND_WINDOW, "lossy link gets less credit");
+
+    teardown();
+}
+
+void t_reorder( void)
+{
+    setup();
+
+    test_compare( receive( 5), 0, NULL, "receive 5");
+    test_compare( receive( 7), 0, NULL, "receive 7");
+    test_compare( delivered_count, 1, NULL, "7 held for 6");
+    test_compare( receive( 6), 0, NULL, "receive 6");
+    test_compare( delivered_count, 3, NULL, "6 and 7 delivered");
+    test_compare( delivered[1], 6, NULL, "in order [1]");
+    test_compare( delivered[2], 7, NULL, "in order [2]");
+
+    test_compare( receive( 6), 0, NULL, "receive duplicate");
+    test_compare( bond.rx_duplicates, 1, NULL, "duplicate counted");
+
+    // gap at 8 is skipped after XBEE_BOND_GAP_MS
+    receive( 9);
+    xbee_bond_tick( &bond);
+    test_compare( delivered_count, 3, NULL, "9 held");
+    bond.rx_gap_ms -= XBEE_BOND_GAP_MS;
+    xbee_bond_tick( &bond);
+    test_compare( delivered_count, 4, NULL, "9 delivered after gap");
+    test_compare( bond.rx_skipped, 1, NULL, "8 skipped");
+
+    // a sequence beyond the reorder window forces older gaps out
+    receive( 12);
+    receive( 10 + XBEE_BOND_REORDER + 1);
+    test_compare( delivered_count, 5, NULL, "12 pushed out");
+    test_compare( delivered[4], 12, NULL, "12 delivered");
+    test_compare( bond.rx_next, 12 + 1, NULL, "next after push");
+
+    // sequence numbers wrap
+    bond.rx_next = 0xFFFF;
+    bond.rx_held = 0;
+    memset( bond.rx_slot, 0, sizeof bond.rx_slot);
+    receive( 0);
+    receive( 0xFFFF);
+    test_compare( bond.rx_next, 1, NULL, "next after wrap");
+
+    teardown();
+}
+
+void t_restart( void)
+{
+    setup();
+
+    receive( 1000);
+    receive( 1001);
+    receive( 1003);
+    test_compare( delivered_count, 2, NULL, "1003 held for 1002");
+
+    // a late copy (as far back as allowed) is still a duplicate
+    receive( 1002 - 2 * XBEE_BOND_REORDER);
+    test_compare( bond.rx_duplicates, 1, NULL, "late copy dropped");
+    test_compare( bond.rx_resyncs, 0, NULL, "no resync for late copy");
+
+    // sender restarts from 0
+    receive( 0);
+    test_compare( bond.rx_resyncs, 1, NULL, "resynced");
+    test_compare( bond.rx_skipped, 1, NULL, "held 1003 given up");
+    test_compare( bond.rx_held, 0, NULL, "nothing held");
+    receive( 2);
+    receive( 1);
+    test_compare( delivered_count, 5, NULL, "new stream delivered");
+    test_compare( delivered[2], 0, NULL, "in order [2]");
+    test_compare( delivered[3], 1, NULL, "in order [3]");
+    test_compare( delivered[4], 2, NULL, "in order [4]");
+    test_compare( bond.rx_duplicates, 1, NULL, "no new duplicates");
+
+    teardown();
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_stripe);
+    failures += DO_TEST( t_reorder);
+    failures += DO_TEST( t_restart);
+
+    return test_exit( failures);
+}
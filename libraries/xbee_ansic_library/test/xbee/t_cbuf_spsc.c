@@ -0,0 +1,204 @@
+// Unit tests for the lock-free SPSC circular buffer, including a stress
+// test with the producer and consumer on separate threads.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/cbuf_spsc.h"
+#include "../unittest.h"
+
+#define STRESS_BYTES    (4UL * 1024 * 1024)
+
+static xbee_cbuf_spsc_t cbuf;
+static uint8_t space[64];
+
+void t_put_get( void)
+{
+    uint8_t in[64], out[64];
+    unsigned int i;
+
+    for (i = 0; i < sizeof in; ++i)
+    {
+        in[i] = (uint8_t) i;
+    }
+
+    test_compare( xbee_cbuf_spsc_init( &cbuf, space, 48), -EINVAL, NULL,
+        "size not power of 2");
+    test_compare( xbee_cbuf_spsc_init( &cbuf, space, 16), 0, NULL, "init");
+    test_bool( offsetof( xbee_cbuf_spsc_t, head)
+        - offsetof( xbee_cbuf_spsc_t, tail) >= XBEE_CACHE_LINE,
+        "head and tail share a cache line");
+
+    test_compare( xbee_cbuf_spsc_put( &cbuf, in, 20), 16, NULL, "fill");
+    test_compare( xbee_cbuf_spsc_used( &cbuf), 16, NULL, "used when full");
+    test_compare( xbee_cbuf_spsc_free( &cbuf), 0, NULL, "free when full");
+    test_compare( xbee_cbuf_spsc_put( &cbuf, in, 1), 0, NULL, "put on full");
+
+    test_compare( xbee_cbuf_spsc_get( &cbuf, out, 10), 10, NULL, "get 10");
+    test_compare( memcmp( out, in, 10), 0, NULL, "get 10 data");
+
+    // wraps the end of the buffer
+    test_compare( xbee_cbuf_spsc_put( &cbuf, in + 16, 10), 10, NULL,
+        "put wrapped");
+    test_compare( xbee_cbuf_spsc_get( &cbuf, out, 64), 16, NULL,
+        "get wrapped");
+    test_compare( memcmp( out, in + 10, 16), 0, NULL, "get wrapped data");
+    test_compare( xbee_cbuf_spsc_get( &cbuf, out, 1), 0, NULL, "get on empty");
+}
+
+void t_zero_copy( void)
+{
+    uint8_t FAR *w;
+    const uint8_t FAR *r;
+    unsigned int length;
+
+    xbee_cbuf_spsc_init( &cbuf, space, 16);
+    xbee_cbuf_spsc_put( &cbuf, "0123456789AB", 12);
+    xbee_cbuf_spsc_get( &cbuf, space + 32, 8);      // head and tail at 8, 12
+
+    // reservation stops at the end of the buffer
+    length = 0;
+    w = xbee_cbuf_spsc_reserve( &cbuf, &length);
+    test_bool( w == space + 12, "reserve address");
+    test_compare( length, 4, NULL, "reserve up to end");
+    memcpy( w, "CD", 2);
+    test_compare( xbee_cbuf_spsc_used( &cbuf), 4, NULL, "not yet committed");
+    xbee_cbuf_spsc_commit( &cbuf, 2);
+    test_compare( xbee_cbuf_spsc_used( &cbuf), 6, NULL, "committed");
+
+    length = 3;
+    w = xbee_cbuf_spsc_reserve( &cbuf, &length);
+    test_compare( length, 2, NULL, "reserve limited by wrap");
+    memcpy( w, "EF", 2);
+    xbee_cbuf_spsc_commit( &cbuf, 2);
+
+    length = 100;
+    w = xbee_cbuf_spsc_reserve( &cbuf, &length);
+    test_bool( w == space, "reserve after wrap");
+    test_compare( length, 8, NULL, "reserve free space after wrap");
+
+    r = xbee_cbuf_spsc_peek( &cbuf, &length);
+    test_bool( r == space + 8, "peek address");
+    test_compare( length, 8, NULL, "peek up to end");
+    test_compare( memcmp( r, "89ABCDEF", 8), 0, NULL, "peek data");
+    xbee_cbuf_spsc_consume( &cbuf, 8);
+    test_bool( xbee_cbuf_spsc_peek( &cbuf, &length) == NULL, "peek on empty");
+    test_compare( length, 0, NULL, "peek length on empty");
+}
+
+// Byte <n> of the stress stream; not a multiple of the buffer size, so
+// misplaced bytes show up.
+#define STREAM_BYTE(n)  ((uint8_t)((n) * 7 + ((n) >> 11)))
+
+static xbee_cbuf_spsc_t stress;
+static uint8_t stress_space[4096];
+
+void *stress_producer( void *arg)
+{
+    unsigned long sent = 0, before;
+    unsigned int length, i, batch = 1;
+    uint8_t chunk[300];
+    uint8_t FAR *w;
+
+    XBEE_UNUSED_PARAMETER( arg);
+
+    while (sent < STRESS_BYTES)
+    {
+        before = sent;
+        batch = batch % 299 + 1;
+        if (batch > STRESS_BYTES - sent)
+        {
+            batch = (unsigned int)(STRESS_BYTES - sent);
+        }
+        if (batch & 1)
+        {
+            // copy in
+            for (i = 0; i < batch; ++i)
+            {
+                chunk[i] = STREAM_BYTE( sent + i);
+            }
+            sent += xbee_cbuf_spsc_put( &stress, chunk, batch);
+            // any bytes that didn't fit are regenerated on the next pass
+        }
+        else
+        {
+            // write in place
+            length = batch;
+            w = xbee_cbuf_spsc_reserve( &stress, &length);
+            if (w != NULL)
+            {
+                for (i = 0; i < length; ++i)
+                {
+                    w[i] = STREAM_BYTE( sent + i);
+                }
+                xbee_cbuf_spsc_commit( &stress, length);
+                sent += length;
+            }
+        }
+        if (sent == before)
+        {
+            sched_yield();      // full; let the consumer run
+        }
+    }
+
+    return NULL;
+}
+
+void t_stress( void)
+{
+    pthread_t producer;
+    unsigned long received = 0, errors = 0;
+    unsigned int length, i, batch = 1;
+    uint8_t chunk[300];
+    const uint8_t FAR *r;
+
+    xbee_cbuf_spsc_init( &stress, stress_space, sizeof stress_space);
+    test_compare( pthread_create( &producer, NULL, stress_producer, NULL), 0,
+        NULL, "pthread_create");
+
+    while (received < STRESS_BYTES)
+    {
+        batch = batch % 255 + 1;
+        if (batch & 1)
+        {
+            length = xbee_cbuf_spsc_get( &stress, chunk, batch);
+            for (i = 0; i < length; ++i)
+            {
+                errors += chunk[i] != STREAM_BYTE( received + i);
+            }
+        }
+        else
+        {
+            r = xbee_cbuf_spsc_peek( &stress, &length);
+            for (i = 0; i < length; ++i)
+            {
+                errors += r[i] != STREAM_BYTE( received + i);
+            }
+            xbee_cbuf_spsc_consume( &stress, length);
+        }
+        received += length;
+        if (length == 0)
+        {
+            sched_yield();      // empty; let the producer run
+        }
+    }
+
+    pthread_join( producer, NULL);
+    test_compare( errors, 0, NULL, "corrupt bytes");
+    test_compare( xbee_cbuf_spsc_used( &stress), 0, NULL, "drained");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_put_get);
+    failures += DO_TEST( t_zero_copy);
+    failures += DO_TEST( t_stress);
+
+    return test_exit( failures);
+}
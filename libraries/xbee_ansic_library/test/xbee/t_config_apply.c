@@ -0,0 +1,305 @@
+// Unit tests for the read-compare-write config engine against a simulated
+// XBee: registers that already match, changes queued until ATAC, and ATWR
+// and ATAC failures that still have to wait for the other request.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/atcmd.h"
+#include "xbee/config_apply.h"
+#include "../unittest.h"
+
+#define REGISTERS       4
+
+// simulated local XBee
+static const char *reg_name[REGISTERS] = { "ID", "CH", "SM", "AP" };
+static struct {
+    uint32_t    reg[REGISTERS];
+    uint32_t    queued[REGISTERS];  // values waiting for ATAC
+    bool_t      changed[REGISTERS];
+    char        fail[3];            // command to answer with an error
+    int         queries;
+    int         writes;
+    int         wr;
+    int         ac;
+} module;
+
+// responses waiting to be delivered, in order
+static struct {
+    xbee_header_local_at_resp_t header;
+    uint8_t     value[4];
+    uint16_t    length;
+} queue[XBEE_CMD_REQUEST_TABLESIZE];
+static int queued;
+
+static xbee_dev_t dev;
+
+static const xbee_config_setting_t settings[REGISTERS] = {
+    { "ID", 0x1234 },
+    { "CH", 0x0C },
+    { "SM", 0 },
+    { "AP", 1 },
+};
+static xbee_config_result_t results[REGISTERS];
+static xbee_config_apply_t apply;
+
+// The device layer: instead of writing a frame to the serial port, the
+// simulated XBee queues its response.
+uint8_t xbee_next_frame_id( xbee_dev_t *xbee)
+{
+    if (++xbee->frame_id == 0)
+    {
+        xbee->frame_id = 1;
+    }
+    return xbee->frame_id;
+}
+
+int xbee_frame_write( xbee_dev_t *xbee, const void FAR *header,
+    uint16_t headerlen, const void FAR *data, uint16_t datalen,
+    uint16_t flags)
+{
+    const xbee_header_local_at_req_t *request = header;
+    const uint8_t *param = data;
+    xbee_header_local_at_resp_t *rsp = &queue[queued].header;
+    uint32_t value;
+    int i;
+
+    if (request->frame_id == 0)
+    {
+        return 0;
+    }
+
+    memset( &queue[queued], 0, sizeof queue[queued]);
+    rsp->frame_type = XBEE_FRAME_LOCAL_AT_RESPONSE;
+    rsp->frame_id = request->frame_id;
+    rsp->command = request->command;
+    queue[queued].length = sizeof *rsp;
+
+    for (i = 0; i < REGISTERS; ++i)
+    {
+        if (memcmp( request->command.str, reg_name[i], 2) == 0)
+        {
+            break;
+        }
+    }
+
+    if (memcmp( request->command.str, module.fail, 2) == 0)
+    {
+        rsp->status = XBEE_AT_RESP_ERROR;
+    }
+    else if (memcmp( request->command.str, "WR", 2) == 0)
+    {
+        ++module.wr;
+    }
+    else if (memcmp( request->command.str, "AC", 2) == 0)
+    {
+        ++module.ac;
+        for (i = 0; i < REGISTERS; ++i)
+        {
+            if (module.changed[i])
+            {
+                module.reg[i] = module.queued[i];
+                module.changed[i] = FALSE;
+            }
+        }
+    }
+    else if (i == REGISTERS)
+    {
+        rsp->status = XBEE_AT_RESP_BAD_COMMAND;
+    }
+    else if (datalen)
+    {
+        // queued change (XBEE_FRAME_LOCAL_AT_CMD_Q) or immediate
+        for (value = 0; datalen; --datalen)
+        {
+            value = value << 8 | *param++;
+        }
+        if (request->frame_type == XBEE_FRAME_LOCAL_AT_CMD_Q)
+        {
+            module.queued[i] = value;
+            module.changed[i] = TRUE;
+        }
+        else
+        {
+            module.reg[i] = value;
+        }
+        ++module.writes;
+    }
+    else
+    {
+        value = module.reg[i];
+        queue[queued].value[0] = (uint8_t) (value >> 24);
+        queue[queued].value[1] = (uint8_t) (value >> 16);
+        queue[queued].value[2] = (uint8_t) (value >> 8);
+        queue[queued].value[3] = (uint8_t) value;
+        queue[queued].length += 4;
+        ++module.queries;
+    }
+    ++queued;
+
+    return 0;
+}
+
+// deliver the oldest queued response
+void deliver_one( void)
+{
+    if (queued)
+    {
+        _xbee_cmd_handle_response( &dev, &queue[0], queue[0].length, NULL);
+        memmove( queue, &queue[1], --queued * sizeof queue[0]);
+    }
+}
+
+// run the engine, delivering responses as they're queued
+int run( void)
+{
+    uint32_t start = xbee_millisecond_timer();
+    int status;
+
+    while ((status = xbee_config_apply_tick( &apply)) == -EBUSY
+        && xbee_millisecond_timer() - start < 5000)
+    {
+        deliver_one();
+    }
+
+    return status;
+}
+
+// A device that skips xbee_dev_init() and xbee_cmd_init_device(), with
+// registers that match settings[] except where <differs> has a bit set.
+void setup( unsigned differs)
+{
+    int i;
+
+    memset( &dev, 0, sizeof dev);
+    dev.flags = XBEE_DEV_FLAG_CMD_INIT;
+    memset( &module, 0, sizeof module);
+    queued = 0;
+
+    for (i = 0; i < REGISTERS; ++i)
+    {
+        module.reg[i] = settings[i].value;
+        if (differs & (1u << i))
+        {
+            module.reg[i] ^= 0x0100;
+        }
+    }
+
+    test_compare( xbee_config_apply_start( &apply, &dev, settings, results,
+        REGISTERS, NULL, 0), 0, NULL, "start");
+}
+
+void t_matched( void)
+{
+    int i;
+
+    setup( 0);
+    test_compare( run(), 0, NULL, "result");
+    test_compare( apply.matched, REGISTERS, NULL, "matched");
+    test_compare( module.queries, REGISTERS, NULL, "registers read");
+    test_compare( module.writes + module.wr + module.ac, 0, NULL,
+        "nothing written");
+    for (i = 0; i < REGISTERS; ++i)
+    {
+        test_compare( results[i].status, XBEE_CONFIG_MATCHED, NULL, "status");
+    }
+    test_compare( dev.cmd_active_count, 0, NULL, "requests released");
+}
+
+void t_changed( void)
+{
+    setup( 0x05);
+    test_compare( run(), 0, NULL, "result");
+    test_compare( apply.differs, 2, NULL, "differs");
+    test_compare( apply.changed, 2, NULL, "changed");
+    test_compare( module.writes, 2, NULL, "registers written");
+    test_compare( module.wr, 1, NULL, "ATWR sent");
+    test_compare( module.ac, 1, NULL, "ATAC sent");
+    test_compare( results[0].status, XBEE_CONFIG_CHANGED, NULL, "ID status");
+    test_compare( results[0].previous, 0x1334, "0x%X", "ID previous");
+    test_compare( results[1].status, XBEE_CONFIG_MATCHED, NULL, "CH status");
+    test_compare( module.reg[0], 0x1234, "0x%X", "ID applied");
+    test_compare( module.reg[2], 0, NULL, "SM applied");
+}
+
+void t_verify_only( void)
+{
+    setup( 0x02);
+    apply.flags |= XBEE_CONFIG_FLAG_VERIFY_ONLY;
+    test_compare( run(), 0, NULL, "result");
+    test_compare( results[1].status, XBEE_CONFIG_DIFFERS, NULL, "CH status");
+    test_compare( module.writes + module.wr + module.ac, 0, NULL,
+        "nothing written");
+}
+
+// a failed ATWR must not end the process while ATAC is still outstanding
+void t_wr_failed( void)
+{
+    int status;
+
+    setup( 0x08);
+    strcpy( module.fail, "WR");
+
+    // run until ATWR and ATAC are both queued
+    while ((status = xbee_config_apply_tick( &apply)) == -EBUSY
+        && apply.state != XBEE_CONFIG_STATE_SAVE)
+    {
+        deliver_one();
+    }
+    test_compare( status, -EBUSY, NULL, "busy before ATWR");
+    test_compare( xbee_config_apply_tick( &apply), -EBUSY, NULL,
+        "busy with ATWR sent");
+    test_compare( queued, 2, NULL, "ATWR and ATAC queued");
+
+    deliver_one();                      // ATWR error
+    test_compare( xbee_config_apply_tick( &apply), -EBUSY, NULL,
+        "busy with ATAC outstanding");
+    test_compare( apply.outstanding, 1, NULL, "ATAC outstanding");
+
+    deliver_one();                      // ATAC
+    test_compare( xbee_config_apply_tick( &apply), -EIO, NULL, "result");
+    test_bool( apply.save_failed, "save_failed set");
+    test_compare( apply.failed, 0, NULL, "no register failed");
+    test_compare( module.ac, 1, NULL, "ATAC sent");
+    test_compare( module.reg[3], 1, NULL, "AP applied");
+    test_compare( dev.cmd_active_count, 0, NULL, "requests released");
+}
+
+void t_ac_failed( void)
+{
+    setup( 0x01);
+    strcpy( module.fail, "AC");
+    test_compare( run(), -EIO, NULL, "result");
+    test_bool( apply.save_failed, "save_failed set");
+    test_compare( module.wr, 1, NULL, "ATWR sent");
+    test_compare( apply.outstanding, 0, NULL, "nothing outstanding");
+}
+
+void t_register_failed( void)
+{
+    setup( 0x02);
+    strcpy( module.fail, "SM");
+    test_compare( run(), -EIO, NULL, "result");
+    test_compare( apply.failed, 1, NULL, "failed");
+    test_compare( results[2].status, XBEE_CONFIG_FAILED, NULL, "SM status");
+    test_compare( results[2].at_status, XBEE_AT_RESP_ERROR, NULL,
+        "SM at_status");
+    test_compare( results[1].status, XBEE_CONFIG_CHANGED, NULL, "CH status");
+    test_bool( ! apply.save_failed, "save_failed clear");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_matched);
+    failures += DO_TEST( t_changed);
+    failures += DO_TEST( t_verify_only);
+    failures += DO_TEST( t_wr_failed);
+    failures += DO_TEST( t_ac_failed);
+    failures += DO_TEST( t_register_failed);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,299 @@
+// Unit tests for configuring a fleet of simulated remote XBees: the limit
+// on nodes configured at once, retrying nodes that don't respond (or whose
+// Remote AT Commands fail to transmit) and giving up once retries run out.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/byteorder.h"
+#include "xbee/atcmd.h"
+#include "xbee/config_fleet.h"
+#include "../unittest.h"
+
+#define NODES           6
+#define REGISTERS       3
+
+// simulated remote node
+static const char *reg_name[REGISTERS] = { "ID", "CH", "NI" };
+static struct {
+    addr64      ieee;
+    uint32_t    reg[REGISTERS];
+    int         drop;           // requests to ignore before responding
+    bool_t      tx_fail;        // answer every request with TX_FAIL
+    char        fail[3];        // command to answer with an error
+    int         requests;       // requests received
+    int         ac;             // ATAC requests received
+} node[NODES];
+
+// responses waiting to be delivered, in order
+static struct {
+    xbee_header_remote_at_resp_t header;
+    uint8_t     value[4];
+    uint16_t    length;
+    int         node;           // index into node[]
+} queue[XBEE_CMD_REQUEST_TABLESIZE];
+static int queued;
+static int max_active;          // most nodes with responses queued at once
+
+static xbee_dev_t dev;
+
+static const xbee_config_setting_t settings[REGISTERS] = {
+    { "ID", 0x7FFF },
+    { "CH", 0x0C },
+    { "NI", 3 },
+};
+static xbee_config_fleet_t fleet;
+static xbee_config_node_t nodes[NODES];
+static xbee_config_result_t results[NODES][REGISTERS];
+
+// The device layer: instead of writing a frame to the serial port, the
+// simulated node queues its response.
+uint8_t xbee_next_frame_id( xbee_dev_t *xbee)
+{
+    if (++xbee->frame_id == 0)
+    {
+        xbee->frame_id = 1;
+    }
+    return xbee->frame_id;
+}
+
+int xbee_frame_write( xbee_dev_t *xbee, const void FAR *header,
+    uint16_t headerlen, const void FAR *data, uint16_t datalen,
+    uint16_t flags)
+{
+    const xbee_header_remote_at_req_t *request = header;
+    const uint8_t *param = data;
+    xbee_header_remote_at_resp_t *rsp = &queue[queued].header;
+    uint32_t value;
+    int n, i;
+
+    for (n = 0; n < NODES; ++n)
+    {
+        if (memcmp( &request->ieee_address, &node[n].ieee, 8) == 0)
+        {
+            break;
+        }
+    }
+    if (request->frame_type != XBEE_FRAME_REMOTE_AT_CMD || n == NODES
+        || request->frame_id == 0)
+    {
+        return 0;
+    }
+    ++node[n].requests;
+    if (node[n].drop)
+    {
+        --node[n].drop;
+        return 0;
+    }
+
+    memset( &queue[queued], 0, sizeof queue[queued]);
+    queue[queued].node = n;
+    rsp->frame_type = XBEE_FRAME_REMOTE_AT_RESPONSE;
+    rsp->frame_id = request->frame_id;
+    rsp->ieee_address = request->ieee_address;
+    rsp->network_address_be = htobe16( 0x1000 + n);
+    rsp->command = request->command;
+    queue[queued].length = sizeof *rsp;
+
+    for (i = 0; i < REGISTERS; ++i)
+    {
+        if (memcmp( request->command.str, reg_name[i], 2) == 0)
+        {
+            break;
+        }
+    }
+
+    if (node[n].tx_fail)
+    {
+        rsp->status = XBEE_AT_RESP_TX_FAIL;
+    }
+    else if (memcmp( request->command.str, node[n].fail, 2) == 0)
+    {
+        rsp->status = XBEE_AT_RESP_ERROR;
+    }
+    else if (memcmp( request->command.str, "AC", 2) == 0)
+    {
+        ++node[n].ac;
+    }
+    else if (i == REGISTERS)
+    {
+        if (memcmp( request->command.str, "WR", 2) != 0)
+        {
+            rsp->status = XBEE_AT_RESP_BAD_COMMAND;
+        }
+    }
+    else if (datalen)
+    {
+        for (value = 0; datalen; --datalen)
+        {
+            value = value << 8 | *param++;
+        }
+        node[n].reg[i] = value;
+    }
+    else
+    {
+        value = node[n].reg[i];
+        queue[queued].value[0] = (uint8_t) (value >> 24);
+        queue[queued].value[1] = (uint8_t) (value >> 16);
+        queue[queued].value[2] = (uint8_t) (value >> 8);
+        queue[queued].value[3] = (uint8_t) value;
+        queue[queued].length += 4;
+    }
+    ++queued;
+
+    return 0;
+}
+
+// deliver the responses queued so far
+void deliver( void)
+{
+    int i, j, active = 0;
+
+    for (i = 0; i < queued; ++i)
+    {
+        for (j = 0; j < i && queue[j].node != queue[i].node; ++j);
+        active += (j == i);
+    }
+    if (active > max_active)
+    {
+        max_active = active;
+    }
+
+    for (i = 0; i < queued; ++i)
+    {
+        _xbee_cmd_handle_response( &dev, &queue[i], queue[i].length, NULL);
+    }
+    queued = 0;
+}
+
+// run the fleet, giving up after a few seconds
+int run( void)
+{
+    uint32_t start = xbee_millisecond_timer();
+    int status;
+
+    while ((status = xbee_config_fleet_tick( &fleet)) == -EBUSY
+        && xbee_millisecond_timer() - start < 10000)
+    {
+        deliver();
+    }
+
+    return status;
+}
+
+// nodes whose registers all differ from settings[]
+void setup( void)
+{
+    int n;
+
+    memset( &dev, 0, sizeof dev);
+    dev.flags = XBEE_DEV_FLAG_CMD_INIT;
+    memset( node, 0, sizeof node);
+    memset( nodes, 0, sizeof nodes);
+    queued = max_active = 0;
+
+    for (n = 0; n < NODES; ++n)
+    {
+        addr64_parse( &node[n].ieee, "0013A200-40A1B200");
+        node[n].ieee.b[7] = (uint8_t) (n + 1);
+        nodes[n].ieee = node[n].ieee;
+        nodes[n].results = results[n];
+    }
+
+    test_compare( xbee_config_fleet_start( &fleet, &dev, settings, REGISTERS,
+        nodes, NODES, 0), 0, NULL, "start");
+    fleet.timeout = 1;
+}
+
+// count nodes whose registers don't match settings[]
+int unconfigured( void)
+{
+    int n, i, errors = 0;
+
+    for (n = 0; n < NODES; ++n)
+    {
+        for (i = 0; i < REGISTERS; ++i)
+        {
+            errors += node[n].reg[i] != settings[i].value;
+        }
+    }
+
+    return errors;
+}
+
+void t_parallel( void)
+{
+    int n;
+
+    setup();
+    fleet.parallel = 2;
+    test_compare( run(), 0, NULL, "result");
+    test_compare( fleet.succeeded, NODES, NULL, "succeeded");
+    test_compare( max_active, 2, NULL, "nodes configured at once");
+    test_compare( unconfigured(), 0, NULL, "registers written");
+    for (n = 0; n < NODES; ++n)
+    {
+        test_compare( nodes[n].status, 0, NULL, "node status");
+        test_compare( nodes[n].attempts, 1, NULL, "attempts");
+        test_compare( nodes[n].changed, REGISTERS, NULL, "changed");
+        test_compare( node[n].ac, 1, NULL, "ATAC sent");
+    }
+    test_compare( dev.cmd_active_count, 0, NULL, "requests released");
+
+    // every node at once, up to the compile-time limit
+    setup();
+    test_compare( run(), 0, NULL, "result");
+    test_compare( max_active, XBEE_CONFIG_FLEET_PARALLEL, NULL,
+        "default limit");
+}
+
+void t_retry( void)
+{
+    setup();
+    fleet.retries = 1;
+    node[1].drop = REGISTERS;           // loses every request of one attempt
+    node[2].drop = 1000;                // never responds
+    node[3].tx_fail = TRUE;             // can't be reached
+    strcpy( node[4].fail, "CH");        // rejects a setting
+
+    test_compare( run(), -EIO, NULL, "result");
+    test_compare( fleet.succeeded, 3, NULL, "succeeded");
+    test_compare( fleet.failed, 3, NULL, "failed");
+
+    test_compare( nodes[0].status, 0, NULL, "node 0 status");
+    test_compare( nodes[0].attempts, 1, NULL, "node 0 attempts");
+
+    test_compare( nodes[1].status, 0, NULL, "timeout, then success");
+    test_compare( nodes[1].attempts, 2, NULL, "node 1 attempts");
+    test_compare( nodes[1].changed, REGISTERS, NULL, "node 1 changed");
+
+    test_compare( nodes[2].status, -ETIMEDOUT, NULL, "out of retries");
+    test_compare( nodes[2].attempts, 2, NULL, "node 2 attempts");
+    test_compare( results[2][0].at_status, XBEE_CONFIG_AT_STATUS_TIMEOUT,
+        NULL, "node 2 at_status");
+
+    test_compare( nodes[3].status, -ETIMEDOUT, NULL, "TX_FAIL retried");
+    test_compare( nodes[3].attempts, 2, NULL, "node 3 attempts");
+    test_compare( node[3].ac, 0, NULL, "node 3 ATAC");
+
+    test_compare( nodes[4].status, -EIO, NULL, "error not retried");
+    test_compare( nodes[4].attempts, 1, NULL, "node 4 attempts");
+    test_compare( results[4][1].status, XBEE_CONFIG_FAILED, NULL,
+        "node 4 CH status");
+    test_compare( nodes[4].changed, REGISTERS - 1, NULL, "node 4 changed");
+
+    test_compare( nodes[5].status, 0, NULL, "node 5 status");
+    test_compare( dev.cmd_active_count, 0, NULL, "requests released");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_parallel);
+    failures += DO_TEST( t_retry);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,107 @@
+// Unit tests for the on-disk xbee_dev_t query cache.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/device_cache.h"
+#include "../unittest.h"
+
+#define CACHE_FILE "t_device_cache.tmp"
+
+static xbee_dev_t saved, loaded;
+
+void fill_device( xbee_dev_t *xbee, const char *port, uint8_t id)
+{
+    memset( xbee, 0, sizeof *xbee);
+    strcpy( xbee->serport.device, port);
+    xbee->hardware_version = 0x4200;
+    xbee->hardware_series = 0x0C00;
+    xbee->firmware_version = 0x3012;
+    xbee->wpan_dev.payload = 100;
+    addr64_parse( &xbee->wpan_dev.address.ieee, "0013A200-40A1B2C3");
+    xbee->wpan_dev.address.ieee.b[7] = id;
+    #ifdef XBEE_DEVICE_ENABLE_ATMODE
+        xbee->guard_time = 1000;
+        xbee->idle_timeout = 100;
+        xbee->escape_char = '+';
+    #endif
+    xbee->flags = XBEE_DEV_FLAG_QUERY_BEGIN | XBEE_DEV_FLAG_QUERY_DONE;
+}
+
+void t_round_trip( void)
+{
+    remove( CACHE_FILE);
+
+    memset( &loaded, 0, sizeof loaded);
+    strcpy( loaded.serport.device, "/dev/ttyS0");
+    test_compare( xbee_dev_cache_load( &loaded, CACHE_FILE), -ENOENT, NULL,
+        "load without cache file");
+
+    fill_device( &saved, "/dev/ttyS0", 1);
+    test_compare( xbee_dev_cache_save( &saved, CACHE_FILE), 0, NULL,
+        "save failed");
+    test_compare( xbee_dev_cache_load( &loaded, CACHE_FILE), 0, NULL,
+        "load failed");
+
+    test_compare( loaded.hardware_version, saved.hardware_version, NULL, "HV");
+    test_compare( loaded.hardware_series, saved.hardware_series, NULL, "HS");
+    test_compare( loaded.firmware_version, saved.firmware_version, NULL, "VR");
+    test_compare( loaded.wpan_dev.payload, saved.wpan_dev.payload, NULL, "NP");
+    test_bool( addr64_equal( &loaded.wpan_dev.address.ieee,
+        &saved.wpan_dev.address.ieee), "IEEE address");
+    #ifdef XBEE_DEVICE_ENABLE_ATMODE
+        test_compare( loaded.guard_time, saved.guard_time, NULL, "GT");
+        test_compare( loaded.escape_char, saved.escape_char, NULL, "CC");
+    #endif
+    test_bool( loaded.flags & XBEE_DEV_FLAG_QUERY_CACHED, "CACHED not set");
+    test_bool( loaded.flags & XBEE_DEV_FLAG_QUERY_DONE, "DONE not set");
+}
+
+void t_multiple_ports( void)
+{
+    remove( CACHE_FILE);
+
+    fill_device( &saved, "/dev/ttyS0", 1);
+    xbee_dev_cache_save( &saved, CACHE_FILE);
+    fill_device( &saved, "/dev/ttyUSB0", 2);
+    xbee_dev_cache_save( &saved, CACHE_FILE);
+
+    // replacing one port's entry keeps the other
+    fill_device( &saved, "/dev/ttyS0", 3);
+    saved.firmware_version = 0x3014;
+    xbee_dev_cache_save( &saved, CACHE_FILE);
+
+    memset( &loaded, 0, sizeof loaded);
+    strcpy( loaded.serport.device, "/dev/ttyUSB0");
+    test_compare( xbee_dev_cache_load( &loaded, CACHE_FILE), 0, NULL,
+        "load ttyUSB0");
+    test_compare( loaded.wpan_dev.address.ieee.b[7], 2, NULL,
+        "ttyUSB0 entry lost");
+
+    memset( &loaded, 0, sizeof loaded);
+    strcpy( loaded.serport.device, "/dev/ttyS0");
+    test_compare( xbee_dev_cache_load( &loaded, CACHE_FILE), 0, NULL,
+        "load ttyS0");
+    test_compare( loaded.wpan_dev.address.ieee.b[7], 3, NULL,
+        "ttyS0 entry not replaced");
+    test_compare( loaded.firmware_version, 0x3014, NULL, "ttyS0 VR");
+
+    // don't cache values that weren't read from a module
+    saved.flags = 0;
+    test_compare( xbee_dev_cache_save( &saved, CACHE_FILE), -EINVAL, NULL,
+        "saved device without query");
+
+    remove( CACHE_FILE);
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_round_trip);
+    failures += DO_TEST( t_multiple_ports);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,271 @@
+// Unit tests for the GPM update engine against simulated remote nodes:
+// pipelined writes, blank pages left to the erase, lost and rejected writes,
+// a node that never answers, one whose GPM is too small and one that
+// rejects every write.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/byteorder.h"
+#include "xbee/gpm_ota.h"
+#include "../unittest.h"
+
+#define NODES           4
+#define IMAGE_SIZE      3000
+#define GPM_BLOCKS      8
+#define GPM_BLOCK_SIZE  512
+
+// simulated remote node
+static struct {
+    addr64      ieee;
+    uint8_t     gpm[GPM_BLOCKS * GPM_BLOCK_SIZE];
+    uint16_t    blocks;         // blocks reported in platform info
+    bool_t      silent;         // never responds
+    int         drop_write;     // lose the response to this write (1-based)
+    int         reject_write;   // return an error for this write (1-based)
+    bool_t      reject_all;     // return an error for every write
+    int         writes;         // write requests received
+    int         in_flight;      // write responses not yet delivered
+    int         max_in_flight;
+    bool_t      verified;
+    bool_t      installed;
+} node[NODES];
+
+// responses waiting to be delivered, in order
+static struct {
+    int         node;
+    xbee_gpm_response_header_t header;
+} queue[64];
+static int queued;
+
+static wpan_dev_t dev;
+static xbee_gpm_ota_t ota;
+static xbee_gpm_ota_node_t nodes[NODES];
+static uint8_t image[IMAGE_SIZE];
+
+static void respond( int n, const xbee_gpm_request_header_t *request,
+    uint8_t cmd_id, bool_t error)
+{
+    xbee_gpm_response_header_t *header = &queue[queued].header;
+
+    queue[queued].node = n;
+    memcpy( header, request, sizeof *header);
+    header->cmd_id = cmd_id;
+    header->status = error ? XBEE_GPM_STATUS_ERROR_FLAG : 0;
+    ++queued;
+}
+
+static int node_send( const wpan_envelope_t FAR *envelope, uint16_t flags)
+{
+    const xbee_gpm_frame_t *frame = envelope->payload;
+    xbee_gpm_request_header_t request = frame->header.request;
+    uint32_t offset;
+    int n;
+
+    for (n = 0; n < NODES; ++n)
+    {
+        if (addr64_equal( &envelope->ieee_address, &node[n].ieee))
+        {
+            break;
+        }
+    }
+    if (n == NODES || node[n].silent)
+    {
+        return 0;
+    }
+
+    switch (request.cmd_id)
+    {
+        case XBEE_GPM_CMD_PLATFORM_INFO_REQ:
+            request.block_num_be = htobe16( node[n].blocks);
+            request.start_index_be = htobe16( GPM_BLOCK_SIZE);
+            respond( n, &request, XBEE_GPM_CMD_PLATFORM_INFO_RESP, FALSE);
+            break;
+
+        case XBEE_GPM_CMD_ERASE_REQ:
+            memset( node[n].gpm, 0xFF, sizeof node[n].gpm);
+            respond( n, &request, XBEE_GPM_CMD_ERASE_RESP, FALSE);
+            break;
+
+        case XBEE_GPM_CMD_WRITE_REQ:
+            ++node[n].writes;
+            if (node[n].writes == node[n].drop_write)
+            {
+                break;
+            }
+            if (node[n].reject_all
+                || node[n].writes == node[n].reject_write)
+            {
+                respond( n, &request, XBEE_GPM_CMD_WRITE_RESP, TRUE);
+                break;
+            }
+            offset = be16toh( request.block_num_be) * GPM_BLOCK_SIZE
+                + be16toh( request.start_index_be);
+            memcpy( &node[n].gpm[offset], frame->data,
+                be16toh( request.byte_count_be));
+            respond( n, &request, XBEE_GPM_CMD_WRITE_RESP, FALSE);
+            if (++node[n].in_flight > node[n].max_in_flight)
+            {
+                node[n].max_in_flight = node[n].in_flight;
+            }
+            break;
+
+        case XBEE_GPM_CMD_FIRMWARE_VERIFY_REQ:
+            node[n].verified =
+                memcmp( node[n].gpm, image, sizeof image) == 0;
+            respond( n, &request, XBEE_GPM_CMD_FIRMWARE_VERIFY_RESP,
+                ! node[n].verified);
+            break;
+
+        case XBEE_GPM_CMD_FIRMWARE_INSTALL_REQ:
+            node[n].installed = TRUE;
+            respond( n, &request, XBEE_GPM_CMD_FIRMWARE_INSTALL_RESP, FALSE);
+            break;
+    }
+
+    return 0;
+}
+
+// deliver the responses queued so far (but not ones they cause)
+static void deliver( void)
+{
+    wpan_envelope_t envelope;
+    int count = queued;
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        memset( &envelope, 0, sizeof envelope);
+        envelope.dev = &dev;
+        envelope.ieee_address = node[queue[i].node].ieee;
+        envelope.payload = &queue[i].header;
+        envelope.length = sizeof queue[i].header;
+        if (queue[i].header.cmd_id == XBEE_GPM_CMD_WRITE_RESP
+            && queue[i].header.status == 0)
+        {
+            --node[queue[i].node].in_flight;
+        }
+        xbee_gpm_ota_response( &envelope, &ota);
+    }
+    queued -= count;
+    memmove( queue, &queue[count], queued * sizeof queue[0]);
+}
+
+static void setup( void)
+{
+    int i;
+
+    memset( node, 0, sizeof node);
+    memset( nodes, 0, sizeof nodes);
+    queued = 0;
+
+    memset( &dev, 0, sizeof dev);
+    dev.endpoint_send = node_send;
+    dev.payload = 84;
+
+    // image with a blank stretch that's left to the erase
+    for (i = 0; i < IMAGE_SIZE; ++i)
+    {
+        image[i] = (i >= 1024 && i < 1600) ? 0xFF : (uint8_t) (i * 13 + 5);
+    }
+
+    for (i = 0; i < NODES; ++i)
+    {
+        node[i].ieee.b[7] = (uint8_t) (i + 1);
+        node[i].blocks = GPM_BLOCKS;
+        nodes[i].ieee = node[i].ieee;
+    }
+}
+
+// run the update, giving up after a couple of seconds
+static int run( void)
+{
+    uint32_t start = xbee_millisecond_timer();
+    int status;
+
+    do
+    {
+        status = xbee_gpm_ota_tick( &ota);
+        deliver();
+    } while (status == -EBUSY && xbee_millisecond_timer() - start < 2000);
+
+    return status;
+}
+
+void t_parallel( void)
+{
+    int i, errors = 0;
+
+    setup();
+    test_compare( xbee_gpm_ota_start( &ota, &dev, image, sizeof image,
+        nodes, NODES, XBEE_GPM_OTA_FLAG_INSTALL), 0, NULL, "start");
+    ota.parallel = 2;
+    test_compare( run(), 0, NULL, "result");
+
+    for (i = 0; i < NODES; ++i)
+    {
+        errors += nodes[i].status != 0;
+        errors += nodes[i].state != XBEE_GPM_OTA_STATE_DONE;
+        errors += nodes[i].written != IMAGE_SIZE;
+        errors += ! node[i].verified || ! node[i].installed;
+        errors += node[i].max_in_flight != XBEE_GPM_OTA_WINDOW;
+    }
+    test_compare( errors, 0, NULL, "every node updated with full window");
+
+    // 3000 bytes in 76-byte writes that stop at 512-byte block boundaries,
+    // less the writes that were all 0xFF
+    test_bool( node[0].writes < (IMAGE_SIZE + 75) / 76,
+        "blank pieces skipped");
+    test_compare( node[0].writes, node[3].writes, NULL, "same writes");
+}
+
+void t_lost_and_rejected( void)
+{
+    setup();
+    node[1].drop_write = 3;
+    node[2].reject_write = 5;
+    xbee_gpm_ota_start( &ota, &dev, image, sizeof image, nodes, NODES, 0);
+    ota.timeout = 20;
+    test_compare( run(), 0, NULL, "result");
+    test_compare( nodes[0].resends, 0, NULL, "no resends");
+    test_compare( nodes[1].resends, 1, NULL, "lost write resent");
+    test_compare( nodes[2].resends, 1, NULL, "rejected write resent");
+    test_bool( node[1].verified && node[2].verified, "images verified");
+    test_bool( ! node[1].installed, "not installed without flag");
+}
+
+void t_failures( void)
+{
+    setup();
+    node[1].silent = TRUE;
+    node[2].blocks = 2;
+    xbee_gpm_ota_start( &ota, &dev, image, sizeof image, nodes, NODES, 0);
+    ota.timeout = 10;
+    ota.retries = 1;
+    node[3].reject_all = TRUE;
+    test_compare( run(), -EIO, NULL, "result");
+    test_compare( nodes[0].status, 0, NULL, "node 0 ok");
+    test_compare( nodes[1].status, -ETIMEDOUT, NULL, "node 1 timed out");
+    test_compare( nodes[1].state, XBEE_GPM_OTA_STATE_INFO, NULL,
+        "node 1 failed state");
+    test_compare( nodes[2].status, -ENOSPC, NULL, "node 2 too small");
+    test_compare( nodes[3].status, -EIO, NULL, "node 3 rejected writes");
+    test_compare( nodes[3].state, XBEE_GPM_OTA_STATE_WRITE, NULL,
+        "node 3 failed state");
+    test_compare( node[3].writes, 2 * XBEE_GPM_OTA_WINDOW, NULL,
+        "node 3 rejected writes resent once");
+    test_compare( ota.succeeded, 1, NULL, "succeeded");
+    test_compare( ota.failed, 3, NULL, "failed");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_parallel);
+    failures += DO_TEST( t_lost_and_rejected);
+    failures += DO_TEST( t_failures);
+
+    return test_exit( failures);
+}
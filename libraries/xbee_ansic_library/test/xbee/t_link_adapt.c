@@ -0,0 +1,152 @@
+// Unit tests for the link controller: additive increase, multiplicative
+// decrease, signal strength and broadcast fallback.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/link_adapt.h"
+#include "../unittest.h"
+
+static xbee_dev_t dev;
+static xbee_link_adapt_t adapt;
+
+void setup( uint16_t np)
+{
+    memset( &dev, 0, sizeof dev);
+    dev.wpan_dev.payload = np;
+    xbee_link_adapt_init( &adapt, &dev);
+}
+
+void deliver( int count, uint8_t retries)
+{
+    while (count--)
+    {
+        xbee_link_adapt_tx_status( &adapt, XBEE_TX_DELIVERY_SUCCESS, retries);
+    }
+}
+
+void fail( int count)
+{
+    while (count--)
+    {
+        xbee_link_adapt_tx_status( &adapt, XBEE_TX_DELIVERY_MAC_ACK_FAIL, 3);
+    }
+}
+
+void t_aimd( void)
+{
+    setup( 84);
+    test_compare( adapt.rate, XBEE_LINK_ADAPT_RATE_START, NULL, "start rate");
+    test_compare( adapt.payload, 84, NULL, "payload from NP");
+
+    fail( 1);
+    test_compare( adapt.rate, XBEE_LINK_ADAPT_RATE_START / 2, NULL,
+        "rate halved");
+    test_compare( adapt.payload, 42, NULL, "payload halved");
+    test_bool( ! adapt.broadcast, "unicast after one failure");
+
+    deliver( XBEE_LINK_ADAPT_INCREASE_AFTER - 1, 0);
+    test_compare( adapt.rate, XBEE_LINK_ADAPT_RATE_START / 2, NULL,
+        "no increase yet");
+    deliver( 1, 0);
+    test_compare( adapt.rate,
+        XBEE_LINK_ADAPT_RATE_START / 2 + XBEE_LINK_ADAPT_RATE_STEP, NULL,
+        "additive increase");
+    test_compare( adapt.payload, 42 + XBEE_LINK_ADAPT_PAYLOAD_STEP, NULL,
+        "payload increase");
+    test_compare( adapt.increases, 1, NULL, "increases");
+
+    // growth stops at the limits
+    deliver( 100 * XBEE_LINK_ADAPT_INCREASE_AFTER, 0);
+    test_compare( adapt.rate, XBEE_LINK_ADAPT_RATE_MAX, NULL, "max rate");
+    test_compare( adapt.payload, 84, NULL, "max payload");
+    fail( 20);
+    test_compare( adapt.rate, XBEE_LINK_ADAPT_RATE_MIN, NULL, "min rate");
+    test_compare( adapt.payload, XBEE_LINK_ADAPT_PAYLOAD_MIN, NULL,
+        "min payload");
+}
+
+void t_retries( void)
+{
+    uint16_t rate;
+
+    setup( 0);
+    test_compare( adapt.payload, XBEE_LINK_ADAPT_PAYLOAD_MAX, NULL,
+        "default payload");
+
+    // deliveries that need several retries don't increase the rate
+    deliver( 16, 3);
+    rate = adapt.rate;
+    deliver( 4 * XBEE_LINK_ADAPT_INCREASE_AFTER, 3);
+    test_compare( adapt.rate, rate, NULL, "held by retries");
+    test_compare( adapt.failed, 0, NULL, "failed");
+}
+
+void t_rssi( void)
+{
+    setup( 100);
+
+    xbee_link_adapt_rssi( &adapt, 60);
+    test_compare( adapt.payload, 100, NULL, "strong signal");
+    xbee_link_adapt_rssi( &adapt, XBEE_LINK_ADAPT_WEAK_RSSI);
+    test_compare( adapt.payload, 50, NULL, "weak signal");
+
+    // payload doesn't grow while the signal is weak
+    fail( 1);
+    deliver( 4 * XBEE_LINK_ADAPT_INCREASE_AFTER, 0);
+    test_compare( adapt.payload, 25, NULL, "weak signal growth");
+    test_bool( adapt.rate > XBEE_LINK_ADAPT_RATE_START / 2,
+        "rate still grows");
+}
+
+void t_broadcast( void)
+{
+    setup( 100);
+
+    fail( XBEE_LINK_ADAPT_BROADCAST_AFTER - 1);
+    test_bool( ! adapt.broadcast, "unicast");
+    fail( 1);
+    test_bool( adapt.broadcast, "broadcast after failures");
+
+    // probe unicast after XBEE_LINK_ADAPT_PROBE_MS
+    adapt.last_send_ms -= 1000;
+    test_bool( xbee_link_adapt_due( &adapt) > 0, "due");
+    test_bool( adapt.broadcast, "still broadcast");
+    adapt.broadcast_ms -= XBEE_LINK_ADAPT_PROBE_MS;
+    adapt.last_send_ms -= 1000;
+    xbee_link_adapt_due( &adapt);
+    test_bool( ! adapt.broadcast, "probing unicast");
+    fail( 1);
+    test_bool( adapt.broadcast, "back to broadcast");
+
+    adapt.broadcast_ms -= XBEE_LINK_ADAPT_PROBE_MS;
+    adapt.last_send_ms -= 1000;
+    xbee_link_adapt_due( &adapt);
+    deliver( 1, 0);
+    test_bool( ! adapt.broadcast, "unicast after good probe");
+    test_compare( adapt.consecutive_failures, 0, NULL, "failures reset");
+}
+
+void t_due( void)
+{
+    setup( 100);
+
+    test_compare( xbee_link_adapt_due( &adapt), 0, NULL, "not due");
+    adapt.last_send_ms -= 1000 / adapt.rate;
+    test_compare( xbee_link_adapt_due( &adapt), 100, NULL, "due");
+    test_compare( xbee_link_adapt_due( &adapt), 0, NULL, "slot claimed");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_aimd);
+    failures += DO_TEST( t_retries);
+    failures += DO_TEST( t_rssi);
+    failures += DO_TEST( t_broadcast);
+    failures += DO_TEST( t_due);
+
+    return test_exit( failures);
+}
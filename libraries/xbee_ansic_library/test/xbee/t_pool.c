@@ -0,0 +1,182 @@
+// Unit tests for the fixed-block pool and per-thread caches, including a
+// stress test with several threads sharing one pool.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/pool.h"
+#include "../unittest.h"
+
+#define BLOCK_SIZE      13
+#define BLOCK_COUNT     20
+
+static XBEE_POOL_STORAGE( space, BLOCK_SIZE, BLOCK_COUNT);
+static xbee_pool_t pool;
+
+void t_alloc_free( void)
+{
+    void *block[BLOCK_COUNT + 1];
+    int i;
+
+    test_compare( xbee_pool_init( &pool, space, 3, BLOCK_SIZE), -EINVAL,
+        NULL, "storage too small");
+    test_compare( xbee_pool_init( &pool, space, sizeof space, 0xFFFF),
+        -EINVAL, NULL, "block size rounds past 16 bits");
+    test_compare( xbee_pool_init( &pool, space, sizeof space, BLOCK_SIZE),
+        BLOCK_COUNT, NULL, "init");
+    test_compare( pool.block_size % sizeof(void *), 0, NULL,
+        "block size aligned");
+
+    for (i = 0; i < BLOCK_COUNT; ++i)
+    {
+        block[i] = xbee_pool_alloc( &pool);
+        if (block[i] != NULL)
+        {
+            memset( block[i], i, BLOCK_SIZE);
+        }
+    }
+    test_bool( block[BLOCK_COUNT - 1] != NULL, "allocate every block");
+    test_compare( xbee_pool_available( &pool), 0, NULL, "none available");
+    test_bool( xbee_pool_alloc( &pool) == NULL, "alloc on empty");
+    test_compare( pool.failures, 1, NULL, "failures");
+
+    // blocks don't overlap
+    for (i = 0; i < BLOCK_COUNT; ++i)
+    {
+        if (((uint8_t *) block[i])[BLOCK_SIZE - 1] != i)
+        {
+            break;
+        }
+    }
+    test_compare( i, BLOCK_COUNT, NULL, "block contents");
+
+    test_compare( xbee_pool_free( &pool, (uint8_t *) block[3] + 1), -EINVAL,
+        NULL, "free unaligned");
+    test_compare( xbee_pool_free( &pool, &pool), -EINVAL, NULL,
+        "free foreign");
+    test_compare( xbee_pool_free( &pool, NULL), 0, NULL, "free NULL");
+
+    // last freed is first reused
+    test_compare( xbee_pool_free( &pool, block[5]), 0, NULL, "free");
+    test_compare( xbee_pool_free( &pool, block[9]), 0, NULL, "free");
+    test_bool( xbee_pool_alloc( &pool) == block[9], "LIFO");
+    test_compare( pool.in_use, BLOCK_COUNT - 1, NULL, "in use");
+    test_compare( pool.high_water, BLOCK_COUNT, NULL, "high water");
+}
+
+void t_cache( void)
+{
+    xbee_pool_cache_t cache;
+    void *block[BLOCK_COUNT];
+    int i;
+
+    xbee_pool_init( &pool, space, sizeof space, BLOCK_SIZE);
+    xbee_pool_cache_init( &cache, &pool);
+
+    // first allocation moves half a cache from the pool
+    block[0] = xbee_pool_cache_alloc( &cache);
+    test_bool( block[0] != NULL, "cache alloc");
+    test_compare( cache.count, (XBEE_POOL_CACHE_SIZE + 1) / 2 - 1, NULL,
+        "cache refilled");
+    test_compare( xbee_pool_available( &pool),
+        BLOCK_COUNT - (XBEE_POOL_CACHE_SIZE + 1) / 2, NULL, "pool after refill");
+
+    for (i = 1; i < BLOCK_COUNT; ++i)
+    {
+        block[i] = xbee_pool_cache_alloc( &cache);
+    }
+    test_bool( block[BLOCK_COUNT - 1] != NULL, "cache drains pool");
+    test_bool( xbee_pool_cache_alloc( &cache) == NULL, "cache alloc on empty");
+
+    // freeing past a full cache returns half to the pool
+    for (i = 0; i < XBEE_POOL_CACHE_SIZE + 1; ++i)
+    {
+        xbee_pool_cache_free( &cache, block[i]);
+    }
+    test_compare( cache.count, XBEE_POOL_CACHE_SIZE / 2 + 1, NULL,
+        "cache after overflow");
+    test_compare( xbee_pool_available( &pool), XBEE_POOL_CACHE_SIZE / 2, NULL,
+        "pool after overflow");
+    test_compare( xbee_pool_cache_free( &cache, space + 1), -EINVAL, NULL,
+        "cache free unaligned");
+
+    xbee_pool_cache_flush( &cache);
+    test_compare( cache.count, 0, NULL, "flushed");
+    test_compare( xbee_pool_available( &pool),
+        BLOCK_COUNT - (BLOCK_COUNT - XBEE_POOL_CACHE_SIZE - 1), NULL,
+        "pool after flush");
+}
+
+#define THREADS         3
+#define ROUNDS          20000
+
+static int stress_errors;
+
+// Each thread holds a few blocks at a time, tagging them with its id.
+void *stress_thread( void *arg)
+{
+    xbee_pool_cache_t cache;
+    uint8_t *held[4];
+    int round, i, id = (int)(intptr_t) arg;
+
+    xbee_pool_cache_init( &cache, &pool);
+    for (round = 0; round < ROUNDS; ++round)
+    {
+        for (i = 0; i < 4; ++i)
+        {
+            held[i] = (round & 1) ? xbee_pool_cache_alloc( &cache)
+                : xbee_pool_alloc( &pool);
+            if (held[i] != NULL)
+            {
+                memset( held[i], id, BLOCK_SIZE);
+            }
+        }
+        for (i = 0; i < 4; ++i)
+        {
+            if (held[i] != NULL)
+            {
+                if (held[i][0] != id || held[i][BLOCK_SIZE - 1] != id)
+                {
+                    __atomic_add_fetch( &stress_errors, 1, __ATOMIC_RELAXED);
+                }
+                xbee_pool_cache_free( &cache, held[i]);
+            }
+        }
+    }
+    xbee_pool_cache_flush( &cache);
+
+    return NULL;
+}
+
+void t_stress( void)
+{
+    pthread_t thread[THREADS];
+    int i;
+
+    xbee_pool_init( &pool, space, sizeof space, BLOCK_SIZE);
+    for (i = 0; i < THREADS; ++i)
+    {
+        pthread_create( &thread[i], NULL, stress_thread, (void *)(intptr_t) i);
+    }
+    for (i = 0; i < THREADS; ++i)
+    {
+        pthread_join( thread[i], NULL);
+    }
+
+    test_compare( stress_errors, 0, NULL, "block shared by two threads");
+    test_compare( xbee_pool_available( &pool), BLOCK_COUNT, NULL,
+        "all blocks returned");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_alloc_free);
+    failures += DO_TEST( t_cache);
+    failures += DO_TEST( t_stress);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,188 @@
+// Unit tests for the multi-device reactor: readiness, per-device stats and
+// round-robin fairness when one device has a backlog of frames.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xbee/platform.h"
+#include "xbee/reactor.h"
+#include "../unittest.h"
+
+#define DEVICES 3
+
+static xbee_dev_t dev[DEVICES];
+static int pipe_fd[DEVICES][2];
+static int frame_count[DEVICES];
+static xbee_reactor_t reactor;
+
+int count_frame( xbee_dev_t *xbee, const void FAR *frame, uint16_t length,
+    void FAR *context)
+{
+    XBEE_UNUSED_PARAMETER( frame);
+    XBEE_UNUSED_PARAMETER( length);
+    XBEE_UNUSED_PARAMETER( context);
+
+    ++frame_count[xbee - dev];
+    return 0;
+}
+
+static const xbee_dispatch_table_entry_t handlers[] = {
+    { XBEE_FRAME_MODEM_STATUS, 0, count_frame, NULL },
+    XBEE_FRAME_TABLE_END
+};
+
+// Devices that read from the read end of a pipe instead of a serial port.
+void setup( void)
+{
+    int i;
+
+    memset( frame_count, 0, sizeof frame_count);
+    for (i = 0; i < DEVICES; ++i)
+    {
+        memset( &dev[i], 0, sizeof dev[i]);
+        if (pipe( pipe_fd[i]) != 0)
+        {
+            perror( "pipe");
+            return;
+        }
+        fcntl( pipe_fd[i][0], F_SETFL, O_NONBLOCK);
+        dev[i].serport.fd = pipe_fd[i][0];
+        dev[i].xbee_frame_handlers_arr = handlers;
+        dev[i].flags = XBEE_DEV_FLAG_CMD_INIT;
+    }
+    test_compare( xbee_reactor_init( &reactor), 0, NULL, "init");
+}
+
+void teardown( void)
+{
+    int i;
+
+    xbee_reactor_close( &reactor);
+    for (i = 0; i < DEVICES; ++i)
+    {
+        close( pipe_fd[i][0]);
+        close( pipe_fd[i][1]);
+    }
+}
+
+// Write <count> Modem Status frames to the pipe feeding device <index>.
+void send_frames( int index, int count)
+{
+    static const uint8_t frame[] = { 0x7E, 0x00, 0x02, 0x8A, 0x00, 0x75 };
+
+    while (count--)
+    {
+        if (write( pipe_fd[index][1], frame, sizeof frame) != sizeof frame)
+        {
+            perror( "write");
+        }
+    }
+}
+
+void t_register( void)
+{
+    xbee_dev_t closed;
+
+    setup();
+
+    test_compare( xbee_reactor_add( &reactor, &dev[0]), 0, NULL, "add 0");
+    test_compare( xbee_reactor_add( &reactor, &dev[1]), 1, NULL, "add 1");
+    test_compare( xbee_reactor_add( &reactor, &dev[0]), -EEXIST, NULL,
+        "add twice");
+
+    memset( &closed, 0, sizeof closed);
+    closed.serport.fd = -1;
+    test_compare( xbee_reactor_add( &reactor, &closed), -EINVAL, NULL,
+        "add closed port");
+
+    test_compare( xbee_reactor_remove( &reactor, &dev[0]), 0, NULL,
+        "remove 0");
+    test_compare( xbee_reactor_remove( &reactor, &dev[0]), -ENOENT, NULL,
+        "remove twice");
+    test_bool( xbee_reactor_stats( &reactor, &dev[0]) == NULL,
+        "stats for removed device");
+
+    // freed slot is reused
+    test_compare( xbee_reactor_add( &reactor, &dev[2]), 0, NULL,
+        "add into freed slot");
+
+    teardown();
+}
+
+void t_ready_only( void)
+{
+    const xbee_reactor_stats_t *stats;
+
+    setup();
+    xbee_reactor_add( &reactor, &dev[0]);
+    xbee_reactor_add( &reactor, &dev[1]);
+
+    test_compare( xbee_reactor_poll( &reactor, 0), 0, NULL, "idle poll");
+
+    send_frames( 1, 2);
+    test_compare( xbee_reactor_poll( &reactor, 100), 2, NULL, "poll");
+    test_compare( frame_count[1], 2, NULL, "frames on dev 1");
+    test_compare( frame_count[0], 0, NULL, "frames on dev 0");
+
+    stats = xbee_reactor_stats( &reactor, &dev[0]);
+    test_compare( stats->ticks, 0, NULL, "idle device was ticked");
+    stats = xbee_reactor_stats( &reactor, &dev[1]);
+    test_compare( stats->ticks, 1, NULL, "dev 1 ticks");
+    test_compare( stats->wakeups, 1, NULL, "dev 1 wakeups");
+    test_compare( stats->frames, 2, NULL, "dev 1 frames");
+    test_compare( stats->deferred, 0, NULL, "dev 1 deferred");
+
+    teardown();
+}
+
+void t_fairness( void)
+{
+    const int backlog = 4 * XBEE_DEV_MAX_DISPATCH_PER_TICK;
+    const xbee_reactor_stats_t *stats;
+    int polls;
+
+    setup();
+    xbee_reactor_add( &reactor, &dev[0]);
+    xbee_reactor_add( &reactor, &dev[1]);
+    xbee_reactor_add( &reactor, &dev[2]);
+
+    // dev 0 floods, the others send one frame each
+    send_frames( 0, backlog);
+    send_frames( 1, 1);
+    send_frames( 2, 1);
+
+    test_compare( xbee_reactor_poll( &reactor, 100),
+        XBEE_DEV_MAX_DISPATCH_PER_TICK + 2, NULL, "first poll");
+    test_compare( frame_count[0], XBEE_DEV_MAX_DISPATCH_PER_TICK, NULL,
+        "dev 0 limited per tick");
+    test_compare( frame_count[1], 1, NULL, "dev 1 served in first round");
+    test_compare( frame_count[2], 1, NULL, "dev 2 served in first round");
+
+    for (polls = 0; polls < 10 && frame_count[0] < backlog; ++polls)
+    {
+        xbee_reactor_poll( &reactor, 100);
+    }
+    test_compare( frame_count[0], backlog, NULL, "dev 0 backlog drained");
+    test_compare( xbee_reactor_poll( &reactor, 0), 0, NULL, "drained poll");
+
+    stats = xbee_reactor_stats( &reactor, &dev[0]);
+    test_compare( stats->frames, backlog, NULL, "dev 0 frames");
+    test_bool( stats->deferred >= 3, "dev 0 deferred");
+    test_compare( stats->errors, 0, NULL, "dev 0 errors");
+
+    teardown();
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_register);
+    failures += DO_TEST( t_ready_only);
+    failures += DO_TEST( t_fairness);
+
+    return test_exit( failures);
+}
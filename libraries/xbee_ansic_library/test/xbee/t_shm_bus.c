@@ -0,0 +1,186 @@
+// Unit tests for the shared-memory frame bus: fan-out to several readers,
+// lapped readers, stale zero-copy reads and a reader in another process.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "xbee/platform.h"
+#include "xbee/shm_bus.h"
+#include "../unittest.h"
+
+#define SLOTS       16
+
+static char name[32];
+static xbee_shm_bus_t bus;
+
+// Publish a 4-byte frame holding <n>.
+static void publish( uint32_t n)
+{
+    xbee_shm_bus_publish( &bus, &n, sizeof n);
+}
+
+static uint32_t frame_number( const xbee_shm_bus_slot_t *slot)
+{
+    uint32_t n;
+
+    memcpy( &n, slot->data, sizeof n);
+    return n;
+}
+
+void t_fan_out( void)
+{
+    xbee_shm_bus_reader_t a, b;
+    const xbee_shm_bus_slot_t *slot;
+    uint8_t big[XBEE_SHM_BUS_FRAME_MAX + 1] = { 0 };
+    uint32_t n;
+    int i;
+
+    test_compare( xbee_shm_bus_create( &bus, name, 12), -EINVAL, NULL,
+        "slots not a power of 2");
+    test_compare( xbee_shm_bus_create( &bus, name, SLOTS), 0, NULL, "create");
+    test_compare( sizeof(xbee_shm_bus_slot_t) % 64, 0, NULL, "slot size");
+    test_compare( xbee_shm_bus_attach( &a, name), 0, NULL, "attach a");
+
+    publish( 1);
+    test_compare( xbee_shm_bus_attach( &b, name), 0, NULL, "attach b");
+    publish( 2);
+    test_compare( xbee_shm_bus_publish( &bus, big, sizeof big), -EMSGSIZE,
+        NULL, "frame too large");
+
+    // both readers see the same frames, from when they attached
+    slot = xbee_shm_bus_peek( &a);
+    test_bool( slot != NULL && frame_number( slot) == 1, "a sees 1");
+    test_compare( slot->length, 4, NULL, "length");
+    test_compare( xbee_shm_bus_release( &a), 0, NULL, "release");
+    test_compare( xbee_shm_bus_read( &a, &n, sizeof n), 4, NULL, "a reads 2");
+    test_compare( n, 2, NULL, "a frame 2");
+    test_bool( xbee_shm_bus_peek( &a) == NULL, "a caught up");
+
+    test_compare( xbee_shm_bus_read( &b, &n, sizeof n), 4, NULL, "b reads");
+    test_compare( n, 2, NULL, "b frame 2");
+    test_compare( xbee_shm_bus_read( &b, &n, sizeof n), 0, NULL, "b empty");
+
+    // detaching doesn't disturb the publisher or other readers
+    xbee_shm_bus_detach( &b);
+    publish( 3);
+    test_compare( xbee_shm_bus_read( &a, &n, sizeof n), 4, NULL,
+        "read after detach");
+    test_compare( n, 3, NULL, "frame 3");
+
+    // a reader that falls a full ring behind skips to the oldest frame
+    for (i = 0; i < SLOTS + 5; ++i)
+    {
+        publish( 100 + i);
+    }
+    slot = xbee_shm_bus_peek( &a);
+    test_bool( slot != NULL, "peek after lap");
+    test_compare( frame_number( slot), 100 + 5 + 1, NULL, "oldest intact");
+    test_compare( a.lost, 6, NULL, "lost frames");
+
+    // overwritten while in use
+    for (i = 0; i < SLOTS; ++i)
+    {
+        publish( 200 + i);
+    }
+    test_compare( xbee_shm_bus_release( &a), -ESTALE, NULL, "stale");
+
+    xbee_shm_bus_detach( &a);
+    xbee_shm_bus_destroy( &bus);
+    test_compare( xbee_shm_bus_attach( &a, name), -ENOENT, NULL,
+        "attach after destroy");
+}
+
+#define CHILD_FRAMES    5000
+
+// Child process: read CHILD_FRAMES frames and check they arrive in order.
+static int child( int ready)
+{
+    xbee_shm_bus_reader_t reader;
+    const xbee_shm_bus_slot_t *slot;
+    uint32_t expected = 0;
+
+    if (xbee_shm_bus_attach( &reader, name) != 0)
+    {
+        return 1;
+    }
+    if (write( ready, "", 1) != 1)
+    {
+        return 2;
+    }
+    close( ready);
+
+    while (expected < CHILD_FRAMES)
+    {
+        slot = xbee_shm_bus_peek( &reader);
+        if (slot == NULL)
+        {
+            usleep( 100);
+            continue;
+        }
+        if (frame_number( slot) != expected || slot->length != 4)
+        {
+            return 3;
+        }
+        if (xbee_shm_bus_release( &reader) == 0)
+        {
+            ++expected;
+        }
+    }
+    xbee_shm_bus_detach( &reader);
+
+    return 0;
+}
+
+void t_process( void)
+{
+    xbee_shm_bus_reader_t self;
+    int fd[2], status = -1;
+    uint32_t n;
+    char c;
+    pid_t pid;
+
+    xbee_shm_bus_create( &bus, name, 8192);
+    if (pipe( fd) != 0)
+    {
+        perror( "pipe");
+        return;
+    }
+    pid = fork();
+    if (pid == 0)
+    {
+        close( fd[0]);
+        _exit( child( fd[1]));
+    }
+    close( fd[1]);
+    test_compare( read( fd[0], &c, 1), 1, NULL, "child attached");
+    close( fd[0]);
+
+    xbee_shm_bus_attach( &self, name);
+    for (n = 0; n < CHILD_FRAMES; ++n)
+    {
+        publish( n);
+    }
+    test_compare( xbee_shm_bus_read( &self, &n, sizeof n), 4, NULL,
+        "reader in publisher process");
+
+    waitpid( pid, &status, 0);
+    test_bool( WIFEXITED( status), "child exited");
+    test_compare( WEXITSTATUS( status), 0, NULL, "child read every frame");
+
+    xbee_shm_bus_detach( &self);
+    xbee_shm_bus_destroy( &bus);
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    snprintf( name, sizeof name, "/t_shm_bus_%d", (int) getpid());
+
+    failures += DO_TEST( t_fan_out);
+    failures += DO_TEST( t_process);
+
+    return test_exit( failures);
+}
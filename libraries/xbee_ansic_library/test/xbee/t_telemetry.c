@@ -0,0 +1,225 @@
+// Unit tests for the columnar telemetry store: record decoding, round trips
+// through delta/bit-packed chunks, the time index and range queries.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "xbee/platform.h"
+#include "xbee/byteorder.h"
+#include "xbee/telemetry.h"
+#include "../unittest.h"
+
+#define ROWS            (2 * XBEE_TELEMETRY_CHUNK_ROWS + 100)
+#define CHANNELS        3
+
+static char dir[] = "/tmp/t_telemetry_XXXXXX";
+static char path[64];
+static xbee_telemetry_t store;
+static xbee_telemetry_reader_t reader;
+
+// Channel values for row <n>: a slow ramp, noise over the full 32-bit range
+// and a constant.
+static int32_t sample( uint32_t n, uint_fast8_t channel)
+{
+    switch (channel)
+    {
+        case 0:     return (int32_t)(n * 3) - 1000;
+        case 1:     return (int32_t)(n * 2654435761u);
+        default:    return 42;
+    }
+}
+
+void t_decode( void)
+{
+    uint8_t payload[2 + 4 + 4 * 2];
+    xbee_telemetry_record_t record;
+    uint32_t be;
+
+    payload[0] = XBEE_TELEMETRY_WIRE_TYPE;
+    payload[1] = 2;
+    be = htobe32( 123456);
+    memcpy( payload + 2, &be, 4);
+    be = htobe32( (uint32_t) -5);
+    memcpy( payload + 6, &be, 4);
+    be = htobe32( 77);
+    memcpy( payload + 10, &be, 4);
+
+    test_compare( xbee_telemetry_decode( payload, sizeof payload, &record), 0,
+        NULL, "decode");
+    test_compare( record.timestamp, 123456, NULL, "timestamp");
+    test_compare( record.channels, 2, NULL, "channels");
+    test_compare( record.value[0], -5, NULL, "value 0");
+    test_compare( record.value[1], 77, NULL, "value 1");
+
+    test_compare( xbee_telemetry_decode( payload, sizeof payload - 1, &record),
+        -EBADMSG, NULL, "short payload");
+    payload[0] = 'H';
+    test_compare( xbee_telemetry_decode( payload, sizeof payload, &record),
+        -EBADMSG, NULL, "text payload");
+}
+
+void t_round_trip( void)
+{
+    xbee_telemetry_record_t record;
+    int32_t column[XBEE_TELEMETRY_CHUNK_ROWS];
+    uint32_t n, chunk, errors = 0;
+    uint_fast8_t c;
+    struct stat st;
+    int rows, i;
+
+    test_compare( xbee_telemetry_create( &store, path, CHANNELS), 0, NULL,
+        "create");
+    record.channels = CHANNELS;
+    for (n = 0; n < ROWS; ++n)
+    {
+        record.timestamp = 1000 + n * 10;
+        for (c = 0; c < CHANNELS; ++c)
+        {
+            record.value[c] = sample( n, c);
+        }
+        errors += xbee_telemetry_append( &store, &record) != 0;
+    }
+    test_compare( errors, 0, NULL, "append");
+    test_compare( store.chunks, 2, NULL, "full chunks written");
+    test_compare( xbee_telemetry_close( &store), 0, NULL, "close");
+
+    // ramp and constant pack to a few bits, noise to 32
+    stat( path, &st);
+    test_bool( st.st_size < ROWS * (4 + 4 + 4 + 4) * 11 / 16,
+        "compressed size");
+
+    test_compare( xbee_telemetry_open( &reader, path), 0, NULL, "open");
+    test_compare( reader.chunks, 3, NULL, "chunks");
+    test_compare( reader.channels, CHANNELS, NULL, "channels");
+
+    n = 0;
+    for (chunk = 0; chunk < reader.chunks; ++chunk)
+    {
+        rows = xbee_telemetry_read_column( &reader, chunk, XBEE_TELEMETRY_TIME,
+            column);
+        for (i = 0; i < rows; ++i)
+        {
+            errors += column[i] != (int32_t)(1000 + (n + i) * 10);
+        }
+        for (c = 0; c < CHANNELS; ++c)
+        {
+            xbee_telemetry_read_column( &reader, chunk, c, column);
+            for (i = 0; i < rows; ++i)
+            {
+                errors += column[i] != sample( n + i, c);
+            }
+        }
+        n += rows;
+    }
+    test_compare( n, ROWS, NULL, "rows read");
+    test_compare( errors, 0, NULL, "values read");
+    test_compare( xbee_telemetry_read_column( &reader, 0, CHANNELS, column),
+        -EINVAL, NULL, "bad channel");
+    test_compare( xbee_telemetry_read_column( &reader, 3, 0, column), -EINVAL,
+        NULL, "bad chunk");
+
+    xbee_telemetry_reader_close( &reader);
+}
+
+void t_range( void)
+{
+    uint32_t t[300];
+    int32_t v[300];
+    uint32_t first, n, errors = 0;
+    int count;
+
+    xbee_telemetry_open( &reader, path);
+
+    test_compare( xbee_telemetry_find( &reader, 0), 0, NULL, "find before");
+    first = 1000 + XBEE_TELEMETRY_CHUNK_ROWS * 10;
+    test_compare( xbee_telemetry_find( &reader, first), 1, NULL,
+        "find chunk start");
+    test_compare( xbee_telemetry_find( &reader, first - 5), 1, NULL,
+        "find between chunks");
+    test_compare( xbee_telemetry_find( &reader, 1000 + ROWS * 10),
+        reader.chunks, NULL, "find after");
+
+    // 200 rows straddling the first chunk boundary
+    first = 1000 + (XBEE_TELEMETRY_CHUNK_ROWS - 100) * 10;
+    count = xbee_telemetry_range( &reader, first - 5, first + 1995, 0, t, v,
+        300);
+    test_compare( count, 200, NULL, "range rows");
+    for (n = 0; n < 200; ++n)
+    {
+        errors += t[n] != first + n * 10
+            || v[n] != sample( XBEE_TELEMETRY_CHUNK_ROWS - 100 + n, 0);
+    }
+    test_compare( errors, 0, NULL, "range values");
+
+    test_compare( xbee_telemetry_range( &reader, first, first + 1995, 1, t, v,
+        50), 50, NULL, "range limited by max");
+    test_compare( xbee_telemetry_range( &reader, 0, 999, 0, t, v, 300), 0,
+        NULL, "range before");
+
+    xbee_telemetry_reader_close( &reader);
+}
+
+void t_errors( void)
+{
+    xbee_telemetry_record_t record;
+
+    xbee_telemetry_create( &store, path, 2);
+    memset( &record, 0, sizeof record);
+    record.channels = 3;
+    test_compare( xbee_telemetry_append( &store, &record), -EINVAL, NULL,
+        "wrong channel count");
+    record.channels = 2;
+    record.timestamp = 50;
+    xbee_telemetry_append( &store, &record);
+    record.timestamp = 49;
+    test_compare( xbee_telemetry_append( &store, &record), -ERANGE, NULL,
+        "timestamp went backwards");
+
+    // the previous record is in a chunk now, but still counts
+    test_compare( xbee_telemetry_flush( &store), 0, NULL, "flush");
+    test_compare( xbee_telemetry_append( &store, &record), -ERANGE, NULL,
+        "timestamp went backwards after flush");
+    record.timestamp = 50;
+    test_compare( xbee_telemetry_append( &store, &record), 0, NULL,
+        "same timestamp after flush");
+    xbee_telemetry_close( &store);
+
+    xbee_telemetry_open( &reader, path);
+    test_compare( reader.chunks, 2, NULL, "partial chunks flushed");
+    xbee_telemetry_reader_close( &reader);
+
+    xbee_telemetry_create( &store, path, 1);
+    close( store.fd);
+    close( store.index_fd);
+    truncate( path, 5);
+    test_compare( xbee_telemetry_open( &reader, path), -EILSEQ, NULL,
+        "not a store");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+    char index_path[80];
+
+    if (mkdtemp( dir) == NULL)
+    {
+        perror( "mkdtemp");
+        return EXIT_FAILURE;
+    }
+    snprintf( path, sizeof path, "%s/telemetry.xbt", dir);
+
+    failures += DO_TEST( t_decode);
+    failures += DO_TEST( t_round_trip);
+    failures += DO_TEST( t_range);
+    failures += DO_TEST( t_errors);
+
+    snprintf( index_path, sizeof index_path, "%s.idx", path);
+    unlink( index_path);
+    unlink( path);
+    rmdir( dir);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,192 @@
+// Unit tests for the double-mapped circular buffer: contiguous access across
+// the wrap point, in-place frame parsing and resync, and dispatching frames
+// read from a (fake) serial port.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "xbee/platform.h"
+#include "xbee/vring.h"
+#include "../unittest.h"
+
+static xbee_vring_t vring;
+
+// Modem Status frame, type 0x8A, status 0x00
+static const uint8_t modem_status[] = { 0x7E, 0x00, 0x02, 0x8A, 0x00, 0x75 };
+
+// Move head and tail to <offset> bytes before the end of the buffer.
+void move_to_end( unsigned int offset)
+{
+    vring.head = vring.tail = vring.size - offset;
+}
+
+void t_mirror( void)
+{
+    uint8_t in[64], out[64];
+    const uint8_t *r;
+    uint8_t *w;
+    unsigned int length, i;
+
+    for (i = 0; i < sizeof in; ++i)
+    {
+        in[i] = (uint8_t) i;
+    }
+
+    test_compare( xbee_vring_init( &vring, 100), 0, NULL, "init");
+    test_bool( vring.size >= 100 && ! (vring.size & (vring.size - 1)),
+        "size is a power of 2");
+
+    // writes through the upper mapping show up at the start of the buffer
+    move_to_end( 10);
+    w = xbee_vring_reserve( &vring, &length);
+    test_compare( length, vring.size, NULL, "reserve whole buffer");
+    memcpy( w, in, 40);
+    xbee_vring_commit( &vring, 40);
+    test_compare( memcmp( vring.base, in + 10, 30), 0, NULL,
+        "wrapped bytes at start");
+
+    r = xbee_vring_peek( &vring, &length);
+    test_compare( length, 40, NULL, "peek across wrap");
+    test_compare( memcmp( r, in, 40), 0, NULL, "peek data");
+
+    test_compare( xbee_vring_get( &vring, out, 64), 40, NULL, "get");
+    test_compare( memcmp( out, in, 40), 0, NULL, "get data");
+    test_bool( xbee_vring_peek( &vring, &length) == NULL, "empty");
+
+    // fill, then check the limit
+    test_compare( xbee_vring_put( &vring, in, 64), 64, NULL, "put");
+    test_compare( xbee_vring_free( &vring), vring.size - 64, NULL, "free");
+    vring.tail += xbee_vring_free( &vring);
+    test_compare( xbee_vring_put( &vring, in, 1), 0, NULL, "put on full");
+    test_bool( xbee_vring_reserve( &vring, &length) == NULL,
+        "reserve on full");
+
+    xbee_vring_close( &vring);
+    test_bool( vring.base == NULL, "closed");
+
+    // no power of 2 that fits in an unsigned int
+    test_compare( xbee_vring_init( &vring, UINT_MAX / 2 + 2), -EINVAL, NULL,
+        "size too large");
+    test_compare( xbee_vring_init( &vring, UINT_MAX), -EINVAL, NULL,
+        "largest size");
+}
+
+void t_frame( void)
+{
+    static const uint8_t stream[] = {
+        0x55, 0xAA,                               // noise
+        0x7E, 0x7E, 0x00, 0x02, 0x8A, 0x02, 0x73, // duplicate start
+        0x7E, 0x00, 0x02, 0x8A, 0x00, 0x00,       // bad checksum
+        0x7E, 0xFF, 0xFF,                         // bad length
+    };
+    const uint8_t *frame;
+    uint16_t length;
+
+    xbee_vring_init( &vring, 0);
+
+    // a frame split across the wrap point is still contiguous
+    move_to_end( 3);
+    xbee_vring_put( &vring, modem_status, 4);
+    test_bool( xbee_vring_frame( &vring, &length) == NULL, "partial frame");
+    xbee_vring_put( &vring, modem_status + 4, 2);
+    frame = xbee_vring_frame( &vring, &length);
+    test_bool( frame != NULL, "frame across wrap");
+    test_compare( length, 2, NULL, "frame length");
+    test_bool( frame == vring.base + vring.size, "frame in place");
+    test_compare( frame[0], 0x8A, NULL, "frame type");
+    xbee_vring_frame_done( &vring, length);
+    test_compare( xbee_vring_used( &vring), 0, NULL, "frame consumed");
+
+    xbee_vring_put( &vring, stream, sizeof stream);
+    xbee_vring_put( &vring, modem_status, sizeof modem_status);
+    frame = xbee_vring_frame( &vring, &length);
+    test_bool( frame != NULL && frame[1] == 0x02, "resync after duplicate");
+    xbee_vring_frame_done( &vring, length);
+    frame = xbee_vring_frame( &vring, &length);
+    test_bool( frame != NULL && frame[1] == 0x00, "frame after bad ones");
+    xbee_vring_frame_done( &vring, length);
+    test_compare( vring.bad_frames, 1, NULL, "bad frames");
+    test_compare( vring.skipped, 2 + 1 + 1 + 2, NULL, "skipped bytes");
+    test_compare( xbee_vring_used( &vring), 0, NULL, "empty");
+
+    xbee_vring_close( &vring);
+}
+
+static int frames_seen;
+static const void *last_frame;
+
+int count_frame( xbee_dev_t *xbee, const void FAR *frame, uint16_t length,
+    void FAR *context)
+{
+    XBEE_UNUSED_PARAMETER( xbee);
+    XBEE_UNUSED_PARAMETER( length);
+    XBEE_UNUSED_PARAMETER( context);
+
+    ++frames_seen;
+    last_frame = frame;
+    return 0;
+}
+
+static const xbee_dispatch_table_entry_t handlers[] = {
+    { XBEE_FRAME_MODEM_STATUS, 0, count_frame, NULL },
+    XBEE_FRAME_TABLE_END
+};
+
+void t_dev_tick( void)
+{
+    xbee_dev_t dev;
+    int fd[2], i;
+
+    memset( &dev, 0, sizeof dev);
+    if (pipe( fd) != 0)
+    {
+        perror( "pipe");
+        return;
+    }
+    fcntl( fd[0], F_SETFL, O_NONBLOCK);
+    dev.serport.fd = fd[0];
+    dev.xbee_frame_handlers_arr = handlers;
+    xbee_vring_init( &vring, 0);
+
+    test_compare( xbee_vring_dev_tick( &dev, &vring), 0, NULL, "no data");
+
+    for (i = 0; i < XBEE_DEV_MAX_DISPATCH_PER_TICK + 2; ++i)
+    {
+        if (write( fd[1], modem_status, sizeof modem_status) < 0)
+        {
+            perror( "write");
+        }
+    }
+    test_compare( xbee_vring_dev_tick( &dev, &vring),
+        XBEE_DEV_MAX_DISPATCH_PER_TICK, NULL, "frames per tick");
+    test_bool( (const uint8_t *) last_frame >= vring.base
+        && (const uint8_t *) last_frame < vring.base + 2 * vring.size,
+        "dispatched in place");
+    test_compare( xbee_vring_dev_tick( &dev, &vring), 2, NULL,
+        "remaining frames");
+    test_compare( frames_seen, XBEE_DEV_MAX_DISPATCH_PER_TICK + 2, NULL,
+        "handler calls");
+
+    dev.flags |= XBEE_DEV_FLAG_IN_TICK;
+    test_compare( xbee_vring_dev_tick( &dev, &vring), -EBUSY, NULL,
+        "recursive tick");
+
+    xbee_vring_close( &vring);
+    close( fd[0]);
+    close( fd[1]);
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_mirror);
+    failures += DO_TEST( t_frame);
+    failures += DO_TEST( t_dev_tick);
+
+    return test_exit( failures);
+}
@@ -0,0 +1,302 @@
+// Unit tests for the Xmodem sender against a simulated receiver: plain
+// 128-byte blocks, prefetching the next block into a second buffer, and
+// negotiating 1K blocks (with the fall back to 128 when they're refused).
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "xbee/xmodem.h"
+#include "xbee/xmodem_crc16.h"
+#include "../unittest.h"
+
+#define FILE_MAX        4096
+
+// firmware image being sent
+static struct {
+    uint8_t     data[FILE_MAX];
+    int         length;
+    int         offset;
+    int         early_reads;    // reads past what the receiver has so far
+} source;
+
+// simulated receiver
+static struct {
+    bool_t      checksum;       // start with NAK instead of 'C'
+    bool_t      accept_1k;      // take STX blocks
+    int         write_limit;    // max bytes accepted per write
+    uint8_t     packet[1024 + 5];
+    int         packet_len;
+    uint8_t     next_num;
+    uint8_t     replies[8];
+    int         reply_count;
+    uint8_t     data[FILE_MAX + 1024];
+    int         length;
+    int         blocks_1k;
+    int         blocks_128;
+    int         bad_packets;
+    bool_t      done;
+} rx;
+
+static xbee_xmodem_state_t xbxm;
+static char buffer[1024 + 5], next_buffer[1024 + 5];
+
+int source_read( void FAR *context, void FAR *buf, int16_t bytes)
+{
+    int count = source.length - source.offset;
+
+    if (count > bytes)
+    {
+        count = bytes;
+    }
+    if (count > 0 && source.offset > rx.length)
+    {
+        ++source.early_reads;
+    }
+    memcpy( buf, &source.data[source.offset], count);
+    source.offset += count;
+
+    return count;
+}
+
+int rx_read( void FAR *context, void FAR *buf, int16_t bytes)
+{
+    if (rx.reply_count == 0)
+    {
+        return -ENODATA;
+    }
+    *(uint8_t *) buf = rx.replies[0];
+    memmove( rx.replies, &rx.replies[1], --rx.reply_count);
+
+    return 1;
+}
+
+void rx_reply( uint8_t ch)
+{
+    rx.replies[rx.reply_count++] = ch;
+}
+
+void rx_packet( void)
+{
+    int block_size = (rx.packet[0] == XMODEM_STX) ? 1024 : 128;
+    const uint8_t *block = &rx.packet[3];
+    uint16_t check = 0;
+    int i;
+
+    if (block_size == 1024 && ! rx.accept_1k)
+    {
+        rx_reply( XMODEM_NAK);
+        return;
+    }
+
+    if (rx.checksum)
+    {
+        for (i = 0; i < block_size; ++i)
+        {
+            check += block[i];
+        }
+        check = (check & 0xFF) != block[block_size];
+    }
+    else
+    {
+        check = crc16_calc( block, block_size, 0)
+            != (block[block_size] << 8 | block[block_size + 1]);
+    }
+
+    if (check || rx.packet[1] != rx.next_num
+        || rx.packet[2] != (uint8_t) ~rx.next_num)
+    {
+        ++rx.bad_packets;
+        rx_reply( XMODEM_NAK);
+        return;
+    }
+
+    memcpy( &rx.data[rx.length], block, block_size);
+    rx.length += block_size;
+    ++rx.next_num;
+    if (block_size == 1024)
+    {
+        ++rx.blocks_1k;
+    }
+    else
+    {
+        ++rx.blocks_128;
+    }
+    rx_reply( XMODEM_ACK);
+}
+
+int rx_write( void FAR *context, const void FAR *buf, int16_t bytes)
+{
+    const uint8_t *p = buf;
+    int packet_size;
+    int i;
+
+    if (bytes > rx.write_limit)
+    {
+        bytes = rx.write_limit;
+    }
+
+    for (i = 0; i < bytes; ++i)
+    {
+        if (rx.packet_len == 0 && p[i] == XMODEM_EOT)
+        {
+            rx.done = TRUE;
+            rx_reply( XMODEM_ACK);
+            continue;
+        }
+        rx.packet[rx.packet_len++] = p[i];
+        packet_size = ((rx.packet[0] == XMODEM_STX) ? 1024 : 128)
+            + (rx.checksum ? 4 : 5);
+        if (rx.packet_len == packet_size)
+        {
+            rx_packet();
+            rx.packet_len = 0;
+        }
+    }
+
+    return bytes;
+}
+
+void setup( int length, bool_t checksum, bool_t accept_1k, int write_limit)
+{
+    int i;
+
+    memset( &source, 0, sizeof source);
+    memset( &rx, 0, sizeof rx);
+    for (i = 0; i < length; ++i)
+    {
+        source.data[i] = (uint8_t) (i * 7 + i / 251);
+    }
+    source.length = length;
+    rx.checksum = checksum;
+    rx.accept_1k = accept_1k;
+    rx.write_limit = write_limit;
+    rx.next_num = 1;
+
+    xbee_xmodem_set_stream( &xbxm, rx_read, rx_write, NULL);
+    xbee_xmodem_set_source( &xbxm, buffer, source_read, NULL);
+}
+
+// send the file, starting once the receiver asks for it
+int transfer( uint16_t flags, bool_t prefetch)
+{
+    int result;
+    int ticks = 0;
+
+    xbee_xmodem_tx_init( &xbxm, flags);
+    if (prefetch)
+    {
+        xbee_xmodem_set_prefetch( &xbxm, next_buffer);
+    }
+    rx_reply( rx.checksum ? XMODEM_NAK : XMODEM_CRC);
+    do
+    {
+        result = xbee_xmodem_tx_tick( &xbxm);
+    } while (result == 0 && ++ticks < 100000);
+
+    return result;
+}
+
+// receiver got the file, padded with 0xFF to the end of the last block
+bool_t received_file( int padded_length)
+{
+    int i;
+
+    if (rx.length != padded_length || ! rx.done || rx.bad_packets)
+    {
+        return FALSE;
+    }
+    for (i = source.length; i < padded_length; ++i)
+    {
+        if (rx.data[i] != 0xFF)
+        {
+            return FALSE;
+        }
+    }
+    return memcmp( rx.data, source.data, source.length) == 0;
+}
+
+void t_crc_128( void)
+{
+    setup( 1000, FALSE, FALSE, 1029);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128, FALSE), 1, NULL, "result");
+    test_bool( received_file( 1024), "received file");
+    test_compare( rx.blocks_128, 8, NULL, "128-byte blocks");
+    test_compare( source.early_reads, 0, NULL, "no prefetch");
+}
+
+void t_checksum( void)
+{
+    setup( 300, TRUE, FALSE, 1029);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_AUTO_1K,
+        TRUE), 1, NULL, "result");
+    test_bool( received_file( 384), "received file");
+    test_compare( rx.blocks_1k, 0, NULL, "no 1K blocks without CRC");
+}
+
+void t_prefetch( void)
+{
+    // receiver takes a few bytes at a time, so blocks are in flight
+    setup( 2000, FALSE, FALSE, 40);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128, TRUE), 1, NULL, "result");
+    test_bool( received_file( 2048), "received file");
+    test_bool( source.early_reads > 0, "read ahead of receiver");
+
+    // file ends on a block boundary, so the prefetch finds EOF
+    setup( 1024, FALSE, FALSE, 40);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128, TRUE), 1, NULL, "result");
+    test_bool( received_file( 1024), "received whole blocks");
+}
+
+void t_auto_1k( void)
+{
+    setup( 3000, FALSE, TRUE, 100);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_AUTO_1K,
+        TRUE), 1, NULL, "result");
+    test_bool( received_file( 3072), "received file");
+    test_compare( rx.blocks_1k, 3, NULL, "1K blocks");
+    test_compare( rx.blocks_128, 0, NULL, "no 128-byte blocks");
+
+    // no second buffer, no 1K blocks
+    setup( 3000, FALSE, TRUE, 1029);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_AUTO_1K,
+        FALSE), 1, NULL, "result");
+    test_bool( received_file( 3072), "received file without prefetch");
+    test_compare( rx.blocks_1k, 0, NULL, "no 1K blocks");
+}
+
+void t_auto_1k_refused( void)
+{
+    setup( 3000, FALSE, FALSE, 100);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_AUTO_1K,
+        TRUE), 1, NULL, "result");
+    test_bool( received_file( 3072), "received file");
+    test_compare( rx.blocks_128, 24, NULL, "fell back to 128-byte blocks");
+
+    // file shorter than the refused 1K block
+    setup( 200, FALSE, FALSE, 1029);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_AUTO_1K,
+        TRUE), 1, NULL, "result");
+    test_bool( received_file( 256), "received short file");
+    test_compare( rx.blocks_128, 2, NULL, "short file blocks");
+
+    // file exactly one 1K block
+    setup( 1024, FALSE, FALSE, 1029);
+    test_compare( transfer( XBEE_XMODEM_FLAG_128 | XBEE_XMODEM_FLAG_AUTO_1K,
+        TRUE), 1, NULL, "result");
+    test_bool( received_file( 1024), "received 1K file");
+    test_compare( rx.blocks_128, 8, NULL, "1K file blocks");
+}
+
+int main( int argc, char *argv[])
+{
+    int failures = 0;
+
+    failures += DO_TEST( t_crc_128);
+    failures += DO_TEST( t_checksum);
+    failures += DO_TEST( t_prefetch);
+    failures += DO_TEST( t_auto_1k);
+    failures += DO_TEST( t_auto_1k_refused);
+
+    return test_exit( failures);
+}
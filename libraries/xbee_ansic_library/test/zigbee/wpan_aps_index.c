@@ -0,0 +1,211 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Unit tests for the endpoint/cluster index built by wpan_aps_index_build():
+// every lookup through the index has to find the same endpoint and cluster
+// entry as a linear search of the tables.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "wpan/aps.h"
+#include "../unittest.h"
+
+#define ENDPOINTS		4
+#define CLUSTERS		(WPAN_APS_INDEX_SLOTS + 4)
+
+wpan_dev_t dev;
+wpan_endpoint_table_entry_t endpoint_table[ENDPOINTS + 1];
+wpan_cluster_table_entry_t cluster_table[ENDPOINTS][CLUSTERS + 1];
+const void *handled;			// context of the handler that got the frame
+
+int cluster_handler( const wpan_envelope_t FAR *envelope, void FAR *context)
+{
+	handled = context;
+	return 0;
+}
+
+int endpoint_handler( const wpan_envelope_t FAR *envelope,
+	struct wpan_ep_state_t FAR *ep_state)
+{
+	handled = envelope->dev;
+	return 0;
+}
+
+// Give each endpoint <clusters> entries, including a duplicate cluster ID,
+// an entry with neither input nor output flags and one without a handler.
+// Endpoints 1 and 2 share endpoint number 0x10 with different profiles.
+void setup( int clusters)
+{
+	static const uint8_t ep_num[ENDPOINTS] = { 0x00, 0x10, 0x10, 0xE8 };
+	wpan_cluster_table_entry_t *clust;
+	int e, c;
+
+	memset( &dev, 0, sizeof dev);
+	memset( endpoint_table, 0, sizeof endpoint_table);
+	memset( cluster_table, 0, sizeof cluster_table);
+
+	for (e = 0; e < ENDPOINTS; ++e)
+	{
+		endpoint_table[e].endpoint = ep_num[e];
+		endpoint_table[e].profile_id = (uint16_t) (0x0100 + e);
+		endpoint_table[e].handler = endpoint_handler;
+		endpoint_table[e].cluster_table = cluster_table[e];
+
+		for (c = 0; c < clusters; ++c)
+		{
+			clust = &cluster_table[e][c];
+			clust->cluster_id = (uint16_t) (c * 0x0101 + e * 3);
+			clust->handler = cluster_handler;
+			clust->context = clust;
+			clust->flags = WPAN_CLUST_FLAG_NOT_ZCL
+				| ((c & 1) ? WPAN_CLUST_FLAG_OUTPUT : WPAN_CLUST_FLAG_INPUT);
+		}
+		cluster_table[e][1].cluster_id = cluster_table[e][0].cluster_id;
+		cluster_table[e][2].flags = WPAN_CLUST_FLAG_NOT_ZCL;
+		cluster_table[e][3].handler = NULL;
+		cluster_table[e][clusters].cluster_id = WPAN_CLUSTER_END_OF_LIST;
+	}
+	endpoint_table[ENDPOINTS].endpoint = WPAN_ENDPOINT_END_OF_LIST;
+	dev.endpoint_table = endpoint_table;
+}
+
+// dispatch a frame, returning the context of the handler that took it
+const void *dispatch( uint8_t endpoint, uint16_t profile_id,
+	uint16_t cluster_id)
+{
+	wpan_envelope_t envelope;
+
+	memset( &envelope, 0, sizeof envelope);
+	envelope.dev = &dev;
+	envelope.dest_endpoint = endpoint;
+	envelope.profile_id = profile_id;
+	envelope.cluster_id = cluster_id;
+
+	handled = NULL;
+	wpan_envelope_dispatch( &envelope);
+	return handled;
+}
+
+// the handler a linear search of the tables picks
+const void *expected( uint8_t endpoint, uint16_t profile_id,
+	uint16_t cluster_id)
+{
+	const wpan_endpoint_table_entry_t *ep;
+	const wpan_cluster_table_entry_t *clust;
+
+	for (ep = endpoint_table; ep->endpoint != WPAN_ENDPOINT_END_OF_LIST; ++ep)
+	{
+		if (ep->endpoint == endpoint && ep->profile_id == profile_id)
+		{
+			clust = wpan_cluster_match( cluster_id, WPAN_CLUST_FLAG_INOUT,
+				ep->cluster_table);
+			return (clust && clust->handler) ? (const void *) clust
+				: (const void *) &dev;
+		}
+	}
+	return NULL;
+}
+
+// try every endpoint and profile with the table's cluster IDs and a few
+// that aren't in it, returning the number of mismatched lookups
+int compare_all( void)
+{
+	int e, p, c, errors = 0;
+	uint16_t cluster_id;
+
+	for (e = 0; e < ENDPOINTS; ++e)
+	{
+		for (p = 0; p < ENDPOINTS; ++p)
+		{
+			for (c = 0; c < CLUSTERS + 8; ++c)
+			{
+				cluster_id = (uint16_t) (c * 0x0101 + e * 3 + (c >= CLUSTERS));
+				if (dispatch( endpoint_table[e].endpoint,
+						(uint16_t) (0x0100 + p), cluster_id)
+					!= expected( endpoint_table[e].endpoint,
+						(uint16_t) (0x0100 + p), cluster_id))
+				{
+					++errors;
+				}
+			}
+		}
+	}
+
+	return errors;
+}
+
+void t_endpoints( void)
+{
+	setup( 8);
+	test_compare( wpan_aps_index_build( &dev), 0, NULL, "build");
+
+	test_bool( wpan_endpoint_match( &dev, 0x10, 0x0102) == &endpoint_table[2],
+		"second entry for shared endpoint");
+	test_bool( wpan_endpoint_match( &dev, 0x10, WPAN_APS_PROFILE_ANY)
+		== &endpoint_table[1], "first entry for any profile");
+	test_bool( wpan_endpoint_match( &dev, 0xE8, 0x0103) == &endpoint_table[3],
+		"last endpoint");
+	test_bool( wpan_endpoint_match( &dev, 0xE8, 0x0100) == NULL,
+		"wrong profile");
+	test_bool( wpan_endpoint_match( &dev, 0x11, WPAN_APS_PROFILE_ANY) == NULL,
+		"missing endpoint");
+	test_bool( wpan_endpoint_match( &dev, WPAN_ENDPOINT_END_OF_LIST,
+		WPAN_APS_PROFILE_ANY) == NULL, "end of list marker");
+}
+
+void t_clusters( void)
+{
+	int clusters;
+
+	// fill the index up to its limit of 7/8 of the slots
+	// (the duplicate and flagless entries aren't indexed)
+	for (clusters = 4; (clusters - 2) * ENDPOINTS
+		<= WPAN_APS_INDEX_SLOTS - WPAN_APS_INDEX_SLOTS / 8; ++clusters)
+	{
+		setup( clusters);
+		test_compare( wpan_aps_index_build( &dev), 0, NULL, "build");
+		test_compare( compare_all(), 0, NULL, "indexed lookups");
+	}
+}
+
+void t_overflow( void)
+{
+	setup( CLUSTERS);
+	test_compare( wpan_aps_index_build( &dev), -ENOSPC, NULL, "build");
+	test_compare( compare_all(), 0, NULL, "endpoints indexed, clusters not");
+}
+
+void t_stale( void)
+{
+	static wpan_endpoint_table_entry_t other_table[2];
+
+	setup( 8);
+	test_compare( wpan_aps_index_build( &dev), 0, NULL, "build");
+
+	// index has to be ignored once the device has a different table
+	other_table[0] = endpoint_table[3];
+	other_table[0].endpoint = 0x20;
+	other_table[1].endpoint = WPAN_ENDPOINT_END_OF_LIST;
+	dev.endpoint_table = other_table;
+	test_bool( wpan_endpoint_match( &dev, 0x20, 0x0103) == &other_table[0],
+		"new table searched");
+	test_bool( dispatch( 0x20, 0x0103, cluster_table[3][4].cluster_id)
+		== &cluster_table[3][4], "dispatched without index");
+}
+
+int main( int argc, char *argv[])
+{
+	int failures = 0;
+
+	failures += DO_TEST( t_endpoints);
+	failures += DO_TEST( t_clusters);
+	failures += DO_TEST( t_overflow);
+	failures += DO_TEST( t_stale);
+
+	return test_exit( failures);
+}
@@ -0,0 +1,426 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Unit tests for batched ZCL attribute reads against simulated nodes:
+// packed requests with responses too small to hold them, several requests
+// in flight per node, rejected requests, a node that never answers, one
+// that can't be sent to (at first or on resends) and a payload too small
+// for a request.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "wpan/aps.h"
+#include "zigbee/zcl.h"
+#include "zigbee/zcl_client.h"
+#include "../unittest.h"
+
+#define NODES			3
+#define ATTRIBUTES		30
+#define RESPONSE_MAX	40			// largest Read Attributes Response payload
+#define LOCAL_EP		0x01
+#define REMOTE_EP		0x0A
+#define PROFILE			0x0104
+#define NAME_ID			0x0005
+#define NAME			"Digi XBee"
+
+// simulated remote node
+struct {
+	addr64		ieee;
+	bool_t		silent;			// never responds
+	uint8_t		reject;			// default response status for every request
+	int			send_error;		// returned when sending to the node
+	int			requests;		// Read Attributes requests received
+	int			in_flight;		// responses not yet delivered
+	int			max_in_flight;
+} node[NODES];
+
+// responses waiting to be delivered
+struct {
+	wpan_envelope_t	envelope;
+	uint8_t			payload[RESPONSE_MAX + 3];
+} queue[16];
+int queued;
+
+wpan_dev_t dev;
+wpan_ep_state_t ep_state;
+const wpan_endpoint_table_entry_t endpoint_table[] = {
+	{ LOCAL_EP, PROFILE, zcl_batch_endpoint_handler, &ep_state, 0, 0, NULL },
+	WPAN_ENDPOINT_TABLE_END
+};
+
+uint16_t attribute_list[ATTRIBUTES + 1];
+zcl_batch_t batch;
+zcl_batch_read_t reads[NODES * 2];
+zcl_batch_attr_t results[NODES * 2][ATTRIBUTES];
+
+// every third attribute (offset by one) isn't supported by the nodes
+bool_t unsupported( uint16_t id)
+{
+	return id % 3 == 1 && id != NAME_ID;
+}
+
+uint16_t value( int n, uint16_t cluster_id, uint16_t id)
+{
+	return (uint16_t) (n * 1000 + cluster_id * 100 + id);
+}
+
+int node_send( const wpan_envelope_t FAR *envelope, uint16_t flags)
+{
+	const uint8_t *request = envelope->payload;
+	uint8_t *rsp;
+	int n, i, length;
+	uint16_t id, v;
+
+	for (n = 0; n < NODES; ++n)
+	{
+		if (addr64_equal( &envelope->ieee_address, &node[n].ieee))
+		{
+			break;
+		}
+	}
+	// ignore everything but Read Attributes (like Default Responses)
+	if (n == NODES || request[2] != ZCL_CMD_READ_ATTRIB)
+	{
+		return 0;
+	}
+	if (node[n].send_error)
+	{
+		return node[n].send_error;
+	}
+	++node[n].requests;
+	if (node[n].silent)
+	{
+		return 0;
+	}
+
+	queue[queued].envelope = *envelope;
+	queue[queued].envelope.source_endpoint = envelope->dest_endpoint;
+	queue[queued].envelope.dest_endpoint = envelope->source_endpoint;
+	rsp = queue[queued].payload;
+	rsp[0] = ZCL_FRAME_TYPE_PROFILE | ZCL_FRAME_SERVER_TO_CLIENT
+		| ZCL_FRAME_DISABLE_DEF_RESP;
+	rsp[1] = request[1];
+	length = 3;
+
+	if (node[n].reject)
+	{
+		rsp[2] = ZCL_CMD_DEFAULT_RESP;
+		rsp[length++] = ZCL_CMD_READ_ATTRIB;
+		rsp[length++] = node[n].reject;
+	}
+	else
+	{
+		// as many records as fit in the response
+		rsp[2] = ZCL_CMD_READ_ATTRIB_RESP;
+		for (i = 3; i < envelope->length; i += 2)
+		{
+			id = (uint16_t) (request[i] | request[i + 1] << 8);
+			if (unsupported( id))
+			{
+				if (length + 3 > RESPONSE_MAX)
+				{
+					break;
+				}
+				rsp[length++] = request[i];
+				rsp[length++] = request[i + 1];
+				rsp[length++] = ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+			}
+			else if (id == NAME_ID)
+			{
+				if (length + 5 + strlen( NAME) > RESPONSE_MAX)
+				{
+					break;
+				}
+				rsp[length++] = request[i];
+				rsp[length++] = request[i + 1];
+				rsp[length++] = ZCL_STATUS_SUCCESS;
+				rsp[length++] = ZCL_TYPE_STRING_CHAR;
+				rsp[length++] = (uint8_t) strlen( NAME);
+				memcpy( &rsp[length], NAME, strlen( NAME));
+				length += strlen( NAME);
+			}
+			else
+			{
+				if (length + 6 > RESPONSE_MAX)
+				{
+					break;
+				}
+				v = value( n, envelope->cluster_id, id);
+				rsp[length++] = request[i];
+				rsp[length++] = request[i + 1];
+				rsp[length++] = ZCL_STATUS_SUCCESS;
+				rsp[length++] = ZCL_TYPE_UNSIGNED_16BIT;
+				rsp[length++] = (uint8_t) v;
+				rsp[length++] = (uint8_t) (v >> 8);
+			}
+		}
+	}
+
+	queue[queued].envelope.payload = rsp;
+	queue[queued].envelope.length = (uint16_t) length;
+	++queued;
+	if (++node[n].in_flight > node[n].max_in_flight)
+	{
+		node[n].max_in_flight = node[n].in_flight;
+	}
+
+	return 0;
+}
+
+// deliver the responses queued so far (but not ones they cause)
+int node_tick( wpan_dev_t *wpan)
+{
+	int count = queued;
+	int i, n;
+
+	for (i = 0; i < count; ++i)
+	{
+		for (n = 0; n < NODES; ++n)
+		{
+			if (addr64_equal( &queue[i].envelope.ieee_address, &node[n].ieee))
+			{
+				--node[n].in_flight;
+			}
+		}
+		wpan_envelope_dispatch( &queue[i].envelope);
+	}
+	queued -= count;
+	memmove( queue, &queue[count], queued * sizeof queue[0]);
+
+	return count;
+}
+
+// read two clusters from each node
+void setup( void)
+{
+	int i;
+
+	memset( node, 0, sizeof node);
+	memset( &ep_state, 0, sizeof ep_state);
+	memset( reads, 0, sizeof reads);
+	queued = 0;
+
+	memset( &dev, 0, sizeof dev);
+	dev.tick = node_tick;
+	dev.endpoint_send = node_send;
+	dev.endpoint_table = endpoint_table;
+	dev.payload = 84;
+
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		attribute_list[i] = (uint16_t) i;
+	}
+	attribute_list[ATTRIBUTES] = ZCL_ATTRIBUTE_END_OF_LIST;
+
+	for (i = 0; i < NODES * 2; ++i)
+	{
+		node[i / 2].ieee.b[7] = (uint8_t) (i / 2 + 1);
+		reads[i].node.ieee = node[i / 2].ieee;
+		reads[i].node.network = WPAN_NET_ADDR_UNDEFINED;
+		reads[i].endpoint = REMOTE_EP;
+		reads[i].cluster_id = (uint16_t) (i % 2 ? 0x0006 : 0x0000);
+		reads[i].attribute_list = attribute_list;
+		reads[i].results = results[i];
+	}
+}
+
+// run the batch, giving up after a few seconds
+int run( void)
+{
+	uint32_t start = xbee_millisecond_timer();
+	int status;
+
+	do
+	{
+		status = zcl_batch_read_tick( &batch);
+		wpan_tick( &dev);
+	} while (status == -EBUSY && xbee_millisecond_timer() - start < 5000);
+
+	return status;
+}
+
+// count results for node <n> that don't match what it sent
+int check_node( int n)
+{
+	const zcl_batch_attr_t *attr;
+	int r, i, errors = 0;
+	uint16_t v;
+
+	for (r = n * 2; r < n * 2 + 2; ++r)
+	{
+		errors += reads[r].count != ATTRIBUTES;
+		for (attr = results[r], i = 0; i < ATTRIBUTES; ++attr, ++i)
+		{
+			v = value( n, reads[r].cluster_id, attr->id);
+			errors += attr->id != i;
+			if (unsupported( attr->id))
+			{
+				errors += attr->status != ZCL_STATUS_UNSUPPORTED_ATTRIBUTE;
+			}
+			else if (attr->id == NAME_ID)
+			{
+				errors += attr->status != ZCL_STATUS_SUCCESS
+					|| attr->type != ZCL_TYPE_STRING_CHAR
+					|| attr->length != 1 + strlen( NAME)
+					|| memcmp( &attr->value[1], NAME, strlen( NAME)) != 0;
+			}
+			else
+			{
+				errors += attr->status != ZCL_STATUS_SUCCESS
+					|| attr->type != ZCL_TYPE_UNSIGNED_16BIT
+					|| attr->length != 2
+					|| (attr->value[0] | attr->value[1] << 8) != v;
+			}
+		}
+	}
+
+	return errors;
+}
+
+void t_batch( void)
+{
+	int n, requests = 0;
+
+	setup();
+	test_compare( zcl_batch_read_start( &batch, &dev, &endpoint_table[0],
+		reads, NODES * 2), 0, NULL, "start");
+	test_compare( batch.per_request, (84 - 5) / 2, NULL, "fill payload");
+	test_compare( run(), 0, NULL, "result");
+
+	for (n = 0; n < NODES; ++n)
+	{
+		test_compare( check_node( n), 0, NULL, "results");
+		requests += node[n].requests;
+	}
+	test_compare( batch.succeeded + batch.failed, NODES * 2 * ATTRIBUTES,
+		NULL, "every attribute read");
+	test_compare( batch.failed, NODES * 2 * 10, NULL, "unsupported");
+	test_compare( batch.requests, requests, NULL, "requests counted");
+
+	// 40-byte responses hold 6 of these records, so 5 or 6 requests per
+	// cluster (and not one per attribute)
+	test_bool( requests <= NODES * 2 * 6, "few requests");
+	test_bool( batch.per_request < 10, "request size follows responses");
+	test_compare( node[0].max_in_flight, ZCL_BATCH_WINDOW, NULL,
+		"pipelined requests");
+}
+
+void t_rejected( void)
+{
+	int i, errors = 0;
+
+	setup();
+	node[1].reject = ZCL_STATUS_UNSUP_GENERAL_COMMAND;
+	zcl_batch_read_start( &batch, &dev, &endpoint_table[0], reads,
+		NODES * 2);
+	test_compare( run(), 0, NULL, "result");
+	test_compare( check_node( 0), 0, NULL, "node 0 results");
+	test_compare( check_node( 2), 0, NULL, "node 2 results");
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		errors += results[2][i].status != ZCL_STATUS_UNSUP_GENERAL_COMMAND;
+		errors += results[3][i].status != ZCL_STATUS_UNSUP_GENERAL_COMMAND;
+	}
+	test_compare( errors, 0, NULL, "node 1 rejected");
+}
+
+void t_timeout( void)
+{
+	int i, errors = 0;
+
+	// node's first requests hold all of its attributes, so they all time out
+	// together
+	setup();
+	node[0].silent = TRUE;
+	zcl_batch_read_start( &batch, &dev, &endpoint_table[0], reads,
+		NODES * 2);
+	batch.timeout = 1;
+	batch.retries = 0;
+	test_compare( run(), -ETIMEDOUT, NULL, "result");
+	test_compare( check_node( 1), 0, NULL, "node 1 results");
+	test_compare( check_node( 2), 0, NULL, "node 2 results");
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		errors += results[0][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+		errors += results[1][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+	}
+	test_compare( errors, 0, NULL, "node 0 timed out");
+	test_compare( batch.timeouts, 2 * ATTRIBUTES, NULL, "timeouts");
+}
+
+void t_resend_failed( void)
+{
+	int i, errors = 0;
+
+	// resends that can't be sent count against the retries
+	setup();
+	node[0].silent = TRUE;
+	zcl_batch_read_start( &batch, &dev, &endpoint_table[0], reads,
+		NODES * 2);
+	batch.timeout = 1;
+	batch.retries = 2;
+	zcl_batch_read_tick( &batch);
+	node[0].send_error = -EIO;
+	test_compare( run(), -ETIMEDOUT, NULL, "result");
+	test_compare( node[0].requests, 2, NULL, "only first requests sent");
+	test_compare( check_node( 1), 0, NULL, "node 1 results");
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		errors += results[0][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+		errors += results[1][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+	}
+	test_compare( errors, 0, NULL, "node 0 timed out");
+}
+
+void t_send_failed( void)
+{
+	int i, errors = 0;
+
+	// first sends that fail count against the retries too
+	setup();
+	node[0].send_error = -EIO;
+	zcl_batch_read_start( &batch, &dev, &endpoint_table[0], reads,
+		NODES * 2);
+	batch.retries = 2;
+	test_compare( run(), -ETIMEDOUT, NULL, "result");
+	test_compare( node[0].requests, 0, NULL, "nothing sent to node 0");
+	test_compare( check_node( 1), 0, NULL, "node 1 results");
+	test_compare( check_node( 2), 0, NULL, "node 2 results");
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		errors += results[0][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+		errors += results[1][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+	}
+	test_compare( errors, 0, NULL, "node 0 timed out");
+}
+
+void t_small_payload( void)
+{
+	setup();
+	dev.payload = 6;
+	test_compare( zcl_batch_read_start( &batch, &dev, &endpoint_table[0],
+		reads, NODES * 2), -EINVAL, NULL, "no room for an attribute ID");
+	dev.payload = 7;
+	test_compare( zcl_batch_read_start( &batch, &dev, &endpoint_table[0],
+		reads, NODES * 2), 0, NULL, "room for one attribute ID");
+	test_compare( batch.per_request, 1, NULL, "attributes per request");
+}
+
+int main( int argc, char *argv[])
+{
+	int failures = 0;
+
+	failures += DO_TEST( t_batch);
+	failures += DO_TEST( t_rejected);
+	failures += DO_TEST( t_timeout);
+	failures += DO_TEST( t_resend_failed);
+	failures += DO_TEST( t_send_failed);
+	failures += DO_TEST( t_small_payload);
+
+	return test_exit( failures);
+}
@@ -0,0 +1,349 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Unit tests for batched ZCL attribute writes against simulated nodes:
+// write records packed into each request, several requests in flight per
+// node, the single SUCCESS record when every write succeeds, per-attribute
+// errors, a node that never answers and values that can't be sent.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "xbee/platform.h"
+#include "wpan/aps.h"
+#include "zigbee/zcl.h"
+#include "zigbee/zcl_client.h"
+#include "../unittest.h"
+
+#define NODES			2
+#define ATTRIBUTES		20
+#define LOCAL_EP		0x01
+#define REMOTE_EP		0x0A
+#define PROFILE			0x0104
+#define CLUSTER			0x0006
+#define NAME_ID			0x0005
+#define NAME			"Digi XBee"
+
+// simulated remote node
+struct {
+	addr64		ieee;
+	bool_t		silent;			// never responds
+	bool_t		read_only;		// every fourth attribute is read-only
+	uint16_t	value[ATTRIBUTES];
+	char		name[sizeof NAME];
+	int			requests;		// Write Attributes requests received
+	int			in_flight;		// responses not yet delivered
+	int			max_in_flight;
+} node[NODES];
+
+// responses waiting to be delivered
+struct {
+	wpan_envelope_t	envelope;
+	uint8_t			payload[3 + 3 * ATTRIBUTES];
+} queue[16];
+int queued;
+
+wpan_dev_t dev;
+wpan_ep_state_t ep_state;
+const wpan_endpoint_table_entry_t endpoint_table[] = {
+	{ LOCAL_EP, PROFILE, zcl_batch_endpoint_handler, &ep_state, 0, 0, NULL },
+	WPAN_ENDPOINT_TABLE_END
+};
+
+uint16_t attribute_list[ATTRIBUTES + 1];
+zcl_batch_t batch;
+zcl_batch_write_t writes[NODES];
+zcl_batch_attr_t values[NODES][ATTRIBUTES];
+
+bool_t read_only( int n, uint16_t id)
+{
+	return node[n].read_only && id % 4 == 3;
+}
+
+uint16_t value( int n, uint16_t id)
+{
+	return (uint16_t) (n * 1000 + id * 7);
+}
+
+int node_send( const wpan_envelope_t FAR *envelope, uint16_t flags)
+{
+	const uint8_t *request = envelope->payload;
+	uint8_t *rsp;
+	int n, i, length;
+	uint16_t id;
+
+	for (n = 0; n < NODES; ++n)
+	{
+		if (addr64_equal( &envelope->ieee_address, &node[n].ieee))
+		{
+			break;
+		}
+	}
+	// ignore everything but Write Attributes (like Default Responses)
+	if (n == NODES || request[2] != ZCL_CMD_WRITE_ATTRIB)
+	{
+		return 0;
+	}
+	++node[n].requests;
+	if (node[n].silent)
+	{
+		return 0;
+	}
+
+	queue[queued].envelope = *envelope;
+	queue[queued].envelope.source_endpoint = envelope->dest_endpoint;
+	queue[queued].envelope.dest_endpoint = envelope->source_endpoint;
+	rsp = queue[queued].payload;
+	rsp[0] = ZCL_FRAME_TYPE_PROFILE | ZCL_FRAME_SERVER_TO_CLIENT
+		| ZCL_FRAME_DISABLE_DEF_RESP;
+	rsp[1] = request[1];
+	rsp[2] = ZCL_CMD_WRITE_ATTRIB_RESP;
+	length = 3;
+
+	// a status record for each attribute that can't be written
+	for (i = 3; i < envelope->length; )
+	{
+		id = (uint16_t) (request[i] | request[i + 1] << 8);
+		if (read_only( n, id))
+		{
+			rsp[length++] = ZCL_STATUS_READ_ONLY;
+			rsp[length++] = request[i];
+			rsp[length++] = request[i + 1];
+		}
+		else if (id == NAME_ID && request[i + 2] == ZCL_TYPE_STRING_CHAR)
+		{
+			memcpy( node[n].name, &request[i + 4], request[i + 3]);
+			node[n].name[request[i + 3]] = '\0';
+		}
+		else if (id < ATTRIBUTES && request[i + 2] == ZCL_TYPE_UNSIGNED_16BIT)
+		{
+			node[n].value[id] = (uint16_t) (request[i + 3]
+				| request[i + 4] << 8);
+		}
+		else
+		{
+			rsp[length++] = ZCL_STATUS_INVALID_DATA_TYPE;
+			rsp[length++] = request[i];
+			rsp[length++] = request[i + 1];
+		}
+		i += (request[i + 2] == ZCL_TYPE_STRING_CHAR)
+			? 4 + request[i + 3] : 5;
+	}
+	if (length == 3)
+	{
+		rsp[length++] = ZCL_STATUS_SUCCESS;
+	}
+
+	queue[queued].envelope.payload = rsp;
+	queue[queued].envelope.length = (uint16_t) length;
+	++queued;
+	if (++node[n].in_flight > node[n].max_in_flight)
+	{
+		node[n].max_in_flight = node[n].in_flight;
+	}
+
+	return 0;
+}
+
+// deliver the responses queued so far (but not ones they cause)
+int node_tick( wpan_dev_t *wpan)
+{
+	int count = queued;
+	int i, n;
+
+	for (i = 0; i < count; ++i)
+	{
+		for (n = 0; n < NODES; ++n)
+		{
+			if (addr64_equal( &queue[i].envelope.ieee_address, &node[n].ieee))
+			{
+				--node[n].in_flight;
+			}
+		}
+		wpan_envelope_dispatch( &queue[i].envelope);
+	}
+	queued -= count;
+	memmove( queue, &queue[count], queued * sizeof queue[0]);
+
+	return count;
+}
+
+// write one cluster on each node: a string and 16-bit values
+void setup( void)
+{
+	zcl_batch_attr_t *attr;
+	int n, i;
+	uint16_t v;
+
+	memset( node, 0, sizeof node);
+	memset( &ep_state, 0, sizeof ep_state);
+	memset( writes, 0, sizeof writes);
+	memset( values, 0, sizeof values);
+	queued = 0;
+
+	memset( &dev, 0, sizeof dev);
+	dev.tick = node_tick;
+	dev.endpoint_send = node_send;
+	dev.endpoint_table = endpoint_table;
+	dev.payload = 84;
+
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		attribute_list[i] = (uint16_t) i;
+	}
+	attribute_list[ATTRIBUTES] = ZCL_ATTRIBUTE_END_OF_LIST;
+
+	for (n = 0; n < NODES; ++n)
+	{
+		node[n].ieee.b[7] = (uint8_t) (n + 1);
+		writes[n].node.ieee = node[n].ieee;
+		writes[n].node.network = WPAN_NET_ADDR_UNDEFINED;
+		writes[n].endpoint = REMOTE_EP;
+		writes[n].cluster_id = CLUSTER;
+		writes[n].attribute_list = attribute_list;
+		writes[n].results = values[n];
+
+		for (attr = values[n], i = 0; i < ATTRIBUTES; ++attr, ++i)
+		{
+			if (i == NAME_ID)
+			{
+				attr->type = ZCL_TYPE_STRING_CHAR;
+				attr->length = 1 + strlen( NAME);
+				attr->value[0] = (uint8_t) strlen( NAME);
+				memcpy( &attr->value[1], NAME, strlen( NAME));
+			}
+			else
+			{
+				v = value( n, (uint16_t) i);
+				attr->type = ZCL_TYPE_UNSIGNED_16BIT;
+				attr->length = 2;
+				attr->value[0] = (uint8_t) v;
+				attr->value[1] = (uint8_t) (v >> 8);
+			}
+		}
+	}
+}
+
+// run the batch, giving up after a few seconds
+int run( void)
+{
+	uint32_t start = xbee_millisecond_timer();
+	int status;
+
+	do
+	{
+		status = zcl_batch_write_tick( &batch);
+		wpan_tick( &dev);
+	} while (status == -EBUSY && xbee_millisecond_timer() - start < 5000);
+
+	return status;
+}
+
+// count attributes of node <n> with the wrong status or value
+int check_node( int n)
+{
+	const zcl_batch_attr_t *attr;
+	int i, errors = 0;
+
+	errors += writes[n].count != ATTRIBUTES;
+	errors += strcmp( node[n].name, NAME) != 0;
+	for (attr = values[n], i = 0; i < ATTRIBUTES; ++attr, ++i)
+	{
+		errors += attr->id != i;
+		if (read_only( n, attr->id))
+		{
+			errors += attr->status != ZCL_STATUS_READ_ONLY;
+			errors += node[n].value[i] != 0;
+		}
+		else
+		{
+			errors += attr->status != ZCL_STATUS_SUCCESS;
+			if (i != NAME_ID)
+			{
+				errors += node[n].value[i] != value( n, (uint16_t) i);
+			}
+		}
+	}
+
+	return errors;
+}
+
+void t_batch( void)
+{
+	int n, requests = 0;
+
+	setup();
+	node[1].read_only = TRUE;
+	test_compare( zcl_batch_write_start( &batch, &dev, &endpoint_table[0],
+		writes, NODES), 0, NULL, "start");
+	test_compare( run(), 0, NULL, "result");
+
+	for (n = 0; n < NODES; ++n)
+	{
+		test_compare( check_node( n), 0, NULL, "results");
+		requests += node[n].requests;
+	}
+	test_compare( batch.succeeded, NODES * ATTRIBUTES - 5, NULL,
+		"attributes written");
+	test_compare( batch.failed, 5, NULL, "read-only attributes");
+	test_compare( batch.requests, requests, NULL, "requests counted");
+
+	// up to 79 bytes of 5-byte records (and one 13-byte string) per request
+	test_compare( node[0].requests, 2, NULL, "records packed");
+	test_compare( node[0].max_in_flight, ZCL_BATCH_WINDOW, NULL,
+		"pipelined requests");
+}
+
+void t_timeout( void)
+{
+	int i, errors = 0;
+
+	setup();
+	node[1].silent = TRUE;
+	zcl_batch_write_start( &batch, &dev, &endpoint_table[0], writes, NODES);
+	batch.timeout = 1;
+	batch.retries = 0;
+	test_compare( run(), -ETIMEDOUT, NULL, "result");
+	test_compare( check_node( 0), 0, NULL, "node 0 results");
+	for (i = 0; i < ATTRIBUTES; ++i)
+	{
+		errors += values[1][i].status != ZCL_BATCH_STATUS_TIMEOUT;
+	}
+	test_compare( errors, 0, NULL, "node 1 timed out");
+	test_compare( batch.timeouts, ATTRIBUTES, NULL, "timeouts");
+}
+
+void t_invalid( void)
+{
+	setup();
+	values[1][2].length = 1;
+	test_compare( zcl_batch_write_start( &batch, &dev, &endpoint_table[0],
+		writes, NODES), -EINVAL, NULL, "length doesn't match type");
+
+	setup();
+	dev.payload = 15;
+	test_compare( zcl_batch_write_start( &batch, &dev, &endpoint_table[0],
+		writes, NODES), -EINVAL, NULL, "value doesn't fit in a request");
+	dev.payload = 18;
+	test_compare( zcl_batch_write_start( &batch, &dev, &endpoint_table[0],
+		writes, NODES), 0, NULL, "value fits");
+	test_compare( run(), 0, NULL, "result");
+	// the string alone, then two 16-bit values per request
+	test_compare( node[0].requests, 1 + (ATTRIBUTES - 1 + 1) / 2, NULL,
+		"requests");
+	test_compare( check_node( 0), 0, NULL, "node 0 results");
+}
+
+int main( int argc, char *argv[])
+{
+	int failures = 0;
+
+	failures += DO_TEST( t_batch);
+	failures += DO_TEST( t_timeout);
+	failures += DO_TEST( t_invalid);
+
+	return test_exit( failures);
+}
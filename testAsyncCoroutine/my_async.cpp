@@ -0,0 +1,69 @@
+#include <cinttypes>
+#include <cstdio>
+
+#include "platform_config.h"
+#include "xbee/async.hpp"
+
+const uint32_t  BAUD_RATE = 921600;
+const char  SERIAL_DEVICE_ID[] = "/dev/ttyS0";
+
+// Read a couple of registers, then broadcast a few messages and print
+// anything received, all written as straight-line code.
+xbee::Task<> talk(xbee::AsyncDevice &dev)
+{
+    xbee::AtResult np = co_await dev.at("NP");
+    if (np.status)
+    {
+        printf("Error reading NP: %d\n", np.status);
+        co_return;
+    }
+    printf("Maximum payload is %" PRIu32 " bytes\n", np.value);
+
+    for (int i = 0; i < 3; i++)
+    {
+        char payload[32];
+        int length = snprintf(payload, sizeof payload, "Payload %d\r\n", i);
+
+        xbee::SendResult sent = co_await dev.send(xbee::TransmitExplicit(),
+            xbee::span<const uint8_t>(reinterpret_cast<uint8_t *>(payload), length));
+        printf("Payload %d: status %d, delivery 0x%02x\n", i, sent.status, sent.delivery);
+    }
+
+    while (std::optional<xbee::Received> rx = co_await dev.receive(5000))
+    {
+        printf("Received %zu bytes on cluster 0x%04x\n", rx->payload.size(), rx->cluster_id);
+    }
+    printf("Nothing received for 5 seconds\n");
+}
+
+// Runs concurrently with talk() on the same thread
+xbee::Task<> watch_rssi(xbee::AsyncDevice &dev)
+{
+    for (int i = 0; i < 5; i++)
+    {
+        xbee::AtResult db = co_await dev.at("DB");
+        if (db.status == 0)
+        {
+            printf("Last RSSI: -%" PRIu32 " dBm\n", db.value);
+        }
+    }
+}
+
+int main()
+{
+    xbee::EventLoop loop;
+    xbee::AsyncDevice dev(loop);
+
+    int err = dev.open(SERIAL_DEVICE_ID, BAUD_RATE);
+    if (err)
+    {
+        printf("Error initializing device: %d\n", err);
+        return EXIT_FAILURE;
+    }
+
+    loop.spawn(talk(dev));
+    loop.spawn(watch_rssi(dev));
+    loop.run();
+
+    return EXIT_SUCCESS;
+}
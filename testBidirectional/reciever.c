@@ -7,6 +7,9 @@
 #include "xbee/device.h"
 #include "xbee/atcmd.h"
 #include "xbee/wpan.h"
+#include "xbee/pool.h"
+#include "xbee/telemetry.h"
+#include "xbee/shm_bus.h"
 #include "platform_config.h"
 
 #define MAX_PAYLOAD_SIZE 100
@@ -14,6 +17,8 @@
 #define BAUD_RATE 921600
 #define SERIAL_DEVICE_ID "/dev/ttyS0"
 #define TEST_MESSAGES_SRC "random_text.txt"
+#define TELEMETRY_FILE "telemetry.xbt"
+#define FRAME_BUS_NAME "/xbee_ttyS0"
 
 // Local Functions
 xbee_serial_t init_serial();
@@ -28,8 +33,25 @@ static int receive_handler(xbee_dev_t *xbee, const void FAR *raw,
 int num_msgs_rx = 0;
 char* recieved_msgs[NUM_EXPECTED_MESSAGES] = {NULL};
 char* expected_msgs[NUM_EXPECTED_MESSAGES] = {NULL};
+
+// Fixed blocks for expected and received messages (payload + null terminator)
+static XBEE_POOL_STORAGE(msg_space, MAX_PAYLOAD_SIZE + 1,
+                         2 * NUM_EXPECTED_MESSAGES);
+static xbee_pool_t msg_pool;
+
+// Telemetry records are stored instead of counted as messages.  The store
+// is created when the first record arrives.
+static xbee_telemetry_t telemetry;
+static int telemetry_open = 0;
+static int store_telemetry(const xbee_telemetry_record_t *record);
+
+// Every received frame is also published for local consumers (dashboard,
+// logger, ...) that attach with xbee_shm_bus_attach(FRAME_BUS_NAME).
+static xbee_shm_bus_t frame_bus;
+
 static volatile sig_atomic_t terminationflag = 0;
 const xbee_dispatch_table_entry_t xbee_frame_handlers[] = {
+    XBEE_SHM_BUS_FRAME_HANDLER(&frame_bus),
     {XBEE_FRAME_RECEIVE, 0, receive_handler, NULL},
     XBEE_FRAME_HANDLE_LOCAL_AT,
     XBEE_FRAME_TABLE_END};
@@ -38,13 +60,25 @@ int main(int argc, char **argv)
 {
   xbee_serial_t serial = init_serial();
   xbee_dev_t my_xbee;
+  int status = EXIT_FAILURE;
+
+  // Create the bus before any frames can arrive
+  int err = xbee_shm_bus_create(&frame_bus, FRAME_BUS_NAME, 0);
+  if (err)
+  {
+    printf("Error creating frame bus: %s\n", strerror(-err));
+    return EXIT_FAILURE;
+  }
+
+  // From here on, failures go through the cleanup at the end of main()
+  xbee_pool_init(&msg_pool, msg_space, sizeof msg_space, MAX_PAYLOAD_SIZE + 1);
 
   // Dump state to stdout for debug
-  int err = xbee_dev_init(&my_xbee, &serial, NULL, NULL, xbee_frame_handlers);
+  err = xbee_dev_init(&my_xbee, &serial, NULL, NULL, xbee_frame_handlers);
   if (err)
   {
     printf("Error initializing abstraction: %" PRIsFAR "\n", strerror(-err));
-    return EXIT_FAILURE;
+    goto cleanup;
   }
   printf("Initialized XBee device abstraction...\n");
   
@@ -53,7 +87,7 @@ int main(int argc, char **argv)
   if (err)
   {
     printf("Error initializing AT layer: %" PRIsFAR "\n", strerror(-err));
-    return EXIT_FAILURE;
+    goto cleanup;
   }
   
   printf( "Waiting for driver to query the XBee device...\n");
@@ -73,7 +107,7 @@ int main(int argc, char **argv)
   if (signal(SIGTERM, sigterm) == SIG_ERR || signal(SIGINT, sigterm) == SIG_ERR)
   {
     printf("Error setting signal handler\n");
-    return EXIT_FAILURE;
+    goto cleanup;
   }
   printf("Set SIGINT handler\n");
 
@@ -82,7 +116,7 @@ int main(int argc, char **argv)
   if (err != 0)
   {
     printf("Could not read all expected messages from file source");
-    return EXIT_FAILURE;
+    goto cleanup;
   }
   printf("Loaded expected messages from file\n");
   
@@ -99,12 +133,12 @@ int main(int argc, char **argv)
     if (terminationflag)
     {
       printf("Recieved SIGINT while waiting ticking device. Exiting\n");
-      return EXIT_FAILURE;
+      goto cleanup;
     }
     if (err < 0)
     {
       printf("ERROR: Could not tick device: %" PRIsFAR "\n", strerror(-err));
-      return EXIT_FAILURE;
+      goto cleanup;
     }
   }
 
@@ -114,24 +148,30 @@ int main(int argc, char **argv)
   if (err < 0)
   {
     printf("ERROR: Could not tick device: %" PRIsFAR "\n", strerror(-err));
-    return EXIT_FAILURE;
+    goto cleanup;
   }
 
   // Summary
   printf("\nExpected number of messages: %d\n", NUM_EXPECTED_MESSAGES);
   printf("Number of messages recieved: %d\n\n", num_msgs_rx);
+  status = EXIT_SUCCESS;
+
+cleanup:
+  if (telemetry_open)
+  {
+    xbee_telemetry_close(&telemetry);
+    printf("Saved telemetry to %s\n", TELEMETRY_FILE);
+  }
 
   // Cleanup Allocations
   for (int i = 0; i < NUM_EXPECTED_MESSAGES; i++)
   {
-    if (expected_msgs[i] != NULL) {
-      free(expected_msgs[i]);
-    }
-    if (recieved_msgs[i]) {
-      free(recieved_msgs[i]);
-    }
+    xbee_pool_free(&msg_pool, expected_msgs[i]);
+    xbee_pool_free(&msg_pool, recieved_msgs[i]);
   }
+  xbee_shm_bus_destroy(&frame_bus);
   printf("Finished clean up\n");
+  return status;
 }
 
 static int receive_handler(xbee_dev_t *xbee, const void FAR *raw,
@@ -159,18 +199,31 @@ static int receive_handler(xbee_dev_t *xbee, const void FAR *raw,
   }
 
   int payload_len = frame_len - offsetof(xbee_frame_receive_t, payload);
+  xbee_telemetry_record_t record;
+  if (xbee_telemetry_decode(frame->payload, payload_len, &record) == 0)
+  {
+    return store_telemetry(&record);
+  }
+
   // if (frame->payload[payload_len-1] != '\0') {
   //   printf("Recieved message not null terminated\n");
   //   return -EBADMSG;
   // }
   
-  recieved_msgs[num_msgs_rx] = malloc((payload_len) * sizeof(char));
+  if (payload_len > MAX_PAYLOAD_SIZE || num_msgs_rx >= NUM_EXPECTED_MESSAGES)
+  {
+    printf("Recieved unexpected message\n");
+    return -EBADMSG;
+  }
+  
+  recieved_msgs[num_msgs_rx] = xbee_pool_alloc(&msg_pool);
   if (recieved_msgs[num_msgs_rx] == NULL) {
     printf("Could not allocate memory for recieved message\n");
     return -ENOMEM;
   }
   
-  strncpy(recieved_msgs[num_msgs_rx], (char *) frame->payload, payload_len);
+  memcpy(recieved_msgs[num_msgs_rx], frame->payload, payload_len);
+  recieved_msgs[num_msgs_rx][payload_len] = '\0';
   num_msgs_rx++;
   printf("Recieved message #%d\n", num_msgs_rx);
   return EXIT_SUCCESS;
@@ -187,7 +240,7 @@ static int get_expected_messages(char *messages[], int max_num_messages)
     return EXIT_FAILURE;
   }
 
-  // Dyn allocate an array of char* with length num_msgs
+  // Copy each line into a block from the message pool
   for (int i = 0; i < max_num_messages; i++)
   {
     char msg[MAX_PAYLOAD_SIZE];
@@ -195,12 +248,39 @@ static int get_expected_messages(char *messages[], int max_num_messages)
     {
       return EXIT_FAILURE;
     }
-    messages[i] = malloc(strlen(msg) * sizeof(char));
+    messages[i] = xbee_pool_alloc(&msg_pool);
+    if (messages[i] == NULL)
+    {
+      return EXIT_FAILURE;
+    }
     strcpy(messages[i], msg);
   }
   return 0;
 }
 
+static int store_telemetry(const xbee_telemetry_record_t *record)
+{
+  int err;
+
+  if (!telemetry_open)
+  {
+    err = xbee_telemetry_create(&telemetry, TELEMETRY_FILE, record->channels);
+    if (err)
+    {
+      printf("Could not create %s: %s\n", TELEMETRY_FILE, strerror(-err));
+      return err;
+    }
+    telemetry_open = 1;
+  }
+
+  err = xbee_telemetry_append(&telemetry, record);
+  if (err)
+  {
+    printf("Dropped telemetry record: %s\n", strerror(-err));
+  }
+  return err;
+}
+
 static void sigterm(int sig)
 {
   signal(sig, sigterm);
@@ -10,6 +10,9 @@
 #include "platform_config.h"
 #include "xbee_baja_init.h"
 
+// Set once the XBee reports the status of our broadcast
+static volatile bool_t tx_status_received = FALSE;
+
 // Custom frame handlers
 int tx_status_handler(xbee_dev_t *xbee,
                       const void FAR *raw, uint16_t length, void FAR *context)
@@ -19,6 +22,7 @@ int tx_status_handler(xbee_dev_t *xbee,
   XBEE_UNUSED_PARAMETER(length);
   XBEE_UNUSED_PARAMETER(context);
   printf("TX Status: id %d, delivery=0x%02x\n", frame->frame_id, frame->delivery);
+  tx_status_received = TRUE;
   return 0;
 }
 
@@ -26,19 +30,26 @@ int tx_status_handler(xbee_dev_t *xbee,
 const xbee_dispatch_table_entry_t xbee_frame_handlers[] = {
     {XBEE_FRAME_TRANSMIT_STATUS, 0, tx_status_handler, NULL},
     XBEE_FRAME_HANDLE_LOCAL_AT,
+    XBEE_FRAME_HANDLE_REMOTE_AT,
     XBEE_FRAME_TABLE_END};
 
 int main(int argc, char **argv)
 {
   // Test the initialization function
   xbee_dev_t my_xbee;
-  int err = init_baja_xbee(&my_xbee);
+  int err = init_baja_xbee(&my_xbee, xbee_frame_handlers);
   if (err)
   {
     printf("Error initializing XBee with baja settings.\n");
     return EXIT_FAILURE;
   }
 
+  // Any arguments are 64-bit addresses of remote XBees to configure
+  if (argc > 1)
+  {
+    return configure_baja_fleet(&my_xbee, argv + 1, argc - 1);
+  }
+
   // Send a broadcast message to make sure the XBee is working
   char payload[] = "First payload!\r\n";
   xbee_header_transmit_explicit_t frame_out_header = {
@@ -70,10 +81,11 @@ int main(int argc, char **argv)
   printf("Successfully wrote frame!\n\n");
   
   printf("Ticking XBee to get TX status...\n");
+  // (responses to the background query can arrive first)
   while (1)
   {
-      err = xbee_dev_tick(&my_xbee);
-      if (err >= 1)
+      err = tick_baja_xbee(&my_xbee);
+      if (tx_status_received)
       {
           printf("Read a frame from the XBee!\n");
           return EXIT_SUCCESS;
@@ -1,15 +1,12 @@
 #ifndef XBEE_BAJA_CONFIGS_H
 #define XBEE_BAJA_CONFIGS_H
 
-struct cmd {
-    const char* name;
-    const int value;
-};
+#include "xbee/config_apply.h"
 
 static const long XBEE_BAJA_CM = 0x3FFFFFFFFFFFF; // Channel mask
 static const int XBEE_BAJA_BD = 921600; // Channel mask
 
-static const struct cmd XBEE_BAJA_CONFIGS[] = {
+static const xbee_config_setting_t XBEE_BAJA_CONFIGS[] = {
     {"HP", 0},
     {"TX", 2},
     {"BR", 1},
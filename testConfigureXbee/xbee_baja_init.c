@@ -15,11 +15,17 @@
 #include "xbee/device.h"
 #include "xbee/atcmd.h"
 #include "xbee/wpan.h"
+#include "xbee/config_apply.h"
+#include "xbee/config_fleet.h"
+#include "xbee/device_cache.h"
 #include "xbee_baja_config.h"
 #include "serial_port_config.h"
 #include "xbee_baja_init.h"
 #include "platform_config.h"
 
+// Set by init_baja_xbee() until the query cache has been saved.
+static bool_t cache_pending = FALSE;
+
 xbee_serial_t _init_serial()
 {
   // We want to start with a clean slate
@@ -33,26 +39,50 @@ xbee_serial_t _init_serial()
 }
 
 /** Write Baja XBee standard firmware settins to the XBee.
- *  to the Baja standard. This function will return none
- *  zero if the XBee does not conform to the standard.
+ *  Every register is read first and only the ones that differ from
+ *  the Baja standard are written, so WR (and its flash wear) is
+ *  skipped when the XBee is already configured. This function will
+ *  return none zero if the XBee does not conform to the standard.
  */
 int _write_baja_settings(xbee_dev_t *xbee)
 {
+  static xbee_config_apply_t apply;
+  xbee_config_result_t results[sizeof XBEE_BAJA_CONFIGS / sizeof XBEE_BAJA_CONFIGS[0]];
   int err;
   // TODO: set channel mask (CM), which doesn't have a 32-bit value?
 
-  for (int i = 0; i < sizeof XBEE_BAJA_CONFIGS / sizeof XBEE_BAJA_CONFIGS[0]; i++) {
-    do {
-      err = xbee_cmd_simple(xbee, XBEE_BAJA_CONFIGS[i].name, XBEE_BAJA_CONFIGS[i].value);
-    } while (err == -EBUSY);
-    if (err == -EINVAL) {
-      printf("Error sending %s command. Invalid parameter\n", XBEE_BAJA_CONFIGS[i].name);
-      return EXIT_FAILURE;
+  err = xbee_config_apply_start(&apply, xbee, XBEE_BAJA_CONFIGS, results,
+                                sizeof XBEE_BAJA_CONFIGS / sizeof XBEE_BAJA_CONFIGS[0],
+                                NULL, 0);
+  if (err)
+  {
+    printf("Error starting configuration: %" PRIsFAR "\n", strerror(-err));
+    return EXIT_FAILURE;
+  }
+  do
+  {
+    tick_baja_xbee(xbee);
+    err = xbee_config_apply_tick(&apply);
+  } while (err == -EBUSY);
+
+  for (int i = 0; i < apply.count; i++) {
+    switch (results[i].status) {
+    case XBEE_CONFIG_MATCHED:
+      printf("%s already %" PRIu32 "\n", XBEE_BAJA_CONFIGS[i].command, XBEE_BAJA_CONFIGS[i].value);
+      break;
+    case XBEE_CONFIG_CHANGED:
+      printf("Set %s to %" PRIu32 " (was %" PRIu32 ")\n", XBEE_BAJA_CONFIGS[i].command,
+             XBEE_BAJA_CONFIGS[i].value, results[i].previous);
+      break;
+    default:
+      printf("Error setting %s (status 0x%02x)\n", XBEE_BAJA_CONFIGS[i].command, results[i].at_status);
+      break;
     }
-    printf("Set %s to %d\n", XBEE_BAJA_CONFIGS[i].name, XBEE_BAJA_CONFIGS[i].value);
   }
-  xbee_cmd_execute(xbee, "WR", NULL, 0);
-  return EXIT_SUCCESS;
+  printf("%u of %u settings changed%s\n", apply.changed, apply.count,
+         (apply.flags & XBEE_CONFIG_FLAG_SAVED) ? ", saved with WR" : "");
+
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 
@@ -72,6 +102,13 @@ int init_baja_xbee(xbee_dev_t *xbee, const xbee_dispatch_table_entry_t* xbee_fra
   }
   printf("Initialized XBee device abstraction.\n");
 
+  // Use the values saved from the last run (if the same XBee is attached)
+  // so we don't block on a full query; they're revalidated in the background.
+  if (xbee_dev_cache_load(xbee, NULL) == 0)
+  {
+    printf("Loaded cached XBee settings.\n");
+  }
+
   // Need to initialize AT layer so we can transmit
   err = xbee_cmd_init_device(xbee);
   if (err)
@@ -79,6 +116,8 @@ int init_baja_xbee(xbee_dev_t *xbee, const xbee_dispatch_table_entry_t* xbee_fra
     printf("Error initializing AT layer: %" PRIsFAR "\n", strerror(-err));
     return EXIT_FAILURE;
   }
+  // Returns as soon as cached values are loaded; otherwise waits for the
+  // full query.
   do
   {
     xbee_dev_tick(xbee);
@@ -88,6 +127,7 @@ int init_baja_xbee(xbee_dev_t *xbee, const xbee_dispatch_table_entry_t* xbee_fra
   {
     printf("Error %d waiting for AT init to complete.\n", err);
   }
+  cache_pending = TRUE;
 
   printf("Initialized XBee AT layer\n");
   xbee_dev_dump_settings(xbee, XBEE_DEV_DUMP_FLAG_DEFAULT);
@@ -99,7 +139,98 @@ int init_baja_xbee(xbee_dev_t *xbee, const xbee_dispatch_table_entry_t* xbee_fra
     printf("Xbee settings were not verified\n");
     return EXIT_FAILURE;
   }
-  xbee_dev_tick(xbee);
+  tick_baja_xbee(xbee);
+
   printf("XBee settings conform to Baja standards\n\n");
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+
+/**
+ * Tick the XBee.  Once the query started by init_baja_xbee() has read the
+ * values from the XBee itself (revalidating the cache in the background),
+ * save them to the cache for the next run.
+ */
+int tick_baja_xbee(xbee_dev_t *xbee)
+{
+  int err = xbee_dev_tick(xbee);
+
+  if (cache_pending
+      && !(xbee->flags & (XBEE_DEV_FLAG_QUERY_CACHED
+                          | XBEE_DEV_FLAG_QUERY_INPROGRESS)))
+  {
+    cache_pending = FALSE;
+    if (!(xbee->flags & XBEE_DEV_FLAG_QUERY_DONE))
+    {
+      printf("XBee query failed, not saving settings cache\n");
+    }
+    else if (xbee_dev_cache_save(xbee, NULL) != 0)
+    {
+      printf("Unable to save XBee settings cache\n");
+    }
+  }
+
+  return err;
+}
+
+
+/**
+ * Apply the Baja standard settings to remote XBees (given as 64-bit
+ * addresses, e.g. "0013A200-40A1B2C3"), all configured concurrently
+ * through the local XBee.  Prints a report of what changed on each node.
+ */
+int configure_baja_fleet(xbee_dev_t *xbee, char *const addresses[], int count)
+{
+  enum { SETTING_COUNT = sizeof XBEE_BAJA_CONFIGS / sizeof XBEE_BAJA_CONFIGS[0] };
+  static xbee_config_fleet_t fleet;
+  xbee_config_node_t *nodes;
+  xbee_config_result_t *results;
+  int err;
+
+  if (count <= 0 || count > 255)
+  {
+    printf("Can only configure 1 to 255 remote XBees\n");
+    return EXIT_FAILURE;
+  }
+  nodes = calloc(count, sizeof *nodes);
+  results = calloc((size_t) count * SETTING_COUNT, sizeof *results);
+  if (nodes == NULL || results == NULL)
+  {
+    free(nodes);
+    free(results);
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    if (addr64_parse(&nodes[i].ieee, addresses[i]))
+    {
+      printf("Invalid address: %s\n", addresses[i]);
+      free(nodes);
+      free(results);
+      return EXIT_FAILURE;
+    }
+    nodes[i].results = &results[i * SETTING_COUNT];
+  }
+
+  err = xbee_config_fleet_start(&fleet, xbee, XBEE_BAJA_CONFIGS, SETTING_COUNT,
+                                nodes, count, 0);
+  if (!err)
+  {
+    printf("Configuring %d remote XBees...\n", count);
+    do
+    {
+      tick_baja_xbee(xbee);
+      err = xbee_config_fleet_tick(&fleet);
+    } while (err == -EBUSY);
+    xbee_config_fleet_report(&fleet);
+  }
+  else
+  {
+    printf("Error starting fleet configuration: %" PRIsFAR "\n", strerror(-err));
+  }
+
+  free(nodes);
+  free(results);
+  return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
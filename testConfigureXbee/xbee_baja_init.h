@@ -4,5 +4,7 @@
 #include "xbee/device.h"
 
 int init_baja_xbee(xbee_dev_t *xbee, const xbee_dispatch_table_entry_t* xbee_frame_handlers);
+int tick_baja_xbee(xbee_dev_t *xbee);
+int configure_baja_fleet(xbee_dev_t *xbee, char *const addresses[], int count);
 
 #endif
@@ -4,9 +4,11 @@
 #include <stdint.h>
 #include <signal.h>
 #include <unistd.h>
+#include "xbee/byteorder.h"
 #include "xbee/device.h"
 #include "xbee/atcmd.h"
 #include "xbee/wpan.h"
+#include "xbee/link_adapt.h"
 #include "platform_config.h"
 
 uint32_t BAUD_RATE = 921600;
@@ -14,6 +16,9 @@ char SERIAL_DEVICE_ID[] = "/dev/ttyS0";
 int const MAX_PAYLOAD_SIZE = 100;
 char TEST_MESSAGES_SRC[] = "random_text.txt";
 
+// Unicast destination; pass another IEEE address as the first argument
+addr64 collector = {{0, 0, 0, 0, 0, 0, 0, 0}}; // the coordinator
+
 // Local Functions
 xbee_serial_t init_serial();
 static void sigterm(int sig);
@@ -24,9 +29,11 @@ static int receive_handler(xbee_dev_t *xbee, const void FAR *raw,
 
 // Shared Variables. NOTE: There are better receive handlers in wpan.h
 static volatile sig_atomic_t terminationflag = 0;
+static xbee_link_adapt_t link_adapt;
 const xbee_dispatch_table_entry_t xbee_frame_handlers[] = {
     {XBEE_FRAME_RECEIVE_EXPLICIT, 0, receive_handler, NULL},
     {XBEE_FRAME_TRANSMIT_STATUS, 0, tx_status_handler, NULL},
+    XBEE_LINK_ADAPT_FRAME_HANDLE_TRANSMIT_STATUS(&link_adapt),
     XBEE_FRAME_HANDLE_LOCAL_AT,
     XBEE_FRAME_TABLE_END};
 
@@ -36,6 +43,12 @@ int main(int argc, char **argv)
   xbee_serial_t serial = init_serial();
   xbee_dev_t my_xbee;
 
+  if (argc > 1 && addr64_parse(&collector, argv[1]))
+  {
+    printf("Invalid collector address: %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
   // Dump state to stdout for debug
   err = xbee_dev_init(&my_xbee, &serial, NULL, NULL, xbee_frame_handlers);
   if (err)
@@ -56,8 +69,7 @@ int main(int argc, char **argv)
   xbee_header_transmit_explicit_t frame_out_header = {
       .frame_type = XBEE_FRAME_TRANSMIT_EXPLICIT,
       .frame_id = 0,
-      .ieee_address = *WPAN_IEEE_ADDR_BROADCAST,
-      .network_address_be = 0xFFFE, // Possibly wrong. Reserved?
+      .network_address_be = htobe16(WPAN_NET_ADDR_UNDEFINED),
       .source_endpoint = WPAN_ENDPOINT_DIGI_DATA,
       .dest_endpoint = WPAN_ENDPOINT_DIGI_DATA,
       .cluster_id_be = DIGI_CLUST_SERIAL,
@@ -74,36 +86,54 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
-  // Send messages & tick XBEE
-  int frame_id = 0;
+  // Send messages at the rate and size the link can currently carry
+  xbee_link_adapt_init(&link_adapt, &my_xbee);
+  int frame_count = 0;
   char payload[MAX_PAYLOAD_SIZE + 1];
-  while (fgets(payload, MAX_PAYLOAD_SIZE + 1, messages) != NULL)
+  while (!terminationflag)
   {
-    // Send the next message, but don't forget to update the header
-    frame_id++;
-    printf("Sending message number: %d\n", frame_id);
-    frame_out_header.frame_id = frame_id;
-    err = xbee_frame_write(&my_xbee, &frame_out_header,
-                           sizeof frame_out_header, &payload, sizeof payload, 0);
-    if (err < 0)
+    // Tick to get TX status updates until the next send is due
+    int length;
+    while ((length = xbee_link_adapt_due(&link_adapt)) == 0)
     {
-      printf("Error writing frame: %" PRIsFAR "\n", strerror(-err));
+      err = xbee_dev_tick(&my_xbee);
+      if (err < 0)
+      {
+        printf("ERROR: Could not tick device: %" PRIsFAR "\n", strerror(-err));
+        return EXIT_FAILURE;
+      }
+      xbee_link_adapt_tick(&link_adapt);
+      usleep(1000);
     }
-
-    usleep(100000);
-    // Tick to get TX status updates
-    err = xbee_dev_tick(&my_xbee);
-    if (terminationflag)
+    if (length > MAX_PAYLOAD_SIZE)
     {
-      printf("Recieved SIGINT while waiting ticking device. Exiting\n");
-      return EXIT_FAILURE;
+      length = MAX_PAYLOAD_SIZE;
     }
+    if (fgets(payload, length + 1, messages) == NULL)
+    {
+      break;
+    }
+
+    // Send the next message, but don't forget to update the header.
+    // Unicast to the collector unless link adaptation has given up on it.
+    frame_count++;
+    printf("Sending message number: %d%s\n", frame_count,
+           link_adapt.broadcast ? " (broadcast)" : "");
+    frame_out_header.ieee_address = link_adapt.broadcast ?
+        *WPAN_IEEE_ADDR_BROADCAST : collector;
+    frame_out_header.frame_id = xbee_next_frame_id(&my_xbee);
+    err = xbee_frame_write(&my_xbee, &frame_out_header,
+                           sizeof frame_out_header, payload, strlen(payload), 0);
     if (err < 0)
     {
-      printf("ERROR: Could not tick device: %" PRIsFAR "\n", strerror(-err));
-      return EXIT_FAILURE;
+      printf("Error writing frame: %" PRIsFAR "\n", strerror(-err));
     }
   }
+  if (terminationflag)
+  {
+    printf("Recieved SIGINT while waiting ticking device. Exiting\n");
+    return EXIT_FAILURE;
+  }
 
   // Cleanup
   usleep(1000000);
@@ -118,7 +148,8 @@ int main(int argc, char **argv)
   // Summary
   printf("\n");
   printf("Could not read more from message source.\n");
-  printf("Sent %d messages!\n", frame_id);
+  printf("Sent %d messages!\n", frame_count);
+  xbee_link_adapt_dump(&link_adapt);
 }
 
 static int receive_handler(xbee_dev_t *xbee, const void FAR *raw,